@@ -13,6 +13,8 @@
 #include "modelparameters.h"
 #include "macro_numerical.h"
 #include "modelfunctions.h"
+#include "MCMC_priors.h"
+#include "init_gpu.h"
 
 using namespace std;
 
@@ -21,45 +23,6 @@ namespace Cudimot{
 #define VOXELS_BLOCK 8
 #define THREADS_VOXEL 32 // Multiple of 32: Threads collaborating to compute a voxel. Do not change this, otherwise Synchronization will be needed and shuffles cannot be used
   
-  // Returns the natural log of the 0th order modified Bessel function of first kind for an argument x
-  // Follows the exponential implementation of the Bessel function in Numerical Recipes, Ch. 6
-  __device__ inline float logIo(const float x){
-    float y,b;
-    b=fabsf(x);
-    if (b<3.75f){
-      float a=x/3.75f;
-      a*=a;
-      //Bessel function evaluation
-      y=1.0f+a*(3.5156229f+a*(3.0899424f+a*(1.2067492f+a*(0.2659732f+a*(0.0360768f+a*0.0045813f)))));
-      y=logf(y);
-    }else{
-      float a=3.75f/b; 
-      //Logarithm of Bessel function
-      y=b+logf((0.39894228f+a*(0.01328592f+a*(0.00225319f+a*(-0.00157565f+a*(0.00916281f+a*(-0.02057706f+a*(0.02635537f+a*(-0.01647633f+a*0.00392377f))))))))/sqrt(b));
-    }
-    return y;
-  }
-  
-  // Version for Double precision
-  __device__ inline double logIo(const double x){
-    double y,b;
-    b=fabs(x);
-    if (b<3.75){
-      double a=x/3.75;
-      a*=a;
-      //Bessel function evaluation
-      y=1.0+a*(3.5156229+a*(3.0899424+a*(1.2067492+a*(0.2659732+a*(0.0360768+a*0.0045813)))));
-      y=log(y);
-    }
-    else{
-      double a=3.75/b; 
-      //Logarithm of Bessel function
-      y=b+log((0.39894228+a*(0.01328592+a*(0.00225319+a*(-0.00157565+a*(0.00916281+a*(-0.02057706+a*(0.02635537+a*(-0.01647633+a*0.00392377))))))))/sqrt(b));
-    }
-    return y;
-  }
-
-
   template <typename T, bool RICIAN_NOISE>
   __device__ inline  void Compute_BIC_AIC(int idSubVOX,
 					  int nmeas,
@@ -77,9 +40,11 @@ namespace Cudimot{
     if (idSubVOX<(nmeas%THREADS_VOXEL)) nmeas2compute++;
     
     T accumulated_error=(T)0.0;
+    T cache[CACHE_SIZE];
+    Prepare_Voxel(parameters,FixP,cache);
     for(int dir=0;dir<nmeas2compute;dir++){
       T* myCFP = &CFP[idMeasurement*CFP_Tsize];
-      T pred_error=Predicted_Signal(NPARAMS,parameters,myCFP,FixP);
+      T pred_error=Predicted_Signal(NPARAMS,parameters,myCFP,FixP,cache);
 
       if(RICIAN_NOISE){
 	T meas = measurements[idMeasurement];
@@ -220,7 +185,25 @@ namespace Cudimot{
 		   T* CFP, T* FixP,
 		   T* BIC,
 		   T* AIC,
-		   T* tau_samples) 
+		   T* tau_samples)
+  {
+    if(cpu_backend()){
+      run_cpu(nvox,nmeas,nsamples,CFP_size,FixP_size,meas,samples,CFP,FixP,BIC,AIC,tau_samples);
+    }else{
+      run_gpu(nvox,nmeas,nsamples,CFP_size,FixP_size,meas,samples,CFP,FixP,BIC,AIC,tau_samples);
+    }
+  }
+
+  template <typename T>
+  void BIC_AIC<T>::run_gpu(
+		   int nvox, int nmeas, int nsamples,
+		   int CFP_size, int FixP_size,
+		   T* meas,
+		   T* samples,
+		   T* CFP, T* FixP,
+		   T* BIC,
+		   T* AIC,
+		   T* tau_samples)
   {
     long int amount_shared_mem = 0;
     amount_shared_mem += (nmeas*CFP_size)*sizeof(T); // CFP
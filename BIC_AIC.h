@@ -5,7 +5,7 @@
  *
  * \class BIC_AIC
  *
- * \brief A class for calculating the Bayesian & Akaike Information Criteria on the GPU
+ * \brief A class for calculating the Bayesian & Akaike Information Criteria on the GPU or on the CPU
  *
  * \author Moises Hernandez-Fernandez - FMRIB Image Analysis Group
  *
@@ -48,7 +48,16 @@ namespace Cudimot{
     BIC_AIC(int nvoxFitpart);
 
     /**
-     * Calculate Bayesian Information Criterion
+     * Calculate Bayesian Information Criterion on the backend selected with --backend (see cpu_backend): run_gpu() or run_cpu(). The pointers are in the memory of the part, on the GPU or on the host (see allocate_part)
+     */
+    void run( int nvox, int nmeas, int nsamples,
+	      int CFP_size, int FixP_size,
+	      T* meas, T* samples,
+	      T* CFP, T* FixP,
+	      T* BIC, T* AIC, T* tau);
+
+    /**
+     * Calculate Bayesian Information Criterion on the GPU
      * @param nvox Number of voxels in the dataset
      * @param nmeas Number of measurements in the dataset
      * @param nsamples Number of samples (can be several if MCMC is used). In this case, the mean of the samples is used.
@@ -62,11 +71,20 @@ namespace Cudimot{
      * @param AIC calculated AIC will be stored here (on the GPU)
      * @param tau if Rician, it contains the calue of tau for all the voxels
      */
-    void run( int nvox, int nmeas, int nsamples,
-	      int CFP_size, int FixP_size,
-	      T* meas, T* samples, 
-	      T* CFP, T* FixP,
-	      T* BIC, T* AIC, T* tau);
+    void run_gpu( int nvox, int nmeas, int nsamples,
+		  int CFP_size, int FixP_size,
+		  T* meas, T* samples,
+		  T* CFP, T* FixP,
+		  T* BIC, T* AIC, T* tau);
+
+    /**
+     * Calculate Bayesian Information Criterion on the CPU. The voxels are distributed among several threads (--nthreads). Same arguments than run_gpu(), but all the pointers are in host memory
+     */
+    void run_cpu( int nvox, int nmeas, int nsamples,
+		  int CFP_size, int FixP_size,
+		  T* meas, T* samples,
+		  T* CFP, T* FixP,
+		  T* BIC, T* AIC, T* tau);
   };
 }
 
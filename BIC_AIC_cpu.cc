@@ -0,0 +1,139 @@
+/* BIC_AIC_cpu.cc
+
+   BIC & AIC calculation on the CPU: Bayesian & Akaike Information Criteria. Same method as the GPU version (BIC_AIC.cu), with the mean of the samples if MCMC is used. The voxels are distributed among a pool of threads in batches of CPU_LANES voxels, one voxel per SIMD lane (cpu_lanes.h).
+
+   This file is compiled with the host compiler (not nvcc), so the model functions are compiled as host functions.
+
+   agent
+
+   Copyright (C) 2026 University of Oxford */
+
+/* CCOPYRIGHT */
+
+#include "BIC_AIC.h"
+#include "functions_gpu.h"
+#include "modelparameters.h"
+#include "macro_numerical.h"
+#include "modelfunctions.h"
+#include "MCMC_priors.h"
+#include "cpu_threads.h"
+#include "cpu_lanes.h"
+
+using namespace std;
+
+namespace Cudimot{
+
+  // BIC and AIC of the voxels [first_voxel,first_voxel+nvox_batch), one voxel per lane. nvox_batch <= CPU_LANES
+  template <typename T, bool RICIAN_NOISE>
+  void bic_aic_lanes_cpu(
+			 int first_voxel,
+			 int nvox_batch,
+			 int nmeas, // num measurements
+			 int nsamples,
+			 int CFP_Tsize, // common fixed params: size*M-measurements
+			 int FixP_Tsize, // fixed params: size*N-voxels
+			 T* meas, // measurements
+			 T* samples, // samples of estimated parameters
+			 T* CFP, // common fixed model parameters
+			 T* FixP, // fixed model parameters
+			 T* BIC_values, // to record BIC values
+			 T* AIC_values, // to record AIC values
+			 T* tau_samples) // TAU values of each voxel for Rician noise
+  {
+    T meanSamples[NPARAMS][CPU_LANES];
+    T* lane_FixP[CPU_LANES];
+    T* lane_meas[CPU_LANES];
+    T TAU[CPU_LANES];
+    T accumulated_error[CPU_LANES];
+    T signal[CPU_LANES];
+    T cache[CACHE_SIZE][CPU_LANES];
+
+    // Lanes beyond the last voxel of the batch replicate its first voxel. They are never written
+    for(int l=0;l<CPU_LANES;l++){
+      int idVOX=first_voxel+((l<nvox_batch)?l:0);
+      T* mysamples=&samples[idVOX*NPARAMS*nsamples];
+      for(int par=0;par<NPARAMS;par++){
+	T value=(T)0.0;
+	for(int samp=0;samp<nsamples;samp++){
+	  value+= mysamples[par*nsamples+samp];
+	}
+	meanSamples[par][l]=value/nsamples;
+      }
+      TAU[l]=(T)0.0;
+      if(RICIAN_NOISE){
+	// TAU provided
+	T value=(T)0.0;
+	for(int samp=0;samp<nsamples;samp++){
+	  value+=tau_samples[idVOX*nsamples+samp];
+	}
+	TAU[l]=value/nsamples;
+      }
+      lane_FixP[l]=&FixP[idVOX*FixP_Tsize];
+      lane_meas[l]=&meas[idVOX*nmeas];
+      accumulated_error[l]=(T)0.0;
+    }
+
+    Prepare_Voxel_lanes(meanSamples,lane_FixP,cache);
+    for(int idMeasurement=0;idMeasurement<nmeas;idMeasurement++){
+      T* myCFP = &CFP[idMeasurement*CFP_Tsize];
+      Predicted_Signal_lanes(meanSamples,cache,myCFP,lane_FixP,signal);
+      for(int l=0;l<CPU_LANES;l++){
+	T pred_error=signal[l];
+	T mymeas=lane_meas[l][idMeasurement];
+	if(RICIAN_NOISE){
+	  pred_error=log_gpu(mymeas)+(-(T)0.5*TAU[l]*(mymeas*mymeas+pred_error*pred_error)+logIo(TAU[l]*pred_error*mymeas));
+	  accumulated_error[l]+=pred_error;
+	}else{
+	  pred_error=pred_error-mymeas;
+	  accumulated_error[l]+=pred_error*pred_error;
+	}
+      }
+    }
+
+    for(int l=0;l<nvox_batch;l++){
+      int idVOX=first_voxel+l;
+      int np=NPARAMS;
+      T bic;
+      if(RICIAN_NOISE){
+	np++;
+	bic = nmeas*log_gpu(TAU[l])+accumulated_error[l];
+      }else{
+	bic = -(nmeas/(T)2.0)*log_gpu(accumulated_error[l]/(T)2.0);
+      }
+      AIC_values[idVOX] = (T)-2.0 * bic + np * (T)2.0;
+      BIC_values[idVOX] = (T)-2.0 * bic + np * log_gpu((T)nmeas);
+    }
+  }
+
+  template <typename T>
+  void BIC_AIC<T>::run_cpu(
+			   int nvox, int nmeas, int nsamples,
+			   int CFP_size, int FixP_size,
+			   T* meas,
+			   T* samples,
+			   T* CFP, T* FixP,
+			   T* BIC,
+			   T* AIC,
+			   T* tau_samples)
+  {
+    cudimotOptions& opts = cudimotOptions::getInstance();
+    int nthreads=cpu_nthreads(opts.nthreads.value());
+    bool rician=RicianNoise;
+
+    cpu_threads_stats stats=parallel_voxels(nvox,CPU_LANES,nthreads,[&](int first, int last){
+	for(int batch=first;batch<last;batch+=CPU_LANES){
+	  int nvox_batch=min(CPU_LANES,last-batch);
+	  if(rician){
+	    bic_aic_lanes_cpu<T,true>(batch,nvox_batch,nmeas,nsamples,CFP_size,FixP_size,meas,samples,CFP,FixP,BIC,AIC,tau_samples);
+	  }else{
+	    bic_aic_lanes_cpu<T,false>(batch,nvox_batch,nmeas,nsamples,CFP_size,FixP_size,meas,samples,CFP,FixP,BIC,AIC,tau_samples);
+	  }
+	}
+      });
+    report_cpu_threads("BIC_AIC",stats);
+  }
+
+  // Explicit Instantiations of the template
+  template void BIC_AIC<float>::run_cpu(int,int,int,int,int,float*,float*,float*,float*,float*,float*,float*);
+  template void BIC_AIC<double>::run_cpu(int,int,int,int,int,double*,double*,double*,double*,double*,double*,double*);
+}
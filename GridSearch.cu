@@ -11,6 +11,9 @@
 #include "modelparameters.h"
 #include "macro_numerical.h"
 #include "modelfunctions.h"
+#include "init_gpu.h"
+#include "dictionary.h"
+#include "grid_levels.h"
 
 using namespace std;
 
@@ -20,6 +23,7 @@ namespace Cudimot{
 #define THREADS_VOXEL 32 // Multiple of 32: Threads collaborating to compute a voxel. Do not change this, otherwise Synchronization will be needed
 
   __constant__ int gridParams [NPARAMS]; // may not use all, but max is NPARAMS
+  __constant__ int gridSizes [NPARAMS];
   __constant__ int GSbound_types [NPARAMS];
   __constant__ float GSbounds_min [NPARAMS];
   __constant__ float GSbounds_max [NPARAMS];
@@ -65,9 +69,11 @@ namespace Cudimot{
     int nmeas2compute = nmeas/THREADS_VOXEL;
     if (idSubVOX<(nmeas%THREADS_VOXEL)) nmeas2compute++;
     
+    T cache[CACHE_SIZE];
+    Prepare_Voxel(parameters,FixP,cache);
     for(int iter=0;iter<nmeas2compute;iter++){
       T* myCFP = &CFP[idMeasurement*CFP_Tsize];
-      T pred_error=Predicted_Signal(NPARAMS,parameters,myCFP,FixP);
+      T pred_error=Predicted_Signal(NPARAMS,parameters,myCFP,FixP,cache);
       
       if(DEBUG){
 	int idVOX= (blockIdx.x*VOXELS_BLOCK)+int(threadIdx.x/THREADS_VOXEL);
@@ -96,6 +102,66 @@ namespace Cudimot{
     }
   }
   
+#if NLINEAR>0
+  // Solves the linear parameters of the model for the nonlinear parameters of the combination (see linear_parameters.h): the normal equations are accumulated by all the threads of the voxel and the leader solves them and sets the linear parameters
+  template <typename T>
+  __device__ inline void Solve_Linear(int idSubVOX,
+				      int nmeas,
+				      int CFP_Tsize,
+				      T* measurements,
+				      T* parameters,
+				      T* CFP,
+				      T* FixP)
+  {
+    int idMeasurement=idSubVOX;
+    T BtB[NLINEAR*NLINEAR];
+    T Bty[NLINEAR];
+    T basis[NLINEAR];
+
+    #pragma unroll
+    for(int j=0;j<NLINEAR;j++){
+      Bty[j]=(T)0.0;
+      #pragma unroll
+      for(int k=0;k<NLINEAR;k++){
+	BtB[j*NLINEAR+k]=(T)0.0;
+      }
+    }
+    
+    int nmeas2compute = nmeas/THREADS_VOXEL;
+    if (idSubVOX<(nmeas%THREADS_VOXEL)) nmeas2compute++;
+    
+    T cache[CACHE_SIZE];
+    Prepare_Voxel(parameters,FixP,cache);
+    for(int iter=0;iter<nmeas2compute;iter++){
+      T* myCFP = &CFP[idMeasurement*CFP_Tsize];
+      Linear_Basis(NPARAMS,parameters,myCFP,FixP,cache,basis);
+      accumulate_linear(basis,measurements[idMeasurement],BtB,Bty);
+      idMeasurement+=THREADS_VOXEL;
+    }
+     
+    #pragma unroll
+    for(int j=0;j<NLINEAR;j++){
+      #pragma unroll
+      for(int k=j;k<NLINEAR;k++){
+	#pragma unroll
+	for(int offset=THREADS_VOXEL/2; offset>0; offset>>=1){
+	  BtB[j*NLINEAR+k]+= shfl_down(BtB[j*NLINEAR+k],offset);
+	}
+      }
+      #pragma unroll
+      for(int offset=THREADS_VOXEL/2; offset>0; offset>>=1){
+	Bty[j]+= shfl_down(Bty[j],offset);
+      }
+    }
+    if(idSubVOX==0){
+      T coeffs[NLINEAR];
+      if(nnls_linear(BtB,Bty,coeffs)){
+	set_linear_parameters(coeffs,parameters,GSbound_types,GSbounds_min,GSbounds_max);
+      }
+    }
+  }
+#endif
+  
   template <typename T, bool DEBUG>
   __global__ void gridSearch_kernel(
 				    int nGridParams,
@@ -108,6 +174,7 @@ namespace Cudimot{
 				    T* parameters, // model parameters 
 				    T* CFP_global, // common fixed model parameters
 				    T* FixP, // fixed model parameters
+				    bool varpro, // solve the linear parameters (--varpro)
 				    int debugVOX)
   {
     // 1 block of threads process several voxels
@@ -196,6 +263,17 @@ namespace Cudimot{
 	}
 	*boundsTest=checkBounds(trial_params);
       }
+
+#if NLINEAR>0
+      if(varpro){
+	//__threadfence_block();
+	__syncthreads();
+	Solve_Linear(idSubVOX,nmeas,CFP_Tsize,meas,trial_params,CFP,FixP);
+	if(leader){
+	  *boundsTest=checkBounds(trial_params);
+	}
+      }
+#endif
     
       if(DEBUG){
 	if(idVOX==debugVOX&&leader){
@@ -249,9 +327,320 @@ namespace Cudimot{
     }
   }
   
+  // Coarse-to-fine GridSearch (--gridLevels, see grid_levels.h). The leader of each voxel generates the combinations of its level: all the voxels of the block evaluate the same number of them (-1: not evaluated), so the synchronisations are outside the conditions
+  // With one level, it evaluates all the combinations of the grid as gridSearch_kernel, and keeps the best ones for Levenberg-Marquardt (--multistart)
+  template <typename T, bool DEBUG>
+  __global__ void gridSearch_levels_kernel(
+					   int nvox,
+					   int nGridParams,
+					   int levels, // --gridLevels
+					   int keep, // --gridKeep
+					   int nmeas, // nmeasurements
+					   int CFP_Tsize, // common fixed params: size*M-measurements
+					   int FixP_Tsize, // fixed params: size*Nvoxels 
+					   T* meas, // measurements
+					   T* grid, // values to try
+					   T* parameters, // model parameters 
+					   T* CFP_global, // common fixed model parameters
+					   T* FixP, // fixed model parameters
+					   bool varpro, // solve the linear parameters (--varpro)
+					   int nstarts, // best combinations written to starts (--multistart)
+					   T* starts, // starting points of Levenberg-Marquardt, NULL if nstarts is 1
+					   int debugVOX)
+  {
+    // 1 block of threads process several voxels
+    // Each warp processes 1 voxel
+    int idVOX= (blockIdx.x*VOXELS_BLOCK)+int(threadIdx.x/THREADS_VOXEL);
+    int idVOX_inBlock =  threadIdx.x/THREADS_VOXEL;
+    int idSubVOX= threadIdx.x%THREADS_VOXEL;
+    bool leader = (idSubVOX==0);  // Some steps are performed by only one thread of the warp
+    
+    ////////// DYNAMIC SHARED MEMORY ///////////
+    extern  __shared__ double shared[];				//Size:
+    double* pcf = (double*) shared;    				//VOXELS_BLOCK 
+    double* ncf = (double*) &pcf[VOXELS_BLOCK];			//VOXELS_BLOCK
+    double* best_cost = (double*) &ncf[VOXELS_BLOCK];		//keep*VOXELS_BLOCK
+    T* CFP = (T*) &best_cost[keep*VOXELS_BLOCK];	       		//nmeas*CMP_Tsize
+    T* params = (T*) &CFP[nmeas*CFP_Tsize]; 			//NPARAMS*VOXELS_BLOCK
+    T* trial_params = (T*) &params[NPARAMS*VOXELS_BLOCK];       //NPARAMS*VOXELS_BLOCK
+    int* boundsTest = (int*) &trial_params[NPARAMS*VOXELS_BLOCK]; //VOXELS_BLOCK
+    int* trial_comb = (int*) &boundsTest[VOXELS_BLOCK];		//VOXELS_BLOCK
+    int* best_comb = (int*) &trial_comb[VOXELS_BLOCK];		//keep*VOXELS_BLOCK
+    int* centres = (int*) &best_comb[keep*VOXELS_BLOCK];	//keep*VOXELS_BLOCK
+    ////////////////////////////////////////////
+    
+    /// Copy common fixed model parameters to Shared Memory ///
+    if(threadIdx.x==0){ // only one thread of the whole block. Common to all voxels
+      for(int i=0;i<nmeas*CFP_Tsize;i++){
+	CFP[i]=CFP_global[i];
+      }
+    }
+    ///////////////////////////////////////////////////////////
+    
+    ///////// each voxel/warp of the block points to its data///////////
+    meas = &meas[idVOX*nmeas]; //Global memory
+    FixP = &FixP[idVOX*FixP_Tsize]; // Global memory
+    pcf = &pcf[idVOX_inBlock];
+    ncf = &ncf[idVOX_inBlock];
+    best_cost = &best_cost[idVOX_inBlock*keep];
+    params = (T*)&params[idVOX_inBlock*NPARAMS];
+    trial_params = (T*)&trial_params[idVOX_inBlock*NPARAMS];
+    boundsTest = (int*)&boundsTest[idVOX_inBlock];
+    trial_comb = (int*)&trial_comb[idVOX_inBlock];
+    best_comb = (int*)&best_comb[idVOX_inBlock*keep];
+    centres = (int*)&centres[idVOX_inBlock*keep];
+    
+    /// Ititialise shared values of each voxel: only the leader///
+    if(leader){
+      #pragma unroll
+      for(int i=0;i<NPARAMS;i++){
+	params[i]=parameters[idVOX*NPARAMS+i];
+      }
+      *pcf=9e20;
+      for(int j=0;j<keep;j++){
+	best_cost[j]=9e20;
+	best_comb[j]=-1;
+      }
+      if(DEBUG){
+	if(idVOX==debugVOX){
+	  printf("\n ----- GridSearch GPU algorithm (%i levels): voxel %i -----\n",levels,idVOX);
+	  for(int i=0;i<NPARAMS;i++){
+	    printf("Initial Parameter[%i]: %f\n",i,params[i]);
+	  }
+	}
+      }
+    }
+    __syncthreads();
+
+    int nneighbours=1;
+    for(int i=0;i<nGridParams;i++) nneighbours*=3;
+
+    for(int level=0;level<levels;level++){
+      int stride=1<<(levels-1-level);
+      int ncandidates;
+      if(level==0){
+	ncandidates=grid_ncoarse(nGridParams,gridSizes,stride);
+      }else{
+	ncandidates=keep*nneighbours;
+	if(leader){
+	  for(int j=0;j<keep;j++) centres[j]=best_comb[j];
+	}
+      }
+      if(DEBUG){
+	if(idVOX==debugVOX&&leader){
+	  printf("---------------------- Level %i: stride %i ---------------------\n",level,stride);
+	}
+      }
+      __syncthreads();
+      
+      for(int c=0;c<ncandidates;c++){
+	if(leader){
+	  int comb;
+	  if(level==0){
+	    comb=grid_coarse(nGridParams,gridSizes,stride,c);
+	  }else{
+	    comb=grid_neighbour(nGridParams,gridSizes,stride,centres,c/nneighbours,c%nneighbours);
+	  }
+	  *trial_comb=comb;
+	  *boundsTest=0;
+	  if(comb>=0){
+	    #pragma unroll
+	    for(int i=0; i<NPARAMS; i++){
+	      trial_params[i]= params[i];
+	    }
+	    for(int i=0;i<nGridParams;i++){
+	      trial_params[gridParams[i]]= grid[(comb*nGridParams)+i];
+	    }
+	    *boundsTest=checkBounds(trial_params);
+	  }
+	}
+	
+#if NLINEAR>0
+	if(varpro){
+	  __syncthreads();
+	  if(*trial_comb>=0){
+	    Solve_Linear(idSubVOX,nmeas,CFP_Tsize,meas,trial_params,CFP,FixP);
+	    if(leader){
+	      *boundsTest=checkBounds(trial_params);
+	    }
+	  }
+	}
+#endif
+	
+	__syncthreads();
+	
+	if(*boundsTest){
+	  Cost_Function<T,false>(idSubVOX,nmeas,CFP_Tsize,meas,trial_params,CFP,FixP,ncf,debugVOX);
+	  if(leader){
+	    if(DEBUG){
+	      if(idVOX==debugVOX){
+		printf("Combination %i: cost %f\n",*trial_comb,*ncf);
+	      }
+	    }
+	    if ((*ncf) < (*pcf)){ 
+	      #pragma unroll
+	      for(int i=0;i<NPARAMS;i++){
+		params[i]=trial_params[i];
+	      }
+	      *pcf=*ncf;
+	    }
+	    grid_keep_best(keep,best_cost,best_comb,*ncf,*trial_comb);
+	  }
+	}
+	__syncthreads(); 
+      }
+    }
+    
+    if(leader){
+      // save parameters in global
+      #pragma unroll
+      for(int i=0;i<NPARAMS;i++){
+	parameters[idVOX*NPARAMS+i]=params[i];
+      }
+      // Starting points of Levenberg-Marquardt: the parameters with the values of each best combination in the grid. If there are less valid combinations, the best one is repeated
+      if(starts!=NULL){
+	for(int s=0;s<nstarts;s++){
+	  T* start=&starts[(s*nvox+idVOX)*NPARAMS];
+	  #pragma unroll
+	  for(int i=0;i<NPARAMS;i++){
+	    start[i]=params[i];
+	  }
+	  if(best_comb[s]>=0){
+	    for(int i=0;i<nGridParams;i++){
+	      start[gridParams[i]]=grid[(best_comb[s]*nGridParams)+i];
+	    }
+	  }
+	}
+      }
+      if(DEBUG){
+	if(idVOX==debugVOX){
+	  for(int i=0;i<NPARAMS;i++){
+	    printf("Final Parameter[%i]: %f\n",i,params[i]);
+	  }
+	}
+      }
+    }
+  }
+  
+  
+  // Best atom of the dictionary for each voxel (--dictionary, see dictionary.h). Each thread of the warp computes the dot products of the measurements of the voxel with DICTIONARY_BLOCK atoms at a time, and the best atom of the warp is found with shuffles
+  template <typename T, bool DEBUG>
+  __global__ void dictionary_kernel(
+				    int nvox,
+				    int nmeas, // nmeasurements
+				    int natoms,
+				    int nGridParams,
+				    int FixP_Tsize, // fixed params: size*Nvoxels
+				    T* meas, // measurements
+				    const T* atoms, // normalised predicted signals [nmeas][natoms]
+				    const T* norms, // norm of each atom
+				    const int* combs, // combination of the grid of each atom
+				    const T* grid, // values of the grid
+				    T* parameters, // model parameters
+				    T* FixP, // fixed model parameters
+				    int debugVOX)
+  {
+    // 1 block of threads process several voxels
+    // Each warp processes 1 voxel
+    int idVOX= (blockIdx.x*VOXELS_BLOCK)+int(threadIdx.x/THREADS_VOXEL);
+    int idVOX_inBlock =  threadIdx.x/THREADS_VOXEL;
+    int idSubVOX= threadIdx.x%THREADS_VOXEL;
+    bool leader = (idSubVOX==0);  // Some steps are performed by only one thread of the warp
+
+    ////////// DYNAMIC SHARED MEMORY ///////////
+    extern  __shared__ double shared[];				//Size:
+    T* y = (T*) shared;						//nmeas*VOXELS_BLOCK
+    ////////////////////////////////////////////
+
+    y = &y[idVOX_inBlock*nmeas];
+    if(idVOX<nvox){
+      for(int m=idSubVOX;m<nmeas;m+=THREADS_VOXEL){
+	y[m]=meas[idVOX*nmeas+m];
+      }
+    }
+    __syncthreads();
+    if(idVOX>=nvox) return;
+
+#ifdef SCALE_FIXP
+    T scale=FixP[idVOX*FixP_Tsize+SCALE_FIXP];
+#else
+    T scale=(T)1.0;
+#endif
+    T best_score=dictionary_min_score<T>();
+    T best_dot=(T)0.0;
+    int best=-1;
+
+    // Atoms of the thread: first+k*THREADS_VOXEL, so the warp reads consecutive atoms of each measurement
+    for(int first=idSubVOX;first<natoms;first+=THREADS_VOXEL*DICTIONARY_BLOCK){
+      T dot[DICTIONARY_BLOCK];
+      #pragma unroll
+      for(int k=0;k<DICTIONARY_BLOCK;k++){
+	dot[k]=(T)0.0;
+      }
+      for(int m=0;m<nmeas;m++){
+	T value=y[m];
+	#pragma unroll
+	for(int k=0;k<DICTIONARY_BLOCK;k++){
+	  int atom=first+k*THREADS_VOXEL;
+	  if(atom<natoms) dot[k]+=atoms[m*natoms+atom]*value;
+	}
+      }
+      #pragma unroll
+      for(int k=0;k<DICTIONARY_BLOCK;k++){
+	int atom=first+k*THREADS_VOXEL;
+	if(atom<natoms){
+	  T score=dictionary_score(dot[k],norms[atom],scale);
+	  if(score>best_score){
+	    best_score=score;
+	    best_dot=dot[k];
+	    best=atom;
+	  }
+	}
+      }
+    }
+
+    // Best atom of the warp. With the same score, the first atom (as the brute-force GridSearch)
+    #pragma unroll
+    for(int offset=THREADS_VOXEL/2; offset>0; offset>>=1){
+      T other_score=shfl_down(best_score,offset);
+      T other_dot=shfl_down(best_dot,offset);
+      int other=__shfl_down_sync(FULL_MASK,best,offset);
+      if(other>=0 && (best<0 || other_score>best_score || (other_score==best_score && other<best))){
+	best_score=other_score;
+	best_dot=other_dot;
+	best=other;
+      }
+    }
+
+    if(leader){
+      if(best>=0){
+	int comb=combs[best];
+	for(int i=0;i<nGridParams;i++){
+	  parameters[idVOX*NPARAMS+gridParams[i]]=grid[comb*nGridParams+i];
+	}
+#ifdef SCALE_PARAM
+	T value=(T)0.0;
+	if(norms[best]>(T)0.0) value=best_dot/norms[best];
+	const int p=SCALE_PARAM;
+	if((GSbound_types[p]==BMIN || GSbound_types[p]==BMINMAX) && value<(T)GSbounds_min[p]) value=GSbounds_min[p];
+	if((GSbound_types[p]==BMAX || GSbound_types[p]==BMINMAX) && value>(T)GSbounds_max[p]) value=GSbounds_max[p];
+	parameters[idVOX*NPARAMS+p]=value;
+#endif
+      }
+      if(DEBUG){
+	if(idVOX==debugVOX){
+	  printf("\n ----- GridSearch GPU dictionary: voxel %i -----\n",idVOX);
+	  printf("Best atom: %i (of %i), score %f\n",best,natoms,best_score);
+	  for(int i=0;i<NPARAMS;i++){
+	    printf("Final Parameter[%i]: %f\n",i,parameters[idVOX*NPARAMS+i]);
+	  }
+	}
+      }
+    }
+  }
   
   template <typename T>
-  GridSearch<T>::GridSearch(int nGP, vector<int> gP, int gC, T* grid_host,
+  GridSearch<T>::GridSearch(int nGP, vector<int> gP, vector<int> gS, int gC, T* grid,
 			    vector<int> bou_types, vector<T> bou_min, 
 			    vector<T> bou_max)
   {
@@ -261,12 +650,19 @@ namespace Cudimot{
       gridParams_host=new int[NPARAMS];
       for(int i=0;i<NPARAMS;i++) gridParams_host[i]=0;
       for(int i=0;i<gP.size();i++) gridParams_host[i]=gP[i];
-      cudaMemcpyToSymbol(gridParams,gridParams_host,NPARAMS*sizeof(int));
+      gridSizes_host=new int[NPARAMS];
+      for(int i=0;i<NPARAMS;i++) gridSizes_host[i]=1;
+      for(int i=0;i<gS.size();i++) gridSizes_host[i]=gS[i];
       gridCombs = gC;
-      cudaMalloc((void**)&grid_gpu,gridCombs*nGridParams*sizeof(T));
-      cudaMemcpy(grid_gpu,grid_host,gridCombs*nGridParams*sizeof(T),cudaMemcpyHostToDevice);
-      
-      sync_check("GridSearch: Copying Grid to GPU");
+      grid_host=grid;
+      if(!cpu_backend()){
+	cudaMemcpyToSymbol(gridParams,gridParams_host,NPARAMS*sizeof(int));
+	cudaMemcpyToSymbol(gridSizes,gridSizes_host,NPARAMS*sizeof(int));
+	cudaMalloc((void**)&grid_gpu,gridCombs*nGridParams*sizeof(T));
+	cudaMemcpy(grid_gpu,grid_host,gridCombs*nGridParams*sizeof(T),cudaMemcpyHostToDevice);
+	
+	sync_check("GridSearch: Copying Grid to GPU");
+      }
 
       // Set bounds
       bound_types_host = new int[NPARAMS];
@@ -277,25 +673,206 @@ namespace Cudimot{
 	bounds_min_host[p]=bou_min[p];
 	bounds_max_host[p]=bou_max[p];
       }
-      cudaMemcpyToSymbol(GSbound_types,bound_types_host,NPARAMS*sizeof(int));
-      cudaMemcpyToSymbol(GSbounds_min,bounds_min_host,NPARAMS*sizeof(float));
-      cudaMemcpyToSymbol(GSbounds_max,bounds_max_host,NPARAMS*sizeof(float));
-      sync_check("GridSearch: Setting Bounds");
+      if(!cpu_backend()){
+	cudaMemcpyToSymbol(GSbound_types,bound_types_host,NPARAMS*sizeof(int));
+	cudaMemcpyToSymbol(GSbounds_min,bounds_min_host,NPARAMS*sizeof(float));
+	cudaMemcpyToSymbol(GSbounds_max,bounds_max_host,NPARAMS*sizeof(float));
+	sync_check("GridSearch: Setting Bounds");
+      }
    
       DEBUG=false;
       if(opts.debug.set()){
 	DEBUG=true;
 	debugVOX= atoi(opts.debug.value().data());
       }
+
+      varpro=false;
+#if NLINEAR>0
+      if(opts.varpro.value()){
+	varpro=true;
+	for(int i=0;i<nGridParams;i++){
+	  for(int j=0;j<NLINEAR;j++){
+	    if(gridParams_host[i]==linear_param(j)){
+	      cout << "Warning: the values of the linear parameter " << linear_param(j) << " in the grid are replaced by its least-squares solution (--varpro)" << endl;
+	    }
+	  }
+	}
+      }
+#endif
+
+      gridLevels=opts.gridLevels.value();
+      gridKeep=opts.gridKeep.value();
+      if(gridLevels<1 || gridKeep<1 || gridKeep>GRID_MAX_KEEP){
+	cerr << "CUDIMOT Error: The number of levels of GridSearch (--gridLevels) must be at least 1 and the number of combinations kept in each level (--gridKeep) in [1," << GRID_MAX_KEEP << "]" << endl;
+	exit(-1);
+      }
+      int multistart=1;
+      if(!opts.no_LevMar.value()) multistart=opts.multistart.value();
+      if(multistart>GRID_MAX_KEEP){
+	cerr << "CUDIMOT Error: The number of starting points of Levenberg-Marquardt (--multistart) must be in [1," << GRID_MAX_KEEP << "]" << endl;
+	exit(-1);
+      }
+      if(nGridParams==0) gridLevels=1;
+      if(gridLevels>1){
+	// Combinations evaluated for each voxel: the coarse grid and the neighbours of the best ones in each level
+	long int nneighbours=1;
+	for(int i=0;i<nGridParams;i++) nneighbours*=3;
+	long int evaluations=grid_ncoarse(nGridParams,gridSizes_host,1<<(gridLevels-1))+(gridLevels-1)*max(gridKeep,multistart)*(nneighbours-1);
+	cout << "Coarse-to-fine GridSearch with " << gridLevels << " levels: at most " << evaluations << " of the " << gridCombs << " combinations of the grid are evaluated for each voxel" << endl;
+      }
+
+      dictionary=NULL;
+      atoms_gpu=NULL;
+      norms_gpu=NULL;
+      combs_gpu=NULL;
+      dictionary_version_gpu=0;
+      if(opts.dictionary.value()){
+	dictionary=new Dictionary<T>(nGridParams,gridParams_host,gridCombs,grid_host,bound_types_host,bounds_min_host,bounds_max_host);
+#ifdef SCALE_PARAM
+	for(int i=0;i<nGridParams;i++){
+	  if(gridParams_host[i]==SCALE_PARAM){
+	    cout << "Warning: the values of the parameter " << SCALE_PARAM << " in the grid are replaced by its least-squares scale (--dictionary)" << endl;
+	  }
+	}
+#endif
+	if(multistart>1){
+	  cout << "GridSearch with a dictionary only finds the best combination: with several starting points for Levenberg-Marquardt (--multistart) the dictionary is not used" << endl;
+	}
+	if(gridLevels>1){
+	  cout << "GridSearch with a dictionary evaluates all the combinations of the grid: --gridLevels is only used if the dictionary cannot be used" << endl;
+	}
+	if(varpro){
+	  cout << "GridSearch with a dictionary does not solve the linear parameters of the model (--varpro): they are taken from the grid" << endl;
+	}
+      }
+    }
+  }
+
+  // Searches the voxels in the dictionary (--dictionary). Returns false if the dictionary cannot be used with these voxels
+  template <typename T>
+  bool GridSearch<T>::run_dictionary(int nvox, int nmeas,
+				     int CFP_size, int FixP_size,
+				     T* meas, T* params,
+				     T* CFP, T* FixP)
+  {
+    // The dictionary is built on the host
+    vector<T> CFP_host(nmeas*CFP_size);
+    vector<T> params_host(nvox*NPARAMS);
+    vector<T> FixP_host(nvox*FixP_size+1);
+    cudaMemcpy(CFP_host.data(),CFP,nmeas*CFP_size*sizeof(T),cudaMemcpyDeviceToHost);
+    cudaMemcpy(params_host.data(),params,nvox*NPARAMS*sizeof(T),cudaMemcpyDeviceToHost);
+    cudaMemcpy(FixP_host.data(),FixP,nvox*FixP_size*sizeof(T),cudaMemcpyDeviceToHost);
+    sync_check("GridSearch: Copying Parameters to the host for the dictionary");
+    if(!dictionary->prepare(nvox,nmeas,CFP_size,FixP_size,CFP_host.data(),params_host.data(),FixP_host.data())){
+      return false;
+    }
+    
+    const int natoms=dictionary->getNatoms();
+    if(natoms==0) return true; // no combination inside the bounds
+    
+    if(dictionary_version_gpu!=dictionary->getVersion()){
+      // Transposed, so the threads of a warp read consecutive atoms
+      vector<T> atoms_t((size_t)nmeas*natoms);
+      const T* atoms=dictionary->getAtoms();
+      for(int a=0;a<natoms;a++){
+	for(int m=0;m<nmeas;m++){
+	  atoms_t[(size_t)m*natoms+a]=atoms[(size_t)a*nmeas+m];
+	}
+      }
+      if(atoms_gpu!=NULL){
+	cudaFree(atoms_gpu);
+	cudaFree(norms_gpu);
+	cudaFree(combs_gpu);
+      }
+      cudaMalloc((void**)&atoms_gpu,atoms_t.size()*sizeof(T));
+      cudaMalloc((void**)&norms_gpu,natoms*sizeof(T));
+      cudaMalloc((void**)&combs_gpu,natoms*sizeof(int));
+      cudaMemcpy(atoms_gpu,atoms_t.data(),atoms_t.size()*sizeof(T),cudaMemcpyHostToDevice);
+      cudaMemcpy(norms_gpu,dictionary->getNorms(),natoms*sizeof(T),cudaMemcpyHostToDevice);
+      cudaMemcpy(combs_gpu,dictionary->getCombs(),natoms*sizeof(int),cudaMemcpyHostToDevice);
+      sync_check("GridSearch: Copying Dictionary to GPU");
+      dictionary_version_gpu=dictionary->getVersion();
+    }
+
+    long int amount_shared_mem = (nmeas*VOXELS_BLOCK)*sizeof(T); // measurements
+    
+    int threads_block = VOXELS_BLOCK * THREADS_VOXEL;
+    int nblocks=(nvox/VOXELS_BLOCK);
+    if(nvox%VOXELS_BLOCK) nblocks++;
+    
+    if(!DEBUG){
+      dictionary_kernel<T,false><<<nblocks,threads_block,amount_shared_mem>>>(nvox,nmeas,natoms,nGridParams,FixP_size,meas,atoms_gpu,norms_gpu,combs_gpu,grid_gpu,params,FixP,debugVOX);
+    }else{
+      dictionary_kernel<T,true><<<nblocks,threads_block,amount_shared_mem>>>(nvox,nmeas,natoms,nGridParams,FixP_size,meas,atoms_gpu,norms_gpu,combs_gpu,grid_gpu,params,FixP,debugVOX);
+    }
+    sync_check("GridSearch Dictionary Kernel");
+    return true;
+  }
+  
+  // Runs the coarse-to-fine GridSearch on the GPU (--gridLevels), keeping the best combinations of each voxel (--multistart)
+  template <typename T>
+  void GridSearch<T>::run_levels(int nvox, int nmeas,
+				 int CFP_size, int FixP_size,
+				 T* meas, T* params,
+				 T* CFP, T* FixP,
+				 int nstarts, T* starts)
+  {
+    int levels=gridLevels;
+    int keep=nstarts;
+    if(levels>1) keep=max(gridKeep,nstarts);
+    
+    long int amount_shared_mem = 0;
+    amount_shared_mem += 2*VOXELS_BLOCK*sizeof(double); // cost function
+    amount_shared_mem += (keep*VOXELS_BLOCK)*sizeof(double); // cost of the best combinations
+    amount_shared_mem += (nmeas*CFP_size)*sizeof(T); // CFP
+    amount_shared_mem += (NPARAMS*VOXELS_BLOCK)*sizeof(T); // Parameters
+    amount_shared_mem += (NPARAMS*VOXELS_BLOCK)*sizeof(T); // trial_Params
+    amount_shared_mem += 2*VOXELS_BLOCK*sizeof(int); // boundsTest, trial combination
+    amount_shared_mem += (2*keep*VOXELS_BLOCK)*sizeof(int); // best combinations, centres of the level
+        
+    cout << "Shared Memory used in GridSearch kernel: " << amount_shared_mem << endl;
+    
+    int threads_block = VOXELS_BLOCK * THREADS_VOXEL;
+    int nblocks=(nvox/VOXELS_BLOCK);
+    if(nvox%VOXELS_BLOCK) nblocks++;
+    
+    if(!DEBUG){
+      gridSearch_levels_kernel<T,false><<<nblocks,threads_block,amount_shared_mem>>>(nvox,nGridParams,levels,keep,nmeas,CFP_size,FixP_size,meas,grid_gpu,params,CFP,FixP,varpro,nstarts,starts,debugVOX);
+    }else{
+      gridSearch_levels_kernel<T,true><<<nblocks,threads_block,amount_shared_mem>>>(nvox,nGridParams,levels,keep,nmeas,CFP_size,FixP_size,meas,grid_gpu,params,CFP,FixP,varpro,nstarts,starts,debugVOX);
     }
+    sync_check("GridSearch Levels Kernel");
   }
   
   template <typename T>
   void GridSearch<T>::run(int nvox, int nmeas,
 			  int CFP_size, int FixP_size,
 			  T* meas, T* params,
-			  T* CFP, T* FixP) 
+			  T* CFP, T* FixP,
+			  int nstarts, T* starts)
+  {
+    if(cpu_backend()){
+      run_cpu(nvox,nmeas,CFP_size,FixP_size,meas,params,CFP,FixP,nstarts,starts);
+    }else{
+      run_gpu(nvox,nmeas,CFP_size,FixP_size,meas,params,CFP,FixP,nstarts,starts);
+    }
+  }
+
+  template <typename T>
+  void GridSearch<T>::run_gpu(int nvox, int nmeas,
+			      int CFP_size, int FixP_size,
+			      T* meas, T* params,
+			      T* CFP, T* FixP,
+			      int nstarts, T* starts)
   {
+    if(dictionary!=NULL && nstarts==1 && run_dictionary(nvox,nmeas,CFP_size,FixP_size,meas,params,CFP,FixP)){
+      return;
+    }
+
+    if(gridLevels>1 || nstarts>1){
+      run_levels(nvox,nmeas,CFP_size,FixP_size,meas,params,CFP,FixP,nstarts,starts);
+      return;
+    }
   
     long int amount_shared_mem = 0;
     amount_shared_mem += 2*VOXELS_BLOCK*sizeof(double); // cost function
@@ -311,9 +888,9 @@ namespace Cudimot{
     if(nvox%VOXELS_BLOCK) nblocks++;
     
     if(!DEBUG){
-      gridSearch_kernel<T,false><<<nblocks,threads_block,amount_shared_mem>>>(nGridParams,gridCombs,nmeas,CFP_size,FixP_size,meas,grid_gpu,params,CFP,FixP,debugVOX);
+      gridSearch_kernel<T,false><<<nblocks,threads_block,amount_shared_mem>>>(nGridParams,gridCombs,nmeas,CFP_size,FixP_size,meas,grid_gpu,params,CFP,FixP,varpro,debugVOX);
     }else{
-      gridSearch_kernel<T,true><<<nblocks,threads_block,amount_shared_mem>>>(nGridParams,gridCombs,nmeas,CFP_size,FixP_size,meas,grid_gpu,params,CFP,FixP,debugVOX);
+      gridSearch_kernel<T,true><<<nblocks,threads_block,amount_shared_mem>>>(nGridParams,gridCombs,nmeas,CFP_size,FixP_size,meas,grid_gpu,params,CFP,FixP,varpro,debugVOX);
     }
     sync_check("GridSearch Kernel");
   }
@@ -5,7 +5,7 @@
  *
  * \class GridSearch
  *
- * \brief A class for initialising the parameters, using Grid Search on a GPU, before the fitting process of a model.
+ * \brief A class for initialising the parameters, using Grid Search on a GPU or on the CPU, before the fitting process of a model.
  *
  * \author Moises Hernandez-Fernandez - FMRIB Image Analysis Group
  *
@@ -26,6 +26,8 @@
 using std::vector;
 
 namespace Cudimot{
+  template <typename T> class Dictionary;
+
   template <typename T>
   class GridSearch{
 
@@ -36,6 +38,11 @@ namespace Cudimot{
      */
     T* grid_gpu;
 
+    /**
+     * All the combinations of parameter values to try on the CPU (grid of the model, in host memory)
+     */
+    T* grid_host;
+
     /**
      * Number of combinations in the grid (size is this * NPARAMS)
      */
@@ -51,6 +58,21 @@ namespace Cudimot{
      */
     int nGridParams;
 
+    /**
+     * Number of values of each parameter in the grid
+     */
+    int* gridSizes_host;
+
+    /**
+     * Levels of the coarse-to-fine GridSearch (--gridLevels, see grid_levels.h). 1: all the combinations of the grid
+     */
+    int gridLevels;
+
+    /**
+     * Best combinations of each voxel refined in each level (--gridKeep)
+     */
+    int gridKeep;
+
     /**
      * Type of each parameter bounds
      */
@@ -66,6 +88,28 @@ namespace Cudimot{
      */
     float* bounds_max_host;
     
+    /**
+     * Solve the linear parameters of the model for each combination of the grid (--varpro, see linear_parameters.h)
+     */
+    bool varpro;
+
+    /**
+     * Dictionary of the predicted signals of the grid (--dictionary, see dictionary.h). NULL without --dictionary
+     */
+    Dictionary<T>* dictionary;
+
+    /**
+     * Normalised predicted signals [nmeas][natoms], norms [natoms] and combination of the grid [natoms] of the atoms of the dictionary on the GPU
+     */
+    T* atoms_gpu;
+    T* norms_gpu;
+    int* combs_gpu;
+
+    /**
+     * Version of the dictionary copied to the GPU (0: not copied)
+     */
+    int dictionary_version_gpu;
+    
     /**
      * Activate debugging messages for a voxel. It prints the evaluation of each set of parameters during GridSearch
      */
@@ -75,6 +119,24 @@ namespace Cudimot{
      * Number of the voxel (starts at 0) to debug if debugging is activated
      */
     int debugVOX;
+
+    /**
+     * Runs GridSearch on the GPU with the dictionary (--dictionary). Same arguments than run()
+     * @return false if the dictionary cannot be used with these voxels
+     */
+    bool run_dictionary(int nvox, int nmeas,
+			int CFP_size, int FixP_size,
+			T* meas, T* params,
+			T* CFP, T* FixP);
+
+    /**
+     * Runs the coarse-to-fine GridSearch (--gridLevels) on the GPU, or keeps the best combinations of each voxel (--multistart). Same arguments than run()
+     */
+    void run_levels(int nvox, int nmeas,
+		    int CFP_size, int FixP_size,
+		    T* meas, T* params,
+		    T* CFP, T* FixP,
+		    int nstarts, T* starts);
     
   public:
     
@@ -82,13 +144,23 @@ namespace Cudimot{
      * Constructor
      * @param number of parameters in each combination of the grid
      * @param Ids of parameters in the grid
+     * @param Number of values of each parameter in the grid
      * @param Number of parameter-value combination to try in GridSearch
      * @param the grid with all the combinations values for Grid Search
      * @param bound_types Vector with the type of each bound type
      * @param bounds_min Vector with the lower bound of each parameter
      * @param bounds_max Vector with the upper bound of each parameter
      */
-    GridSearch(int nGridParams, vector<int> gridParams, int gridCombs, T* grid_host, vector<int> bou_types, vector<T> bou_min, vector<T> bou_max);
+    GridSearch(int nGridParams, vector<int> gridParams, vector<int> gridSizes, int gridCombs, T* grid, vector<int> bou_types, vector<T> bou_min, vector<T> bou_max);
+
+    /**
+     * Run GridSearch on the backend selected with --backend (see cpu_backend): run_gpu() or run_cpu(). The pointers are in the memory of the part, on the GPU or on the host (see allocate_part)
+     */
+    void run( int nvox, int nmeas,
+	      int CFP_size, int FixP_size,
+	      T* meas, T* params,
+	      T* CFP, T* FixP,
+	      int nstarts, T* starts);
 
     /**
      * Run GridSearch on the GPU
@@ -100,11 +172,23 @@ namespace Cudimot{
      * @param params Value of the parameters to estimate of the model for all the voxels of the dataset (on GPU)
      * @param CFP Common (to all the voxels) fixed parameters of the model (on GPU). CFP_size*nmeas
      * @param FixP Fixed parameters of the model (on GPU). FixP_size*nvoxels
+     * @param nstarts Number of best combinations of each voxel written to starts (--multistart)
+     * @param starts Starting points of Levenberg-Marquardt (on GPU): the parameters with the s-th best combination of voxel v at (s*nvox+v)*NPARAMS. NULL if nstarts is 1
      */
-    void run( int nvox, int nmeas,
-	      int CFP_size, int FixP_size,
-	      T* meas, T* params,
-	      T* CFP, T* FixP);
+    void run_gpu( int nvox, int nmeas,
+		  int CFP_size, int FixP_size,
+		  T* meas, T* params,
+		  T* CFP, T* FixP,
+		  int nstarts, T* starts);
+
+    /**
+     * Run GridSearch on the CPU. The voxels are distributed among several threads (--nthreads). Same arguments than run_gpu(), but all the pointers are in host memory
+     */
+    void run_cpu( int nvox, int nmeas,
+		  int CFP_size, int FixP_size,
+		  T* meas, T* params,
+		  T* CFP, T* FixP,
+		  int nstarts, T* starts);
   };
 }
 
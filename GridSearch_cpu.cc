@@ -0,0 +1,605 @@
+/* GridSearch_cpu.cc
+
+   GridSearch on the CPU. It is the same algorithm as the GPU version (GridSearch.cu): every combination of the grid that is inside the bounds is evaluated and the one with the lowest cost is kept. The voxels are distributed among a pool of threads in batches of CPU_LANES voxels, one voxel per SIMD lane (cpu_lanes.h). All the voxels try the same combinations, so the grid values are the same for all the lanes.
+
+   With --gridLevels, the coarse-to-fine GridSearch (grid_levels.h) evaluates a coarse grid and then the neighbours of the best combinations of each voxel. After the coarse grid, each lane evaluates its own combinations. The same function keeps the best combinations of each voxel as starting points of Levenberg-Marquardt (--multistart).
+
+   With --dictionary, the predicted signals of the grid are computed once (dictionary.h) and each voxel only needs the dot products of its measurements with them. The dot products of DICTIONARY_BLOCK atoms are computed together, so each measurement of the lanes is loaded once for all of them.
+
+   This file is compiled with the host compiler (not nvcc), so the model functions are compiled as host functions.
+
+   agent
+
+   Copyright (C) 2026 University of Oxford */
+
+/* CCOPYRIGHT */
+
+#include <cstdio>
+#include <vector>
+#include "GridSearch.h"
+#include "functions_gpu.h"
+#include "modelparameters.h"
+#include "macro_numerical.h"
+#include "modelfunctions.h"
+#include "cpu_threads.h"
+#include "cpu_lanes.h"
+#include "dictionary.h"
+#include "grid_levels.h"
+
+using namespace std;
+
+namespace Cudimot{
+
+  template <typename T>
+  inline bool checkBounds_cpu(const T* params,
+			      const int* bound_types,
+			      const float* bounds_min,
+			      const float* bounds_max)
+  {
+    for(int p=0;p<NPARAMS;p++){
+      if(bound_types[p]==BMIN){
+	// Bounded with only min
+	if (params[p] < bounds_min[p])
+	  return false;
+      }else if(bound_types[p]==BMAX){
+	// Bounded with only max
+	if (params[p] > bounds_max[p])
+	   return false;
+      }else if(bound_types[p]==BMINMAX){
+	// Bounded with min & max
+	if (params[p] < bounds_min[p])
+	  return false;
+	else if (params[p] > bounds_max[p])
+	  return false;
+      }
+    }
+    return true;
+  }
+
+  template <typename T, bool DEBUG>
+  inline void Cost_Function_lanes(
+				  int first_voxel, // first voxel of the batch (for debugging)
+				  int nmeas,
+				  int CFP_Tsize,
+				  T* measurements, // [nmeas][CPU_LANES]
+				  T parameters[][CPU_LANES],
+				  T* CFP,
+				  T* const* FixP,
+				  double* cost,
+				  int debugVOX)
+  {
+    T accumulated_error[CPU_LANES];
+    T signal[CPU_LANES];
+    T cache[CACHE_SIZE][CPU_LANES];
+    Prepare_Voxel_lanes(parameters,FixP,cache);
+    for(int l=0;l<CPU_LANES;l++){
+      accumulated_error[l]=(T)0.0;
+    }
+    for(int idMeasurement=0;idMeasurement<nmeas;idMeasurement++){
+      T* myCFP = &CFP[idMeasurement*CFP_Tsize];
+      T* mymeas = &measurements[idMeasurement*CPU_LANES];
+      Predicted_Signal_lanes(parameters,cache,myCFP,FixP,signal);
+      if(DEBUG){
+	for(int l=0;l<CPU_LANES;l++){
+	  if(first_voxel+l==debugVOX){
+	    printf("PredictedSignal[%i]: %f\n",idMeasurement,signal[l]);
+	  }
+	}
+      }
+      #pragma omp simd
+      for(int l=0;l<CPU_LANES;l++){
+	T pred_error=signal[l]-mymeas[l];
+	accumulated_error[l]+=pred_error*pred_error;
+      }
+    }
+    for(int l=0;l<CPU_LANES;l++){
+      cost[l]=accumulated_error[l];
+      if(DEBUG){
+	if(first_voxel+l==debugVOX){
+	  printf("COST FUNTION: %f\n",cost[l]);
+	}
+      }
+    }
+  }
+
+  // Searches the voxels [first_voxel,first_voxel+nvox_batch), one voxel per lane. nvox_batch <= CPU_LANES
+  template <typename T, bool DEBUG>
+  void gridSearch_lanes_cpu(
+			    int first_voxel,
+			    int nvox_batch,
+			    int nGridParams,
+			    int gridCombs,
+			    int nmeas, // nmeasurements
+			    int CFP_Tsize, // common fixed params: size*M-measurements
+			    int FixP_Tsize, // fixed params: size*Nvoxels
+			    T* meas, // measurements
+			    const T* grid, // values to try
+			    T* parameters, // model parameters
+			    T* CFP, // common fixed model parameters
+			    T* FixP, // fixed model parameters
+			    bool varpro, // solve the linear parameters (--varpro)
+			    int debugVOX,
+			    const int* gridParams,
+			    const int* bound_types,
+			    const float* bounds_min,
+			    const float* bounds_max)
+  {
+    T params[NPARAMS][CPU_LANES];
+    T trial_params[NPARAMS][CPU_LANES];
+    T* lane_FixP[CPU_LANES];
+    vector<T> lane_meas(nmeas*CPU_LANES);
+    double pcf[CPU_LANES], ncf[CPU_LANES];
+    bool boundsTest[CPU_LANES];
+#if NLINEAR>0
+    bool batch_lanes[CPU_LANES]; // lanes with a voxel of the batch
+#endif
+
+    // Lanes beyond the last voxel of the batch replicate its first voxel, so they compute valid values. They are never written
+    for(int l=0;l<CPU_LANES;l++){
+      int idVOX=first_voxel+((l<nvox_batch)?l:0);
+      for(int p=0;p<NPARAMS;p++){
+	params[p][l]=parameters[idVOX*NPARAMS+p];
+      }
+      for(int m=0;m<nmeas;m++){
+	lane_meas[m*CPU_LANES+l]=meas[idVOX*nmeas+m];
+      }
+      lane_FixP[l]=&FixP[idVOX*FixP_Tsize];
+      pcf[l]=9e20;
+#if NLINEAR>0
+      batch_lanes[l]=(l<nvox_batch);
+#endif
+    }
+
+    for(int l=0;l<nvox_batch;l++){
+      if(DEBUG){
+	if(first_voxel+l==debugVOX){
+	  printf("\n ----- GridSearch CPU algorithm: voxel %i -----\n",debugVOX);
+	  for(int i=0;i<NPARAMS;i++){
+	    printf("Initial Parameter[%i]: %f\n",i,params[i][l]);
+	  }
+	  for(int i=0;i<CFP_Tsize;i++){
+	    printf("Commonn Fixed Params[%i]: ",i);
+	    for(int j=0;j<nmeas;j++){
+	      printf("%f ",CFP[j*CFP_Tsize+i]);
+	    }
+	    printf("\n");
+	  }
+	  printf("Fix Parameters: ");
+	  for(int i=0;i< FixP_Tsize;i++){
+	    printf("%f, ",lane_FixP[l][i]);
+	  }
+	  printf("\n--------------------------------------------------------\n");
+	}
+      }
+    }
+
+    for(int comb=0;comb<gridCombs;comb++){
+      for(int i=0;i<NPARAMS;i++){
+	#pragma omp simd
+	for(int l=0;l<CPU_LANES;l++){
+	  trial_params[i][l]=params[i][l];
+	}
+      }
+      for(int i=0;i<nGridParams;i++){
+	T value=grid[(comb*nGridParams)+i];
+	for(int l=0;l<CPU_LANES;l++){
+	  trial_params[gridParams[i]][l]=value;
+	}
+      }
+#if NLINEAR>0
+      if(varpro){
+	bool solved[CPU_LANES];
+	Solve_Linear_lanes(nmeas,CFP_Tsize,lane_meas.data(),trial_params,CFP,lane_FixP,batch_lanes,solved,bound_types,bounds_min,bounds_max);
+      }
+#endif
+      for(int l=0;l<CPU_LANES;l++){
+	T p[NPARAMS];
+	get_lane(trial_params,NPARAMS,l,p);
+	boundsTest[l]=(l<nvox_batch) && checkBounds_cpu(p,bound_types,bounds_min,bounds_max);
+      }
+
+      if(DEBUG){
+	for(int l=0;l<nvox_batch;l++){
+	  if(first_voxel+l==debugVOX){
+	    printf("---------------------- Combination %i ---------------------\n",comb);
+	    printf("Parameters: ");
+	    for(int i=0;i<NPARAMS;i++) printf("%f ",trial_params[i][l]);
+	    printf("\nBoundsTest: %i\n",boundsTest[l]);
+	  }
+	}
+      }
+
+      if(any_lane(boundsTest)){
+	Cost_Function_lanes<T,DEBUG>(first_voxel,nmeas,CFP_Tsize,lane_meas.data(),trial_params,CFP,lane_FixP,ncf,debugVOX);
+	for(int l=0;l<CPU_LANES;l++){
+	  if(boundsTest[l] && ncf[l]<pcf[l]){
+	    for(int i=0;i<NPARAMS;i++){
+	      params[i][l]=trial_params[i][l];
+	    }
+	    pcf[l]=ncf[l];
+	  }
+	}
+      }
+      if(DEBUG){
+	for(int l=0;l<nvox_batch;l++){
+	  if(first_voxel+l==debugVOX){
+	    printf("--------------------------------------------------------\n");
+	  }
+	}
+      }
+    }
+
+    for(int l=0;l<nvox_batch;l++){
+      int idVOX=first_voxel+l;
+      // save parameters
+      for(int i=0;i<NPARAMS;i++){
+	parameters[idVOX*NPARAMS+i]=params[i][l];
+      }
+      if(DEBUG){
+	if(idVOX==debugVOX){
+	  for(int i=0;i<NPARAMS;i++){
+	    printf("Final Parameter[%i]: %f\n",i,params[i][l]);
+	  }
+	}
+      }
+    }
+  }
+
+  // Coarse-to-fine GridSearch (--gridLevels) of the voxels [first_voxel,first_voxel+nvox_batch), one voxel per lane. nvox_batch <= CPU_LANES
+  // With one level, it evaluates all the combinations of the grid as gridSearch_lanes_cpu, and keeps the best ones for Levenberg-Marquardt (--multistart)
+  template <typename T, bool DEBUG>
+  void gridSearch_levels_lanes_cpu(
+				   int first_voxel,
+				   int nvox_batch,
+				   int nvox,
+				   int nGridParams,
+				   const int* gridSizes,
+				   int levels, // --gridLevels
+				   int keep, // --gridKeep
+				   int nmeas, // nmeasurements
+				   int CFP_Tsize, // common fixed params: size*M-measurements
+				   int FixP_Tsize, // fixed params: size*Nvoxels
+				   T* meas, // measurements
+				   const T* grid, // values to try
+				   T* parameters, // model parameters
+				   T* CFP, // common fixed model parameters
+				   T* FixP, // fixed model parameters
+				   bool varpro, // solve the linear parameters (--varpro)
+				   int nstarts, // best combinations written to starts (--multistart)
+				   T* starts, // starting points of Levenberg-Marquardt, NULL if nstarts is 1
+				   int debugVOX,
+				   const int* gridParams,
+				   const int* bound_types,
+				   const float* bounds_min,
+				   const float* bounds_max)
+  {
+    T params[NPARAMS][CPU_LANES];
+    T trial_params[NPARAMS][CPU_LANES];
+    T* lane_FixP[CPU_LANES];
+    vector<T> lane_meas(nmeas*CPU_LANES);
+    double pcf[CPU_LANES], ncf[CPU_LANES];
+    bool boundsTest[CPU_LANES];
+    int comb[CPU_LANES]; // combination of each lane (-1: none)
+    double best_cost[CPU_LANES][GRID_MAX_KEEP];
+    int best_comb[CPU_LANES][GRID_MAX_KEEP];
+    int centres[CPU_LANES][GRID_MAX_KEEP];
+
+    // Lanes beyond the last voxel of the batch replicate its first voxel, so they compute valid values. They are never written
+    for(int l=0;l<CPU_LANES;l++){
+      int idVOX=first_voxel+((l<nvox_batch)?l:0);
+      for(int p=0;p<NPARAMS;p++){
+	params[p][l]=parameters[idVOX*NPARAMS+p];
+      }
+      for(int m=0;m<nmeas;m++){
+	lane_meas[m*CPU_LANES+l]=meas[idVOX*nmeas+m];
+      }
+      lane_FixP[l]=&FixP[idVOX*FixP_Tsize];
+      pcf[l]=9e20;
+      for(int j=0;j<keep;j++){
+	best_cost[l][j]=9e20;
+	best_comb[l][j]=-1;
+      }
+    }
+
+    for(int l=0;l<nvox_batch;l++){
+      if(DEBUG){
+	if(first_voxel+l==debugVOX){
+	  printf("\n ----- GridSearch CPU algorithm (%i levels): voxel %i -----\n",levels,debugVOX);
+	  for(int i=0;i<NPARAMS;i++){
+	    printf("Initial Parameter[%i]: %f\n",i,params[i][l]);
+	  }
+	}
+      }
+    }
+
+    int nneighbours=1;
+    for(int i=0;i<nGridParams;i++) nneighbours*=3;
+
+    for(int level=0;level<levels;level++){
+      int stride=1<<(levels-1-level);
+      int ncandidates;
+      if(level==0){
+	ncandidates=grid_ncoarse(nGridParams,gridSizes,stride);
+      }else{
+	ncandidates=keep*nneighbours;
+	for(int l=0;l<CPU_LANES;l++){
+	  for(int j=0;j<keep;j++) centres[l][j]=best_comb[l][j];
+	}
+      }
+      for(int l=0;l<nvox_batch;l++){
+	if(DEBUG){
+	  if(first_voxel+l==debugVOX){
+	    printf("---------------------- Level %i: stride %i ---------------------\n",level,stride);
+	  }
+	}
+      }
+
+      for(int c=0;c<ncandidates;c++){
+	bool active[CPU_LANES];
+	for(int l=0;l<CPU_LANES;l++){
+	  if(l>=nvox_batch){
+	    comb[l]=-1;
+	  }else if(level==0){
+	    comb[l]=grid_coarse(nGridParams,gridSizes,stride,c);
+	  }else{
+	    comb[l]=grid_neighbour(nGridParams,gridSizes,stride,centres[l],c/nneighbours,c%nneighbours);
+	  }
+	  active[l]=(comb[l]>=0);
+	}
+	if(!any_lane(active)) continue;
+
+	for(int i=0;i<NPARAMS;i++){
+	  #pragma omp simd
+	  for(int l=0;l<CPU_LANES;l++){
+	    trial_params[i][l]=params[i][l];
+	  }
+	}
+	for(int l=0;l<CPU_LANES;l++){
+	  if(comb[l]>=0){
+	    for(int i=0;i<nGridParams;i++){
+	      trial_params[gridParams[i]][l]=grid[(comb[l]*nGridParams)+i];
+	    }
+	  }
+	}
+#if NLINEAR>0
+	if(varpro){
+	  bool solved[CPU_LANES];
+	  Solve_Linear_lanes(nmeas,CFP_Tsize,lane_meas.data(),trial_params,CFP,lane_FixP,active,solved,bound_types,bounds_min,bounds_max);
+	}
+#endif
+	for(int l=0;l<CPU_LANES;l++){
+	  T p[NPARAMS];
+	  get_lane(trial_params,NPARAMS,l,p);
+	  boundsTest[l]=active[l] && checkBounds_cpu(p,bound_types,bounds_min,bounds_max);
+	}
+
+	if(any_lane(boundsTest)){
+	  Cost_Function_lanes<T,false>(first_voxel,nmeas,CFP_Tsize,lane_meas.data(),trial_params,CFP,lane_FixP,ncf,debugVOX);
+	  for(int l=0;l<CPU_LANES;l++){
+	    if(boundsTest[l]){
+	      if(DEBUG){
+		if(first_voxel+l==debugVOX){
+		  printf("Combination %i: cost %f\n",comb[l],ncf[l]);
+		}
+	      }
+	      if(ncf[l]<pcf[l]){
+		for(int i=0;i<NPARAMS;i++){
+		  params[i][l]=trial_params[i][l];
+		}
+		pcf[l]=ncf[l];
+	      }
+	      grid_keep_best(keep,best_cost[l],best_comb[l],ncf[l],comb[l]);
+	    }
+	  }
+	}
+      }
+    }
+
+    for(int l=0;l<nvox_batch;l++){
+      int idVOX=first_voxel+l;
+      // save parameters
+      for(int i=0;i<NPARAMS;i++){
+	parameters[idVOX*NPARAMS+i]=params[i][l];
+      }
+      // Starting points of Levenberg-Marquardt: the parameters with the values of each best combination in the grid. If there are less valid combinations, the best one is repeated
+      if(starts!=NULL){
+	for(int s=0;s<nstarts;s++){
+	  T* start=&starts[(s*nvox+idVOX)*NPARAMS];
+	  for(int i=0;i<NPARAMS;i++){
+	    start[i]=params[i][l];
+	  }
+	  if(best_comb[l][s]>=0){
+	    for(int i=0;i<nGridParams;i++){
+	      start[gridParams[i]]=grid[(best_comb[l][s]*nGridParams)+i];
+	    }
+	  }
+	}
+      }
+      if(DEBUG){
+	if(idVOX==debugVOX){
+	  for(int i=0;i<NPARAMS;i++){
+	    printf("Final Parameter[%i]: %f\n",i,params[i][l]);
+	  }
+	}
+      }
+    }
+  }
+
+  // Dot products of the measurements of the lanes with the atoms [first_atom,first_atom+NB), and best atom of each lane
+  template <typename T, int NB>
+  inline void dictionary_block_lanes(int first_atom,
+				     int nmeas,
+				     const T* atoms, // [natoms][nmeas]
+				     const T* norms,
+				     const T* measurements, // [nmeas][CPU_LANES]
+				     const T* scale,
+				     T* best_score,
+				     T* best_dot,
+				     int* best)
+  {
+    T dot[NB][CPU_LANES];
+    for(int k=0;k<NB;k++){
+      #pragma omp simd
+      for(int l=0;l<CPU_LANES;l++){
+	dot[k][l]=(T)0.0;
+      }
+    }
+    const T* atom=&atoms[(size_t)first_atom*nmeas];
+    for(int m=0;m<nmeas;m++){
+      const T* y=&measurements[m*CPU_LANES];
+      for(int k=0;k<NB;k++){
+	T value=atom[k*nmeas+m];
+	#pragma omp simd
+	for(int l=0;l<CPU_LANES;l++){
+	  dot[k][l]+=value*y[l];
+	}
+      }
+    }
+    for(int k=0;k<NB;k++){
+      T norm=norms[first_atom+k];
+      for(int l=0;l<CPU_LANES;l++){
+	T score=dictionary_score(dot[k][l],norm,scale[l]);
+	if(score>best_score[l]){
+	  best_score[l]=score;
+	  best_dot[l]=dot[k][l];
+	  best[l]=first_atom+k;
+	}
+      }
+    }
+  }
+
+  // Searches the voxels [first_voxel,first_voxel+nvox_batch) in the dictionary, one voxel per lane. nvox_batch <= CPU_LANES
+  template <typename T, bool DEBUG>
+  void dictionary_lanes_cpu(
+			    int first_voxel,
+			    int nvox_batch,
+			    int nmeas,
+			    int FixP_Tsize,
+			    T* meas,
+			    T* parameters,
+			    T* FixP,
+			    const Dictionary<T>& dictionary,
+			    int debugVOX)
+  {
+    const int natoms=dictionary.getNatoms();
+    const T* atoms=dictionary.getAtoms();
+    const T* norms=dictionary.getNorms();
+    vector<T> lane_meas(nmeas*CPU_LANES);
+    T scale[CPU_LANES];
+    T best_score[CPU_LANES];
+    T best_dot[CPU_LANES];
+    int best[CPU_LANES];
+
+    for(int l=0;l<CPU_LANES;l++){
+      int idVOX=first_voxel+((l<nvox_batch)?l:0);
+      for(int m=0;m<nmeas;m++){
+	lane_meas[m*CPU_LANES+l]=meas[idVOX*nmeas+m];
+      }
+#ifdef SCALE_FIXP
+      scale[l]=FixP[idVOX*FixP_Tsize+SCALE_FIXP];
+#else
+      scale[l]=(T)1.0;
+#endif
+      best_score[l]=dictionary_min_score<T>();
+      best_dot[l]=(T)0.0;
+      best[l]=-1;
+    }
+
+    int atom=0;
+    for(;atom+DICTIONARY_BLOCK<=natoms;atom+=DICTIONARY_BLOCK){
+      dictionary_block_lanes<T,DICTIONARY_BLOCK>(atom,nmeas,atoms,norms,lane_meas.data(),scale,best_score,best_dot,best);
+    }
+    for(;atom<natoms;atom++){
+      dictionary_block_lanes<T,1>(atom,nmeas,atoms,norms,lane_meas.data(),scale,best_score,best_dot,best);
+    }
+
+    for(int l=0;l<nvox_batch;l++){
+      int idVOX=first_voxel+l;
+      if(best[l]>=0){
+	dictionary.set_parameters(best[l],best_dot[l],&parameters[idVOX*NPARAMS]);
+      }
+      if(DEBUG){
+	if(idVOX==debugVOX){
+	  printf("\n ----- GridSearch CPU dictionary: voxel %i -----\n",debugVOX);
+	  printf("Best atom: %i (of %i), score %f\n",best[l],natoms,best_score[l]);
+	  for(int i=0;i<NPARAMS;i++){
+	    printf("Final Parameter[%i]: %f\n",i,parameters[idVOX*NPARAMS+i]);
+	  }
+	}
+      }
+    }
+  }
+
+  template <typename T>
+  void GridSearch<T>::run_cpu(int nvox, int nmeas,
+			      int CFP_size, int FixP_size,
+			      T* meas, T* params,
+			      T* CFP, T* FixP,
+			      int nstarts, T* starts)
+  {
+    cudimotOptions& opts = cudimotOptions::getInstance();
+    int nthreads=cpu_nthreads(opts.nthreads.value());
+
+    const T* grid=grid_host;
+    const int* gridParams=gridParams_host;
+    const int* bound_types=bound_types_host;
+    const float* bounds_min=bounds_min_host;
+    const float* bounds_max=bounds_max_host;
+    int nGP=nGridParams;
+    int gC=gridCombs;
+    int debugVOX_=debugVOX;
+    bool debug=DEBUG;
+    bool varpro_=varpro;
+    const int* gridSizes=gridSizes_host;
+    int levels=gridLevels;
+    int keep=nstarts;
+    if(levels>1) keep=max(gridKeep,nstarts);
+
+    if(dictionary!=NULL && nstarts==1 && dictionary->prepare(nvox,nmeas,CFP_size,FixP_size,CFP,params,FixP)){
+      const Dictionary<T>& dict=*dictionary;
+      cpu_threads_stats stats=parallel_voxels(nvox,CPU_LANES,nthreads,[&](int first, int last){
+	  for(int batch=first;batch<last;batch+=CPU_LANES){
+	    int nvox_batch=min(CPU_LANES,last-batch);
+	    if(!debug){
+	      dictionary_lanes_cpu<T,false>(batch,nvox_batch,nmeas,FixP_size,meas,params,FixP,dict,debugVOX_);
+	    }else{
+	      dictionary_lanes_cpu<T,true>(batch,nvox_batch,nmeas,FixP_size,meas,params,FixP,dict,debugVOX_);
+	    }
+	  }
+	});
+      report_cpu_threads("GridSearch (dictionary)",stats);
+      return;
+    }
+
+    if(levels>1 || nstarts>1){
+      cpu_threads_stats stats=parallel_voxels(nvox,CPU_LANES,nthreads,[&](int first, int last){
+	  for(int batch=first;batch<last;batch+=CPU_LANES){
+	    int nvox_batch=min(CPU_LANES,last-batch);
+	    if(!debug){
+	      gridSearch_levels_lanes_cpu<T,false>(batch,nvox_batch,nvox,nGP,gridSizes,levels,keep,nmeas,CFP_size,FixP_size,meas,grid,params,CFP,FixP,varpro_,nstarts,starts,debugVOX_,gridParams,bound_types,bounds_min,bounds_max);
+	    }else{
+	      gridSearch_levels_lanes_cpu<T,true>(batch,nvox_batch,nvox,nGP,gridSizes,levels,keep,nmeas,CFP_size,FixP_size,meas,grid,params,CFP,FixP,varpro_,nstarts,starts,debugVOX_,gridParams,bound_types,bounds_min,bounds_max);
+	    }
+	  }
+	});
+      report_cpu_threads((levels>1)?"GridSearch (coarse-to-fine)":"GridSearch",stats);
+      return;
+    }
+
+    cpu_threads_stats stats=parallel_voxels(nvox,CPU_LANES,nthreads,[&](int first, int last){
+	for(int batch=first;batch<last;batch+=CPU_LANES){
+	  int nvox_batch=min(CPU_LANES,last-batch);
+	  if(!debug){
+	    gridSearch_lanes_cpu<T,false>(batch,nvox_batch,nGP,gC,nmeas,CFP_size,FixP_size,meas,grid,params,CFP,FixP,varpro_,debugVOX_,gridParams,bound_types,bounds_min,bounds_max);
+	  }else{
+	    gridSearch_lanes_cpu<T,true>(batch,nvox_batch,nGP,gC,nmeas,CFP_size,FixP_size,meas,grid,params,CFP,FixP,varpro_,debugVOX_,gridParams,bound_types,bounds_min,bounds_max);
+	  }
+	}
+      });
+    report_cpu_threads("GridSearch",stats);
+  }
+
+  // Explicit Instantiations of the template
+  template void GridSearch<float>::run_cpu(int,int,int,int,float*,float*,float*,float*,int,float*);
+  template void GridSearch<double>::run_cpu(int,int,int,int,double*,double*,double*,double*,int,double*);
+}
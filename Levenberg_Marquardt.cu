@@ -11,6 +11,9 @@
 #include "modelparameters.h"
 #include "macro_numerical.h"
 #include "modelfunctions.h"
+#include "Levenberg_Marquardt_transforms.h"
+#include "Levenberg_Marquardt_solvers.h"
+#include "init_gpu.h"
 
 using namespace std;
 
@@ -20,122 +23,11 @@ namespace Cudimot{
 #define THREADS_VOXEL 32 // Multiple of 32: Threads collaborating to compute a voxel. Do not change this, otherwise Synchronization will be needed and shuffles cannot be used
 //Dynamic
 
-#define CFTOL 1.0e-8
-#define LTOL 1.0e20
-#define EPS_gpu 2.0e-16 //Losely based on NRinC 20.1
-#define TwoDivPI 0.636619772367581 //0.6353  // 0.636619772367581
-#define avoidErrors 1e-4 // Avoid maximum and minimums because tan(pi/2) is undefined to inf
-#define SpeedFactor 10 // Speed of Transformations-function
-
   __constant__ int LMbound_types [NPARAMS];
   __constant__ float LMbounds_min [NPARAMS];
   __constant__ float LMbounds_max [NPARAMS];
   __constant__ int LMfixed [NPARAMS];
   
-  __device__ inline bool zero_cf_diff_conv(double* cfold, double* cfnew){
-    return(2.0*fabs(*cfold-*cfnew) <= CFTOL*(fabs(*cfold)+fabs(*cfnew)+EPS_gpu));
-  }
-
-  template <typename T>
-  __device__ inline void MinMaxInvTransform(int idpar, T* params, T* transfParams){
-
-    if(params[idpar]<=((T)LMbounds_min[idpar]+(T)avoidErrors)) params[idpar]+=(T)avoidErrors;
-    if(params[idpar]>=((T)LMbounds_max[idpar]-(T)avoidErrors)) params[idpar]-=(T)avoidErrors;
-    // Avoid maximum and minimum because tan(pi/2) is undefined to inf
-
-    transfParams[idpar] = params[idpar]-(((T)LMbounds_min[idpar]+(T)LMbounds_max[idpar])/(T)2.0);
-    transfParams[idpar] *= ((T)2.0/(((T)LMbounds_max[idpar]-(T)LMbounds_min[idpar])*(T)TwoDivPI));
-    transfParams[idpar] = tan_gpu(transfParams[idpar])*SpeedFactor;
-  }
-  
-  template <typename T>
-  __device__ inline void MinMaxTransform(int idpar, T* params, T* transfParams){ 
-    params[idpar] = (((T)LMbounds_max[idpar]-(T)LMbounds_min[idpar])/(T)2.0);
-    params[idpar] *= atan_gpu(transfParams[idpar]/SpeedFactor);
-    params[idpar] *=  (T)TwoDivPI;
-    params[idpar] += (((T)LMbounds_min[idpar]+(T)LMbounds_max[idpar])/(T)2.0);
-
-    if(params[idpar]<=((T)LMbounds_min[idpar]+(T)avoidErrors)){ 
-      params[idpar]+=(T)avoidErrors;
-      transfParams[idpar] = params[idpar]-(((T)LMbounds_min[idpar]+(T)LMbounds_max[idpar])/(T)2.0);
-      transfParams[idpar] *= ((T)2.0/(((T)LMbounds_max[idpar]-(T)LMbounds_min[idpar])*(T)TwoDivPI));
-      transfParams[idpar] = tan_gpu(transfParams[idpar])*SpeedFactor;
-    }
-    if(params[idpar]>=((T)LMbounds_max[idpar]-(T)avoidErrors)){ 
-      params[idpar]-=(T)avoidErrors;
-      transfParams[idpar] = params[idpar]-(((T)LMbounds_min[idpar]+(T)LMbounds_max[idpar])/(T)2.0);
-      transfParams[idpar] *= ((T)2.0/(((T)LMbounds_max[idpar]-(T)LMbounds_min[idpar])*(T)TwoDivPI));
-      transfParams[idpar] = tan_gpu(transfParams[idpar])*SpeedFactor;
-    }
-    // Avoid maximum and minimum because tan(pi/2) is undefined to inf
-  }
-  
-  template <typename T>
-  __device__ inline void MinInvTransform(int idpar, T* params, T* transfParams){
-    transfParams[idpar] = log_gpu(params[idpar]-(T)LMbounds_min[idpar]);
-  }
-  
-  template <typename T>
-  __device__ inline void MinTransform(int idpar, T* params, T* transfParams){
-    params[idpar] = exp_gpu(transfParams[idpar]) + (T)LMbounds_min[idpar];
-  }
-  template <typename T>
-  __device__ inline void MaxInvTransform(int idpar, T* params, T* transfParams){
-    transfParams[idpar] = log_gpu((T)LMbounds_max[idpar]-params[idpar]);
-  }
-  
-  template <typename T>
-  __device__ inline void MaxTransform(int idpar, T* params, T* transfParams){
-    params[idpar] = (T)LMbounds_max[idpar] - exp_gpu(transfParams[idpar]);
-  }
-
-  template <typename T>
-  __device__ inline void invtransformAll(T* params, T* transfParams){
-    #pragma unroll
-    for(int p=0; p<NPARAMS; p++){	
-      if(LMbound_types[p]==BMIN)
-	      MinInvTransform(p,params,transfParams);
-      else if(LMbound_types[p]==BMAX)
-	      MaxInvTransform(p,params,transfParams);
-      else if(LMbound_types[p]==BMINMAX)
-	      MinMaxInvTransform(p,params,transfParams);
-      else
-	      transfParams[p]=params[p];
-    }
-  }
-
-  template <typename T>
-  __device__ inline void transformAll(T* params, T* transfParams){
-    #pragma unroll
-    for(int p=0; p<NPARAMS; p++){	
-      if(LMbound_types[p]==BMIN)
-	      MinTransform(p,params,transfParams);
-      else if(LMbound_types[p]==BMAX)
-	      MaxTransform(p,params,transfParams);
-      else if(LMbound_types[p]==BMINMAX)
-	      MinMaxTransform(p,params,transfParams);
-      else
-	      params[p]=transfParams[p];
-    }
-  }
-  
-  template <typename T>
-  __device__ inline void derivative_transf(T* transfParams, T* derivatives){
-    #pragma unroll
-    for(int p=0; p<NPARAMS; p++){
-      //if(threadIdx.x==0) printf("Input derivatve %.20f\n",derivatives[p]);
-      if(LMbound_types[p]==BMIN)
-	      derivatives[p]=derivatives[p]*exp_gpu(transfParams[p]);
-      else if(LMbound_types[p]==BMAX)
-	      derivatives[p]=derivatives[p]*(-exp_gpu(transfParams[p]));
-      else if(LMbound_types[p]==BMINMAX){
-        derivatives[p]=derivatives[p]*((LMbounds_max[p]-LMbounds_min[p])/(T)2.0)*(T)TwoDivPI;
-        derivatives[p]=derivatives[p]* ((T)SpeedFactor/ ((T)SpeedFactor*(T)SpeedFactor + transfParams[p]*transfParams[p]));
-      }
-      //else keep the same
-    }
-  }
-  
   template <typename T, bool DEBUG>
   __device__ inline void Cost_Function(
 				       int idSubVOX,
@@ -154,9 +46,11 @@ namespace Cudimot{
     int nmeas2compute = nmeas/THREADS_VOXEL;
     if (idSubVOX<(nmeas%THREADS_VOXEL)) nmeas2compute++;
     
+    T cache[CACHE_SIZE];
+    Prepare_Voxel(parameters,FixP,cache);
     for(int iter=0;iter<nmeas2compute;iter++){
       T* myCFP = &CFP[idMeasurement*CFP_Tsize];
-      T pred_error=Predicted_Signal(NPARAMS,parameters,myCFP,FixP);
+      T pred_error=Predicted_Signal(NPARAMS,parameters,myCFP,FixP,cache);
       
       if(DEBUG){
         int idVOX= (blockIdx.x*VOXELS_BLOCK)+int(threadIdx.x/THREADS_VOXEL);
@@ -185,32 +79,44 @@ namespace Cudimot{
     }
   }
   
+  // Gradient and Hessian in a single pass over the measurements: the predicted signal and the derivatives of each measurement are computed once
+  // If cost is not NULL, the cost function (sum of squared residuals) is also accumulated in this pass
   template <typename T, bool DEBUG>
-  __device__ inline void Calculate_Gradient(
-					    int idSubVOX,
-					    int nmeas,
-					    int CFP_Tsize,
-					    T* measurements,
-					    T* parameters,
-					    T* params_transf,
-					    T* CFP,
-					    T* FixP,
-					    T* Gradient,
-					    int debugVOX)
+  __device__ inline void Calculate_Gradient_Hessian(
+						    int idSubVOX,
+						    int nmeas,
+						    int CFP_Tsize,
+						    T* measurements,
+						    T* parameters,
+						    T* params_transf,
+						    T* CFP,
+						    T* FixP,
+						    T* Gradient,
+						    T* Hessian,
+						    double* cost,
+						    int debugVOX)
   {
     int idMeasurement=idSubVOX;
     T myderivatives[NPARAMS];
+    T accumulated_error=(T)0.0;
     
     int max_iters = nmeas/THREADS_VOXEL;
     if(nmeas%THREADS_VOXEL) max_iters++;
 
+    // Only the upper triangle of the Hessian is used (see Levenberg_Marquardt_solvers.h)
     if(idSubVOX==0){
       #pragma unroll
       for(int p=0;p<NPARAMS;p++){
 	      Gradient[p]=(T)0.0;
+        #pragma unroll
+        for(int p2=p;p2<NPARAMS;p2++){
+          Hessian[p*NPARAMS+p2]=(T)0.0;
+        }
       }
     }
     
+    T cache[CACHE_SIZE];
+    Prepare_Voxel(parameters,FixP,cache);
     for(int iter=0;iter<max_iters;iter++){
       #pragma unroll
       for(int p=0;p<NPARAMS;p++){
@@ -221,11 +127,11 @@ namespace Cudimot{
       T pred_error=(T)0.0;
       
       if(idMeasurement<nmeas){
-        pred_error=Predicted_Signal(NPARAMS,parameters,myCFP,FixP);
+        Signal_And_Derivatives(NPARAMS,parameters,myCFP,FixP,cache,pred_error,myderivatives);
         pred_error=pred_error-measurements[idMeasurement];
+        accumulated_error+=pred_error*pred_error;
         
-        Partial_Derivatives(NPARAMS,parameters,myCFP,FixP,myderivatives);
-        derivative_transf(params_transf,myderivatives);
+        derivative_transf(params_transf,myderivatives,LMbound_types,LMbounds_min,LMbounds_max);
 
         if(DEBUG){
           int idVOX= (blockIdx.x*VOXELS_BLOCK)+int(threadIdx.x/THREADS_VOXEL);
@@ -236,6 +142,22 @@ namespace Cudimot{
           }
         }
       }
+
+      // J^T J is symmetric: only the upper triangle is reduced
+      #pragma unroll
+      for(int p=0;p<NPARAMS;p++){
+        #pragma unroll
+        for(int p2=p;p2<NPARAMS;p2++){
+          T element = (T)2.0 * myderivatives[p] * myderivatives[p2];
+          #pragma unroll
+          for (int offset=THREADS_VOXEL/2; offset>0; offset>>=1){
+            element+= shfl_down(element,offset);
+          }
+          if(idSubVOX==0){
+            Hessian[p*NPARAMS+p2]+=element;
+          }
+        }
+      }
       
       #pragma unroll 
       for(int p=0;p<NPARAMS;p++){
@@ -255,161 +177,197 @@ namespace Cudimot{
         }
       }
       idMeasurement+=THREADS_VOXEL;
-    }  
-  }
-
-  template <typename T>
-  __device__ inline void Calculate_Hessian(
-					   int idSubVOX,
-					   int nmeas,
-					   int CFP_Tsize,
-					   T* measurements,
-					   T* parameters,
-					   T* params_transf,
-					   T* CFP,
-					   T* FixP,
-					   T* Hessian)
-  {
-    int idMeasurement=idSubVOX;
-    T myderivatives[NPARAMS];
-    
-    int max_dir = nmeas/THREADS_VOXEL;
-    if(nmeas%THREADS_VOXEL) max_dir++;
-    
+    }
     if(idSubVOX==0){
       #pragma unroll
       for(int p=0;p<NPARAMS;p++){
         #pragma unroll
-        for(int p2=0;p2<NPARAMS;p2++){
-          Hessian[p*NPARAMS+p2]=(T)0.0;
+        for(int p2=p;p2<NPARAMS;p2++){
+          if(LMfixed[p] || LMfixed[p2]){
+            if(p==p2) Hessian[p*NPARAMS+p2]=(T)1.0;
+            else Hessian[p*NPARAMS+p2]=(T)0.0;
+          }
         }
       }
     }
-
-    for(int iter=0;iter<max_dir;iter++){
-
-      T* myCFP = &CFP[idMeasurement*CFP_Tsize];
-
+    if(cost!=NULL){
       #pragma unroll
-      for(int p=0;p<NPARAMS;p++){
-	      myderivatives[p]=(T)0.0;
+      for(int offset=THREADS_VOXEL/2; offset>0; offset>>=1){
+        accumulated_error+= shfl_down(accumulated_error,offset);
       }
-      T pred_error=(T)0.0;
+      if(idSubVOX==0){
+        *cost=accumulated_error;
+      }
+    }
+  }
+  
+#if NLINEAR>0
+  // Solves the linear parameters of the model for the current nonlinear parameters (see linear_parameters.h): the normal equations are accumulated by all the threads of the voxel and the leader solves them
+  // The leader sets the linear parameters in params and their transformation in params_transf
+  template <typename T, bool DEBUG>
+  __device__ inline void Solve_Linear(
+				      int idSubVOX,
+				      int nmeas,
+				      int CFP_Tsize,
+				      T* measurements,
+				      T* params,
+				      T* params_transf,
+				      T* CFP,
+				      T* FixP,
+				      int debugVOX)
+  {
+    int idMeasurement=idSubVOX;
+    T BtB[NLINEAR*NLINEAR];
+    T Bty[NLINEAR];
+    T basis[NLINEAR];
 
-      if(idMeasurement<nmeas){
-        pred_error=Predicted_Signal(NPARAMS,parameters,myCFP,FixP);
-        pred_error=pred_error-measurements[idMeasurement];
-        Partial_Derivatives(NPARAMS,parameters,myCFP,FixP,myderivatives);
-        derivative_transf(params_transf,myderivatives);
+    #pragma unroll
+    for(int j=0;j<NLINEAR;j++){
+      Bty[j]=(T)0.0;
+      #pragma unroll
+      for(int k=0;k<NLINEAR;k++){
+        BtB[j*NLINEAR+k]=(T)0.0;
       }
- 
+    }
+    
+    int nmeas2compute = nmeas/THREADS_VOXEL;
+    if (idSubVOX<(nmeas%THREADS_VOXEL)) nmeas2compute++;
+    
+    T cache[CACHE_SIZE];
+    Prepare_Voxel(params,FixP,cache);
+    for(int iter=0;iter<nmeas2compute;iter++){
+      T* myCFP = &CFP[idMeasurement*CFP_Tsize];
+      Linear_Basis(NPARAMS,params,myCFP,FixP,cache,basis);
+      accumulate_linear(basis,measurements[idMeasurement],BtB,Bty);
+      idMeasurement+=THREADS_VOXEL;
+    }
+
+    #pragma unroll
+    for(int j=0;j<NLINEAR;j++){
       #pragma unroll
-      for(int p=0;p<NPARAMS;p++){
+      for(int k=j;k<NLINEAR;k++){
         #pragma unroll
-        for(int p2=0;p2<NPARAMS;p2++){
-          T element = (T)2.0 * myderivatives[p] * myderivatives[p2];
-          #pragma unroll
-          for (int offset=THREADS_VOXEL/2; offset>0; offset>>=1){
-            element+= shfl_down(element,offset);
-          }
-          if(idSubVOX==0){
-            Hessian[p*NPARAMS+p2]+=element;
-          }
+        for(int offset=THREADS_VOXEL/2; offset>0; offset>>=1){
+          BtB[j*NLINEAR+k]+= shfl_down(BtB[j*NLINEAR+k],offset);
         }
       }
-      idMeasurement+=THREADS_VOXEL;
+      #pragma unroll
+      for(int offset=THREADS_VOXEL/2; offset>0; offset>>=1){
+        Bty[j]+= shfl_down(Bty[j],offset);
+      }
     }
     if(idSubVOX==0){
-      #pragma unroll
-      for(int p=0;p<NPARAMS;p++){
+      T coeffs[NLINEAR];
+      if(nnls_linear(BtB,Bty,coeffs)){
+        set_linear_parameters(coeffs,params,LMbound_types,LMbounds_min,LMbounds_max);
         #pragma unroll
-        for(int p2=0;p2<NPARAMS;p2++){
-          if(LMfixed[p] || LMfixed[p2]){
-            if(p==p2) Hessian[p*NPARAMS+p2]=(T)1.0;
-            else Hessian[p*NPARAMS+p2]=(T)0.0;
+        for(int i=0;i<NLINEAR;i++){
+          invtransform(linear_param(i),params,params_transf,LMbound_types,LMbounds_min,LMbounds_max);
+        }
+      }
+      if(DEBUG){
+        int idVOX= (blockIdx.x*VOXELS_BLOCK)+int(threadIdx.x/THREADS_VOXEL);
+        if(idVOX==debugVOX){
+          for(int i=0;i<NLINEAR;i++){
+            printf("Linear Parameter[%i]: %f   ",linear_param(i),params[linear_param(i)]);
           }
+          printf("\n");
         }
       }
     }
   }
+#endif
   
-  // Hessian * X  =  Gradient -> Calculate X
+  // Hessian * X  =  Gradient -> Calculate X, with Hessian = L * L^T
+  // Cholesky factorization in parallel: each thread contains a column of the Hessian, and then of L, so NPARAMS<THREADS_VOXEL. Only the upper triangle of the Hessian is read
+  // The damped Hessian is positive definite in exact arithmetic. Returns false in all the threads (and does not write Solution) if a pivot is not positive
   template <typename T>
-  __device__ inline void LUsolver(int idSubVOX,
-				  T* Hessian,
-				  T* Gradient,
-				  T* Solution){
-    
-    // If NPARAMS > 32 the current version of the method will fail !!
-    // Need to generalise
+  __device__ inline bool Cholesky_warp(int idSubVOX,
+				       T* Hessian,
+				       T* Gradient,
+				       T* Solution){
     
-    T col_elems[NPARAMS];
+    T col_elems[NPARAMS]; // column idSubVOX
+    T colk[NPARAMS]; // column k of L, the same in all the threads
+    T x[NPARAMS]; // solution, the same in all the threads
     T pivot;
+    T Ljk=(T)0.0; // L[idSubVOX][k]
     
-    // Initialise Matrix. Each thread contains a column of the Hessian and one thread the Gradient column:   Matrix = [Hessian | Gradient]
-    if (idSubVOX<NPARAMS){
-      #pragma unroll
-      for(int p=0;p<NPARAMS;p++){
-	      col_elems[p] = Hessian[p*NPARAMS+idSubVOX];
+    // Initialise Matrix. Each thread contains a column of the Hessian: the elements under the diagonal are the transposed upper triangle
+    #pragma unroll
+    for(int p=0;p<NPARAMS;p++){
+      col_elems[p]=(T)0.0;
+      if(idSubVOX<NPARAMS){
+        if(p<=idSubVOX) col_elems[p]=Hessian[p*NPARAMS+idSubVOX];
+        else col_elems[p]=Hessian[idSubVOX*NPARAMS+p];
       }
-    }else if(idSubVOX==NPARAMS){
+    }
+
+    // Factorization: at step k, the thread k finishes the column k of L and the threads of the columns j>k subtract L[:][k]*L[j][k]
+    #pragma unroll
+    for(int k=0;k<NPARAMS;k++){
+      pivot=shfl(col_elems[k],k);
+      // All the threads have the same pivot. Also catches NaN
+      if(!(pivot>(T)0.0)) return false;
+      pivot=sqrt_gpu(pivot);
       #pragma unroll
-      for(int p=0;p<NPARAMS;p++){
-	      col_elems[p] = Gradient[p];
+      for(int p=k+1;p<NPARAMS;p++){
+        colk[p]=shfl(col_elems[p],k)/pivot;
+        if(p==idSubVOX) Ljk=colk[p];
       }
-    }else{
-      #pragma unroll
-      for(int p=0;p<NPARAMS;p++){
-	      col_elems[p] = (T)0.0;
+      if(idSubVOX==k){
+        col_elems[k]=pivot;
+        #pragma unroll
+        for(int p=k+1;p<NPARAMS;p++){
+          col_elems[p]=colk[p];
+        }
+      }else if(idSubVOX>k){
+        // Only the rows p>=idSubVOX are used later
+        #pragma unroll
+        for(int p=k+1;p<NPARAMS;p++){
+          col_elems[p]-=colk[p]*Ljk;
+        }
       }
     }
-    
-    // Solve in two steps: 
-    // Forward step: Zero's under diagonal
-    // Backward step: Zero's above diagonal
 
-    // Forward step
+    // Forward substitution: L * y = Gradient. The column k of L is in the thread k
     #pragma unroll
-    for (int col=0; col<NPARAMS; col++){
-      // Divide row by diagonal element (1 in the diagonal)
-      // Cannot have negative numbers in the diagonal -r/-r = +1
-      pivot = col_elems[col];
-      pivot = shfl(pivot,col);
-      col_elems[col] = col_elems[col]/pivot; 
-      
-      // Eliminate all terms under diagonal element (1)
-      // Pivot is the element to make zero, Pivot-Pivot*1 = 0
-      // This_row = This_row - Pivot * row_of_diagonal_element
+    for(int p=0;p<NPARAMS;p++){
+      x[p]=Gradient[p];
+    }
+    #pragma unroll
+    for(int k=0;k<NPARAMS;k++){
+      x[k]=x[k]/shfl(col_elems[k],k);
       #pragma unroll
-      for (int row=col+1; row<NPARAMS; row++){
-        pivot  = col_elems[row];
-        pivot  = shfl(pivot,col);
-        col_elems[row] -= pivot*col_elems[col];
+      for(int p=k+1;p<NPARAMS;p++){
+        x[p]-=shfl(col_elems[p],k)*x[k];
       }
     }
 
-    // Backward step
+    // Backward substitution: L^T * X = y. The row k of L^T is in the thread k
     #pragma unroll
-    for (int col=NPARAMS-1; col>0; col--) {
-      // Eliminate all terms above diagonal element
-      for (int row=0; row<col; row++) {
-        pivot  = col_elems[row];
-        pivot  = shfl(pivot,col);
-        col_elems[row] -= pivot*col_elems[col];
+    for(int k=NPARAMS-1;k>=0;k--){
+      T value=x[k];
+      #pragma unroll
+      for(int p=k+1;p<NPARAMS;p++){
+        value-=col_elems[p]*x[p];
       }
+      x[k]=shfl(value/col_elems[k],k);
     }
 
-    if(idSubVOX==NPARAMS){
+    if(idSubVOX==0){
       #pragma unroll
       for(int p=0;p<NPARAMS;p++){
-	      Solution[p] = col_elems[p];
+	      Solution[p]=x[p];
       }
     }
-    
+    return true;
   }
   
+  // With several starting points (--multistart), each one is fitted as a voxel: the voxel idVOX has the measurements and fixed parameters of the voxel idVOX%nvox_meas, and its final cost is written to costs
   template <typename T, bool MARQUARDT, bool DEBUG>
   __global__ void levenberg_kernel(
+				   int nvox_meas, // voxels with measurements
 				   int nmeas, // nmeasurements
 				   int CFP_Tsize, // common fixed params: size*M-measurements
 				   int FixP_Tsize, // fixed params: size*Nvoxels 
@@ -418,6 +376,8 @@ namespace Cudimot{
 				   T* CFP_global, // common fixed model parameters
 				   T* FixP, // fixed model parameters
 				   int nmax_iters,
+				   bool varpro, // solve the linear parameters (--varpro)
+				   double* costs, // final cost of each voxel, NULL if not needed
 				   int debugVOX)
 {
   // 1 block of threads process several voxels
@@ -454,8 +414,8 @@ namespace Cudimot{
   ///////////////////////////////////////////////////////////
 
   ///////// each voxel/warp of the block points to its data///////////
-  meas = &meas[idVOX*nmeas]; //Global memory
-  FixP = &FixP[idVOX*FixP_Tsize]; // Global memory
+  meas = &meas[(idVOX%nvox_meas)*nmeas]; //Global memory
+  FixP = &FixP[(idVOX%nvox_meas)*FixP_Tsize]; // Global memory
   pcf = &pcf[idVOX_inBlock];
   ncf = &ncf[idVOX_inBlock];
   lambda = &lambda[idVOX_inBlock];
@@ -501,18 +461,20 @@ namespace Cudimot{
         printf("\n--------------------------------------------------------\n");
       }
     }
-    invtransformAll(params,params_transf); //calculate params_transf  
+    invtransformAll(params,params_transf,LMbound_types,LMbounds_min,LMbounds_max); //calculate params_transf  
   }
   // __threadfence_block();
   __syncthreads();
   ///////////////////////////////////////////
 
-  Cost_Function<T,DEBUG>(idSubVOX,nmeas,CFP_Tsize,meas,params,CFP,FixP,pcf,debugVOX);
-  if(DEBUG){
-    if(idVOX==debugVOX&&leader){
-      printf("--------------------------------------------------------\n");  
-    }
+#if NLINEAR>0
+  if(varpro){
+    Solve_Linear<T,DEBUG>(idSubVOX,nmeas,CFP_Tsize,meas,params,params_transf,CFP,FixP,debugVOX);
+    __syncthreads();
   }
+#endif
+
+  // The initial cost is computed in the first pass of Calculate_Gradient_Hessian
     
   while (!( (*success) && iter++>=nmax_iters)){
     //if success we don't increase niter (first condition is true)
@@ -525,8 +487,7 @@ namespace Cudimot{
     }
 
     if(*success){
-      Calculate_Gradient<T,DEBUG>(idSubVOX,nmeas,CFP_Tsize,meas,params,params_transf,CFP,FixP,Gradient,debugVOX);
-      Calculate_Hessian(idSubVOX,nmeas,CFP_Tsize,meas,params,params_transf,CFP,FixP,Hessian);
+      Calculate_Gradient_Hessian<T,DEBUG>(idSubVOX,nmeas,CFP_Tsize,meas,params,params_transf,CFP,FixP,Gradient,Hessian,(iter==1)?pcf:NULL,debugVOX);
     }
         
     if(leader){
@@ -541,16 +502,24 @@ namespace Cudimot{
 
     //__threadfence_block(); // Hessian & Gradient updated
     __syncthreads();    
-    LUsolver(idSubVOX,Hessian,Gradient,step);
-    // Hessian & Gradient updated // LU solution updated by thread(NPARAMS)
-    __syncthreads(); 
+
+    // false if the Hessian is singular: the step is rejected
+    bool solved=false;
+    if(NPARAMS<THREADS_VOXEL){
+      // The leader writes the solution
+      solved=Cholesky_warp(idSubVOX,Hessian,Gradient,step);
+    }
 
     if(leader){
+      if(!solved){
+        // NPARAMS>=THREADS_VOXEL or the Hessian is not positive definite: the leader solves the system with Cholesky, or pivoting
+        solved=LMsolver(Hessian,Gradient,step);
+      }
       #pragma unroll
       for(int p=0;p<NPARAMS;p++){
 	      step[p]=params_transf[p]-step[p];
       }
-      transformAll(params,step);
+      transformAll(params,step,LMbound_types,LMbounds_min,LMbounds_max);
 
       if(DEBUG){
         if(idVOX==debugVOX){
@@ -568,12 +537,19 @@ namespace Cudimot{
     
     //__threadfence_block();  // params updated
     __syncthreads(); 
+#if NLINEAR>0
+    if(varpro){
+      // The step of the linear parameters is replaced by their solution at the proposed nonlinear parameters
+      Solve_Linear<T,DEBUG>(idSubVOX,nmeas,CFP_Tsize,meas,params,step,CFP,FixP,debugVOX);
+      __syncthreads();
+    }
+#endif
     Cost_Function<T,DEBUG>(idSubVOX,nmeas,CFP_Tsize,meas,params,CFP,FixP,ncf,debugVOX);
     //__threadfence_block(); // Leader may be faster an update params
     __syncthreads(); 
 
     if(leader){
-      if ( *success = ((*ncf) < (*pcf))){ 
+      if ( *success = (solved && (*ncf) < (*pcf))){ 
 	      *olambda = 0.0;
         #pragma unroll
         for(int i=0;i<NPARAMS;i++){
@@ -592,7 +568,7 @@ namespace Cudimot{
           *end=true;
         }
         // undo step in parameters
-        transformAll(params,params_transf);
+        transformAll(params,params_transf,LMbound_types,LMbounds_min,LMbounds_max);
       }
       if(DEBUG){
         if(idVOX==debugVOX){
@@ -609,6 +585,16 @@ namespace Cudimot{
   if(leader){
     // Change parameters if needed: FixConstraints()
     FixConstraintsLM(NPARAMS,params);
+  }
+  if(costs!=NULL){
+    // Cost of the final parameters, to choose the best starting point. Only the threads of the voxel use its parameters
+    __syncwarp();
+    Cost_Function<T,false>(idSubVOX,nmeas,CFP_Tsize,meas,params,CFP,FixP,pcf,debugVOX);
+    if(leader){
+      costs[idVOX]=*pcf;
+    }
+  }
+  if(leader){
     // save parameters in global
     #pragma unroll
     for(int i=0;i<NPARAMS;i++){
@@ -624,7 +610,30 @@ namespace Cudimot{
   }
 }
   
-  
+
+  // Parameters of each voxel from its starting point with the lowest cost (--multistart)
+  template <typename T>
+  __global__ void select_start_kernel(
+				      int nvox,
+				      int nstarts,
+				      T* starts, // fitted starting points: start s of voxel v at (s*nvox+v)*NPARAMS
+				      double* costs, // cost of each starting point
+				      T* parameters) // model parameters
+  {
+    int idVOX=blockIdx.x*blockDim.x+threadIdx.x;
+    if(idVOX>=nvox) return;
+    int best=0;
+    for(int s=1;s<nstarts;s++){
+      if(costs[s*nvox+idVOX]<costs[best*nvox+idVOX] || costs[best*nvox+idVOX]!=costs[best*nvox+idVOX]){
+	best=s;
+      }
+    }
+    #pragma unroll
+    for(int i=0;i<NPARAMS;i++){
+      parameters[idVOX*NPARAMS+i]=starts[(best*nvox+idVOX)*NPARAMS+i];
+    }
+  }
+    
   template <typename T>
   Levenberg_Marquardt<T>::Levenberg_Marquardt(vector<int> bou_types, 
 					      vector<T> bou_min, 
@@ -657,11 +666,26 @@ namespace Cudimot{
        fixed_host[p]=fix[p];
     }
 
-    cudaMemcpyToSymbol(LMbound_types,bound_types_host,NPARAMS*sizeof(int));
-    cudaMemcpyToSymbol(LMbounds_min,bounds_min_host,NPARAMS*sizeof(float));
-    cudaMemcpyToSymbol(LMbounds_max,bounds_max_host,NPARAMS*sizeof(float));
-    cudaMemcpyToSymbol(LMfixed,fixed_host,NPARAMS*sizeof(int));
-    sync_check("Levenberg_Marquardt: Setting Bounds - Constant Memory");
+    varpro=false;
+#if NLINEAR>0
+    if(opts.varpro.value()){
+      varpro=true;
+      for(int i=0;i<NLINEAR;i++){
+	if(fixed_host[linear_param(i)]){
+	  cerr << "Warning: the linear parameter " << linear_param(i) << " is fixed. Levenberg-Marquardt does not solve the linear parameters (--varpro)" << endl;
+	  varpro=false;
+	}
+      }
+    }
+#endif
+
+    if(!cpu_backend()){
+      cudaMemcpyToSymbol(LMbound_types,bound_types_host,NPARAMS*sizeof(int));
+      cudaMemcpyToSymbol(LMbounds_min,bounds_min_host,NPARAMS*sizeof(float));
+      cudaMemcpyToSymbol(LMbounds_max,bounds_max_host,NPARAMS*sizeof(float));
+      cudaMemcpyToSymbol(LMfixed,fixed_host,NPARAMS*sizeof(int));
+      sync_check("Levenberg_Marquardt: Setting Bounds - Constant Memory");
+    }
   }
   
   template <typename T>
@@ -670,8 +694,35 @@ namespace Cudimot{
 				   int CFP_size, int FixP_size,
 				   T* meas,
 				   T* params,
-				   T* CFP, T* FixP) 
+				   T* CFP, T* FixP,
+				   int nstarts, T* starts)
   {
+    if(cpu_backend()){
+      run_cpu(nvox,nmeas,CFP_size,FixP_size,meas,params,CFP,FixP,nstarts,starts);
+    }else{
+      run_gpu(nvox,nmeas,CFP_size,FixP_size,meas,params,CFP,FixP,nstarts,starts);
+    }
+  }
+
+  template <typename T>
+  void Levenberg_Marquardt<T>::run_gpu(
+				       int nvox, int nmeas,
+				       int CFP_size, int FixP_size,
+				       T* meas,
+				       T* params,
+				       T* CFP, T* FixP,
+				       int nstarts, T* starts)
+  {
+    // With several starting points, all of them are fitted as voxels with the measurements of their voxel
+    int nfit=nvox;
+    T* fit_params=params;
+    double* costs=NULL;
+    if(nstarts>1){
+      nfit=nstarts*nvox;
+      fit_params=starts;
+      cudaMalloc((void**)&costs,nfit*sizeof(double));
+      sync_check("Levenberg_Marquardt: Allocating the costs of the starting points");
+    }
     
     long int amount_shared_mem = 0;
     amount_shared_mem += 4*VOXELS_BLOCK*sizeof(double); // Levenberg parameters
@@ -686,23 +737,31 @@ namespace Cudimot{
     cout << "Shared Memory used in Levenberg-Marquardt kernel: " << amount_shared_mem << endl;
     
     int threads_block = VOXELS_BLOCK * THREADS_VOXEL;
-    int nblocks=(nvox/VOXELS_BLOCK);
-    if(nvox%VOXELS_BLOCK) nblocks++;
+    int nblocks=(nfit/VOXELS_BLOCK);
+    if(nfit%VOXELS_BLOCK) nblocks++;
     
     if(!DEBUG){
       if(Marquardt){
-	      levenberg_kernel<T,true,false><<<nblocks,threads_block,amount_shared_mem>>>(nmeas,CFP_size,FixP_size,meas,params,CFP,FixP,max_iterations,debugVOX);
+	      levenberg_kernel<T,true,false><<<nblocks,threads_block,amount_shared_mem>>>(nvox,nmeas,CFP_size,FixP_size,meas,fit_params,CFP,FixP,max_iterations,varpro,costs,debugVOX);
       }else{
-	      levenberg_kernel<T,false,false><<<nblocks,threads_block,amount_shared_mem>>>(nmeas,CFP_size,FixP_size,meas,params,CFP,FixP,max_iterations,debugVOX);
+	      levenberg_kernel<T,false,false><<<nblocks,threads_block,amount_shared_mem>>>(nvox,nmeas,CFP_size,FixP_size,meas,fit_params,CFP,FixP,max_iterations,varpro,costs,debugVOX);
       }
     }else{
       if(Marquardt){
-	      levenberg_kernel<T,true,true><<<nblocks,threads_block,amount_shared_mem>>>(nmeas,CFP_size,FixP_size,meas,params,CFP,FixP,max_iterations,debugVOX);
+	      levenberg_kernel<T,true,true><<<nblocks,threads_block,amount_shared_mem>>>(nvox,nmeas,CFP_size,FixP_size,meas,fit_params,CFP,FixP,max_iterations,varpro,costs,debugVOX);
       }else{
-	      levenberg_kernel<T,false,true><<<nblocks,threads_block,amount_shared_mem>>>(nmeas,CFP_size,FixP_size,meas,params,CFP,FixP,max_iterations,debugVOX);
+	      levenberg_kernel<T,false,true><<<nblocks,threads_block,amount_shared_mem>>>(nvox,nmeas,CFP_size,FixP_size,meas,fit_params,CFP,FixP,max_iterations,varpro,costs,debugVOX);
       }
     }
     sync_check("Levenberg_Marquardt Kernel");
+
+    if(nstarts>1){
+      int threads_select=256;
+      int nblocks_select=(nvox+threads_select-1)/threads_select;
+      select_start_kernel<T><<<nblocks_select,threads_select>>>(nvox,nstarts,starts,costs,params);
+      sync_check("Levenberg_Marquardt: Selecting the best starting point");
+      cudaFree(costs);
+    }
   }
   
   // Explicit Instantiations of the template
@@ -61,6 +61,11 @@ namespace Cudimot{
      */
     int* fixed_host;
 
+    /**
+     * Solve the linear parameters of the model in closed form (--varpro, see linear_parameters.h)
+     */
+    bool varpro;
+
     /**
      * Activate debugging messages for a voxel. It prints the value of some variables at certain steps of Levenberg_Marquardt (Parameters, PredictedSignal, Derivatives, Gradient, Proposed Parameters)
      */
@@ -82,6 +87,15 @@ namespace Cudimot{
      */
     Levenberg_Marquardt(vector<int> bound_types, vector<T> bounds_min, vector<T> bounds_max,vector<int> fixed);
 
+    /**
+     * Run Levenberg-Marquardt on the backend selected with --backend (see cpu_backend): run_gpu() or run_cpu(). The pointers are in the memory of the part, on the GPU or on the host (see allocate_part)
+     */
+    void run( int nvox, int nmeas,
+	      int CFP_size, int FixP_size,
+	      T* meas, T* params,
+	      T* CFP, T* FixP,
+	      int nstarts, T* starts);
+
     /**
      * Run Levenberg-Marquard on the GPU
      * @param nvox Number of voxels in the dataset
@@ -92,11 +106,23 @@ namespace Cudimot{
      * @param params Value of the parameters to estimate of the model for all the voxels of the dataset (on GPU)
      * @param CFP Common (to all the voxels) fixed parameters of the model (on GPU). CFP_size*nmeas
      * @param FixP Fixed parameters of the model (on GPU). FixP_size*nvoxels
+     * @param nstarts Number of starting points of each voxel (--multistart)
+     * @param starts Starting points of each voxel (on GPU), written by GridSearch: start s of voxel v at (s*nvox+v)*NPARAMS. All of them are fitted and the one with the lowest cost is written to params. NULL if nstarts is 1
      */
-    void run( int nvox, int nmeas,
-	      int CFP_size, int FixP_size,
-	      T* meas, T* params,
-	      T* CFP, T* FixP);
+    void run_gpu( int nvox, int nmeas,
+		  int CFP_size, int FixP_size,
+		  T* meas, T* params,
+		  T* CFP, T* FixP,
+		  int nstarts, T* starts);
+
+    /**
+     * Run Levenberg-Marquard on the CPU. The voxels are distributed among several threads (--nthreads). Same arguments than run_gpu(), but all the pointers are in host memory
+     */
+    void run_cpu( int nvox, int nmeas,
+		  int CFP_size, int FixP_size,
+		  T* meas, T* params,
+		  T* CFP, T* FixP,
+		  int nstarts, T* starts);
   };
 }
 
@@ -0,0 +1,599 @@
+/* Levenberg_Marquardt_cpu.cc
+
+   Levenberg-Marquardt algorithm on the CPU. It is the same algorithm as the GPU version (Levenberg_Marquardt.cu): same transformations of the parameters, damping and convergence criteria. The voxels are distributed among a pool of threads. Each thread iterates CPU_LANES voxels in lockstep, one voxel per SIMD lane (cpu_lanes.h), so the model functions are evaluated for all of them with vector instructions. When a voxel converges it is written to the output and its lane takes the next voxel of the thread, so the lanes stay busy while a few voxels reach the maximum number of iterations.
+
+   With several starting points for each voxel (--multistart), every starting point is fitted as another voxel of the stream, with the measurements of its voxel, and the one with the lowest cost is kept.
+
+   This file is compiled with the host compiler (not nvcc), so the model functions are compiled as host functions.
+
+   agent
+
+   Copyright (C) 2026 University of Oxford */
+
+/* CCOPYRIGHT */
+
+#include <cstdio>
+#include <vector>
+#include "Levenberg_Marquardt.h"
+#include "functions_gpu.h"
+#include "modelparameters.h"
+#include "macro_numerical.h"
+#include "modelfunctions.h"
+#include "Levenberg_Marquardt_transforms.h"
+#include "Levenberg_Marquardt_solvers.h"
+#include "cpu_threads.h"
+#include "cpu_lanes.h"
+
+using namespace std;
+
+namespace Cudimot{
+
+
+  template <typename T, bool DEBUG>
+  inline void Cost_Function_lanes(
+				  const int* lane_voxel, // voxel of each lane (for debugging)
+				  int nmeas,
+				  int CFP_Tsize,
+				  T* measurements, // [nmeas][CPU_LANES]
+				  T parameters[][CPU_LANES],
+				  T* CFP,
+				  T* const* FixP,
+				  double* cost,
+				  int debugVOX)
+  {
+    T accumulated_error[CPU_LANES];
+    T signal[CPU_LANES];
+    T cache[CACHE_SIZE][CPU_LANES];
+    Prepare_Voxel_lanes(parameters,FixP,cache);
+    for(int l=0;l<CPU_LANES;l++){
+      accumulated_error[l]=(T)0.0;
+    }
+    for(int idMeasurement=0;idMeasurement<nmeas;idMeasurement++){
+      T* myCFP = &CFP[idMeasurement*CFP_Tsize];
+      T* mymeas = &measurements[idMeasurement*CPU_LANES];
+      Predicted_Signal_lanes(parameters,cache,myCFP,FixP,signal);
+      if(DEBUG){
+	for(int l=0;l<CPU_LANES;l++){
+	  if(lane_voxel[l]==debugVOX){
+	    printf("PredictedSignal[%i]: %f\n",idMeasurement,signal[l]);
+	  }
+	}
+      }
+      #pragma omp simd
+      for(int l=0;l<CPU_LANES;l++){
+	T pred_error=signal[l]-mymeas[l];
+	accumulated_error[l]+=pred_error*pred_error;
+      }
+    }
+    for(int l=0;l<CPU_LANES;l++){
+      cost[l]=accumulated_error[l];
+      if(DEBUG){
+	if(lane_voxel[l]==debugVOX){
+	  printf("COST FUNTION: %f\n",cost[l]);
+	}
+      }
+    }
+  }
+
+  // Predicted signal and its derivatives with respect to the transformed parameters, for all the lanes
+  template <typename T>
+  inline void Signal_Derivatives_transf_lanes(
+					      T parameters[][CPU_LANES],
+					      T params_transf[][CPU_LANES],
+					      T cache[][CPU_LANES],
+					      T* CFP,
+					      T* const* FixP,
+					      T* signal,
+					      T derivatives[][CPU_LANES],
+					      const int* bound_types,
+					      const float* bounds_min,
+					      const float* bounds_max)
+  {
+    Signal_And_Derivatives_lanes(parameters,cache,CFP,FixP,signal,derivatives);
+    #pragma GCC ivdep
+    for(int l=0;l<CPU_LANES;l++){
+      T pt[NPARAMS];
+      T d[NPARAMS];
+      for(int p=0;p<NPARAMS;p++){
+	pt[p]=params_transf[p][l];
+	d[p]=derivatives[p][l];
+      }
+      derivative_transf(pt,d,bound_types,bounds_min,bounds_max);
+      for(int p=0;p<NPARAMS;p++){
+	derivatives[p][l]=d[p];
+      }
+    }
+  }
+
+  // Gradient and Hessian in a single pass over the measurements: the predicted signal and the derivatives of each measurement are computed once, and the cost (sum of squared residuals) is accumulated at the same time
+  // Only the lanes with update[lane] are modified in Gradient and Hessian. The cost is computed for all the lanes
+  template <typename T, bool DEBUG>
+  inline void Calculate_Gradient_Hessian_lanes(
+					       const int* lane_voxel, // voxel of each lane (for debugging)
+					       int nmeas,
+					       int CFP_Tsize,
+					       T* measurements, // [nmeas][CPU_LANES]
+					       T parameters[][CPU_LANES],
+					       T params_transf[][CPU_LANES],
+					       T* CFP,
+					       T* const* FixP,
+					       T Gradient[][CPU_LANES],
+					       T Hessian[][CPU_LANES], // [NPARAMS*NPARAMS][CPU_LANES]
+					       double* cost,
+					       const bool* update,
+					       const int* bound_types,
+					       const float* bounds_min,
+					       const float* bounds_max,
+					       const int* fixed,
+					       int debugVOX)
+  {
+    T myderivatives[NPARAMS][CPU_LANES];
+    T accumulated_gradient[NPARAMS][CPU_LANES];
+    T accumulated_hessian[NPARAMS*NPARAMS][CPU_LANES];
+    T accumulated_error[CPU_LANES];
+    T signal[CPU_LANES];
+    T cache[CACHE_SIZE][CPU_LANES];
+
+    Prepare_Voxel_lanes(parameters,FixP,cache);
+    for(int l=0;l<CPU_LANES;l++){
+      accumulated_error[l]=(T)0.0;
+    }
+    for(int p=0;p<NPARAMS;p++){
+      for(int l=0;l<CPU_LANES;l++){
+	accumulated_gradient[p][l]=(T)0.0;
+      }
+    }
+    for(int p=0;p<NPARAMS;p++){
+      for(int p2=p;p2<NPARAMS;p2++){
+	for(int l=0;l<CPU_LANES;l++){
+	  accumulated_hessian[p*NPARAMS+p2][l]=(T)0.0;
+	}
+      }
+    }
+    for(int idMeasurement=0;idMeasurement<nmeas;idMeasurement++){
+      T* myCFP = &CFP[idMeasurement*CFP_Tsize];
+      T* mymeas = &measurements[idMeasurement*CPU_LANES];
+      Signal_Derivatives_transf_lanes(parameters,params_transf,cache,myCFP,FixP,signal,myderivatives,bound_types,bounds_min,bounds_max);
+
+      if(DEBUG){
+	for(int l=0;l<CPU_LANES;l++){
+	  if(lane_voxel[l]==debugVOX){
+	    for(int i=0;i<NPARAMS;i++){
+	      printf("Derivatives Measurement[%i]_Parameter[%i]: %f\n",idMeasurement,i,myderivatives[i][l]);
+	    }
+	  }
+	}
+      }
+      #pragma omp simd
+      for(int l=0;l<CPU_LANES;l++){
+	T pred_error=signal[l]-mymeas[l];
+	accumulated_error[l]+=pred_error*pred_error;
+      }
+      for(int p=0;p<NPARAMS;p++){
+	#pragma omp simd
+	for(int l=0;l<CPU_LANES;l++){
+	  accumulated_gradient[p][l]+=(T)2.0*(signal[l]-mymeas[l])*myderivatives[p][l];
+	}
+      }
+      // J^T J is symmetric: only the upper triangle is accumulated
+      for(int p=0;p<NPARAMS;p++){
+	for(int p2=p;p2<NPARAMS;p2++){
+	  #pragma omp simd
+	  for(int l=0;l<CPU_LANES;l++){
+	    accumulated_hessian[p*NPARAMS+p2][l]+=(T)2.0*myderivatives[p][l]*myderivatives[p2][l];
+	  }
+	}
+      }
+    }
+    for(int l=0;l<CPU_LANES;l++){
+      cost[l]=accumulated_error[l];
+    }
+    for(int p=0;p<NPARAMS;p++){
+      for(int l=0;l<CPU_LANES;l++){
+	if(update[l]){
+	  if(fixed[p]) Gradient[p][l]=0;
+	  else Gradient[p][l]=accumulated_gradient[p][l];
+	}
+      }
+    }
+    for(int p=0;p<NPARAMS;p++){
+      for(int p2=0;p2<NPARAMS;p2++){
+	for(int l=0;l<CPU_LANES;l++){
+	  if(update[l]){
+	    if(fixed[p] || fixed[p2]){
+	      if(p==p2) Hessian[p*NPARAMS+p2][l]=(T)1.0;
+	      else Hessian[p*NPARAMS+p2][l]=(T)0.0;
+	    }else if(p2>=p){
+	      Hessian[p*NPARAMS+p2][l]=accumulated_hessian[p*NPARAMS+p2][l];
+	    }else{
+	      Hessian[p*NPARAMS+p2][l]=accumulated_hessian[p2*NPARAMS+p][l];
+	    }
+	  }
+	}
+      }
+    }
+  }
+
+  // Fits all the voxels returned by next(first,last), CPU_LANES voxels at a time in lockstep, one voxel per lane.
+  // Between iterations, the voxels that have finished are written to the output and their lanes are given the next pending voxels, so the lanes are not spent on converged voxels while a few voxels take many iterations
+  // With several starting points (--multistart), the voxel idVOX has the measurements and fixed parameters of the voxel idVOX%nvox_meas, and its final cost is written to costs
+  template <typename T, bool MARQUARDT, bool DEBUG, typename Next>
+  void levenberg_lanes_cpu(
+			   Next& next, // gives the next voxels to fit
+			   int nvox_meas, // voxels with measurements
+			   int nmeas, // nmeasurements
+			   int CFP_Tsize, // common fixed params: size*M-measurements
+			   int FixP_Tsize, // fixed params: size*Nvoxels
+			   T* meas, // measurements
+			   T* parameters, // model parameters
+			   T* CFP, // common fixed model parameters
+			   T* FixP, // fixed model parameters
+			   int nmax_iters,
+			   bool varpro, // solve the linear parameters (--varpro)
+			   double* costs, // final cost of each voxel, NULL if not needed
+			   int debugVOX,
+			   const int* bound_types,
+			   const float* bounds_min,
+			   const float* bounds_max,
+			   const int* fixed)
+  {
+    T params[NPARAMS][CPU_LANES];
+    T params_transf[NPARAMS][CPU_LANES];
+    T step[NPARAMS][CPU_LANES];
+    T Gradient[NPARAMS][CPU_LANES];
+    T Hessian[NPARAMS*NPARAMS][CPU_LANES];
+    T* lane_FixP[CPU_LANES];
+    vector<T> lane_meas(nmeas*CPU_LANES);
+    double pcf[CPU_LANES]={0}, ncf[CPU_LANES]={0}; // initialised: the compiler cannot tell that only the loaded lanes are read
+    double lambda[CPU_LANES], olambda[CPU_LANES];
+    bool success[CPU_LANES];
+    bool solved[CPU_LANES]={false};
+    bool active[CPU_LANES];
+    bool update[CPU_LANES];
+    bool loaded[CPU_LANES];
+    int iter[CPU_LANES];
+    int lane_voxel[CPU_LANES]; // voxel fitted in each lane, -1 if the lane is empty
+    int pending_first=0, pending_last=0; // voxels taken from the queue and not yet in a lane
+
+    // Puts a voxel in a lane: initial parameters, measurements and state of the algorithm
+    auto load_lane = [&](int l, int idVOX){
+      T p[NPARAMS];
+      T pt[NPARAMS];
+      for(int i=0;i<NPARAMS;i++){
+	p[i]=parameters[idVOX*NPARAMS+i];
+      }
+      int idVOX_meas=idVOX%nvox_meas;
+      for(int m=0;m<nmeas;m++){
+	lane_meas[m*CPU_LANES+l]=meas[idVOX_meas*nmeas+m];
+      }
+      lane_FixP[l]=&FixP[idVOX_meas*FixP_Tsize];
+      lane_voxel[l]=idVOX;
+      lambda[l]=0.1;
+      olambda[l]=0.0;
+      success[l]=true;
+      active[l]=true;
+      iter[l]=0;
+
+      if(DEBUG){
+	if(idVOX==debugVOX){
+	  printf("\n ----- Levenberg_Marquardt CPU algorithm: voxel %i -----\n",debugVOX);
+	  for(int i=0;i<NPARAMS;i++){
+	    printf("Initial Parameter[%i]: %f\n",i,p[i]);
+	  }
+	  for(int i=0;i<CFP_Tsize;i++){
+	    printf("Commonn Fixed Params[%i]: ",i);
+	    for(int j=0;j<nmeas;j++){
+	      printf("%f ",CFP[j*CFP_Tsize+i]);
+	    }
+	    printf("\n");
+	  }
+	  printf("Fix Parameters: ");
+	  for(int i=0;i< FixP_Tsize;i++){
+	    printf("%f, ",lane_FixP[l][i]);
+	  }
+	  printf("\n--------------------------------------------------------\n");
+	}
+      }
+      invtransformAll(p,pt,bound_types,bounds_min,bounds_max); //calculate params_transf
+      set_lane(params,NPARAMS,l,p);
+      set_lane(params_transf,NPARAMS,l,pt);
+    };
+
+    // Writes the parameters of the voxel of a lane to the output. The lane keeps its values, so it still computes valid numbers until it gets another voxel
+    auto retire_lane = [&](int l){
+      int idVOX=lane_voxel[l];
+      T p[NPARAMS];
+      get_lane(params,NPARAMS,l,p);
+      // Change parameters if needed: FixConstraints()
+      FixConstraintsLM(NPARAMS,p);
+      for(int i=0;i<NPARAMS;i++){
+	parameters[idVOX*NPARAMS+i]=p[i];
+      }
+      if(costs!=NULL){
+	// Cost of the final parameters, to choose the best starting point
+	T cache[CACHE_SIZE];
+	Prepare_Voxel(p,lane_FixP[l],cache);
+	double cost=0.0;
+	for(int m=0;m<nmeas;m++){
+	  T pred_error=Predicted_Signal(NPARAMS,p,&CFP[m*CFP_Tsize],lane_FixP[l],cache)-lane_meas[m*CPU_LANES+l];
+	  cost+=pred_error*pred_error;
+	}
+	costs[idVOX]=cost;
+      }
+      if(DEBUG){
+	if(idVOX==debugVOX){
+	  for(int i=0;i<NPARAMS;i++){
+	    printf("Final Parameter[%i]: %f\n",i,p[i]);
+	  }
+	}
+      }
+      lane_voxel[l]=-1;
+    };
+
+    auto next_voxel = [&](int& idVOX) -> bool {
+      if(pending_first==pending_last && !next(pending_first,pending_last)) return false;
+      idVOX=pending_first++;
+      return true;
+    };
+
+#if NLINEAR>0
+    // Solves the linear parameters of the lanes in mask for their current nonlinear parameters (see linear_parameters.h) and sets their transformation in transf
+    auto solve_linear = [&](const bool* mask, T transf[][CPU_LANES]){
+      bool solved[CPU_LANES];
+      Solve_Linear_lanes(nmeas,CFP_Tsize,lane_meas.data(),params,CFP,lane_FixP,mask,solved,bound_types,bounds_min,bounds_max);
+      for(int l=0;l<CPU_LANES;l++){
+	if(!solved[l]) continue;
+	T p[NPARAMS];
+	T pt[NPARAMS];
+	get_lane(params,NPARAMS,l,p);
+	get_lane(transf,NPARAMS,l,pt);
+	for(int i=0;i<NLINEAR;i++){
+	  invtransform(linear_param(i),p,pt,bound_types,bounds_min,bounds_max);
+	}
+	set_lane(params,NPARAMS,l,p);
+	set_lane(transf,NPARAMS,l,pt);
+	if(DEBUG){
+	  if(lane_voxel[l]==debugVOX){
+	    for(int i=0;i<NLINEAR;i++){
+	      printf("Linear Parameter[%i]: %f   ",linear_param(i),p[linear_param(i)]);
+	    }
+	    printf("\n");
+	  }
+	}
+      }
+    };
+#endif
+
+    for(int l=0;l<CPU_LANES;l++){
+      active[l]=false;
+      lane_voxel[l]=-1;
+    }
+
+    bool first_fill=true;
+    while(true){
+      // Retire the voxels that have finished and give their lanes new voxels
+      for(int l=0;l<CPU_LANES;l++){
+	loaded[l]=false;
+	if(active[l]) continue;
+	if(lane_voxel[l]>=0) retire_lane(l);
+	int idVOX;
+	while(next_voxel(idVOX)){
+	  load_lane(l,idVOX);
+	  //if success we don't increase niter (first condition is true)
+	  if(iter[l]++>=nmax_iters){
+	    retire_lane(l);
+	    active[l]=false;
+	    continue;
+	  }
+	  loaded[l]=true;
+	  break;
+	}
+      }
+      if(!any_lane(active)) break;
+
+      if(first_fill){
+	// Lanes without a voxel replicate a lane with a voxel, so they compute valid values. They are never active
+	int source=0;
+	while(!active[source]) source++;
+	for(int l=0;l<CPU_LANES;l++){
+	  if(lane_voxel[l]>=0) continue;
+	  for(int i=0;i<NPARAMS;i++){
+	    params[i][l]=params[i][source];
+	    params_transf[i][l]=params_transf[i][source];
+	  }
+	  for(int m=0;m<nmeas;m++){
+	    lane_meas[m*CPU_LANES+l]=lane_meas[m*CPU_LANES+source];
+	  }
+	  lane_FixP[l]=lane_FixP[source];
+	}
+	first_fill=false;
+      }
+
+#if NLINEAR>0
+      if(varpro && any_lane(loaded)){
+	solve_linear(loaded,params_transf);
+      }
+#endif
+
+      bool any_update=false;
+      for(int l=0;l<CPU_LANES;l++){
+	update[l]=active[l] && success[l];
+	if(update[l]) any_update=true;
+      }
+
+      if(DEBUG){
+	for(int l=0;l<CPU_LANES;l++){
+	  if(active[l] && lane_voxel[l]==debugVOX){
+	    printf("---------------------- Iteration %i ---------------------\n",iter[l]);
+	  }
+	}
+      }
+
+      if(any_update){
+	Calculate_Gradient_Hessian_lanes<T,DEBUG>(lane_voxel,nmeas,CFP_Tsize,lane_meas.data(),params,params_transf,CFP,lane_FixP,Gradient,Hessian,ncf,update,bound_types,bounds_min,bounds_max,fixed,debugVOX);
+	// The new voxels get their initial cost from this pass
+	for(int l=0;l<CPU_LANES;l++){
+	  if(loaded[l]) pcf[l]=ncf[l];
+	}
+      }
+
+      // Solve each active lane
+      for(int l=0;l<CPU_LANES;l++){
+	if(!active[l]) continue;
+	T myHessian[NPARAMS*NPARAMS];
+	T myGradient[NPARAMS];
+	T p[NPARAMS];
+	T s[NPARAMS];
+	for (int i=0; i<NPARAMS; i++){
+	  if(MARQUARDT)
+	    Hessian[(i*NPARAMS)+i][l]=((1+lambda[l])/(1+olambda[l]))*Hessian[i*NPARAMS+i][l];	//Levenberg-Marquardt
+	  else
+	    Hessian[(i*NPARAMS)+i][l]+=lambda[l]-olambda[l];	//Levenberg
+	}
+	get_lane(Hessian,NPARAMS*NPARAMS,l,myHessian);
+	get_lane(Gradient,NPARAMS,l,myGradient);
+
+	// false if the Hessian is singular: the step is rejected
+	solved[l]=LMsolver(myHessian,myGradient,s);
+
+	for(int i=0;i<NPARAMS;i++){
+	  s[i]=params_transf[i][l]-s[i];
+	}
+	transformAll(p,s,bound_types,bounds_min,bounds_max);
+	set_lane(params,NPARAMS,l,p);
+	set_lane(step,NPARAMS,l,s);
+
+	if(DEBUG){
+	  if(lane_voxel[l]==debugVOX){
+	    for(int i=0;i<NPARAMS;i++){
+	      printf("Gradient[%i]: %f   ",i,myGradient[i]);
+	    }
+	    printf("\n");
+	    for(int i=0;i<NPARAMS;i++){
+	      printf("Proposed[%i]: %f   ",i,p[i]);
+	    }
+	    printf("\n");
+	  }
+	}
+      }
+
+#if NLINEAR>0
+      if(varpro){
+	// The step of the linear parameters is replaced by their solution at the proposed nonlinear parameters
+	solve_linear(active,step);
+      }
+#endif
+
+      Cost_Function_lanes<T,DEBUG>(lane_voxel,nmeas,CFP_Tsize,lane_meas.data(),params,CFP,lane_FixP,ncf,debugVOX);
+
+      for(int l=0;l<CPU_LANES;l++){
+	if(!active[l]) continue;
+	bool end=false;
+	if ((success[l] = (solved[l] && ncf[l] < pcf[l]))){
+	  olambda[l] = 0.0;
+	  for(int i=0;i<NPARAMS;i++){
+	    params_transf[i][l]=step[i][l];
+	  }
+	  lambda[l]=lambda[l]/10.0;
+	  if (zero_cf_diff_conv(&pcf[l],&ncf[l])){
+	    end=true;
+	  }
+	  pcf[l]=ncf[l];
+	}else{
+	  olambda[l]=lambda[l];
+	  lambda[l]=lambda[l]*10.0;
+	  if(lambda[l] > LTOL){
+	    end=true;
+	  }
+	  // undo step in parameters
+	  T p[NPARAMS];
+	  T pt[NPARAMS];
+	  get_lane(params_transf,NPARAMS,l,pt);
+	  transformAll(p,pt,bound_types,bounds_min,bounds_max);
+	  set_lane(params,NPARAMS,l,p);
+	  set_lane(params_transf,NPARAMS,l,pt);
+	}
+	if(DEBUG){
+	  if(lane_voxel[l]==debugVOX){
+	    printf("--------------------------------------------------------\n");
+	  }
+	}
+	//if success we don't increase niter (first condition is true)
+	//function cost has been decreased, we have advanced.
+	if(!end && success[l] && iter[l]++>=nmax_iters) end=true;
+	if(end) active[l]=false;
+      }
+    }
+  }
+
+  template <typename T>
+  void Levenberg_Marquardt<T>::run_cpu(
+				       int nvox, int nmeas,
+				       int CFP_size, int FixP_size,
+				       T* meas,
+				       T* params,
+				       T* CFP, T* FixP,
+				       int nstarts, T* starts)
+  {
+    cudimotOptions& opts = cudimotOptions::getInstance();
+    int nthreads=cpu_nthreads(opts.nthreads.value());
+
+    const int* bound_types=bound_types_host;
+    const float* bounds_min=bounds_min_host;
+    const float* bounds_max=bounds_max_host;
+    const int* fixed=fixed_host;
+    int nmax_iters=max_iterations;
+    int debugVOX_=debugVOX;
+    bool marquardt=Marquardt;
+    bool debug=DEBUG;
+    bool varpro_=varpro;
+
+    // With several starting points, all of them are fitted as voxels with the measurements of their voxel
+    int nfit=nvox;
+    T* fit_params=params;
+    vector<double> costs;
+    double* costs_=NULL;
+    if(nstarts>1){
+      nfit=nstarts*nvox;
+      fit_params=starts;
+      costs.assign(nfit,0.0);
+      costs_=costs.data();
+    }
+
+    cpu_threads_stats stats=parallel_voxel_stream(nfit,CPU_LANES,nthreads,[&](auto& next){
+	if(!debug){
+	  if(marquardt){
+	    levenberg_lanes_cpu<T,true,false>(next,nvox,nmeas,CFP_size,FixP_size,meas,fit_params,CFP,FixP,nmax_iters,varpro_,costs_,debugVOX_,bound_types,bounds_min,bounds_max,fixed);
+	  }else{
+	    levenberg_lanes_cpu<T,false,false>(next,nvox,nmeas,CFP_size,FixP_size,meas,fit_params,CFP,FixP,nmax_iters,varpro_,costs_,debugVOX_,bound_types,bounds_min,bounds_max,fixed);
+	  }
+	}else{
+	  if(marquardt){
+	    levenberg_lanes_cpu<T,true,true>(next,nvox,nmeas,CFP_size,FixP_size,meas,fit_params,CFP,FixP,nmax_iters,varpro_,costs_,debugVOX_,bound_types,bounds_min,bounds_max,fixed);
+	  }else{
+	    levenberg_lanes_cpu<T,false,true>(next,nvox,nmeas,CFP_size,FixP_size,meas,fit_params,CFP,FixP,nmax_iters,varpro_,costs_,debugVOX_,bound_types,bounds_min,bounds_max,fixed);
+	  }
+	}
+      });
+    report_cpu_threads("Levenberg-Marquardt",stats);
+
+    if(nstarts>1){
+      // Parameters of each voxel from its starting point with the lowest cost
+      for(int v=0;v<nvox;v++){
+	int best=0;
+	for(int s=1;s<nstarts;s++){
+	  if(costs[s*nvox+v]<costs[best*nvox+v] || costs[best*nvox+v]!=costs[best*nvox+v]){
+	    best=s;
+	  }
+	}
+	for(int i=0;i<NPARAMS;i++){
+	  params[v*NPARAMS+i]=starts[(best*nvox+v)*NPARAMS+i];
+	}
+      }
+    }
+  }
+
+  // Explicit Instantiations of the template
+  template void Levenberg_Marquardt<float>::run_cpu(int,int,int,int,float*,float*,float*,float*,int,float*);
+  template void Levenberg_Marquardt<double>::run_cpu(int,int,int,int,double*,double*,double*,double*,int,double*);
+}
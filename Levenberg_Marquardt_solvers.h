@@ -0,0 +1,136 @@
+#ifndef CUDIMOT_LEVENBERG_MARQUARDT_SOLVERS_H_INCLUDED
+#define CUDIMOT_LEVENBERG_MARQUARDT_SOLVERS_H_INCLUDED
+
+/*  Levenberg_Marquardt_solvers.h
+
+    Solvers of the linear system of each Levenberg-Marquardt iteration: Hessian * X = Gradient. They are shared by the CPU version and the GPU version, which executes them in one thread of the warp if the warp-parallel Cholesky solver cannot be used (NPARAMS>=32) or fails. Only the upper triangle of the Hessian (Hessian[row*NPARAMS+col] with col>=row) is read. The matrices are NPARAMS*NPARAMS in local memory, so there is no limit on the number of parameters of the model. It must be included after functions_gpu.h and modelparameters.h
+
+    The damped Gauss-Newton Hessian (J^T J + damping) is symmetric and, in exact arithmetic, positive definite, so the system is solved with a Cholesky factorization (NPARAMS^3/6 operations). With very small damping, J^T J can be numerically singular (e.g. a fibre with null volume fraction has undefined orientation). Then the factorization fails and the system is solved with Gaussian elimination with partial pivoting. If the matrix is singular (a null pivot), there is no solution: the solvers return false with a null step, and the iteration must be rejected so that the damping increases.
+
+    Moises Hernandez-Fernandez FMRIB Image Analysis Group (code moved from Levenberg_Marquardt.cu), agent
+
+    Copyright (C) 2005, 2026 University of Oxford  */
+
+/*  CCOPYRIGHT  */
+
+namespace Cudimot{
+
+  // Hessian * X  =  Gradient -> Calculate X, with Hessian = L * L^T
+  // Returns false (and does not write Solution) if the Hessian is not positive definite
+  template <typename T>
+  FUNC bool Cholesky_solver(const T* Hessian,
+			    const T* Gradient,
+			    T* Solution)
+  {
+    T L[NPARAMS*NPARAMS]; // lower triangle
+    T y[NPARAMS];
+
+    for(int col=0;col<NPARAMS;col++){
+      T diag=Hessian[col*NPARAMS+col];
+      for(int k=0;k<col;k++){
+	diag-=L[col*NPARAMS+k]*L[col*NPARAMS+k];
+      }
+      // Also catches NaN
+      if(!(diag>(T)0.0)) return false;
+      diag=(T)sqrt_gpu(diag);
+      L[col*NPARAMS+col]=diag;
+      for(int row=col+1;row<NPARAMS;row++){
+	T value=Hessian[col*NPARAMS+row]; // upper triangle
+	for(int k=0;k<col;k++){
+	  value-=L[row*NPARAMS+k]*L[col*NPARAMS+k];
+	}
+	L[row*NPARAMS+col]=value/diag;
+      }
+    }
+
+    // Forward substitution: L * y = Gradient
+    for(int row=0;row<NPARAMS;row++){
+      T value=Gradient[row];
+      for(int k=0;k<row;k++){
+	value-=L[row*NPARAMS+k]*y[k];
+      }
+      y[row]=value/L[row*NPARAMS+row];
+    }
+    // Backward substitution: L^T * X = y
+    for(int row=NPARAMS-1;row>=0;row--){
+      T value=y[row];
+      for(int k=row+1;k<NPARAMS;k++){
+	value-=L[k*NPARAMS+row]*Solution[k];
+      }
+      Solution[row]=value/L[row*NPARAMS+row];
+    }
+    return true;
+  }
+
+  // Hessian * X  =  Gradient -> Calculate X
+  // Gaussian elimination with partial pivoting: Matrix = [Hessian | Gradient]
+  // Returns false (and does not write Solution) if the Hessian is singular
+  template <typename T>
+  FUNC bool Pivoting_solver(const T* Hessian,
+			    const T* Gradient,
+			    T* Solution)
+  {
+    const int ncols=NPARAMS+1;
+    T matrix[NPARAMS*(NPARAMS+1)];
+    for(int row=0;row<NPARAMS;row++){
+      for(int col=0;col<NPARAMS;col++){
+	// The lower triangle is the transposed upper triangle
+	matrix[row*ncols+col]=(col>=row)?Hessian[row*NPARAMS+col]:Hessian[col*NPARAMS+row];
+      }
+      matrix[row*ncols+NPARAMS]=Gradient[row];
+    }
+
+    // Forward step: Zero's under diagonal
+    for(int col=0;col<NPARAMS;col++){
+      // Row with the largest element in this column
+      int pivot_row=col;
+      for(int row=col+1;row<NPARAMS;row++){
+	if(fabs_gpu(matrix[row*ncols+col])>fabs_gpu(matrix[pivot_row*ncols+col])) pivot_row=row;
+      }
+      if(pivot_row!=col){
+	for(int c=col;c<ncols;c++){
+	  T tmp=matrix[col*ncols+c];
+	  matrix[col*ncols+c]=matrix[pivot_row*ncols+c];
+	  matrix[pivot_row*ncols+c]=tmp;
+	}
+      }
+      // Also catches NaN
+      if(!(fabs_gpu(matrix[col*ncols+col])>(T)0.0)) return false;
+      // Eliminate all terms under diagonal element
+      for(int row=col+1;row<NPARAMS;row++){
+	T factor=matrix[row*ncols+col]/matrix[col*ncols+col];
+	for(int c=col;c<ncols;c++){
+	  matrix[row*ncols+c]-=factor*matrix[col*ncols+c];
+	}
+      }
+    }
+
+    // Backward substitution
+    for(int row=NPARAMS-1;row>=0;row--){
+      T value=matrix[row*ncols+NPARAMS];
+      for(int k=row+1;k<NPARAMS;k++){
+	value-=matrix[row*ncols+k]*Solution[k];
+      }
+      Solution[row]=value/matrix[row*ncols+row];
+    }
+    return true;
+  }
+
+  // Hessian * X  =  Gradient -> Calculate X
+  // Cholesky factorization, or Gaussian elimination with partial pivoting if the Hessian is not positive definite
+  // Returns false, with a null Solution, if the Hessian is singular: the step must be rejected
+  template <typename T>
+  FUNC bool LMsolver(const T* Hessian,
+		     const T* Gradient,
+		     T* Solution)
+  {
+    if(Cholesky_solver(Hessian,Gradient,Solution)) return true;
+    if(Pivoting_solver(Hessian,Gradient,Solution)) return true;
+    for(int p=0;p<NPARAMS;p++){
+      Solution[p]=(T)0.0;
+    }
+    return false;
+  }
+}
+
+#endif
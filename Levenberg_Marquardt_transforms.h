@@ -0,0 +1,138 @@
+#ifndef CUDIMOT_LEVENBERG_MARQUARDT_TRANSFORMS_H_INCLUDED
+#define CUDIMOT_LEVENBERG_MARQUARDT_TRANSFORMS_H_INCLUDED
+
+/*  Levenberg_Marquardt_transforms.h
+
+    Constants and transformations of the parameters (to deal with the bounds) used by the Levenberg-Marquardt algorithm. They are shared by the GPU version (bounds in constant memory) and the CPU version (bounds in host memory). It must be included after functions_gpu.h and modelparameters.h
+
+    Moises Hernandez-Fernandez FMRIB Image Analysis Group (code moved from Levenberg_Marquardt.cu), agent
+
+    Copyright (C) 2005, 2026 University of Oxford  */
+
+/*  CCOPYRIGHT  */
+
+#include "cudimot.h"
+
+#define CFTOL 1.0e-8
+#define LTOL 1.0e20
+#define EPS_gpu 2.0e-16 //Losely based on NRinC 20.1
+#define TwoDivPI 0.636619772367581 //0.6353  // 0.636619772367581
+#define avoidErrors 1e-4 // Avoid maximum and minimums because tan(pi/2) is undefined to inf
+#define SpeedFactor 10 // Speed of Transformations-function
+
+namespace Cudimot{
+
+  FUNC bool zero_cf_diff_conv(double* cfold, double* cfnew){
+    return(2.0*fabs(*cfold-*cfnew) <= CFTOL*(fabs(*cfold)+fabs(*cfnew)+EPS_gpu));
+  }
+
+  template <typename T>
+  FUNC void MinMaxInvTransform(int idpar, T* params, T* transfParams,
+			       const float* bounds_min, const float* bounds_max){
+
+    if(params[idpar]<=((T)bounds_min[idpar]+(T)avoidErrors)) params[idpar]+=(T)avoidErrors;
+    if(params[idpar]>=((T)bounds_max[idpar]-(T)avoidErrors)) params[idpar]-=(T)avoidErrors;
+    // Avoid maximum and minimum because tan(pi/2) is undefined to inf
+
+    transfParams[idpar] = params[idpar]-(((T)bounds_min[idpar]+(T)bounds_max[idpar])/(T)2.0);
+    transfParams[idpar] *= ((T)2.0/(((T)bounds_max[idpar]-(T)bounds_min[idpar])*(T)TwoDivPI));
+    transfParams[idpar] = tan_gpu(transfParams[idpar])*SpeedFactor;
+  }
+
+  template <typename T>
+  FUNC void MinMaxTransform(int idpar, T* params, T* transfParams,
+			    const float* bounds_min, const float* bounds_max){
+    params[idpar] = (((T)bounds_max[idpar]-(T)bounds_min[idpar])/(T)2.0);
+    params[idpar] *= atan_gpu(transfParams[idpar]/SpeedFactor);
+    params[idpar] *=  (T)TwoDivPI;
+    params[idpar] += (((T)bounds_min[idpar]+(T)bounds_max[idpar])/(T)2.0);
+
+    if(params[idpar]<=((T)bounds_min[idpar]+(T)avoidErrors)){
+      params[idpar]+=(T)avoidErrors;
+      transfParams[idpar] = params[idpar]-(((T)bounds_min[idpar]+(T)bounds_max[idpar])/(T)2.0);
+      transfParams[idpar] *= ((T)2.0/(((T)bounds_max[idpar]-(T)bounds_min[idpar])*(T)TwoDivPI));
+      transfParams[idpar] = tan_gpu(transfParams[idpar])*SpeedFactor;
+    }
+    if(params[idpar]>=((T)bounds_max[idpar]-(T)avoidErrors)){
+      params[idpar]-=(T)avoidErrors;
+      transfParams[idpar] = params[idpar]-(((T)bounds_min[idpar]+(T)bounds_max[idpar])/(T)2.0);
+      transfParams[idpar] *= ((T)2.0/(((T)bounds_max[idpar]-(T)bounds_min[idpar])*(T)TwoDivPI));
+      transfParams[idpar] = tan_gpu(transfParams[idpar])*SpeedFactor;
+    }
+    // Avoid maximum and minimum because tan(pi/2) is undefined to inf
+  }
+
+  template <typename T>
+  FUNC void MinInvTransform(int idpar, T* params, T* transfParams, const float* bounds_min){
+    transfParams[idpar] = log_gpu(params[idpar]-(T)bounds_min[idpar]);
+  }
+
+  template <typename T>
+  FUNC void MinTransform(int idpar, T* params, T* transfParams, const float* bounds_min){
+    params[idpar] = exp_gpu(transfParams[idpar]) + (T)bounds_min[idpar];
+  }
+
+  template <typename T>
+  FUNC void MaxInvTransform(int idpar, T* params, T* transfParams, const float* bounds_max){
+    transfParams[idpar] = log_gpu((T)bounds_max[idpar]-params[idpar]);
+  }
+
+  template <typename T>
+  FUNC void MaxTransform(int idpar, T* params, T* transfParams, const float* bounds_max){
+    params[idpar] = (T)bounds_max[idpar] - exp_gpu(transfParams[idpar]);
+  }
+
+  template <typename T>
+  FUNC void invtransform(int p, T* params, T* transfParams, const int* bound_types,
+			 const float* bounds_min, const float* bounds_max){
+    if(bound_types[p]==BMIN)
+      MinInvTransform(p,params,transfParams,bounds_min);
+    else if(bound_types[p]==BMAX)
+      MaxInvTransform(p,params,transfParams,bounds_max);
+    else if(bound_types[p]==BMINMAX)
+      MinMaxInvTransform(p,params,transfParams,bounds_min,bounds_max);
+    else
+      transfParams[p]=params[p];
+  }
+
+  template <typename T>
+  FUNC void invtransformAll(T* params, T* transfParams, const int* bound_types,
+			    const float* bounds_min, const float* bounds_max){
+    for(int p=0; p<NPARAMS; p++){
+      invtransform(p,params,transfParams,bound_types,bounds_min,bounds_max);
+    }
+  }
+
+  template <typename T>
+  FUNC void transformAll(T* params, T* transfParams, const int* bound_types,
+			 const float* bounds_min, const float* bounds_max){
+    for(int p=0; p<NPARAMS; p++){
+      if(bound_types[p]==BMIN)
+	MinTransform(p,params,transfParams,bounds_min);
+      else if(bound_types[p]==BMAX)
+	MaxTransform(p,params,transfParams,bounds_max);
+      else if(bound_types[p]==BMINMAX)
+	MinMaxTransform(p,params,transfParams,bounds_min,bounds_max);
+      else
+	params[p]=transfParams[p];
+    }
+  }
+
+  template <typename T>
+  FUNC void derivative_transf(T* transfParams, T* derivatives, const int* bound_types,
+			      const float* bounds_min, const float* bounds_max){
+    for(int p=0; p<NPARAMS; p++){
+      if(bound_types[p]==BMIN)
+	derivatives[p]=derivatives[p]*exp_gpu(transfParams[p]);
+      else if(bound_types[p]==BMAX)
+	derivatives[p]=derivatives[p]*(-exp_gpu(transfParams[p]));
+      else if(bound_types[p]==BMINMAX){
+        derivatives[p]=derivatives[p]*((bounds_max[p]-bounds_min[p])/(T)2.0)*(T)TwoDivPI;
+        derivatives[p]=derivatives[p]* ((T)SpeedFactor/ ((T)SpeedFactor*(T)SpeedFactor + transfParams[p]*transfParams[p]));
+      }
+      //else keep the same
+    }
+  }
+}
+
+#endif
@@ -13,6 +13,10 @@
 #include "modelparameters.h"
 #include "macro_numerical.h"
 #include "modelfunctions.h"
+#include "MCMC_priors.h"
+#include "MCMC_block.h"
+#include "MCMC_summary.h"
+#include "init_gpu.h"
 
 using namespace std;
 
@@ -22,6 +26,7 @@ namespace Cudimot{
 #define THREADS_VOXEL 32 // Multiple of 32: Threads collaborating to compute a voxel. Do not change this, otherwise Synchronization will be needed and shuffles cannot be used
 
 #define maxfloat 1e10
+#define CHECKPOINT_UPDATES 10 // With checkpoints, updates of the proposals in each launch of the kernel
   
   __constant__ int MCbound_types [NPARAMS];
   __constant__ float MCbounds_min [NPARAMS];
@@ -31,45 +36,6 @@ namespace Cudimot{
   __constant__ float MCpriors_b [NPARAMS];
   __constant__ int MCfixed [NPARAMS];
   
-  // Returns the natural log of the 0th order modified Bessel function of first kind for an argument x
-  // Follows the exponential implementation of the Bessel function in Numerical Recipes, Ch. 6
-  __device__ inline float logIo(const float x){
-    float y,b;
-    b=fabsf(x);
-    if (b<3.75f){
-      float a=x/3.75f;
-      a*=a;
-      //Bessel function evaluation
-      y=1.0f+a*(3.5156229f+a*(3.0899424f+a*(1.2067492f+a*(0.2659732f+a*(0.0360768f+a*0.0045813f)))));
-      y=logf(y);
-    }else{
-      float a=3.75f/b; 
-      //Logarithm of Bessel function
-      y=b+logf((0.39894228f+a*(0.01328592f+a*(0.00225319f+a*(-0.00157565f+a*(0.00916281f+a*(-0.02057706f+a*(0.02635537f+a*(-0.01647633f+a*0.00392377f))))))))/sqrt(b));
-    }
-    return y;
-  }
-  
-  // Version for Double precision
-  __device__ inline double logIo(const double x){
-    double y,b;
-    b=fabs(x);
-    if (b<3.75){
-      double a=x/3.75;
-      a*=a;
-      //Bessel function evaluation
-      y=1.0+a*(3.5156229+a*(3.0899424+a*(1.2067492+a*(0.2659732+a*(0.0360768+a*0.0045813)))));
-      y=log(y);
-    }
-    else{
-      double a=3.75/b; 
-      //Logarithm of Bessel function
-      y=b+log((0.39894228+a*(0.01328592+a*(0.00225319+a*(-0.00157565+a*(0.00916281+a*(-0.02057706+a*(0.02635537+a*(-0.01647633+a*0.00392377))))))))/sqrt(b));
-    }
-    return y;
-  }
-
-
   template <typename T, bool DEBUG>
   __device__ inline void Propose(int par, T* params, T* old, T* propSD, curandState* localrandState,int debugVOX){
     *old=params[par];
@@ -86,112 +52,6 @@ namespace Cudimot{
     }
   }
 
-   template <typename T>
-   __device__ inline void Compute_TotalPrior(T* priors, T* TotalPrior){
-     *TotalPrior=(T)0.0;
-     #pragma unroll
-     for(int p=0;p<NPARAMS;p++){
-       *TotalPrior += priors[p]; 
-     }
-   }
-
-
-  template <typename T>
-  __device__ inline void Initialize_priors_params(T* params, T* priors, int nmeas, T* CFP, T* FixP){
-    #pragma unroll
-    for(int p=0;p<NPARAMS;p++){
-      if(MCbound_types[p]==BMIN){
-	      // Bounded with only min
-	      if (params[p] < MCbounds_min[p]) 
-	        params[p]=MCbounds_min[p];
-      }else if(MCbound_types[p]==BMAX){
-	      // Bounded with only max
-	      if (params[p] > MCbounds_max[p])
-	        params[p]=MCbounds_max[p];
-      }else if(MCbound_types[p]==BMINMAX){
-	      // Bounded with min & max
-	      if (params[p] < MCbounds_min[p])
-	        params[p]=MCbounds_min[p];
-	      else if (params[p] > MCbounds_max[p])
-	      params[p]=MCbounds_max[p];
-      }
-      // Initialise priors
-      if(MCprior_types[p]==1){
-	      // Gaussian(mean,std)
-	      T std2= MCpriors_b[p]*MCpriors_b[p]; //variance*variance
-	      priors[p]=(params[p]-MCpriors_a[p])*(params[p]-MCpriors_a[p])/(2*std2);
-	      //prior=(param-mean)*(param-mean)/(2*var*var)
-      }else if(MCprior_types[p]==2){
-	      // Gamma(alpha,beta)
-	      priors[p]= ((T)1.0-MCpriors_a[p])* log_gpu(params[p]) + MCpriors_b[p]*params[p];
-      }else if(MCprior_types[p]==3){
-	      // ARD(fudge_factor)
-	      priors[p]=MCpriors_a[p]*log_gpu(params[p]);
-	      //fudgefactor*log(param)
-      }else if(MCprior_types[p]==4){
-	      // sin()
-        priors[p]=-log_gpu(fabs_gpu(sin_gpu(params[p])/(T)2.0));
-      }else if(MCprior_types[p]==5){
-	      // custom() .. defined by the user in modelfunctions.h
-	      priors[p]=custom_priors(p,params,nmeas,CFP,FixP);  
-      }else{
-	      priors[p]=0;
-      }
-    }
-  }
-  
-  template <typename T>
-  __device__ inline int Check_bounds_constraints(int idpar, T* params){
-    // Check Designer Constraints
-    if(!ConstraintsMCMC(NPARAMS,params)) return 0;
-    if(MCbound_types[idpar]==BMIN){
-      // Bounded with only min
-      if (params[idpar] < MCbounds_min[idpar]) return 0;
-      return 1;
-    }else if(MCbound_types[idpar]==BMAX){
-      // Bounded with only max
-      if (params[idpar] > MCbounds_max[idpar]) return 0;
-      return 1;
-    }else if(MCbound_types[idpar]==BMINMAX){
-      // Bounded with min & max
-      if (params[idpar] < MCbounds_min[idpar]) return 0;
-      if (params[idpar] > MCbounds_max[idpar]) return 0;
-      return 1;
-    } 
-    return 1;
-   }
-
-  template <typename T>
-  __device__ inline void Compute_prior(int idpar, T* params, T* priors, T* old_prior, int nmeas, T* CFP, T* FixP){
-    *old_prior = priors[idpar];
-    if(MCprior_types[idpar]==GAUSSPRIOR){
-      // Gaussian(mean,std)
-      T std2= MCpriors_b[idpar]*MCpriors_b[idpar]; //std*std
-      priors[idpar]=(params[idpar]-MCpriors_a[idpar])*(params[idpar]-MCpriors_a[idpar])/(2*std2);
-      //prior=(param-mean)*(param-mean)/(2*std*std)
-     
-    }else if(MCprior_types[idpar]==GAMMAPRIOR){
-      // Gamma(alpha,beta)
-      priors[idpar]= ((T)1.0-MCpriors_a[idpar])* log_gpu(params[idpar]) + MCpriors_b[idpar]*params[idpar];
-
-    }else if(MCprior_types[idpar]==ARDPRIOR){
-      // ARD(fudge_factor)
-      priors[idpar]=MCpriors_a[idpar]*log_gpu(params[idpar]);
-      //fudgefactor*log(param)
-   
-    }else if(MCprior_types[idpar]==SINPRIOR){
-      // sin()
-      priors[idpar]=-log_gpu(fabs_gpu(sin_gpu(params[idpar])/(T)2.0));
-
-    }else if(MCprior_types[idpar]==CUSTOM){
-      // custom() .. defined by the user in modelfunctions.h
-      priors[idpar]=custom_priors(idpar,params,nmeas,CFP,FixP);  
-
-    }else{
-      priors[idpar]=0;
-    }
-  }
-  
   template <typename T>
   __device__ inline void Initialise_TauRician(int idSubVOX,
 					      int nmeas,
@@ -208,10 +68,12 @@ namespace Cudimot{
     if (idSubVOX<(nmeas%THREADS_VOXEL)) nmeas2compute++;
     
     T accumulated_error=(T)0.0;
+    T cache[CACHE_SIZE];
+    Prepare_Voxel(parameters,FixP,cache);
     //Calculate Mean of Residuals
     for(int dir=0;dir<nmeas2compute;dir++){
       T* myCFP = &CFP[idMeasurement*CFP_Tsize];
-      T pred_error=Predicted_Signal(NPARAMS,parameters,myCFP,FixP);
+      T pred_error=Predicted_Signal(NPARAMS,parameters,myCFP,FixP,cache);
       pred_error=pred_error-measurements[idMeasurement];
       accumulated_error+=pred_error;
       idMeasurement+=THREADS_VOXEL;
@@ -232,7 +94,7 @@ namespace Cudimot{
     //Calculate the square of each difference from the mean 
     for(int dir=0;dir<nmeas2compute;dir++){
       T* myCFP = &CFP[idMeasurement*CFP_Tsize];
-      T pred_error=Predicted_Signal(NPARAMS,parameters,myCFP,FixP);
+      T pred_error=Predicted_Signal(NPARAMS,parameters,myCFP,FixP,cache);
       pred_error=pred_error-measurements[idMeasurement];
       pred_error=(*TAU)-pred_error;
       accumulated_error+=pred_error*pred_error;
@@ -270,9 +132,11 @@ namespace Cudimot{
     if (idSubVOX<(nmeas%THREADS_VOXEL)) nmeas2compute++;
     
     T accumulated_error=(T)0.0;
+    T cache[CACHE_SIZE];
+    Prepare_Voxel(parameters,FixP,cache);
     for(int dir=0;dir<nmeas2compute;dir++){
       T* myCFP = &CFP[idMeasurement*CFP_Tsize];
-      T pred_error=Predicted_Signal(NPARAMS,parameters,myCFP,FixP);
+      T pred_error=Predicted_Signal(NPARAMS,parameters,myCFP,FixP,cache);
 
       if(DEBUG){
 	      int idVOX= (blockIdx.x*VOXELS_BLOCK)+int(threadIdx.x/THREADS_VOXEL);
@@ -332,7 +196,8 @@ namespace Cudimot{
 			      int nmeas, // num measurements
 			      int CFP_Tsize, // common fixed params: size*M-measurements
 			      int FixP_Tsize, // fixed params: size*N-voxels
-			      int niters,
+			      int first_iter, // iterations [first_iter,last_iter) of the step: several launches with checkpoints
+			      int last_iter,
 			      int nsamples, // num samples per parameter
 			      int sampleevery, // record a sample every x iterations
 			      int updateproposalevery, // update SD proposals every x iters
@@ -343,7 +208,10 @@ namespace Cudimot{
 			      T* FixP, // fixed model parameters
 			      T* samples, // to record parameters samples
 			      T* tau_samples, // TAU values of each voxel for Rician noise
+			      T* tau_global, // TAU of each voxel between launches of the kernel
 			      T* tau_propSD_global, // std of tau proposals
+			      T* block_state, // state of the adaptive block sampler (NULL: Metropolis for each parameter)
+			      T* summary, // summaries of the samples of each voxel (NULL: the samples are recorded)
 			      int debugVOX)
   {
     // 1 block of threads process several voxels
@@ -392,6 +260,9 @@ namespace Cudimot{
     FixP = &FixP[idVOX*FixP_Tsize]; // Global memory
     if(RECORDING){
       samples = &samples[idVOX*NPARAMS*nsamples]; //Global memory
+      if(summary){
+        summary = &summary[idVOX*SUMMARY_VOXEL_SIZE]; //Global memory, only used by the leader
+      }
     }
     localrandState = (curandState*)&localrandState[idVOX_inBlock];
     params = &params[idVOX_inBlock*NPARAMS];
@@ -409,6 +280,10 @@ namespace Cudimot{
     nrejected = &nrejected[idVOX_inBlock*NPARAMS];
     TAU_accepted = &TAU_accepted[idVOX_inBlock];
     TAU_rejected = &TAU_rejected[idVOX_inBlock];
+    T* block = NULL; // Global memory, only used by the leader
+    if(block_state){
+      block = &block_state[idVOX*BLOCK_STATE_SIZE];
+    }
     
     /// Ititialise shared values of each voxel: only the leader///
     if(leader){ 
@@ -423,7 +298,7 @@ namespace Cudimot{
         naccepted[par]=0;
         nrejected[par]=0;
         priors[par]=(T)0.0;
-        if(RECORDING){
+        if(RECORDING || first_iter>0){
           // already have std of the proposals from previous iterations
           propSD[par]=propSD_global[idVOX*NPARAMS+par];
         }else{
@@ -431,11 +306,19 @@ namespace Cudimot{
         }
       }
       
-      if(RICIAN_NOISE && RECORDING){
+      if(RICIAN_NOISE && (RECORDING || first_iter>0)){
         // TAU has been already initializated
-        *TAU=tau_samples[idVOX*nsamples];
+        *TAU=tau_global[idVOX];
         *TAUpropSD=tau_propSD_global[idVOX];
       }
+      if(block && !RECORDING && first_iter==0){
+        block_init(block,propSD,MCfixed);
+      }
+      if(summary && RECORDING && first_iter==0){
+        for(int par=0;par<=NPARAMS;par++){
+          summary_init(&summary[par*SUMMARY_SIZE]);
+        }
+      }
       if(DEBUG){
 	      if(idVOX==debugVOX){
           printf("\n ----- MCMC GPU algorithm: voxel %i -----\n",idVOX);
@@ -463,13 +346,13 @@ namespace Cudimot{
     ///////////////////////////////////////////
     
     if(leader){
-      Initialize_priors_params(params,priors,nmeas,CFP,FixP);
+      Initialize_priors_params(params,priors,nmeas,CFP,FixP,MCbound_types,MCbounds_min,MCbounds_max,MCprior_types,MCpriors_a,MCpriors_b);
       Compute_TotalPrior(priors,TotalPrior);
     }
     // __threadfence_block();
     __syncthreads(); 
 
-    if(RICIAN_NOISE && !RECORDING){
+    if(RICIAN_NOISE && !RECORDING && first_iter==0){
       // TAU needs to be initializated 
       Initialise_TauRician<T>(idSubVOX,nmeas,CFP_Tsize,meas,params,CFP,FixP,TAU,TAUpropSD);
       // __threadfence_block();
@@ -496,8 +379,10 @@ namespace Cudimot{
     __syncthreads();
 
     int criteria=0;
+    T block_old_params[NPARAMS]; // only the leader, adaptive block sampler
+    T block_old_priors[NPARAMS];
     
-    for(int iter=0; iter<niters; iter++){
+    for(int iter=first_iter; iter<last_iter; iter++){
 
       if(DEBUG){
         if(idVOX==debugVOX&&leader){
@@ -561,13 +446,77 @@ namespace Cudimot{
         }	
       }
 
+      if(block){
+        // Propose all the free parameters together
+        criteria=0;
+        if(leader){
+          T z[NPARAMS];
+          #pragma unroll
+          for(int par=0; par<NPARAMS; par++){
+            block_old_params[par]=params[par];
+            block_old_priors[par]=priors[par];
+            z[par]=(T)0.0;
+            if(!MCfixed[par]){
+              z[par]=curand_normal(localrandState);
+            }
+          }
+          block_propose(block,z,block_old_params,params);
+          if(DEBUG){
+            if(idVOX==debugVOX){
+              printf("----\n");
+              for(int i=0;i<NPARAMS;i++){
+                printf("Proposing Value for Parameter_%i: %f\n",i,params[i]);
+              }
+            }
+          }
+          criteria=block_check_bounds(params,MCfixed,MCbound_types,MCbounds_min,MCbounds_max);
+        }
+        criteria = shfl(criteria,0);
+        // __threadfence_block(); //params is modified by leader
+        __syncthreads();
+
+        if(criteria){
+          Compute_Likelihood<T,RICIAN_NOISE,DEBUG>(idSubVOX,nmeas,CFP_Tsize,meas,params,TAU,CFP,FixP,likelihood,debugVOX);
+        }
+        // __threadfence_block(); // params cannot be modify until all threads finish
+        __syncthreads();
+
+        if(leader){
+          if(criteria){
+            block_priors(params,priors,nmeas,CFP,FixP,MCfixed,MCprior_types,MCpriors_a,MCpriors_b);
+            Compute_TotalPrior(priors,TotalPrior);
+            criteria=Compute_test_energy<T,DEBUG>(energy,old_energy,TotalPrior,likelihood,localrandState,debugVOX);
+            if(!criteria){
+              *energy=*old_energy;
+            }
+          }
+          if(criteria){
+            naccepted[0]++;
+          }else{
+            nrejected[0]++;
+            #pragma unroll
+            for(int par=0; par<NPARAMS; par++){
+              params[par]=block_old_params[par];
+              priors[par]=block_old_priors[par];
+            }
+          }
+          if(DEBUG){
+            if(idVOX==debugVOX){
+              printf(criteria?"Accepted Parameters\n":"Rejected Parameters\n");
+            }
+          }
+          if(!RECORDING){
+            block_accumulate(block,params,MCfixed);
+          }
+        }
+      }else{
       // Propose the rest of Parameters
       for(int par=0; par<NPARAMS; par++){
 	      criteria=0;
 	
         if(leader){
           Propose<T,DEBUG>(par,params,old_param,propSD,localrandState,debugVOX);
-          criteria=Check_bounds_constraints(par,params);
+          criteria=Check_bounds_constraints(par,params,MCbound_types,MCbounds_min,MCbounds_max);
         }	
         criteria = shfl(criteria,0);
         // __threadfence_block(); //params is modified by leader
@@ -581,7 +530,7 @@ namespace Cudimot{
  
         if(leader){
           if(criteria){
-            Compute_prior(par,params,priors,old_prior,nmeas,CFP,FixP);
+            Compute_prior(par,params,priors,old_prior,nmeas,CFP,FixP,MCprior_types,MCpriors_a,MCpriors_b);
             Compute_TotalPrior(priors,TotalPrior);
             criteria=Compute_test_energy<T,DEBUG>(energy,old_energy,TotalPrior,likelihood,localrandState,debugVOX);
             if(criteria){
@@ -614,16 +563,22 @@ namespace Cudimot{
 	      }
       }
       
+      }
+
       // Record Samples
       if(RECORDING){
 	      if((!(iter%sampleevery))&&(leader)){
 	        int nsamp=iter/sampleevery;
-	        #pragma unroll
-	        for(int par=0; par<NPARAMS; par++){
-	          samples[par*nsamples+nsamp]=params[par];
-	        }
-	        if(RICIAN_NOISE){
-	          tau_samples[idVOX*nsamples+nsamp]=*TAU;
+	        if(summary){
+	          summary_record(summary,params,*TAU,RICIAN_NOISE);
+	        }else{
+	          #pragma unroll
+	          for(int par=0; par<NPARAMS; par++){
+	            samples[par*nsamples+nsamp]=params[par];
+	          }
+	          if(RICIAN_NOISE){
+	            tau_samples[idVOX*nsamples+nsamp]=*TAU;
+	          }
 	        }
 	      }
       }
@@ -631,13 +586,23 @@ namespace Cudimot{
       // Update propsals Std
       if(!RECORDING || UPDATE_PROP){  // deactivated when not recording if --no_updateproposal
 	      if((iter>0)&&(!(iter%updateproposalevery))&&(leader)){
-          #pragma unroll
-	        for(int par=0; par<NPARAMS; par++){
-            propSD[par]*=sqrt((naccepted[par]+(T)1.0)/(nrejected[par]+(T)1.0));
-            propSD[par]=min_gpu(propSD[par],(T)maxfloat);
-            naccepted[par]=0;
-            nrejected[par]=0;
-	        }
+          if(block){
+            block_adapt_scale(block,naccepted[0],nrejected[0]);
+            if(!RECORDING){
+              // the covariance is frozen during the recording step
+              block_factor(block,MCfixed);
+            }
+            naccepted[0]=0;
+            nrejected[0]=0;
+          }else{
+            #pragma unroll
+            for(int par=0; par<NPARAMS; par++){
+              propSD[par]*=sqrt((naccepted[par]+(T)1.0)/(nrejected[par]+(T)1.0));
+              propSD[par]=min_gpu(propSD[par],(T)maxfloat);
+              naccepted[par]=0;
+              nrejected[par]=0;
+            }
+          }
 	        if(RICIAN_NOISE){
             (*TAUpropSD)*=sqrt(((*TAU_accepted)+(T)1.0)/(*(TAU_rejected)+(T)1.0));
             (*TAUpropSD)=min_gpu(*TAUpropSD,(T)maxfloat);
@@ -665,9 +630,7 @@ namespace Cudimot{
       #pragma unroll
       for(int par=0;par<NPARAMS;par++){
       	parameters[idVOX*NPARAMS+par]=params[par];
-        if(!RECORDING){
-          propSD_global[idVOX*NPARAMS+par]=propSD[par];
-        }
+        propSD_global[idVOX*NPARAMS+par]=propSD[par];
       }
       if(DEBUG){
 	      if(idVOX==debugVOX){
@@ -676,9 +639,9 @@ namespace Cudimot{
           }
 	      }
 	    }
-      if(RICIAN_NOISE && !RECORDING){
+      if(RICIAN_NOISE){
         //save TAU and TAUpropSD
-        tau_samples[idVOX*nsamples]=*TAU;
+        tau_global[idVOX]=*TAU;
         tau_propSD_global[idVOX]=*TAUpropSD;
       }
     }
@@ -689,6 +652,31 @@ namespace Cudimot{
     curand_init(seed,id,0,&randstate[id]);
   }
   
+  // Host buffers for the arrays of a part on the GPU, for the checkpoints
+  template <typename T>
+  vector<checkpoint_array<T> > checkpoint_host(const vector<checkpoint_array<T> >& gpu, vector<vector<T> >& buffers, int nvox){
+    vector<checkpoint_array<T> > host;
+    buffers.resize(gpu.size());
+    for(unsigned int a=0;a<gpu.size();a++){
+      buffers[a].resize((long)nvox*gpu[a].stride);
+      host.push_back(checkpoint_array<T>{buffers[a].data(),gpu[a].stride,gpu[a].size});
+    }
+    return host;
+  }
+
+  // Copies the arrays of a part between the GPU and the host buffers
+  template <typename T>
+  void checkpoint_copy(const vector<checkpoint_array<T> >& gpu, const vector<checkpoint_array<T> >& host, int nvox, bool to_gpu){
+    for(unsigned int a=0;a<gpu.size();a++){
+      if(to_gpu){
+        cudaMemcpy(gpu[a].data,host[a].data,(long)nvox*gpu[a].stride*sizeof(T),cudaMemcpyHostToDevice);
+      }else{
+        cudaMemcpy(host[a].data,gpu[a].data,(long)nvox*gpu[a].stride*sizeof(T),cudaMemcpyDeviceToHost);
+      }
+    }
+    sync_check("MCMC: Copying checkpoint");
+  }
+
   template <typename T>
   MCMC<T>::MCMC(int nvoxFitpart,
 		vector<int> bou_types, 
@@ -715,6 +703,37 @@ namespace Cudimot{
     if(opts.no_updateproposal.value()) updateproposal=false;
     RicianNoise=opts.rician.value();
 
+    if(opts.sampler.value()=="metropolis"){
+      sampler=METROPOLIS;
+    }else if(opts.sampler.value()=="adaptive_block"){
+      sampler=ADAPTIVE_BLOCK;
+    }else if(opts.sampler.value()=="hmc"){
+      sampler=HMC;
+    }else if(opts.sampler.value()=="nuts"){
+      sampler=NUTS;
+    }else{
+      cerr << "CUDIMOT Error: Unknown sampler '" << opts.sampler.value() << "'. The options of --sampler are metropolis, adaptive_block, hmc and nuts" << endl;
+      exit(-1);
+    }
+    if((sampler==HMC || sampler==NUTS) && !cpu_backend()){
+      cerr << "CUDIMOT Error: The samplers hmc and nuts are only available on the CPU. Use --backend=cpu" << endl;
+      exit(-1);
+    }
+    if((sampler==HMC && opts.hmc_steps.value()<1) || (sampler==NUTS && opts.nuts_depth.value()<1)){
+      cerr << "CUDIMOT Error: The number of leapfrog steps (--hmc_steps) and the depth of the trajectories (--nuts_depth) must be at least 1" << endl;
+      exit(-1);
+    }
+    nchains=opts.nchains.value();
+    if(nchains<1 || nchains>nsamples){
+      cerr << "CUDIMOT Error: The number of chains (--nchains) must be at least 1 and at most the number of samples (--nj/--se): " << nsamples << endl;
+      exit(-1);
+    }
+    if(nchains>1 && !cpu_backend()){
+      cerr << "CUDIMOT Error: Several chains per voxel (--nchains) are only available on the CPU. Use --backend=cpu" << endl;
+      exit(-1);
+    }
+    block_state=NULL;
+
     DEBUG=false;
     if(opts.debug.set()){
       DEBUG=true;
@@ -743,30 +762,60 @@ namespace Cudimot{
       fixed_host[p]=fix[p];
     }
 
-    cudaMemcpyToSymbol(MCbound_types,bound_types_host,NPARAMS*sizeof(int));
-    cudaMemcpyToSymbol(MCbounds_min,bounds_min_host,NPARAMS*sizeof(float));
-    cudaMemcpyToSymbol(MCbounds_max,bounds_max_host,NPARAMS*sizeof(float));
+    if(!cpu_backend()){
+      cudaMemcpyToSymbol(MCbound_types,bound_types_host,NPARAMS*sizeof(int));
+      cudaMemcpyToSymbol(MCbounds_min,bounds_min_host,NPARAMS*sizeof(float));
+      cudaMemcpyToSymbol(MCbounds_max,bounds_max_host,NPARAMS*sizeof(float));
     
-    cudaMemcpyToSymbol(MCprior_types,prior_types_host,NPARAMS*sizeof(int));
-    cudaMemcpyToSymbol(MCpriors_a,priors_a_host,NPARAMS*sizeof(float));
-    cudaMemcpyToSymbol(MCpriors_b,priors_b_host,NPARAMS*sizeof(float));
-
-    cudaMemcpyToSymbol(MCfixed,fixed_host,NPARAMS*sizeof(int));
-    sync_check("MCMC: Setting Bounds - Priors - Fixed");
-
-    //Allocate mem for proposal SD on GPU
-    cudaMalloc((void**)&propSD, nvoxFit_part*NPARAMS*sizeof(T));
-    cudaMalloc((void**)&tau_propSD, nvoxFit_part*sizeof(T));
-
-    // Initialise Randoms
-    int blocks_Rand = nvoxFit_part/256;
-    if(nvoxFit_part%256) blocks_Rand++;
-    cudaMalloc((void**)&randStates, blocks_Rand*256*sizeof(curandState));
-    dim3 Dim_Grid_Rand(blocks_Rand,1);
-    dim3 Dim_Block_Rand(256,1);
-    srand(opts.seed.value()+opts.idPart.value());  //randoms seed
-    setup_randoms_kernel<<<Dim_Grid_Rand,Dim_Block_Rand>>>(randStates,rand());
-    sync_check("Setup_Randoms_kernel");
+      cudaMemcpyToSymbol(MCprior_types,prior_types_host,NPARAMS*sizeof(int));
+      cudaMemcpyToSymbol(MCpriors_a,priors_a_host,NPARAMS*sizeof(float));
+      cudaMemcpyToSymbol(MCpriors_b,priors_b_host,NPARAMS*sizeof(float));
+
+      cudaMemcpyToSymbol(MCfixed,fixed_host,NPARAMS*sizeof(int));
+      sync_check("MCMC: Setting Bounds - Priors - Fixed");
+
+      //Allocate mem for proposal SD on GPU
+      cudaMalloc((void**)&propSD, nvoxFit_part*NPARAMS*sizeof(T));
+      cudaMalloc((void**)&tau_state, nvoxFit_part*sizeof(T));
+      cudaMalloc((void**)&tau_propSD, nvoxFit_part*sizeof(T));
+      if(sampler==ADAPTIVE_BLOCK){
+        cudaMalloc((void**)&block_state, nvoxFit_part*BLOCK_STATE_SIZE*sizeof(T));
+      }
+
+      // Initialise Randoms
+      int blocks_Rand = nvoxFit_part/256;
+      if(nvoxFit_part%256) blocks_Rand++;
+      cudaMalloc((void**)&randStates, blocks_Rand*256*sizeof(curandState));
+      dim3 Dim_Grid_Rand(blocks_Rand,1);
+      dim3 Dim_Block_Rand(256,1);
+      srand(opts.seed.value()+opts.idPart.value());  //randoms seed
+      setup_randoms_kernel<<<Dim_Grid_Rand,Dim_Block_Rand>>>(randStates,rand());
+      sync_check("Setup_Randoms_kernel");
+    }
+
+    // Options that determine the samples: a checkpoint can only be resumed with the same ones
+    vector<double> config;
+    config.push_back(sizeof(T));
+    config.push_back(NPARAMS);
+    config.push_back(cpu_backend());
+    config.push_back(cpu_backend()?0:nvoxFit_part); // random generators of the GPU
+    config.push_back(opts.seed.value());
+    config.push_back(nburnin);
+    config.push_back(njumps);
+    config.push_back(sampleevery);
+    config.push_back(updateproposal);
+    config.push_back(RicianNoise);
+    config.push_back(sampler);
+    config.push_back(opts.hmc_steps.value());
+    config.push_back(opts.nuts_depth.value());
+    config.push_back(nchains);
+    config.push_back(opts.rhat.value());
+    config.push_back(opts.min_ess.value());
+    config.push_back(opts.summary_only.value());
+    checkpoint=NULL;
+    if(opts.runMCMC.value()){
+      checkpoint=new mcmc_checkpoint<T>(config);
+    }
   }
   
   template <typename T>
@@ -777,7 +826,30 @@ namespace Cudimot{
 		    T* params,
 		    T* CFP, T* FixP,
 		    T* samples,
-		    T* tau_samples) 
+		    T* tau_samples,
+		    T* summary,
+		    T* convergence,
+		    int first_voxel)
+  {
+    if(cpu_backend()){
+      run_cpu(nvox,nmeas,CFP_size,FixP_size,meas,params,CFP,FixP,samples,tau_samples,summary,convergence,first_voxel);
+    }else{
+      // One chain per voxel on the GPU: there are no convergence diagnostics
+      run_gpu(nvox,nmeas,CFP_size,FixP_size,meas,params,CFP,FixP,samples,tau_samples,summary,first_voxel);
+    }
+  }
+
+  template <typename T>
+  void MCMC<T>::run_gpu(
+			int nvox, int nmeas,
+			int CFP_size, int FixP_size,
+			T* meas,
+			T* params,
+			T* CFP, T* FixP,
+			T* samples,
+			T* tau_samples,
+			T* summary,
+			int first_voxel)
   {
     long int amount_shared_mem = 0;
     amount_shared_mem += VOXELS_BLOCK*sizeof(curandState); // curandState
@@ -797,56 +869,152 @@ namespace Cudimot{
     int threads_block = VOXELS_BLOCK * THREADS_VOXEL;
     int nblocks=(nvox/VOXELS_BLOCK);
     if(nvox%VOXELS_BLOCK) nblocks++;
+
+    // Samples stored per voxel: one if the summaries are computed
+    int stride=summary?1:nsamples;
+
+    // Checkpoints: state of the chains (burn-in), state of the chains and results (recording), and parameters and results of each voxel at the end (voxels)
+    vector<checkpoint_array<T> > state, results;
+    state.push_back(checkpoint_array<T>{params,NPARAMS,NPARAMS});
+    state.push_back(checkpoint_array<T>{propSD,NPARAMS,NPARAMS});
+    if(RicianNoise){
+      state.push_back(checkpoint_array<T>{tau_state,1,1});
+      state.push_back(checkpoint_array<T>{tau_propSD,1,1});
+    }
+    if(block_state){
+      state.push_back(checkpoint_array<T>{block_state,BLOCK_STATE_SIZE,BLOCK_STATE_SIZE});
+    }
+    if(summary){
+      results.push_back(checkpoint_array<T>{summary,SUMMARY_VOXEL_SIZE,SUMMARY_VOXEL_SIZE});
+    }else{
+      results.push_back(checkpoint_array<T>{samples,NPARAMS*nsamples,NPARAMS*nsamples});
+      if(RicianNoise) results.push_back(checkpoint_array<T>{tau_samples,nsamples,nsamples});
+    }
+    vector<checkpoint_array<T> > outputs(1,state[0]), recording(state);
+    outputs.insert(outputs.end(),results.begin(),results.end());
+    recording.insert(recording.end(),results.begin(),results.end());
+    vector<vector<T> > state_buffers, results_buffers;
+    vector<checkpoint_array<T> > state_host, outputs_host, recording_host;
+    if(checkpoint->writing() || checkpoint->resuming()){
+      state_host=checkpoint_host(state,state_buffers,nvox);
+      vector<checkpoint_array<T> > results_host=checkpoint_host(results,results_buffers,nvox);
+      outputs_host.push_back(state_host[0]);
+      outputs_host.insert(outputs_host.end(),results_host.begin(),results_host.end());
+      recording_host=state_host;
+      recording_host.insert(recording_host.end(),results_host.begin(),results_host.end());
+    }
+
+    // Extra bytes of the records: state of the random number generators and iterations done of the step
+    long rand_bytes=((nvoxFit_part+255)/256)*256*sizeof(curandState);
+    vector<char> extra(rand_bytes+sizeof(int));
+    vector<int> voxels(nvox);
+    for(int idVOX=0;idVOX<nvox;idVOX++) voxels[idVOX]=idVOX;
+
+    auto save = [&](int type, const vector<checkpoint_array<T> >& gpu, const vector<checkpoint_array<T> >& host, int iters){
+      checkpoint_copy(gpu,host,nvox,false);
+      cudaMemcpy(extra.data(),randStates,rand_bytes,cudaMemcpyDeviceToHost);
+      memcpy(&extra[rand_bytes],&iters,sizeof(int));
+      checkpoint->write(type,first_voxel,voxels,host,extra.data(),extra.size());
+    };
+    auto load = [&](int type, const vector<checkpoint_array<T> >& gpu, const vector<checkpoint_array<T> >& host, int& iters){
+      vector<char> done(nvox,0);
+      if(checkpoint->restore(type,first_voxel,nvox,host,done,extra.data(),extra.size())<nvox) return false;
+      checkpoint_copy(gpu,host,nvox,true);
+      cudaMemcpy(randStates,extra.data(),rand_bytes,cudaMemcpyHostToDevice);
+      memcpy(&iters,&extra[rand_bytes],sizeof(int));
+      sync_check("MCMC: Restoring checkpoint");
+      return true;
+    };
+
+    // Iterations of each launch of the kernel: all, or CHECKPOINT_UPDATES updates of the proposals if checkpoints are written, finishing just after an update
+    long launch_iters=(long)nburnin+njumps;
+    if(checkpoint->writing()) launch_iters=(long)CHECKPOINT_UPDATES*updateproposalevery;
+    auto launch_end = [&](int iter, int niters){
+      long end=(iter/updateproposalevery)*(long)updateproposalevery+launch_iters+1;
+      return (int)(end<niters?end:niters);
+    };
+
+    int burnin_iters=0, recording_iters=0; // iterations done
+    if(checkpoint->resuming()){
+      int iters;
+      if(load(CHECKPOINT_VOXELS,outputs,outputs_host,iters)){
+        cout << "MCMC: part restored from the checkpoint" << endl;
+        return;
+      }
+      if(load(CHECKPOINT_RECORDING,recording,recording_host,recording_iters)){
+        burnin_iters=nburnin;
+        cout << "MCMC: part restored from the checkpoint, " << recording_iters << " iterations of the recording done" << endl;
+      }else if(load(CHECKPOINT_BURNIN,state,state_host,burnin_iters)){
+        cout << "MCMC: part restored from the checkpoint, " << burnin_iters << " iterations of the burn-in done" << endl;
+      }
+    }
     
     // Burn-In   ... always update_proposals
-    if(RicianNoise){
-      if(DEBUG){
-	      mcmc_kernel<T,false,true,true,true><<<nblocks,threads_block,amount_shared_mem>>>(randStates,nmeas,CFP_size,FixP_size,nburnin,nsamples,sampleevery,updateproposalevery,meas,params,propSD,CFP,FixP,samples,tau_samples,tau_propSD,debugVOX);
+    while(burnin_iters<nburnin){
+      int end=launch_end(burnin_iters,nburnin);
+      if(RicianNoise){
+        if(DEBUG){
+	        mcmc_kernel<T,false,true,true,true><<<nblocks,threads_block,amount_shared_mem>>>(randStates,nmeas,CFP_size,FixP_size,burnin_iters,end,stride,sampleevery,updateproposalevery,meas,params,propSD,CFP,FixP,samples,tau_samples,tau_state,tau_propSD,block_state,summary,debugVOX);
+        }else{
+	        mcmc_kernel<T,false,true,true,false><<<nblocks,threads_block,amount_shared_mem>>>(randStates,nmeas,CFP_size,FixP_size,burnin_iters,end,stride,sampleevery,updateproposalevery,meas,params,propSD,CFP,FixP,samples,tau_samples,tau_state,tau_propSD,block_state,summary,debugVOX);
+        }
       }else{
-	      mcmc_kernel<T,false,true,true,false><<<nblocks,threads_block,amount_shared_mem>>>(randStates,nmeas,CFP_size,FixP_size,nburnin,nsamples,sampleevery,updateproposalevery,meas,params,propSD,CFP,FixP,samples,tau_samples,tau_propSD,debugVOX);
+        if(DEBUG){
+	        mcmc_kernel<T,false,true,false,true><<<nblocks,threads_block,amount_shared_mem>>>(randStates,nmeas,CFP_size,FixP_size,burnin_iters,end,stride,sampleevery,updateproposalevery,meas,params,propSD,CFP,FixP,samples,tau_samples,tau_state,tau_propSD,block_state,summary,debugVOX);
+        }else{
+	        mcmc_kernel<T,false,true,false,false><<<nblocks,threads_block,amount_shared_mem>>>(randStates,nmeas,CFP_size,FixP_size,burnin_iters,end,stride,sampleevery,updateproposalevery,meas,params,propSD,CFP,FixP,samples,tau_samples,tau_state,tau_propSD,block_state,summary,debugVOX);
+        }
       }
-    }else{
-      if(DEBUG){
-	      mcmc_kernel<T,false,true,false,true><<<nblocks,threads_block,amount_shared_mem>>>(randStates,nmeas,CFP_size,FixP_size,nburnin,nsamples,sampleevery,updateproposalevery,meas,params,propSD,CFP,FixP,samples,tau_samples,tau_propSD,debugVOX);
-      }else{
-	      mcmc_kernel<T,false,true,false,false><<<nblocks,threads_block,amount_shared_mem>>>(randStates,nmeas,CFP_size,FixP_size,nburnin,nsamples,sampleevery,updateproposalevery,meas,params,propSD,CFP,FixP,samples,tau_samples,tau_propSD,debugVOX);
+      sync_check("MCMC Kernel: burnin step");
+      burnin_iters=end;
+      if(checkpoint->writing() && checkpoint->due()){
+        save(CHECKPOINT_BURNIN,state,state_host,burnin_iters);
       }
     }
-    sync_check("MCMC Kernel: burnin step");
     
     
     // Recordig
-    if(updateproposal){
-      if(RicianNoise){
-	      if(DEBUG){
-	        mcmc_kernel<T,true,true,true,true><<<nblocks,threads_block,amount_shared_mem>>>(randStates,nmeas,CFP_size,FixP_size,njumps,nsamples,sampleevery,updateproposalevery,meas,params,propSD,CFP,FixP,samples,tau_samples,tau_propSD,debugVOX);
-	      }else{
-	        mcmc_kernel<T,true,true,true,false><<<nblocks,threads_block,amount_shared_mem>>>(randStates,nmeas,CFP_size,FixP_size,njumps,nsamples,sampleevery,updateproposalevery,meas,params,propSD,CFP,FixP,samples,tau_samples,tau_propSD,debugVOX);
-	      }
-      }else{
-	      if(DEBUG){
-	        mcmc_kernel<T,true,true,false,true><<<nblocks,threads_block,amount_shared_mem>>>(randStates,nmeas,CFP_size,FixP_size,njumps,nsamples,sampleevery,updateproposalevery,meas,params,propSD,CFP,FixP,samples,tau_samples,tau_propSD,debugVOX);
-	      }else{
-	        mcmc_kernel<T,true,true,false,false><<<nblocks,threads_block,amount_shared_mem>>>(randStates,nmeas,CFP_size,FixP_size,njumps,nsamples,sampleevery,updateproposalevery,meas,params,propSD,CFP,FixP,samples,tau_samples,tau_propSD,debugVOX);
-	      }
+    while(recording_iters<njumps){
+      int end=launch_end(recording_iters,njumps);
+      if(updateproposal){
+        if(RicianNoise){
+	        if(DEBUG){
+	          mcmc_kernel<T,true,true,true,true><<<nblocks,threads_block,amount_shared_mem>>>(randStates,nmeas,CFP_size,FixP_size,recording_iters,end,stride,sampleevery,updateproposalevery,meas,params,propSD,CFP,FixP,samples,tau_samples,tau_state,tau_propSD,block_state,summary,debugVOX);
+	        }else{
+	          mcmc_kernel<T,true,true,true,false><<<nblocks,threads_block,amount_shared_mem>>>(randStates,nmeas,CFP_size,FixP_size,recording_iters,end,stride,sampleevery,updateproposalevery,meas,params,propSD,CFP,FixP,samples,tau_samples,tau_state,tau_propSD,block_state,summary,debugVOX);
+	        }
+        }else{
+	        if(DEBUG){
+	          mcmc_kernel<T,true,true,false,true><<<nblocks,threads_block,amount_shared_mem>>>(randStates,nmeas,CFP_size,FixP_size,recording_iters,end,stride,sampleevery,updateproposalevery,meas,params,propSD,CFP,FixP,samples,tau_samples,tau_state,tau_propSD,block_state,summary,debugVOX);
+	        }else{
+	          mcmc_kernel<T,true,true,false,false><<<nblocks,threads_block,amount_shared_mem>>>(randStates,nmeas,CFP_size,FixP_size,recording_iters,end,stride,sampleevery,updateproposalevery,meas,params,propSD,CFP,FixP,samples,tau_samples,tau_state,tau_propSD,block_state,summary,debugVOX);
+	        }
+        }
+        
+      }else{ // no_updateproposal
+        if(RicianNoise){
+	        if(DEBUG){
+	          mcmc_kernel<T,true,false,true,true><<<nblocks,threads_block,amount_shared_mem>>>(randStates,nmeas,CFP_size,FixP_size,recording_iters,end,stride,sampleevery,updateproposalevery,meas,params,propSD,CFP,FixP,samples,tau_samples,tau_state,tau_propSD,block_state,summary,debugVOX);
+	        }else{
+	          mcmc_kernel<T,true,false,true,false><<<nblocks,threads_block,amount_shared_mem>>>(randStates,nmeas,CFP_size,FixP_size,recording_iters,end,stride,sampleevery,updateproposalevery,meas,params,propSD,CFP,FixP,samples,tau_samples,tau_state,tau_propSD,block_state,summary,debugVOX);
+	        }
+        }else{
+	        if(DEBUG){
+	          mcmc_kernel<T,true,false,false,true><<<nblocks,threads_block,amount_shared_mem>>>(randStates,nmeas,CFP_size,FixP_size,recording_iters,end,stride,sampleevery,updateproposalevery,meas,params,propSD,CFP,FixP,samples,tau_samples,tau_state,tau_propSD,block_state,summary,debugVOX);
+	        }else{
+	          mcmc_kernel<T,true,false,false,false><<<nblocks,threads_block,amount_shared_mem>>>(randStates,nmeas,CFP_size,FixP_size,recording_iters,end,stride,sampleevery,updateproposalevery,meas,params,propSD,CFP,FixP,samples,tau_samples,tau_state,tau_propSD,block_state,summary,debugVOX);
+	        }
+        }
       }
-      
-    }else{ // no_updateproposal
-      if(RicianNoise){
-	      if(DEBUG){
-	        mcmc_kernel<T,true,false,true,true><<<nblocks,threads_block,amount_shared_mem>>>(randStates,nmeas,CFP_size,FixP_size,njumps,nsamples,sampleevery,updateproposalevery,meas,params,propSD,CFP,FixP,samples,tau_samples,tau_propSD,debugVOX);
-	      }else{
-	        mcmc_kernel<T,true,false,true,false><<<nblocks,threads_block,amount_shared_mem>>>(randStates,nmeas,CFP_size,FixP_size,njumps,nsamples,sampleevery,updateproposalevery,meas,params,propSD,CFP,FixP,samples,tau_samples,tau_propSD,debugVOX);
-	      }
-      }else{
-	      if(DEBUG){
-	        mcmc_kernel<T,true,false,false,true><<<nblocks,threads_block,amount_shared_mem>>>(randStates,nmeas,CFP_size,FixP_size,njumps,nsamples,sampleevery,updateproposalevery,meas,params,propSD,CFP,FixP,samples,tau_samples,tau_propSD,debugVOX);
-	      }else{
-	        mcmc_kernel<T,true,false,false,false><<<nblocks,threads_block,amount_shared_mem>>>(randStates,nmeas,CFP_size,FixP_size,njumps,nsamples,sampleevery,updateproposalevery,meas,params,propSD,CFP,FixP,samples,tau_samples,tau_propSD,debugVOX);
-	      }
+      sync_check("MCMC Kernel: recording step"); 
+      recording_iters=end;
+      if(checkpoint->writing() && recording_iters<njumps && checkpoint->due()){
+        save(CHECKPOINT_RECORDING,recording,recording_host,recording_iters);
       }
     }
-    sync_check("MCMC Kernel: recording step"); 
+    if(checkpoint->writing()){
+      save(CHECKPOINT_VOXELS,outputs,outputs_host,recording_iters);
+    }
   }
 
   // Explicit Instantiations of the template
@@ -18,18 +18,30 @@
 /* CCOPYRIGHT */
 
 #include <vector>
+#ifdef __CUDACC__
 #include <curand_kernel.h>
 #include <curand.h>
 #include <curand_kernel.h>
+#else
+// The host compiler (MCMC_cpu.cc) only needs the type of the pointer to the GPU random states
+struct curandStateXORWOW;
+typedef struct curandStateXORWOW curandState;
+#endif
 #include "gridOptions.h"
 #include "cudimot.h"
 #include "checkcudacalls.h"
 #include "cudimotoptions.h"
+#include "MCMC_checkpoint.h"
 
 using std::vector;
 
 namespace Cudimot{
 
+  /**
+   * Sampler of MCMC (--sampler)
+   */
+  enum mcmc_sampler{METROPOLIS,ADAPTIVE_BLOCK,HMC,NUTS};
+
   template <typename T>
   class MCMC{
 
@@ -75,6 +87,16 @@ namespace Cudimot{
      */
     bool RicianNoise;
 
+    /** 
+     * Sampler: Metropolis for each parameter in turn, adaptive block Metropolis (see MCMC_block.h) or Hamiltonian Monte Carlo (only CPU, see MCMC_hmc.h)
+     */
+    mcmc_sampler sampler;
+
+    /**
+     * Number of chains per voxel (only CPU). With several chains the burn-in of each voxel stops when the chains have converged
+     */
+    int nchains;
+
     /**
      * State of several random number generators on the GPU
      */
@@ -85,10 +107,25 @@ namespace Cudimot{
      */
      T* propSD;
 
+    /**
+     * Tau parameter (rician noise) of each voxel on the GPU, kept between the launches of the kernel
+     */
+    T* tau_state;
+
     /**
      * Standard Deviation of Proposal Distributions for Tau parameter (rician noise) on the GPU
      */
     T* tau_propSD;
+
+    /**
+     * State of the adaptive block sampler of each voxel on the GPU (BLOCK_STATE_SIZE values per voxel). NULL with the Metropolis sampler
+     */
+    T* block_state;
+
+    /**
+     * Checkpoints of the state of MCMC of the part (--checkpoint, --resume, see MCMC_checkpoint.h)
+     */
+    mcmc_checkpoint<T>* checkpoint;
     
     /**
      * Type of each parameter bounds
@@ -154,6 +191,19 @@ namespace Cudimot{
 	 vector<int> prior_types, vector<T> priors_a, vector<T> prior_b,
 	 vector<int> fixed);
 
+    /**
+     * Run MCMC algorithm on the backend selected with --backend (see cpu_backend): run_gpu() or run_cpu(). The pointers are in the memory of the part, on the GPU or on the host (see allocate_part)
+     * @param convergence Convergence diagnostics of each voxel with several chains (only on the CPU, see run_cpu)
+     */
+    void run( int nvox, int nmeas,
+	      int CFP_size, int FixP_size,
+	      T* meas, T* params,
+	      T* CFP, T* FixP,
+	      T* samples, T* tau,
+	      T* summary,
+	      T* convergence,
+	      int first_voxel);
+
     /**
      * Run MCMC algorithm on the GPU
      * @param nvox Number of voxels in the dataset
@@ -165,12 +215,30 @@ namespace Cudimot{
      * @param CFP Common (to all the voxels) fixed parameters of the model (on GPU). CFP_size*nmeas
      * @param FixP Fixed parameters of the model (on GPU). FixP_size*nvoxels
      * @param samples Samples of the parameters estimation will be stored here (on the GPU)
+     * @param summary Summaries of the samples of each voxel (SUMMARY_VOXEL_SIZE values per voxel, see MCMC_summary.h) will be stored here instead of the samples (on the GPU). NULL: the samples are stored. With summaries, samples and tau keep only one value per voxel
+     * @param first_voxel Index (mask order) in the whole dataset of the first voxel of the part. It identifies the part in the checkpoints
      */
-    void run( int nvox, int nmeas, 
-	      int CFP_size, int FixP_size,
-	      T* meas, T* params, 
-	      T* CFP, T* FixP,
-	      T* samples, T* tau);
+    void run_gpu( int nvox, int nmeas,
+		  int CFP_size, int FixP_size,
+		  T* meas, T* params,
+		  T* CFP, T* FixP,
+		  T* samples, T* tau,
+		  T* summary,
+		  int first_voxel);
+
+    /**
+     * Run MCMC algorithm on the CPU. The voxels are distributed among several threads (--nthreads). Same arguments than run_gpu(), but all the pointers are in host memory
+     * @param convergence Convergence diagnostics of each voxel with several chains (MCMC_NDIAGNOSTICS values per voxel). Not used with one chain
+     * @param first_voxel Index (mask order) in the whole dataset of the first voxel of the part. The random numbers of each voxel depend only on the seed and this index
+     */
+    void run_cpu( int nvox, int nmeas,
+		  int CFP_size, int FixP_size,
+		  T* meas, T* params,
+		  T* CFP, T* FixP,
+		  T* samples, T* tau,
+		  T* summary,
+		  T* convergence,
+		  int first_voxel);
   };
 }
 
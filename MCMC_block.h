@@ -0,0 +1,167 @@
+#ifndef CUDIMOT_MCMC_BLOCK_H_INCLUDED
+#define CUDIMOT_MCMC_BLOCK_H_INCLUDED
+
+/*  MCMC_block.h
+
+    Adaptive block Metropolis sampler (--sampler=adaptive_block), in the style of the Adaptive Metropolis of Haario et al. (Bernoulli 7, 2001). Instead of a proposal and a likelihood evaluation for each parameter in turn, all the free parameters are proposed together:
+
+      x' = x + scale * L * z,   z ~ N(0,I)
+
+    where L is the Cholesky factor of the covariance of the states of the chain during burn-in. The covariance is accumulated at every iteration of burn-in (Welford), and L is computed again every updateproposalevery iterations once there are BLOCK_MIN_STATES states per free parameter. Before that, L is diagonal with the initial standard deviations of the proposals. The scale starts at 2.38/sqrt(d) when the covariance is used (d: number of free parameters), and it is adapted every updateproposalevery iterations towards an acceptance rate of BLOCK_ACCEPTANCE, as the standard deviations of the one-parameter sampler. During the recording step L is not modified, so the samples come from a fixed proposal (the scale is still adapted unless --no_updateproposal).
+
+    One iteration costs one likelihood evaluation (two with Rician noise: tau is proposed alone) instead of NPARAMS. The state of the sampler of each voxel (BLOCK_STATE_SIZE values) is kept between the burn-in and the recording steps.
+
+    They are shared by the GPU version (MCMC.cu, only the leader thread of a voxel) and the CPU version (MCMC_cpu.cc). It must be included after MCMC_priors.h
+
+    agent
+
+    Copyright (C) 2026 University of Oxford  */
+
+/*  CCOPYRIGHT  */
+
+#include "cudimot.h"
+
+// Target acceptance rate of the joint proposals
+#define BLOCK_ACCEPTANCE 0.234
+// States of the chain per free parameter needed before using their covariance
+#define BLOCK_MIN_STATES 10
+
+// State of the sampler of a voxel
+#define BLOCK_MEAN 0 // Mean of the states [NPARAMS]
+#define BLOCK_M2 NPARAMS // Sum of the products of the deviations from the mean [NPARAMS*NPARAMS]
+#define BLOCK_CHOL (NPARAMS+NPARAMS*NPARAMS) // Cholesky factor of the proposal (lower triangular) [NPARAMS*NPARAMS]
+#define BLOCK_SCALE (NPARAMS+2*NPARAMS*NPARAMS) // Scale of the proposal
+#define BLOCK_NSTATES (BLOCK_SCALE+1) // Number of states accumulated
+#define BLOCK_READY (BLOCK_SCALE+2) // 1 if L is the factor of the covariance
+#define BLOCK_STATE_SIZE (BLOCK_SCALE+3)
+
+namespace Cudimot{
+
+  // Number of parameters that are not fixed
+  FUNC int block_nfree(const int* fixed){
+    int nfree=0;
+    for(int p=0;p<NPARAMS;p++){
+      if(!fixed[p]) nfree++;
+    }
+    if(nfree<1) nfree=1;
+    return nfree;
+  }
+
+  // Initial state of the sampler: diagonal proposal with the standard deviations propSD
+  template <typename T>
+  FUNC void block_init(T* block, const T* propSD, const int* fixed){
+    for(int p=0;p<NPARAMS;p++){
+      block[BLOCK_MEAN+p]=(T)0.0;
+      for(int q=0;q<NPARAMS;q++){
+	block[BLOCK_M2+p*NPARAMS+q]=(T)0.0;
+	block[BLOCK_CHOL+p*NPARAMS+q]=(T)0.0;
+      }
+      if(!fixed[p]) block[BLOCK_CHOL+p*NPARAMS+p]=fabs_gpu(propSD[p]);
+    }
+    block[BLOCK_SCALE]=(T)1.0/sqrt_gpu((T)block_nfree(fixed));
+    block[BLOCK_NSTATES]=(T)0.0;
+    block[BLOCK_READY]=(T)0.0;
+  }
+
+  // Adds the current state of the chain to the mean and covariance (Welford)
+  template <typename T>
+  FUNC void block_accumulate(T* block, const T* params, const int* fixed){
+    T n=block[BLOCK_NSTATES]+(T)1.0;
+    block[BLOCK_NSTATES]=n;
+    T delta[NPARAMS];
+    for(int p=0;p<NPARAMS;p++){
+      delta[p]=params[p]-block[BLOCK_MEAN+p];
+      block[BLOCK_MEAN+p]+=delta[p]/n;
+    }
+    for(int p=0;p<NPARAMS;p++){
+      if(fixed[p]) continue;
+      for(int q=0;q<=p;q++){
+	if(fixed[q]) continue;
+	block[BLOCK_M2+p*NPARAMS+q]+=delta[p]*(params[q]-block[BLOCK_MEAN+q]);
+      }
+    }
+  }
+
+  /**
+   * Cholesky factor of the covariance of the states, with a small regularisation of the diagonal. The factor is not modified if there are not enough states or the covariance is not positive definite (e.g. a parameter did not move)
+   */
+  template <typename T>
+  FUNC void block_factor(T* block, const int* fixed){
+    T n=block[BLOCK_NSTATES];
+    int nfree=block_nfree(fixed);
+    if(n<(T)(BLOCK_MIN_STATES*nfree)) return;
+    T L[NPARAMS*NPARAMS];
+    for(int p=0;p<NPARAMS;p++){
+      for(int q=0;q<NPARAMS;q++){
+	L[p*NPARAMS+q]=(T)0.0;
+      }
+    }
+    for(int p=0;p<NPARAMS;p++){
+      if(fixed[p]) continue;
+      for(int q=0;q<=p;q++){
+	if(fixed[q]) continue;
+	T sum=block[BLOCK_M2+p*NPARAMS+q]/(n-(T)1.0);
+	if(p==q) sum*=(T)1.000001;
+	for(int k=0;k<q;k++){
+	  sum-=L[p*NPARAMS+k]*L[q*NPARAMS+k];
+	}
+	if(p==q){
+	  if(!(sum>(T)0.0)) return;
+	  L[p*NPARAMS+p]=sqrt_gpu(sum);
+	}else{
+	  L[p*NPARAMS+q]=sum/L[q*NPARAMS+q];
+	}
+      }
+    }
+    for(int i=0;i<NPARAMS*NPARAMS;i++){
+      block[BLOCK_CHOL+i]=L[i];
+    }
+    if(block[BLOCK_READY]==(T)0.0){
+      block[BLOCK_SCALE]=(T)2.38/sqrt_gpu((T)nfree);
+      block[BLOCK_READY]=(T)1.0;
+    }
+  }
+
+  // Joint proposal: params = old + scale*L*z. z of the fixed parameters must be 0
+  template <typename T>
+  FUNC void block_propose(const T* block, const T* z, const T* old, T* params){
+    for(int p=0;p<NPARAMS;p++){
+      T step=(T)0.0;
+      for(int q=0;q<=p;q++){
+	step+=block[BLOCK_CHOL+p*NPARAMS+q]*z[q];
+      }
+      params[p]=old[p]+block[BLOCK_SCALE]*step;
+    }
+  }
+
+  // Adapts the scale towards an acceptance rate of BLOCK_ACCEPTANCE
+  template <typename T>
+  FUNC void block_adapt_scale(T* block, int naccepted, int nrejected){
+    block[BLOCK_SCALE]*=sqrt_gpu(((naccepted+(T)1.0)/(nrejected+(T)1.0))*(T)((1.0-BLOCK_ACCEPTANCE)/BLOCK_ACCEPTANCE));
+    block[BLOCK_SCALE]=min_gpu(block[BLOCK_SCALE],(T)1e10);
+  }
+
+  // Bounds and constraints of all the free parameters
+  template <typename T>
+  FUNC int block_check_bounds(T* params, const int* fixed,
+			      const int* bound_types, const float* bounds_min, const float* bounds_max){
+    for(int p=0;p<NPARAMS;p++){
+      if(fixed[p]) continue;
+      if(!Check_bounds_constraints(p,params,bound_types,bounds_min,bounds_max)) return 0;
+    }
+    return 1;
+  }
+
+  // Priors of all the free parameters
+  template <typename T>
+  FUNC void block_priors(T* params, T* priors, int nmeas, T* CFP, T* FixP, const int* fixed,
+			 const int* prior_types, const float* priors_a, const float* priors_b){
+    T old_prior;
+    for(int p=0;p<NPARAMS;p++){
+      if(fixed[p]) continue;
+      Compute_prior(p,params,priors,&old_prior,nmeas,CFP,FixP,prior_types,priors_a,priors_b);
+    }
+  }
+}
+
+#endif
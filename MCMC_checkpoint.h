@@ -0,0 +1,306 @@
+#ifndef CUDIMOT_MCMC_CHECKPOINT_H_INCLUDED
+#define CUDIMOT_MCMC_CHECKPOINT_H_INCLUDED
+
+/*  MCMC_checkpoint.h
+
+    Checkpoints of MCMC (--checkpoint) in the directory of the part, to continue a run that was stopped (--resume) with the same samples.
+
+    The file starts with the options that determine the samples, and it is followed by the records appended during the run:
+      CHECKPOINT_VOXELS: final values of some voxels (parameters, samples or summaries, convergence diagnostics). The CPU version writes the voxels finished every --checkpoint seconds: the random numbers of a voxel depend only on the seed and the index of the voxel, so the voxels that are not in the checkpoint give the same samples when they are run again. The GPU version writes the whole part after the recording, with the state of the random number generators, that continues in the next part.
+      CHECKPOINT_BURNIN: state of the chains of a part during the burn-in (GPU), every --checkpoint seconds: parameters, std of the proposals, tau, state of the adaptive block sampler, and the state of the random number generators and the iterations done. The kernel is launched for a few updates of the proposals at a time, and a launch finishes just after an update, so the accepted/rejected counters are zero and are not needed.
+      CHECKPOINT_RECORDING: the same during the recording (GPU), with the samples or summaries recorded so far.
+
+    A record that was not completely written (the run was stopped while writing it) is removed when resuming. Only host code: it is included through MCMC.h by MCMC_cpu.cc and by MCMC.cu, compiled with nvcc.
+
+    agent
+
+    Copyright (C) 2026 University of Oxford  */
+
+/*  CCOPYRIGHT  */
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <chrono>
+#include <mutex>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+#include "cudimotoptions.h"
+
+#define CHECKPOINT_VERSION 2
+#define CHECKPOINT_VOXELS 0 // Final values of some voxels
+#define CHECKPOINT_BURNIN 1 // State of the chains of a part during the burn-in (GPU)
+#define CHECKPOINT_RECORDING 2 // State of the chains and samples of a part during the recording (GPU)
+
+namespace Cudimot{
+
+  /**
+   * @return Path of the checkpoint of MCMC of this part
+   */
+  inline std::string checkpoint_file(){
+    cudimotOptions& opts = cudimotOptions::getInstance();
+    return opts.partsdir.value()+"/part_"+std::to_string(opts.idPart.value())+"/MCMC_checkpoint";
+  }
+
+  /**
+   * Array of a part with the values of each voxel: the first size values every stride values
+   */
+  template <typename T>
+  struct checkpoint_array{
+    T* data;
+    int stride;
+    int size;
+  };
+
+  /**
+   * Header of a record of the checkpoint. It is followed by the index of each voxel (long), the values of each voxel (T) and the extra bytes
+   */
+  struct checkpoint_record{
+    int type;          // CHECKPOINT_VOXELS or CHECKPOINT_BURNIN
+    int nvox;          // Number of voxels in the record
+    long first_voxel;  // Index of the first voxel of the part
+    long values;       // Values of each voxel
+    long extra;        // Bytes of the state of the random number generators and the iterations done (GPU)
+  };
+
+  template <typename T>
+  class mcmc_checkpoint{
+    std::string file;
+    double interval; // seconds between checkpoints, 0: no checkpoints
+    bool resume; // there is a checkpoint of a previous run
+    long start; // position of the first record
+    std::chrono::steady_clock::time_point last;
+    std::mutex lock; // finished and last, with the threads of the CPU version
+    std::mutex writer; // appends to the file
+    std::vector<int> finished; // voxels finished since the last checkpoint (CPU)
+
+    /**
+     * Reads the records of the checkpoint and calls visit(record,voxels,values,extra) for each one
+     * @return Position of the end of the last complete record
+     */
+    template <typename Visit>
+    long scan(std::ifstream& in, Visit visit){
+      long end=in.tellg();
+      checkpoint_record rec;
+      while(in.read((char*)&rec,sizeof(rec))){
+	if(rec.nvox<0 || rec.values<0 || rec.extra<0) break;
+	std::vector<long> voxels(rec.nvox);
+	std::vector<T> values(rec.nvox*rec.values);
+	std::vector<char> extra(rec.extra);
+	if(rec.nvox>0 && !in.read((char*)&voxels[0],rec.nvox*sizeof(long))) break;
+	if(values.size()>0 && !in.read((char*)&values[0],values.size()*sizeof(T))) break;
+	if(rec.extra>0 && !in.read(&extra[0],rec.extra)) break;
+	visit(rec,voxels,values,extra);
+	end=in.tellg();
+      }
+      return end;
+    }
+
+    /**
+     * Opens the checkpoint and checks its header
+     * @return false if the options are different
+     */
+    bool open(std::ifstream& in, const std::vector<double>& config){
+      in.open(file.data(), std::ios::in | std::ios::binary);
+      char magic[8];
+      int version, nconfig;
+      if(!in.read(magic,8) || strncmp(magic,"CUDIMOT",8) || !in.read((char*)&version,4) || version!=CHECKPOINT_VERSION) return false;
+      if(!in.read((char*)&nconfig,4) || nconfig!=(int)config.size()) return false;
+      std::vector<double> previous(nconfig);
+      if(!in.read((char*)&previous[0],nconfig*sizeof(double))) return false;
+      return previous==config;
+    }
+
+    /**
+     * Appends a record to the file. The caller holds writer
+     */
+    void append(int type, long first_voxel, const std::vector<int>& voxels, const std::vector<checkpoint_array<T> >& arrays, const void* extra, long extra_bytes){
+      checkpoint_record rec;
+      rec.type=type;
+      rec.nvox=voxels.size();
+      rec.first_voxel=first_voxel;
+      rec.values=0;
+      for(unsigned int a=0;a<arrays.size();a++) rec.values+=arrays[a].size;
+      rec.extra=extra_bytes;
+      std::vector<long> ids(rec.nvox);
+      std::vector<T> values(rec.nvox*rec.values);
+      T* v=values.data();
+      for(int i=0;i<rec.nvox;i++){
+	ids[i]=first_voxel+voxels[i];
+	for(unsigned int a=0;a<arrays.size();a++){
+	  memcpy(v,&arrays[a].data[(long)voxels[i]*arrays[a].stride],arrays[a].size*sizeof(T));
+	  v+=arrays[a].size;
+	}
+      }
+      std::ofstream out;
+      out.open(file.data(), std::ios::out | std::ios::binary | std::ios::app);
+      out.write((char*)&rec,sizeof(rec));
+      out.write((char*)ids.data(),rec.nvox*sizeof(long));
+      out.write((char*)values.data(),values.size()*sizeof(T));
+      if(extra_bytes>0) out.write((const char*)extra,extra_bytes);
+      out.close();
+      if(!out){
+	std::cerr << "CUDIMOT Error: The checkpoint " << file << " cannot be written" << std::endl;
+	exit(-1);
+      }
+    }
+
+  public:
+
+    /**
+     * Resumes the checkpoint of a previous run (--resume) or creates a new one (--checkpoint)
+     * @param config Options that determine the samples, they must be the same to resume a run
+     */
+    mcmc_checkpoint(const std::vector<double>& config){
+      cudimotOptions& opts = cudimotOptions::getInstance();
+      file=checkpoint_file();
+      interval=opts.checkpoint.value();
+      resume=false;
+      if(opts.resume.value()){
+	if(access(file.data(),F_OK)==0){
+	  std::ifstream in;
+	  if(!open(in,config)){
+	    std::cerr << "CUDIMOT Error: The checkpoint " << file << " was written with different options, MCMC cannot be resumed" << std::endl;
+	    exit(-1);
+	  }
+	  start=in.tellg();
+	  long end=scan(in,[](const checkpoint_record&, const std::vector<long>&, const std::vector<T>&, const std::vector<char>&){});
+	  in.close();
+	  if(truncate(file.data(),end)){ // removes an incomplete record
+	    std::cerr << "CUDIMOT Error: The checkpoint " << file << " cannot be written" << std::endl;
+	    exit(-1);
+	  }
+	  resume=true;
+	}else{
+	  std::cout << "No checkpoint of MCMC in " << file << ": it starts from the beginning" << std::endl;
+	}
+      }
+      if(interval>0 && !resume){
+	std::ofstream out;
+	out.open(file.data(), std::ios::out | std::ios::binary | std::ios::trunc);
+	int version=CHECKPOINT_VERSION;
+	int nconfig=config.size();
+	out.write("CUDIMOT",8);
+	out.write((char*)&version,4);
+	out.write((char*)&nconfig,4);
+	out.write((char*)&config[0],nconfig*sizeof(double));
+	out.close();
+	if(!out){
+	  std::cerr << "CUDIMOT Error: The checkpoint " << file << " cannot be written" << std::endl;
+	  exit(-1);
+	}
+      }
+      last=std::chrono::steady_clock::now();
+    }
+
+    /**
+     * @return true if checkpoints are written (--checkpoint)
+     */
+    bool writing() const{
+      return interval>0;
+    }
+
+    /**
+     * @return true if --checkpoint seconds have passed since the last checkpoint
+     */
+    bool due() const{
+      return std::chrono::duration<double>(std::chrono::steady_clock::now()-last).count()>=interval;
+    }
+
+    /**
+     * @return true if there is a checkpoint of a previous run to continue (--resume)
+     */
+    bool resuming() const{
+      return resume;
+    }
+
+    /**
+     * Appends a record to the checkpoint
+     * @param voxels Voxels of the part (index in the part) to write
+     * @param arrays Arrays of the part with the values of the voxels
+     * @param extra State of the random number generators and iterations done, NULL if extra_bytes is 0
+     */
+    void write(int type, long first_voxel, const std::vector<int>& voxels, const std::vector<checkpoint_array<T> >& arrays, const void* extra, long extra_bytes){
+      {
+	std::lock_guard<std::mutex> guard(writer);
+	append(type,first_voxel,voxels,arrays,extra,extra_bytes);
+      }
+      std::lock_guard<std::mutex> guard(lock);
+      last=std::chrono::steady_clock::now();
+    }
+
+    /**
+     * Restores the values of the voxels of a part from the records of a type
+     * @param nvox Number of voxels of the part
+     * @param arrays Arrays of the part where the values are restored, the same than in write
+     * @param done Voxels restored are set to 1
+     * @param extra State of the random number generators and iterations done of the last record of the part are copied here, if it has extra_bytes
+     * @return Number of voxels restored
+     */
+    int restore(int type, long first_voxel, int nvox, const std::vector<checkpoint_array<T> >& arrays, std::vector<char>& done, void* extra, long extra_bytes){
+      long nvalues=0;
+      for(unsigned int a=0;a<arrays.size();a++) nvalues+=arrays[a].size;
+      int restored=0;
+      std::ifstream in;
+      in.open(file.data(), std::ios::in | std::ios::binary);
+      in.seekg(start);
+      scan(in,[&](const checkpoint_record& rec, const std::vector<long>& voxels, const std::vector<T>& values, const std::vector<char>& bytes){
+	  if(rec.type!=type || rec.values!=nvalues) return;
+	  for(int i=0;i<rec.nvox;i++){
+	    long idVOX=voxels[i]-first_voxel;
+	    if(idVOX<0 || idVOX>=nvox) continue;
+	    const T* v=&values[i*nvalues];
+	    for(unsigned int a=0;a<arrays.size();a++){
+	      memcpy(&arrays[a].data[idVOX*arrays[a].stride],v,arrays[a].size*sizeof(T));
+	      v+=arrays[a].size;
+	    }
+	    if(!done[idVOX]){
+	      done[idVOX]=1;
+	      restored++;
+	    }
+	  }
+	  if(extra_bytes>0 && rec.first_voxel==first_voxel && rec.extra==extra_bytes){
+	    memcpy(extra,bytes.data(),extra_bytes);
+	  }
+	});
+      in.close();
+      return restored;
+    }
+
+    /**
+     * Called by the threads of the CPU version when a voxel has finished. The voxels finished are written every --checkpoint seconds, by the thread that finds the checkpoint due. The other threads never wait for the file
+     */
+    void voxel_finished(long first_voxel, int idVOX, const std::vector<checkpoint_array<T> >& arrays){
+      std::vector<int> voxels;
+      {
+	std::lock_guard<std::mutex> guard(lock);
+	finished.push_back(idVOX);
+	if(!due()) return;
+	voxels.swap(finished);
+	last=std::chrono::steady_clock::now();
+      }
+      // The values of the voxels finished are not modified anymore, so they are written without holding lock. If another thread is writing, the voxels are left for the next checkpoint
+      std::unique_lock<std::mutex> writing(writer,std::try_to_lock);
+      if(writing.owns_lock()){
+	append(CHECKPOINT_VOXELS,first_voxel,voxels,arrays,NULL,0);
+      }else{
+	std::lock_guard<std::mutex> guard(lock);
+	finished.insert(finished.end(),voxels.begin(),voxels.end());
+      }
+    }
+
+    /**
+     * Writes the voxels finished since the last checkpoint (CPU), at the end of a part
+     */
+    void flush(long first_voxel, const std::vector<checkpoint_array<T> >& arrays){
+      if(!finished.empty()){
+	write(CHECKPOINT_VOXELS,first_voxel,finished,arrays,NULL,0);
+	finished.clear();
+      }
+    }
+  };
+}
+
+#endif
@@ -0,0 +1,153 @@
+#ifndef CUDIMOT_MCMC_CONVERGENCE_H_INCLUDED
+#define CUDIMOT_MCMC_CONVERGENCE_H_INCLUDED
+
+/*  MCMC_convergence.h
+
+    Convergence diagnostics of several chains of a voxel (--nchains), used by the CPU version of MCMC (MCMC_cpu.cc) to stop the burn-in of each voxel when its chains have converged.
+
+      split R-hat: potential scale reduction factor (Gelman et al., Bayesian Data Analysis, 3rd edition), with each chain divided in two halves to detect the chains that have not become stationary.
+      effective sample size: of all the chains together, with the autocorrelations combined as in Stan and truncated with the initial monotone sequence estimator of Geyer (Statistical Science 7, 1992).
+
+    The states of the chains are stored in a buffer [nchains x n]: state i of chain c at x[c*n+i]. Only compiled with the host compiler.
+
+    agent
+
+    Copyright (C) 2026 University of Oxford  */
+
+/*  CCOPYRIGHT  */
+
+#include <cmath>
+#include <vector>
+
+#define RHAT_MIN_STATES 4 // States of each half of a chain needed to compute the diagnostics
+
+namespace Cudimot{
+
+  /**
+   * Split R-hat of a parameter
+   * @param x States of the chains [nchains x n]
+   * @return R-hat, HUGE_VAL if a chain did not move
+   */
+  inline double split_rhat(const double* x, int nchains, int n){
+    int h=n/2; // the middle state is not used if n is odd
+    int m=2*nchains;
+    std::vector<double> means(m), vars(m);
+    for(int c=0;c<nchains;c++){
+      for(int half=0;half<2;half++){
+	const double* seq=&x[c*n+(half?n-h:0)];
+	double mean=0.0;
+	for(int i=0;i<h;i++) mean+=seq[i];
+	mean/=h;
+	double var=0.0;
+	for(int i=0;i<h;i++) var+=(seq[i]-mean)*(seq[i]-mean);
+	means[2*c+half]=mean;
+	vars[2*c+half]=var/(h-1);
+      }
+    }
+    double mean=0.0, W=0.0;
+    for(int s=0;s<m;s++){
+      mean+=means[s];
+      W+=vars[s];
+    }
+    mean/=m;
+    W/=m;
+    double B=0.0; // between-chains variance divided by h
+    for(int s=0;s<m;s++) B+=(means[s]-mean)*(means[s]-mean);
+    B/=(m-1);
+    if(!(W>0.0)) return HUGE_VAL;
+    double var_plus=((h-1.0)/h)*W+B;
+    return sqrt(var_plus/W);
+  }
+
+  /**
+   * Autocovariance at lag t of a chain (biased estimator, as Stan)
+   */
+  inline double chain_autocovariance(const double* seq, int n, double mean, int t){
+    double sum=0.0;
+    for(int i=0;i+t<n;i++) sum+=(seq[i]-mean)*(seq[i+t]-mean);
+    return sum/n;
+  }
+
+  /**
+   * Effective sample size of a parameter in all the chains. The autocovariances are computed only up to the truncation of the sum of autocorrelations, usually a few lags
+   * @param x States of the chains [nchains x n]
+   * @return Effective sample size, 0 if the chains did not move
+   */
+  inline double multichain_ess(const double* x, int nchains, int n){
+    std::vector<double> means(nchains);
+    double mean=0.0, W=0.0;
+    for(int c=0;c<nchains;c++){
+      const double* seq=&x[c*n];
+      double m=0.0;
+      for(int i=0;i<n;i++) m+=seq[i];
+      m/=n;
+      means[c]=m;
+      mean+=m;
+      W+=chain_autocovariance(seq,n,m,0)*n/(n-1.0);
+    }
+    mean/=nchains;
+    W/=nchains;
+    double B=0.0; // between-chains variance divided by n
+    if(nchains>1){
+      for(int c=0;c<nchains;c++) B+=(means[c]-mean)*(means[c]-mean);
+      B/=(nchains-1);
+    }
+    double var_plus=((n-1.0)/n)*W+B;
+    if(!(var_plus>0.0)) return 0.0;
+
+    // Autocorrelation of all the chains: rho_t = 1 - (W - mean of the autocovariances at lag t)/var_plus
+    auto rho=[&](int t){
+      if(t==0) return 1.0;
+      double acov_t=0.0;
+      for(int c=0;c<nchains;c++) acov_t+=chain_autocovariance(&x[c*n],n,means[c],t);
+      acov_t/=nchains;
+      return 1.0-(W-acov_t)/var_plus;
+    };
+
+    // Sums of pairs of autocorrelations while they are positive, forced to be monotone
+    double tau=-1.0;
+    double last_pair=HUGE_VAL;
+    for(int t=0;t+1<n;t+=2){
+      double pair=rho(t)+rho(t+1);
+      if(!(pair>0.0)) break;
+      if(pair>last_pair) pair=last_pair;
+      last_pair=pair;
+      tau+=2.0*pair;
+    }
+    double total=(double)nchains*n;
+    if(tau<1.0/log10(total)) tau=1.0/log10(total); // antithetic chains: at most N*log10(N) as Stan
+    return total/tau;
+  }
+
+  /**
+   * Diagnostics of the last half of the states of the chains of a voxel: maximum split R-hat and minimum effective sample size of the free parameters
+   * @param history States of the chains [nchains x nparams x maxstates]
+   * @param nstates Number of states stored in history
+   * @return false if there are not enough states
+   */
+  inline bool chains_diagnostics(const double* history, int nchains, int nparams, int maxstates, int nstates,
+				 const int* fixed, double& rhat, double& ess){
+    int first=nstates/2;
+    int n=nstates-first;
+    if(n<2*RHAT_MIN_STATES) return false;
+    std::vector<double> x(nchains*n);
+    rhat=1.0;
+    ess=HUGE_VAL;
+    for(int p=0;p<nparams;p++){
+      if(fixed[p]) continue;
+      for(int c=0;c<nchains;c++){
+	for(int i=0;i<n;i++){
+	  x[c*n+i]=history[(c*nparams+p)*maxstates+first+i];
+	}
+      }
+      double r=split_rhat(&x[0],nchains,n);
+      double e=multichain_ess(&x[0],nchains,n);
+      if(!(r<=rhat)) rhat=r; // also NaN
+      if(!(e>=ess)) ess=e;
+    }
+    if(ess==HUGE_VAL) ess=(double)nchains*n; // all the parameters fixed
+    return true;
+  }
+}
+
+#endif
@@ -0,0 +1,896 @@
+/* MCMC_cpu.cc
+
+   MCMC on the CPU. It is the same algorithm as the GPU version (MCMC.cu): a Metropolis step for each parameter in turn (or a joint step of all the parameters with --sampler=adaptive_block, see MCMC_block.h), update of the standard deviation of the proposals every updateproposalevery iterations and Rician noise modelling with a tau parameter. Each voxel is processed by a single CPU thread and the voxels are distributed among a pool of threads.
+
+   The Hamiltonian Monte Carlo samplers (--sampler=hmc or nuts, see MCMC_hmc.h) are only available on the CPU.
+
+   Several chains per voxel (--nchains) are also only available on the CPU. The chains start from the initial parameters perturbed (except the first chain) and their burn-in is run in steps of updateproposalevery iterations. After each step the split R-hat and the effective sample size of the last half of the burn-in states are computed (MCMC_convergence.h), and the burn-in of the voxel stops when they reach --rhat and --min_ess, or after --bi iterations. The samples are divided among the chains, so the number of samples and the cost of the recording step do not change. The R-hat, the effective sample size and the iterations of burn-in of each voxel are returned as diagnostics.
+
+   The random numbers come from a counter-based generator (cpu_random.h) keyed by the seed and the index of the voxel in the whole dataset, so the samples do not depend on the number of threads, on the number of parts (--nParts) or on the size of the parts.
+
+   This file is compiled with the host compiler (not nvcc), so the model functions are compiled as host functions.
+
+   agent
+
+   Copyright (C) 2026 University of Oxford */
+
+/* CCOPYRIGHT */
+
+#include <cstdio>
+#include "MCMC.h"
+#include "functions_gpu.h"
+#include "modelparameters.h"
+#include "macro_numerical.h"
+#include "modelfunctions.h"
+#include "MCMC_priors.h"
+#include "MCMC_block.h"
+#include "Levenberg_Marquardt_transforms.h"
+#include "MCMC_hmc.h"
+#include "MCMC_convergence.h"
+#include "MCMC_summary.h"
+#include "cpu_threads.h"
+#include "cpu_random.h"
+
+using namespace std;
+
+namespace Cudimot{
+
+#define VOXELS_BATCH_MCMC_CPU 1 // Voxels taken by a CPU thread each time. A voxel is already a lot of work in MCMC
+
+#define maxfloat 1e10
+
+#define CHAINS_DISPERSION 0.3 // Perturbation of the initial parameters of the chains 1,2..., relative to the scale of each parameter
+#define CHAINS_SCALE_WIDTH 0.001 // Minimum scale of a parameter: fraction of the width of its bounds (of 1 if it is not bounded in both sides)
+#define CHAINS_SLOT (1<<25) // Slots of the random numbers of the perturbation of the initial parameters
+#define CHAINS_CHECK_GROWTH 1.25 // The convergence of the chains is checked when the number of states grows by this factor
+
+  /**
+   * Bounds, priors and settings of the chains, in host memory
+   */
+  struct mcmc_cpu_config{
+    const int* bound_types;
+    const float* bounds_min;
+    const float* bounds_max;
+    const int* prior_types;
+    const float* priors_a;
+    const float* priors_b;
+    const int* fixed;
+    int nmeas;
+    int CFP_Tsize;
+    int FixP_Tsize;
+    int nburnin;
+    int njumps;
+    int nsamples;
+    int sampleevery;
+    int updateproposalevery;
+    int debugVOX;
+    mcmc_sampler sampler;
+    int hmc_steps;
+    int nuts_maxdepth;
+    int nchains;
+    double rhat;
+    double min_ess;
+  };
+
+  /**
+   * State of a chain of a voxel, kept between the steps of burn-in and the recording step
+   */
+  template <typename T>
+  struct mcmc_chain_state{
+    T params[NPARAMS];
+    T propSD[NPARAMS];
+    T TAU;
+    T TAUpropSD;
+    T block_state[BLOCK_STATE_SIZE];
+    hmc_adaptation<T> adapt;
+  };
+
+  /**
+   * Scale of a parameter for the initial point of the chains: its absolute value, but not smaller than a fraction of the width of its bounds, so a null parameter is also perturbed
+   */
+  template <typename T>
+  inline T chain_scale(int par, T value, const mcmc_cpu_config& cfg){
+    T width=(T)1.0;
+    if(cfg.bound_types[par]==BMINMAX){
+      width=(T)cfg.bounds_max[par]-(T)cfg.bounds_min[par];
+    }
+    T scale=fabs(value);
+    if(scale<(T)CHAINS_SCALE_WIDTH*width) scale=(T)CHAINS_SCALE_WIDTH*width;
+    return scale;
+  }
+
+  template <typename T>
+  inline void Initialise_TauRician_cpu(int nmeas,
+				       int CFP_Tsize,
+				       T* measurements,
+				       T* parameters,
+				       T* CFP,
+				       T* FixP,
+				       T* TAU,
+				       T* TAUpropSD)
+  {
+    T accumulated_error=(T)0.0;
+    T cache[CACHE_SIZE];
+    Prepare_Voxel(parameters,FixP,cache);
+    //Calculate Mean of Residuals
+    for(int idMeasurement=0;idMeasurement<nmeas;idMeasurement++){
+      T* myCFP = &CFP[idMeasurement*CFP_Tsize];
+      T pred_error=Predicted_Signal(NPARAMS,parameters,myCFP,FixP,cache);
+      pred_error=pred_error-measurements[idMeasurement];
+      accumulated_error+=pred_error;
+    }
+    *TAU=accumulated_error/nmeas; // this is the mean
+
+    accumulated_error=(T)0.0;
+    //Calculate the square of each difference from the mean
+    for(int idMeasurement=0;idMeasurement<nmeas;idMeasurement++){
+      T* myCFP = &CFP[idMeasurement*CFP_Tsize];
+      T pred_error=Predicted_Signal(NPARAMS,parameters,myCFP,FixP,cache);
+      pred_error=pred_error-measurements[idMeasurement];
+      pred_error=(*TAU)-pred_error;
+      accumulated_error+=pred_error*pred_error;
+    }
+    *TAU= accumulated_error/nmeas; //this is the variance
+    *TAU = (T)1.0/(*TAU);
+    *TAUpropSD = *TAU/(T)2.0;
+  }
+
+  template <typename T, bool RICIAN_NOISE, bool DEBUG>
+  inline T Compute_Likelihood_cpu(int idVOX,
+				  int nmeas,
+				  int CFP_Tsize,
+				  T* measurements,
+				  T* parameters,
+				  T tau,
+				  T* CFP,
+				  T* FixP,
+				  int debugVOX)
+  {
+    T accumulated_error=(T)0.0;
+    T cache[CACHE_SIZE];
+    Prepare_Voxel(parameters,FixP,cache);
+    for(int idMeasurement=0;idMeasurement<nmeas;idMeasurement++){
+      T* myCFP = &CFP[idMeasurement*CFP_Tsize];
+      T pred_error=Predicted_Signal(NPARAMS,parameters,myCFP,FixP,cache);
+
+      if(DEBUG){
+	if(idVOX==debugVOX){
+	  printf("PredictedSignal[%i]: %f\n",idMeasurement,(double)pred_error);
+	}
+      }
+
+      if(RICIAN_NOISE){
+	T meas = measurements[idMeasurement];
+	pred_error=log_gpu(meas)+(-(T)0.5*tau*(meas*meas+pred_error*pred_error)+logIo(tau*pred_error*meas));
+	accumulated_error+=pred_error;
+      }else{
+	pred_error=pred_error-measurements[idMeasurement];
+	accumulated_error+=pred_error*pred_error;
+      }
+    }
+    if(RICIAN_NOISE){
+      return -nmeas*log_gpu(tau)-accumulated_error;
+    }else{
+      return (nmeas/(T)2.0)*log_gpu(accumulated_error/(T)2.0);
+    }
+  }
+
+  template <typename T, bool DEBUG>
+  inline int Compute_test_energy_cpu(int idVOX, T* new_energy, T* old_energy, T prior, T likelihood, double uniform, int debugVOX){
+    (*old_energy) = (*new_energy);
+    (*new_energy) = prior + likelihood;
+
+    T tmp=exp_gpu((*old_energy)-(*new_energy));
+
+    if(DEBUG){
+      if(idVOX==debugVOX){
+	printf("OldEnergy(%f), Likelihood(%f) Prior(%f) NewEnergy(%f)\n",(double)*old_energy,(double)likelihood,(double)prior,(double)*new_energy);
+      }
+    }
+
+    return (tmp>(T)uniform);
+  }
+
+  /**
+   * Same steps as one call of mcmc_kernel (burn-in or recording), for one voxel
+   * @param first_iter Number of iterations run by this chain before this call. Used as the counter of the random numbers, and during burn-in (that can be run in several calls) also to update the proposals
+   * @param block State of the adaptive block sampler of the voxel (NULL: Metropolis for each parameter)
+   * @param summary Summaries of the samples of the voxel (NULL: the samples are recorded)
+   */
+  template <typename T, bool RECORDING, bool UPDATE_PROP, bool RICIAN_NOISE, bool DEBUG>
+  inline void mcmc_chain_cpu(int idVOX,
+			     const voxel_random& rnd,
+			     long first_iter,
+			     int niters,
+			     const mcmc_cpu_config& cfg,
+			     T* meas,
+			     T* params,
+			     T* propSD,
+			     T* CFP,
+			     T* FixP,
+			     T* samples,
+			     T* tau_samples,
+			     T* TAU,
+			     T* TAUpropSD,
+			     T* block,
+			     T* summary)
+  {
+    int nmeas=cfg.nmeas;
+    int debugVOX=cfg.debugVOX;
+    T priors[NPARAMS];
+    int naccepted[NPARAMS];
+    int nrejected[NPARAMS];
+    int TAU_accepted=0;
+    int TAU_rejected=0;
+    T TotalPrior, likelihood, energy, old_energy=0;
+    T old_param, old_prior;
+    T block_old_params[NPARAMS];
+    T block_old_priors[NPARAMS];
+
+    for(int par=0;par<NPARAMS;par++){
+      naccepted[par]=0;
+      nrejected[par]=0;
+      priors[par]=(T)0.0;
+    }
+
+    Initialize_priors_params(params,priors,nmeas,CFP,FixP,cfg.bound_types,cfg.bounds_min,cfg.bounds_max,cfg.prior_types,cfg.priors_a,cfg.priors_b);
+    Compute_TotalPrior(priors,&TotalPrior);
+
+    if(RICIAN_NOISE && !RECORDING && first_iter==0){
+      // TAU needs to be initializated
+      Initialise_TauRician_cpu<T>(nmeas,cfg.CFP_Tsize,meas,params,CFP,FixP,TAU,TAUpropSD);
+    }
+
+    likelihood=Compute_Likelihood_cpu<T,RICIAN_NOISE,DEBUG>(idVOX,nmeas,cfg.CFP_Tsize,meas,params,*TAU,CFP,FixP,debugVOX);
+    energy=TotalPrior+likelihood;
+
+    if(DEBUG){
+      if(idVOX==debugVOX){
+	printf("Initial Point: Likelihood(%f) Prior(%f) Energy(%f)\n",(double)likelihood,(double)TotalPrior,(double)energy);
+	printf("--------------------------------------------------------\n");
+      }
+    }
+
+    for(int iter=0; iter<niters; iter++){
+      long counter=first_iter+iter;
+      double normal, uniform;
+
+      if(DEBUG){
+	if(idVOX==debugVOX){
+	  printf("---------------------- Iteration %i ---------------------\n",iter);
+	}
+      }
+
+      // Propose Tau if Rician Noise
+      if(RICIAN_NOISE){
+	rnd.draw(counter,0,normal,uniform);
+	old_param=*TAU;
+	*TAU = (*TAU) + (T)normal*(*TAUpropSD);
+	if(DEBUG){
+	  if(idVOX==debugVOX){
+	    printf("Proposing Value for TAU: %f",(double)*TAU);
+	  }
+	}
+	if(*TAU>(T)0.0){
+	  likelihood=Compute_Likelihood_cpu<T,true,DEBUG>(idVOX,nmeas,cfg.CFP_Tsize,meas,params,*TAU,CFP,FixP,debugVOX);
+	  Compute_TotalPrior(priors,&TotalPrior);
+	  if(Compute_test_energy_cpu<T,DEBUG>(idVOX,&energy,&old_energy,TotalPrior,likelihood,uniform,debugVOX)){
+	    TAU_accepted++;
+	    if(DEBUG){
+	      if(idVOX==debugVOX){
+		printf("Accepted TAU\n");
+	      }
+	    }
+	  }else{
+	    TAU_rejected++;
+	    *TAU=old_param;
+	    energy=old_energy;
+	    if(DEBUG){
+	      if(idVOX==debugVOX){
+		printf("Rejected TAU\n");
+	      }
+	    }
+	  }
+	}else{
+	  TAU_rejected++;
+	  *TAU=old_param;
+	  if(DEBUG){
+	    if(idVOX==debugVOX){
+	      printf("Rejected TAU\n");
+	    }
+	  }
+	}
+      }
+
+      if(block){
+	// Propose all the free parameters together
+	T z[NPARAMS];
+	double block_uniform=0.0;
+	for(int par=0; par<NPARAMS; par++){
+	  rnd.draw(counter,1+par,normal,uniform);
+	  if(par==0) block_uniform=uniform;
+	  block_old_params[par]=params[par];
+	  block_old_priors[par]=priors[par];
+	  z[par]=cfg.fixed[par]?(T)0.0:(T)normal;
+	}
+	block_propose(block,z,block_old_params,params);
+	if(DEBUG){
+	  if(idVOX==debugVOX){
+	    printf("----\n");
+	    for(int i=0;i<NPARAMS;i++){
+	      printf("Proposing Value for Parameter_%i: %f\n",i,(double)params[i]);
+	    }
+	  }
+	}
+
+	int accepted=0;
+	if(block_check_bounds(params,cfg.fixed,cfg.bound_types,cfg.bounds_min,cfg.bounds_max)){
+	  likelihood=Compute_Likelihood_cpu<T,RICIAN_NOISE,DEBUG>(idVOX,nmeas,cfg.CFP_Tsize,meas,params,*TAU,CFP,FixP,debugVOX);
+	  block_priors(params,priors,nmeas,CFP,FixP,cfg.fixed,cfg.prior_types,cfg.priors_a,cfg.priors_b);
+	  Compute_TotalPrior(priors,&TotalPrior);
+	  accepted=Compute_test_energy_cpu<T,DEBUG>(idVOX,&energy,&old_energy,TotalPrior,likelihood,block_uniform,debugVOX);
+	  if(!accepted) energy=old_energy;
+	}
+	if(accepted){
+	  naccepted[0]++;
+	}else{
+	  nrejected[0]++;
+	  for(int par=0; par<NPARAMS; par++){
+	    params[par]=block_old_params[par];
+	    priors[par]=block_old_priors[par];
+	  }
+	}
+	if(DEBUG){
+	  if(idVOX==debugVOX){
+	    printf(accepted?"Accepted Parameters\n":"Rejected Parameters\n");
+	  }
+	}
+	if(!RECORDING){
+	  block_accumulate(block,params,cfg.fixed);
+	}
+      }else{
+	// Propose the rest of Parameters
+	for(int par=0; par<NPARAMS; par++){
+	  rnd.draw(counter,1+par,normal,uniform);
+	  old_param=params[par];
+	  if(!cfg.fixed[par]){
+	    params[par] = params[par] + (T)normal*propSD[par];
+	  }
+	  if(DEBUG){
+	    if(idVOX==debugVOX){
+	      printf("----\n");
+	      printf("Proposing Value for Parameter_%i: %f\n",par,(double)params[par]);
+	    }
+	  }
+
+	  if(Check_bounds_constraints(par,params,cfg.bound_types,cfg.bounds_min,cfg.bounds_max)){
+	    likelihood=Compute_Likelihood_cpu<T,RICIAN_NOISE,DEBUG>(idVOX,nmeas,cfg.CFP_Tsize,meas,params,*TAU,CFP,FixP,debugVOX);
+	    Compute_prior(par,params,priors,&old_prior,nmeas,CFP,FixP,cfg.prior_types,cfg.priors_a,cfg.priors_b);
+	    Compute_TotalPrior(priors,&TotalPrior);
+	    if(Compute_test_energy_cpu<T,DEBUG>(idVOX,&energy,&old_energy,TotalPrior,likelihood,uniform,debugVOX)){
+	      naccepted[par]++;
+	      if(DEBUG){
+		if(idVOX==debugVOX){
+		  printf("Accepted Parameter_%i\n",par);
+		}
+	      }
+	    }else{
+	      nrejected[par]++;
+	      params[par]=old_param;
+	      priors[par]=old_prior;
+	      energy=old_energy;
+	      if(DEBUG){
+		if(idVOX==debugVOX){
+		  printf("Rejected Parameter_%i\n",par);
+		}
+	      }
+	    }
+	  }else{
+	    nrejected[par]++;
+	    params[par]=old_param;
+	    if(DEBUG){
+	      if(idVOX==debugVOX){
+		printf("Rejected Parameter_%i\n",par);
+	      }
+	    }
+	  }
+	}
+      }
+
+      // Record Samples
+      if(RECORDING){
+	if(!(iter%cfg.sampleevery)){
+	  int nsamp=iter/cfg.sampleevery;
+	  if(nsamp<cfg.nsamples){
+	    if(summary){
+	      summary_record(summary,params,*TAU,RICIAN_NOISE);
+	    }else{
+	      for(int par=0; par<NPARAMS; par++){
+		samples[par*cfg.nsamples+nsamp]=params[par];
+	      }
+	      if(RICIAN_NOISE){
+		tau_samples[nsamp]=*TAU;
+	      }
+	    }
+	  }
+	}
+      }
+
+      // Update propsals Std
+      if(!RECORDING || UPDATE_PROP){  // deactivated when not recording if --no_updateproposal
+	long step=RECORDING?iter:counter;
+	if((step>0)&&(!(step%cfg.updateproposalevery))){
+	  if(block){
+	    block_adapt_scale(block,naccepted[0],nrejected[0]);
+	    if(!RECORDING){
+	      // the covariance is frozen during the recording step
+	      block_factor(block,cfg.fixed);
+	    }
+	    naccepted[0]=0;
+	    nrejected[0]=0;
+	  }else{
+	    for(int par=0; par<NPARAMS; par++){
+	      propSD[par]*=sqrt((naccepted[par]+(T)1.0)/(nrejected[par]+(T)1.0));
+	      propSD[par]=min_gpu(propSD[par],(T)maxfloat);
+	      naccepted[par]=0;
+	      nrejected[par]=0;
+	    }
+	  }
+	  if(RICIAN_NOISE){
+	    (*TAUpropSD)*=sqrt((TAU_accepted+(T)1.0)/(TAU_rejected+(T)1.0));
+	    (*TAUpropSD)=min_gpu(*TAUpropSD,(T)maxfloat);
+	    TAU_accepted=0;
+	    TAU_rejected=0;
+	  }
+	}
+      }
+
+      if(DEBUG){
+	if(idVOX==debugVOX){
+	  for(int i=0;i<NPARAMS;i++){
+	    printf("Parameter[%i]: %f\n",i,(double)params[i]);
+	  }
+	  printf("--------------------------------------------------------\n");
+	}
+      }
+    }  // end Iterations
+  }
+
+  /**
+   * Hamiltonian Monte Carlo for one voxel (see MCMC_hmc.h): burn-in, with the adaptation of the step size and of the mass matrix, or recording. Tau (Rician noise) is proposed with a Metropolis step before each trajectory
+   * @param adapt Step size and mass matrix, kept between the burn-in and the recording steps. hmc_adapt_finish must be called at the end of burn-in
+   * @param summary Summaries of the samples of the voxel (NULL: the samples are recorded)
+   */
+  template <typename T, bool RECORDING, bool RICIAN_NOISE, bool DEBUG>
+  inline void mcmc_hmc_chain_cpu(int idVOX,
+				 const voxel_random& rnd,
+				 long first_iter,
+				 int niters,
+				 const mcmc_cpu_config& cfg,
+				 T* meas,
+				 T* params,
+				 T* CFP,
+				 T* FixP,
+				 T* samples,
+				 T* tau_samples,
+				 T* TAU,
+				 T* TAUpropSD,
+				 hmc_adaptation<T>& adapt,
+				 T* summary)
+  {
+    int debugVOX=cfg.debugVOX;
+    int TAU_accepted=0;
+    int TAU_rejected=0;
+
+    if(!RECORDING && first_iter==0){
+      T priors[NPARAMS];
+      Initialize_priors_params(params,priors,cfg.nmeas,CFP,FixP,cfg.bound_types,cfg.bounds_min,cfg.bounds_max,cfg.prior_types,cfg.priors_a,cfg.priors_b);
+      if(RICIAN_NOISE){
+	// TAU needs to be initializated
+	Initialise_TauRician_cpu<T>(cfg.nmeas,cfg.CFP_Tsize,meas,params,CFP,FixP,TAU,TAUpropSD);
+      }
+    }
+
+    hmc_target<T> tg;
+    tg.nmeas=cfg.nmeas;
+    tg.CFP_Tsize=cfg.CFP_Tsize;
+    tg.meas=meas;
+    tg.CFP=CFP;
+    tg.FixP=FixP;
+    tg.bound_types=cfg.bound_types;
+    tg.bounds_min=cfg.bounds_min;
+    tg.bounds_max=cfg.bounds_max;
+    tg.prior_types=cfg.prior_types;
+    tg.priors_a=cfg.priors_a;
+    tg.priors_b=cfg.priors_b;
+    tg.fixed=cfg.fixed;
+    tg.tau=*TAU;
+
+    hmc_point<T> z;
+    for(int par=0;par<NPARAMS;par++){
+      z.params[par]=params[par];
+      invtransform(par,z.params,z.phi,cfg.bound_types,cfg.bounds_min,cfg.bounds_max);
+      if(cfg.bound_types[par]==BMINMAX && !cfg.fixed[par]){
+	// The energy is not defined at the bounds: the initial point is moved inside the interval
+	MinMaxTransform(par,z.params,z.phi,cfg.bounds_min,cfg.bounds_max);
+      }
+      z.r[par]=(T)0.0;
+    }
+    z.U=hmc_potential<T,RICIAN_NOISE>(tg,z.phi,z.params,z.grad);
+
+    if(!RECORDING && first_iter==0){
+      hmc_adapt_init(adapt,cfg.nburnin,z,tg);
+      hmc_initial_stepsize<T,RICIAN_NOISE>(tg,z,adapt,rnd,first_iter);
+      hmc_adapt_restart(adapt);
+    }
+
+    if(DEBUG){
+      if(idVOX==debugVOX){
+	printf("Initial Point: Energy(%f) StepSize(%f)\n",z.U,(double)adapt.eps);
+	printf("--------------------------------------------------------\n");
+      }
+    }
+
+    for(int iter=0; iter<niters; iter++){
+      long counter=first_iter+iter;
+      hmc_random rng(rnd,counter,1);
+
+      // Propose Tau if Rician Noise
+      if(RICIAN_NOISE){
+	double normal, uniform;
+	rnd.draw(counter,0,normal,uniform);
+	T old_tau=tg.tau;
+	tg.tau=tg.tau+(T)normal*(*TAUpropSD);
+	int accepted=0;
+	if(tg.tau>(T)0.0){
+	  hmc_point<T> ztau=z;
+	  ztau.U=hmc_potential<T,true>(tg,ztau.phi,ztau.params,ztau.grad);
+	  if(exp(z.U-ztau.U)>uniform){
+	    z=ztau;
+	    accepted=1;
+	  }
+	}
+	if(accepted){
+	  TAU_accepted++;
+	}else{
+	  TAU_rejected++;
+	  tg.tau=old_tau;
+	}
+      }
+
+      int nleapfrog;
+      double accept;
+      if(cfg.sampler==NUTS){
+	accept=nuts_transition<T,RICIAN_NOISE>(tg,z,adapt.minv,adapt.eps,cfg.nuts_maxdepth,rng,nleapfrog);
+      }else{
+	accept=hmc_transition<T,RICIAN_NOISE>(tg,z,adapt.minv,adapt.eps,cfg.hmc_steps,rng,nleapfrog);
+      }
+
+      if(DEBUG){
+	if(idVOX==debugVOX){
+	  printf("Iteration %i: StepSize(%f) LeapfrogSteps(%i) AcceptanceStat(%f) Energy(%f)\n",iter,(double)adapt.eps,nleapfrog,accept,z.U);
+	  for(int i=0;i<NPARAMS;i++){
+	    printf("Parameter[%i]: %f\n",i,(double)z.params[i]);
+	  }
+	}
+      }
+
+      if(!RECORDING){
+	hmc_adapt_stepsize(adapt,accept);
+	if(hmc_adapt_metric(adapt,counter,z.phi,cfg.fixed)){
+	  hmc_initial_stepsize<T,RICIAN_NOISE>(tg,z,adapt,rnd,counter);
+	  hmc_adapt_restart(adapt);
+	}
+	if(RICIAN_NOISE && (counter>0) && (!(counter%cfg.updateproposalevery))){
+	  (*TAUpropSD)*=sqrt((TAU_accepted+(T)1.0)/(TAU_rejected+(T)1.0));
+	  (*TAUpropSD)=min_gpu(*TAUpropSD,(T)maxfloat);
+	  TAU_accepted=0;
+	  TAU_rejected=0;
+	}
+      }
+
+      // Record Samples
+      if(RECORDING){
+	if(!(iter%cfg.sampleevery)){
+	  int nsamp=iter/cfg.sampleevery;
+	  if(nsamp<cfg.nsamples){
+	    if(summary){
+	      summary_record(summary,z.params,tg.tau,RICIAN_NOISE);
+	    }else{
+	      for(int par=0; par<NPARAMS; par++){
+		samples[par*cfg.nsamples+nsamp]=z.params[par];
+	      }
+	      if(RICIAN_NOISE){
+		tau_samples[nsamp]=tg.tau;
+	      }
+	    }
+	  }
+	}
+      }
+    }
+
+    for(int par=0;par<NPARAMS;par++){
+      params[par]=z.params[par];
+    }
+    *TAU=tg.tau;
+  }
+
+  /**
+   * Burn-in or recording step of a chain with the sampler selected (--sampler)
+   */
+  template <typename T, bool RECORDING, bool UPDATE_PROP, bool RICIAN_NOISE, bool DEBUG>
+  inline void mcmc_step_cpu(int idVOX,
+			    const voxel_random& rnd,
+			    long first_iter,
+			    int niters,
+			    const mcmc_cpu_config& cfg,
+			    T* meas,
+			    T* CFP,
+			    T* FixP,
+			    T* samples,
+			    T* tau_samples,
+			    T* summary,
+			    mcmc_chain_state<T>& chain)
+  {
+    if(cfg.sampler==HMC || cfg.sampler==NUTS){
+      mcmc_hmc_chain_cpu<T,RECORDING,RICIAN_NOISE,DEBUG>(idVOX,rnd,first_iter,niters,cfg,meas,chain.params,CFP,FixP,samples,tau_samples,&chain.TAU,&chain.TAUpropSD,chain.adapt,summary);
+    }else{
+      T* block=(cfg.sampler==ADAPTIVE_BLOCK)?chain.block_state:NULL;
+      mcmc_chain_cpu<T,RECORDING,UPDATE_PROP,RICIAN_NOISE,DEBUG>(idVOX,rnd,first_iter,niters,cfg,meas,chain.params,chain.propSD,CFP,FixP,samples,tau_samples,&chain.TAU,&chain.TAUpropSD,block,summary);
+    }
+  }
+
+  template <typename T, bool UPDATE_PROP, bool RICIAN_NOISE, bool DEBUG>
+  void mcmc_voxel_cpu(int idVOX,
+		      long global_voxel,
+		      int seed,
+		      const mcmc_cpu_config& cfg,
+		      T* meas,
+		      T* parameters,
+		      T* CFP,
+		      T* FixP,
+		      T* samples,
+		      T* tau_samples,
+		      T* summary,
+		      T* convergence)
+  {
+    int nchains=cfg.nchains;
+    vector<voxel_random> rnd;
+    vector<mcmc_chain_state<T> > chains(nchains);
+
+    meas=&meas[idVOX*cfg.nmeas];
+    FixP=&FixP[idVOX*cfg.FixP_Tsize];
+    if(summary){
+      // the samples of all the chains are added to the same summaries
+      summary=&summary[idVOX*SUMMARY_VOXEL_SIZE];
+      for(int par=0;par<=NPARAMS;par++){
+	summary_init(&summary[par*SUMMARY_SIZE]);
+      }
+    }else{
+      samples=&samples[idVOX*NPARAMS*cfg.nsamples];
+      if(RICIAN_NOISE){
+	tau_samples=&tau_samples[idVOX*cfg.nsamples];
+      }
+    }
+
+    for(int c=0;c<nchains;c++){
+      mcmc_chain_state<T>& chain=chains[c];
+      rnd.push_back(voxel_random(seed,global_voxel,c));
+      for(int par=0;par<NPARAMS;par++){
+	chain.params[par]=parameters[idVOX*NPARAMS+par];
+      }
+      if(c>0){
+	// Perturbed initial point, inside the bounds
+	for(int par=0;par<NPARAMS;par++){
+	  if(cfg.fixed[par]) continue;
+	  double normal, uniform;
+	  rnd[c].draw(0,CHAINS_SLOT+par,normal,uniform);
+	  T old_param=chain.params[par];
+	  chain.params[par]+=(T)(CHAINS_DISPERSION*normal)*chain_scale(par,old_param,cfg);
+	  if(!Check_bounds_constraints(par,chain.params,cfg.bound_types,cfg.bounds_min,cfg.bounds_max)){
+	    chain.params[par]=old_param;
+	  }
+	}
+      }
+      for(int par=0;par<NPARAMS;par++){
+	chain.propSD[par]=chain.params[par]/(T)10.0;
+	if(chain.propSD[par]==(T)0.0 && !cfg.fixed[par]){
+	  // A null parameter would never move
+	  chain.propSD[par]=chain_scale(par,(T)0.0,cfg)/(T)10.0;
+	}
+      }
+      chain.TAU=(T)0.0;
+      chain.TAUpropSD=(T)0.0;
+      if(cfg.sampler==ADAPTIVE_BLOCK){
+	block_init(chain.block_state,chain.propSD,cfg.fixed);
+      }
+    }
+
+    if(DEBUG){
+      if(idVOX==cfg.debugVOX){
+	printf("\n ----- MCMC CPU algorithm: voxel %i -----\n",idVOX);
+	for(int i=0;i<NPARAMS;i++){
+	  printf("Initial Parameter[%i]: %f\n",i,(double)chains[0].params[i]);
+	}
+	for(int i=0;i<cfg.CFP_Tsize;i++){
+	  printf("Commonn Fixed Params[%i]: ",i);
+	  for(int j=0;j<cfg.nmeas;j++){
+	    printf("%f ",(double)CFP[j*cfg.CFP_Tsize+i]);
+	  }
+	  printf("\n");
+	}
+	printf("Fix Parameters: ");
+	for(int i=0;i<cfg.FixP_Tsize;i++){
+	  printf("%f, ",(double)FixP[i]);
+	}
+	printf("\n--------------------------------------------------------\n");
+      }
+    }
+
+    long nburnin=cfg.nburnin;
+    if(nchains==1){
+      // Burn-In   ... always update_proposals
+      mcmc_step_cpu<T,false,true,RICIAN_NOISE,DEBUG>(idVOX,rnd[0],0,cfg.nburnin,cfg,meas,CFP,FixP,samples,tau_samples,NULL,chains[0]);
+    }else{
+      // Burn-In   ... in steps that finish after an update of the proposals, until the chains converge
+      int maxstates=cfg.nburnin/cfg.updateproposalevery+1;
+      vector<double> history(nchains*NPARAMS*maxstates);
+      int nstates=0;
+      double rhat=0.0, ess=0.0; // 0: not enough states to compute them
+      // The cost of the diagnostics grows with the number of states: they are computed in a geometric sequence of states, and at the end of the burn-in
+      int next_check=4*RHAT_MIN_STATES;
+      nburnin=0;
+      while(nburnin<cfg.nburnin){
+	long end=(nburnin/cfg.updateproposalevery+1)*cfg.updateproposalevery+1;
+	if(end>cfg.nburnin) end=cfg.nburnin;
+	for(int c=0;c<nchains;c++){
+	  mcmc_step_cpu<T,false,true,RICIAN_NOISE,DEBUG>(idVOX,rnd[c],nburnin,end-nburnin,cfg,meas,CFP,FixP,samples,tau_samples,NULL,chains[c]);
+	  for(int par=0;par<NPARAMS;par++){
+	    history[(c*NPARAMS+par)*maxstates+nstates]=chains[c].params[par];
+	  }
+	}
+	nburnin=end;
+	nstates++;
+	if(nstates<next_check && nburnin<cfg.nburnin) continue;
+	next_check=(int)(nstates*CHAINS_CHECK_GROWTH)+1;
+	if(chains_diagnostics(&history[0],nchains,NPARAMS,maxstates,nstates,cfg.fixed,rhat,ess)){
+	  if(rhat<=cfg.rhat && ess>=cfg.min_ess) break;
+	}
+      }
+      convergence[idVOX*MCMC_NDIAGNOSTICS]=(T)rhat;
+      convergence[idVOX*MCMC_NDIAGNOSTICS+1]=(T)ess;
+      convergence[idVOX*MCMC_NDIAGNOSTICS+2]=(T)nburnin;
+      if(DEBUG){
+	if(idVOX==cfg.debugVOX){
+	  printf("Burn-In of %i chains: %li iterations, R-hat(%f) ESS(%f)\n",nchains,nburnin,rhat,ess);
+	}
+      }
+    }
+    if(cfg.sampler==HMC || cfg.sampler==NUTS){
+      for(int c=0;c<nchains;c++){
+	hmc_adapt_finish(chains[c].adapt);
+      }
+    }
+
+    // Recording   ... the samples are divided among the chains
+    int first_sample=0;
+    for(int c=0;c<nchains;c++){
+      int nsamples_chain=cfg.nsamples/nchains+((c<cfg.nsamples%nchains)?1:0);
+      int niters=(nchains==1)?cfg.njumps:nsamples_chain*cfg.sampleevery;
+      T* tau_samples_chain=RICIAN_NOISE?&tau_samples[first_sample]:tau_samples;
+      mcmc_step_cpu<T,true,UPDATE_PROP,RICIAN_NOISE,DEBUG>(idVOX,rnd[c],nburnin,niters,cfg,meas,CFP,FixP,&samples[first_sample],tau_samples_chain,summary,chains[c]);
+      first_sample+=nsamples_chain;
+    }
+
+    for(int par=0;par<NPARAMS;par++){
+      parameters[idVOX*NPARAMS+par]=chains[0].params[par];
+    }
+    if(DEBUG){
+      if(idVOX==cfg.debugVOX){
+	for(int i=0;i<NPARAMS;i++){
+	  printf("Final Parameter[%i]: %f\n",i,(double)chains[0].params[i]);
+	}
+      }
+    }
+  }
+
+  template <typename T>
+  void MCMC<T>::run_cpu(
+			int nvox, int nmeas,
+			int CFP_size, int FixP_size,
+			T* meas,
+			T* params,
+			T* CFP, T* FixP,
+			T* samples,
+			T* tau_samples,
+			T* summary,
+			T* convergence,
+			int first_voxel)
+  {
+    cudimotOptions& opts = cudimotOptions::getInstance();
+    int nthreads=cpu_nthreads(opts.nthreads.value());
+    int seed=opts.seed.value();
+
+    mcmc_cpu_config cfg;
+    cfg.bound_types=bound_types_host;
+    cfg.bounds_min=bounds_min_host;
+    cfg.bounds_max=bounds_max_host;
+    cfg.prior_types=prior_types_host;
+    cfg.priors_a=priors_a_host;
+    cfg.priors_b=priors_b_host;
+    cfg.fixed=fixed_host;
+    cfg.nmeas=nmeas;
+    cfg.CFP_Tsize=CFP_size;
+    cfg.FixP_Tsize=FixP_size;
+    cfg.nburnin=nburnin;
+    cfg.njumps=njumps;
+    cfg.nsamples=nsamples;
+    cfg.sampleevery=sampleevery;
+    cfg.updateproposalevery=updateproposalevery;
+    cfg.debugVOX=debugVOX;
+    cfg.sampler=sampler;
+    cfg.hmc_steps=opts.hmc_steps.value();
+    cfg.nuts_maxdepth=opts.nuts_depth.value();
+    cfg.nchains=nchains;
+    cfg.rhat=opts.rhat.value();
+    cfg.min_ess=opts.min_ess.value();
+    bool update=updateproposal;
+    bool rician=RicianNoise;
+    bool debug=DEBUG;
+
+    // Values of each voxel kept in the checkpoints
+    vector<checkpoint_array<T> > outputs;
+    outputs.push_back(checkpoint_array<T>{params,NPARAMS,NPARAMS});
+    if(summary){
+      outputs.push_back(checkpoint_array<T>{summary,SUMMARY_VOXEL_SIZE,SUMMARY_VOXEL_SIZE});
+    }else{
+      outputs.push_back(checkpoint_array<T>{samples,NPARAMS*nsamples,NPARAMS*nsamples});
+      if(rician) outputs.push_back(checkpoint_array<T>{tau_samples,nsamples,nsamples});
+    }
+    if(convergence){
+      outputs.push_back(checkpoint_array<T>{convergence,MCMC_NDIAGNOSTICS,MCMC_NDIAGNOSTICS});
+    }
+    // Voxels finished in a previous run (--resume) are not run again
+    vector<char> done(nvox,0);
+    if(checkpoint->resuming()){
+      int restored=checkpoint->restore(CHECKPOINT_VOXELS,first_voxel,nvox,outputs,done,NULL,0);
+      cout << "MCMC: " << restored << " voxels of the part restored from the checkpoint" << endl;
+    }
+    vector<int> pending;
+    for(int idVOX=0;idVOX<nvox;idVOX++){
+      if(!done[idVOX]) pending.push_back(idVOX);
+    }
+    bool save=checkpoint->writing();
+
+    cpu_threads_stats stats=parallel_voxels(pending.size(),VOXELS_BATCH_MCMC_CPU,nthreads,[&](int first, int last){
+	for(int i=first;i<last;i++){
+	  int idVOX=pending[i];
+	  long global_voxel=(long)first_voxel+idVOX;
+	  if(!debug){
+	    if(update){
+	      if(rician) mcmc_voxel_cpu<T,true,true,false>(idVOX,global_voxel,seed,cfg,meas,params,CFP,FixP,samples,tau_samples,summary,convergence);
+	      else mcmc_voxel_cpu<T,true,false,false>(idVOX,global_voxel,seed,cfg,meas,params,CFP,FixP,samples,tau_samples,summary,convergence);
+	    }else{
+	      if(rician) mcmc_voxel_cpu<T,false,true,false>(idVOX,global_voxel,seed,cfg,meas,params,CFP,FixP,samples,tau_samples,summary,convergence);
+	      else mcmc_voxel_cpu<T,false,false,false>(idVOX,global_voxel,seed,cfg,meas,params,CFP,FixP,samples,tau_samples,summary,convergence);
+	    }
+	  }else{
+	    if(update){
+	      if(rician) mcmc_voxel_cpu<T,true,true,true>(idVOX,global_voxel,seed,cfg,meas,params,CFP,FixP,samples,tau_samples,summary,convergence);
+	      else mcmc_voxel_cpu<T,true,false,true>(idVOX,global_voxel,seed,cfg,meas,params,CFP,FixP,samples,tau_samples,summary,convergence);
+	    }else{
+	      if(rician) mcmc_voxel_cpu<T,false,true,true>(idVOX,global_voxel,seed,cfg,meas,params,CFP,FixP,samples,tau_samples,summary,convergence);
+	      else mcmc_voxel_cpu<T,false,false,true>(idVOX,global_voxel,seed,cfg,meas,params,CFP,FixP,samples,tau_samples,summary,convergence);
+	    }
+	  }
+	  if(save) checkpoint->voxel_finished(first_voxel,idVOX,outputs);
+	}
+      });
+    if(save) checkpoint->flush(first_voxel,outputs);
+    report_cpu_threads("MCMC",stats);
+  }
+
+  // Explicit Instantiations of the template
+  template void MCMC<float>::run_cpu(int,int,int,int,float*,float*,float*,float*,float*,float*,float*,float*,int);
+  template void MCMC<double>::run_cpu(int,int,int,int,double*,double*,double*,double*,double*,double*,double*,double*,int);
+}
@@ -0,0 +1,564 @@
+#ifndef CUDIMOT_MCMC_HMC_H_INCLUDED
+#define CUDIMOT_MCMC_HMC_H_INCLUDED
+
+/*  MCMC_hmc.h
+
+    Hamiltonian Monte Carlo samplers (--sampler=hmc or --sampler=nuts) of the CPU version of MCMC (MCMC_cpu.cc). The chain moves in the space of the transformed parameters used by Levenberg-Marquardt (Levenberg_Marquardt_transforms.h), where the bounds are not needed, and the logarithm of the Jacobian of the transformations is added to the energy, so the samples (transformed back) come from the same posterior distribution as with the Metropolis samplers. The gradient of the energy is computed with the partial derivatives of the model (Signal_And_Derivatives), the derivatives of the priors (numerical for the custom priors) and the chain rule of the transformations.
+
+      hmc: a trajectory of a fixed number of leapfrog steps (--hmc_steps) per iteration and a Metropolis test of the end point.
+      nuts: No-U-Turn sampler (Hoffman and Gelman, JMLR 15, 2014), with the multinomial sampling of the points of the trajectory as in Stan (Betancourt, arXiv:1701.02434). The trajectory is doubled until it makes a U-turn, with at most 2^(--nuts_depth) leapfrog steps.
+
+    During burn-in the step size is adapted with dual averaging towards an acceptance statistic of HMC_TARGET_ACCEPTANCE, and a diagonal mass matrix is estimated with the variance of the transformed parameters in windows of increasing size (as Stan). The step size and the mass matrix are fixed during the recording step (also without --no_updateproposal), so the recorded chain is reversible.
+
+    The random numbers come from the counter-based generator of the voxel (cpu_random.h): slot 0 of an iteration is the proposal of tau (Rician noise), slots 1..NPARAMS are the momenta and the next slots are the uniform numbers of the trajectory. The search of the step size after each update of the mass matrix uses the slots from HMC_STEPSIZE_SLOT.
+
+    It must be included after functions_gpu.h, modelparameters.h, macro_numerical.h, modelfunctions.h, MCMC_priors.h and Levenberg_Marquardt_transforms.h. Only compiled with the host compiler.
+
+    agent
+
+    Copyright (C) 2026 University of Oxford  */
+
+/*  CCOPYRIGHT  */
+
+#include <cmath>
+#include "cudimot.h"
+#include "cpu_random.h"
+
+#define HMC_TARGET_ACCEPTANCE 0.8 // Target of the adaptation of the step size
+#define HMC_MAX_ENERGY_ERROR 1000.0 // Change of energy in a trajectory considered a divergence
+#define HMC_STEPSIZE_SLOT (1<<24) // First slot of the random numbers of the search of the step size
+
+namespace Cudimot{
+
+  /**
+   * Measurements, bounds and priors of the posterior distribution of a voxel
+   */
+  template <typename T>
+  struct hmc_target{
+    int nmeas;
+    int CFP_Tsize;
+    T* meas;
+    T* CFP;
+    T* FixP;
+    const int* bound_types;
+    const float* bounds_min;
+    const float* bounds_max;
+    const int* prior_types;
+    const float* priors_a;
+    const float* priors_b;
+    const int* fixed;
+    T tau; // Rician noise
+  };
+
+  /**
+   * A point of a trajectory: transformed parameters, parameters, momenta, gradient and energy
+   */
+  template <typename T>
+  struct hmc_point{
+    T phi[NPARAMS];
+    T params[NPARAMS];
+    T r[NPARAMS];
+    T grad[NPARAMS];
+    double U;
+  };
+
+  /**
+   * State of the adaptation of the step size and of the mass matrix of a voxel
+   */
+  template <typename T>
+  struct hmc_adaptation{
+    T eps; // step size
+    T minv[NPARAMS]; // inverse of the (diagonal) mass matrix
+    // Dual averaging
+    double mu;
+    double Hbar;
+    double logeps_bar;
+    int m;
+    // Variance of the transformed parameters in the current window
+    double wmean[NPARAMS];
+    double wm2[NPARAMS];
+    int wn;
+    // Windows
+    int nburnin;
+    int init_buffer;
+    int term_buffer;
+    int window_size;
+    int window_end;
+  };
+
+  /**
+   * Random numbers of an iteration
+   */
+  struct hmc_random{
+    const voxel_random& rnd;
+    long counter;
+    int slot;
+    hmc_random(const voxel_random& r, long c, int first_slot): rnd(r), counter(c), slot(first_slot){}
+    double normal(){
+      double n,u;
+      rnd.draw(counter,slot++,n,u);
+      return n;
+    }
+    double uniform(){
+      double n,u;
+      rnd.draw(counter,slot++,n,u);
+      return u;
+    }
+  };
+
+  // Derivative of logIo (the same approximation of Numerical Recipes)
+  template <typename T>
+  inline T dlogIo(const T x){
+    double b=fabs((double)x);
+    if(b<3.75){
+      double a=(double)x/3.75;
+      a*=a;
+      double P=1.0+a*(3.5156229+a*(3.0899424+a*(1.2067492+a*(0.2659732+a*(0.0360768+a*0.0045813)))));
+      double dP=3.5156229+a*(2.0*3.0899424+a*(3.0*1.2067492+a*(4.0*0.2659732+a*(5.0*0.0360768+a*6.0*0.0045813))));
+      return (T)(dP/P*2.0*(double)x/(3.75*3.75));
+    }
+    double a=3.75/b;
+    double Q=0.39894228+a*(0.01328592+a*(0.00225319+a*(-0.00157565+a*(0.00916281+a*(-0.02057706+a*(0.02635537+a*(-0.01647633+a*0.00392377)))))));
+    double dQ=0.01328592+a*(2.0*0.00225319+a*(3.0*-0.00157565+a*(4.0*0.00916281+a*(5.0*-0.02057706+a*(6.0*0.02635537+a*(7.0*-0.01647633+a*8.0*0.00392377))))));
+    double dy=1.0-dQ/Q*3.75/(b*b)-0.5/b;
+    return (T)(x<0?-dy:dy);
+  }
+
+  // Derivative of the prior of a parameter (not custom)
+  template <typename T>
+  inline T hmc_prior_derivative(int p, const T* params, const int* prior_types, const float* priors_a, const float* priors_b){
+    if(prior_types[p]==GAUSSPRIOR){
+      return (params[p]-priors_a[p])/(priors_b[p]*priors_b[p]);
+    }else if(prior_types[p]==GAMMAPRIOR){
+      return ((T)1.0-priors_a[p])/params[p]+priors_b[p];
+    }else if(prior_types[p]==ARDPRIOR){
+      return priors_a[p]/params[p];
+    }else if(prior_types[p]==SINPRIOR){
+      return -cos_gpu(params[p])/sin_gpu(params[p]);
+    }
+    return (T)0.0;
+  }
+
+  /**
+   * Energy (minus the logarithm of the posterior) at some transformed parameters and its gradient
+   * @param phi Transformed parameters (not modified). The fixed parameters are not used
+   * @param params Parameters. Input: values of the fixed parameters. Output: all the parameters
+   * @param grad Gradient respect the transformed parameters (0 for the fixed parameters)
+   * @return Energy, or HUGE_VAL if the parameters do not meet the constraints of the model or are (numerically) at the bounds
+   */
+  template <typename T, bool RICIAN_NOISE>
+  inline double hmc_potential(const hmc_target<T>& tg, const T* phi, T* params, T* grad){
+    T transf[NPARAMS]; // copy: MinMaxTransform moves the point inside the open interval if it is at a bound
+    for(int p=0;p<NPARAMS;p++){
+      transf[p]=phi[p];
+      if(tg.fixed[p]) continue;
+      if(tg.bound_types[p]==BMIN)
+	MinTransform(p,params,transf,tg.bounds_min);
+      else if(tg.bound_types[p]==BMAX)
+	MaxTransform(p,params,transf,tg.bounds_max);
+      else if(tg.bound_types[p]==BMINMAX){
+	MinMaxTransform(p,params,transf,tg.bounds_min,tg.bounds_max);
+	// The leapfrog position is not modified: it is a divergence
+	if(transf[p]!=phi[p]) return HUGE_VAL;
+      }else
+	params[p]=phi[p];
+    }
+    if(!ConstraintsMCMC(NPARAMS,params)) return HUGE_VAL;
+
+    T cache[CACHE_SIZE];
+    Prepare_Voxel(params,tg.FixP,cache);
+    T acc[NPARAMS];
+    for(int p=0;p<NPARAMS;p++) acc[p]=(T)0.0;
+    double sum=0.0;
+    for(int m=0;m<tg.nmeas;m++){
+      T* myCFP=&tg.CFP[m*tg.CFP_Tsize];
+      T signal;
+      T derivatives[NPARAMS];
+      Signal_And_Derivatives(NPARAMS,params,myCFP,tg.FixP,cache,signal,derivatives);
+      T y=tg.meas[m];
+      T dS;
+      if(RICIAN_NOISE){
+	T x=tg.tau*signal*y;
+	sum+=log_gpu(y)-(T)0.5*tg.tau*(y*y+signal*signal)+logIo(x);
+	dS=tg.tau*signal-tg.tau*y*dlogIo(x);
+      }else{
+	dS=signal-y;
+	sum+=dS*dS;
+      }
+      for(int p=0;p<NPARAMS;p++){
+	acc[p]+=dS*derivatives[p];
+      }
+    }
+    double U;
+    if(RICIAN_NOISE){
+      U=-tg.nmeas*log((double)tg.tau)-sum;
+      for(int p=0;p<NPARAMS;p++) grad[p]=acc[p];
+    }else{
+      U=(tg.nmeas/2.0)*log(sum/2.0);
+      for(int p=0;p<NPARAMS;p++) grad[p]=(T)(tg.nmeas/sum)*acc[p];
+    }
+
+    // Priors
+    T priors[NPARAMS];
+    T old_prior;
+    bool custom=false;
+    for(int p=0;p<NPARAMS;p++){
+      priors[p]=(T)0.0;
+      Compute_prior(p,params,priors,&old_prior,tg.nmeas,tg.CFP,tg.FixP,tg.prior_types,tg.priors_a,tg.priors_b);
+      U+=priors[p];
+      if(tg.prior_types[p]==CUSTOM) custom=true;
+      if(!tg.fixed[p]) grad[p]+=hmc_prior_derivative(p,params,tg.prior_types,tg.priors_a,tg.priors_b);
+    }
+    if(custom){
+      // Central differences of the sum of the custom priors (they can depend on several parameters)
+      for(int p=0;p<NPARAMS;p++){
+	if(tg.fixed[p]) continue;
+	T value=params[p];
+	T h=(T)1e-4*(fabs_gpu(value)+(T)1e-4);
+	T cplus=(T)0.0, cminus=(T)0.0;
+	params[p]=value+h;
+	for(int q=0;q<NPARAMS;q++){
+	  if(tg.prior_types[q]==CUSTOM) cplus+=custom_priors(q,params,tg.nmeas,tg.CFP,tg.FixP);
+	}
+	params[p]=value-h;
+	for(int q=0;q<NPARAMS;q++){
+	  if(tg.prior_types[q]==CUSTOM) cminus+=custom_priors(q,params,tg.nmeas,tg.CFP,tg.FixP);
+	}
+	params[p]=value;
+	grad[p]+=(cplus-cminus)/((T)2.0*h);
+      }
+    }
+
+    // Chain rule and Jacobian of the transformations
+    derivative_transf(transf,grad,tg.bound_types,tg.bounds_min,tg.bounds_max);
+    for(int p=0;p<NPARAMS;p++){
+      if(tg.fixed[p]){
+	grad[p]=(T)0.0;
+      }else if(tg.bound_types[p]==BMIN || tg.bound_types[p]==BMAX){
+	U-=phi[p];
+	grad[p]-=(T)1.0;
+      }else if(tg.bound_types[p]==BMINMAX){
+	T s2=(T)SpeedFactor*(T)SpeedFactor+phi[p]*phi[p];
+	U+=log((double)s2);
+	grad[p]+=(T)2.0*phi[p]/s2;
+      }
+    }
+    if(!std::isfinite(U)) return HUGE_VAL;
+    return U;
+  }
+
+  // Energy plus kinetic energy
+  template <typename T>
+  inline double hmc_hamiltonian(const hmc_point<T>& z, const T* minv){
+    double K=0.0;
+    for(int p=0;p<NPARAMS;p++){
+      K+=(double)minv[p]*z.r[p]*z.r[p];
+    }
+    double h=z.U+0.5*K;
+    if(!std::isfinite(h)) return HUGE_VAL;
+    return h;
+  }
+
+  // Momenta from the normal distribution of the mass matrix (0 for the fixed parameters)
+  template <typename T>
+  inline void hmc_momenta(hmc_point<T>& z, const T* minv, hmc_random& rng){
+    for(int p=0;p<NPARAMS;p++){
+      T n=(T)rng.normal();
+      z.r[p]=(minv[p]>(T)0.0)?n/sqrt_gpu(minv[p]):(T)0.0;
+    }
+  }
+
+  // One leapfrog step of size eps (negative backwards in time)
+  template <typename T, bool RICIAN_NOISE>
+  inline void hmc_leapfrog(const hmc_target<T>& tg, hmc_point<T>& z, const T* minv, T eps){
+    for(int p=0;p<NPARAMS;p++){
+      z.r[p]-=(T)0.5*eps*z.grad[p];
+      z.phi[p]+=eps*minv[p]*z.r[p];
+    }
+    z.U=hmc_potential<T,RICIAN_NOISE>(tg,z.phi,z.params,z.grad);
+    if(z.U==HUGE_VAL) return;
+    for(int p=0;p<NPARAMS;p++){
+      z.r[p]-=(T)0.5*eps*z.grad[p];
+    }
+  }
+
+  inline double hmc_log_sum_exp(double a, double b){
+    if(a==-HUGE_VAL) return b;
+    if(b==-HUGE_VAL) return a;
+    if(a>b) return a+log1p(exp(b-a));
+    return b+log1p(exp(a-b));
+  }
+
+  /**
+   * Static HMC: a trajectory of nsteps leapfrog steps and a Metropolis test of its end point
+   * @return Acceptance probability, for the adaptation of the step size
+   */
+  template <typename T, bool RICIAN_NOISE>
+  inline double hmc_transition(const hmc_target<T>& tg, hmc_point<T>& z, const T* minv, T eps, int nsteps,
+			       hmc_random& rng, int& nleapfrog){
+    hmc_momenta(z,minv,rng);
+    double h0=hmc_hamiltonian(z,minv);
+    hmc_point<T> znew=z;
+    nleapfrog=0;
+    for(int s=0;s<nsteps;s++){
+      hmc_leapfrog<T,RICIAN_NOISE>(tg,znew,minv,eps);
+      nleapfrog++;
+      if(znew.U==HUGE_VAL) break;
+    }
+    double h=hmc_hamiltonian(znew,minv);
+    double accept=(h==HUGE_VAL)?0.0:((h0-h>0.0)?1.0:exp(h0-h));
+    if(rng.uniform()<accept) z=znew;
+    return accept;
+  }
+
+  // No U-turn between the ends of a trajectory with momenta pbeg and pend and sum of momenta rho
+  template <typename T>
+  inline bool nuts_no_uturn(const T* rho, const T* pbeg, const T* pend, const T* minv){
+    double dbeg=0.0, dend=0.0;
+    for(int p=0;p<NPARAMS;p++){
+      dbeg+=(double)minv[p]*pbeg[p]*rho[p];
+      dend+=(double)minv[p]*pend[p]*rho[p];
+    }
+    return (dbeg>0.0 && dend>0.0);
+  }
+
+  /**
+   * Builds a subtree of 2^depth leapfrog steps from the edge z of the trajectory
+   * @param z Edge of the trajectory, moved to the end of the subtree
+   * @param z_propose Point of the subtree sampled with the multinomial weights
+   * @param pbeg, pend Momenta of the first and the last points of the subtree
+   * @param rho Sum of the momenta of the subtree (accumulated)
+   * @param log_sum_weight Logarithm of the sum of the weights of the subtree (accumulated)
+   * @return false if the subtree diverged or made a U-turn
+   */
+  template <typename T, bool RICIAN_NOISE>
+  inline bool nuts_build_tree(const hmc_target<T>& tg, int depth, hmc_point<T>& z, hmc_point<T>& z_propose,
+			      T* pbeg, T* pend, T* rho, double h0, T eps, const T* minv, hmc_random& rng,
+			      int& nleapfrog, double& log_sum_weight, double& sum_metro_prob){
+    if(depth==0){
+      hmc_leapfrog<T,RICIAN_NOISE>(tg,z,minv,eps);
+      nleapfrog++;
+      double h=hmc_hamiltonian(z,minv);
+      if(h==HUGE_VAL || h-h0>HMC_MAX_ENERGY_ERROR) return false; // divergence
+      log_sum_weight=hmc_log_sum_exp(log_sum_weight,h0-h);
+      sum_metro_prob+=(h0-h>0.0)?1.0:exp(h0-h);
+      z_propose=z;
+      for(int p=0;p<NPARAMS;p++){
+	rho[p]+=z.r[p];
+	pbeg[p]=z.r[p];
+	pend[p]=z.r[p];
+      }
+      return true;
+    }
+    T rho_left[NPARAMS], rho_right[NPARAMS], pend_left[NPARAMS], pbeg_right[NPARAMS];
+    for(int p=0;p<NPARAMS;p++){
+      rho_left[p]=(T)0.0;
+      rho_right[p]=(T)0.0;
+    }
+    double lsw_left=-HUGE_VAL, lsw_right=-HUGE_VAL;
+    if(!nuts_build_tree<T,RICIAN_NOISE>(tg,depth-1,z,z_propose,pbeg,pend_left,rho_left,h0,eps,minv,rng,nleapfrog,lsw_left,sum_metro_prob)) return false;
+    hmc_point<T> z_propose_right;
+    if(!nuts_build_tree<T,RICIAN_NOISE>(tg,depth-1,z,z_propose_right,pbeg_right,pend,rho_right,h0,eps,minv,rng,nleapfrog,lsw_right,sum_metro_prob)) return false;
+
+    double lsw_subtree=hmc_log_sum_exp(lsw_left,lsw_right);
+    log_sum_weight=hmc_log_sum_exp(log_sum_weight,lsw_subtree);
+    if(rng.uniform()<exp(lsw_right-lsw_subtree)) z_propose=z_propose_right;
+
+    T rho_subtree[NPARAMS];
+    for(int p=0;p<NPARAMS;p++){
+      rho_subtree[p]=rho_left[p]+rho_right[p];
+      rho[p]+=rho_subtree[p];
+    }
+    return nuts_no_uturn(rho_subtree,pbeg,pend,minv);
+  }
+
+  /**
+   * One iteration of NUTS
+   * @return Mean acceptance probability of the points of the trajectory, for the adaptation of the step size
+   */
+  template <typename T, bool RICIAN_NOISE>
+  inline double nuts_transition(const hmc_target<T>& tg, hmc_point<T>& z, const T* minv, T eps, int maxdepth,
+				hmc_random& rng, int& nleapfrog){
+    hmc_momenta(z,minv,rng);
+    double h0=hmc_hamiltonian(z,minv);
+    hmc_point<T> z_minus=z, z_plus=z, z_sample=z, z_propose;
+    T rho[NPARAMS], p_minus[NPARAMS], p_plus[NPARAMS], pbeg[NPARAMS];
+    for(int p=0;p<NPARAMS;p++){
+      rho[p]=z.r[p];
+      p_minus[p]=z.r[p];
+      p_plus[p]=z.r[p];
+    }
+    double log_sum_weight=0.0; // weight of the initial point: exp(h0-h0)
+    double sum_metro_prob=0.0;
+    nleapfrog=0;
+
+    for(int depth=0;depth<maxdepth;depth++){
+      T rho_subtree[NPARAMS];
+      for(int p=0;p<NPARAMS;p++) rho_subtree[p]=(T)0.0;
+      double lsw_subtree=-HUGE_VAL;
+      bool valid;
+      if(rng.uniform()>0.5){
+	valid=nuts_build_tree<T,RICIAN_NOISE>(tg,depth,z_plus,z_propose,pbeg,p_plus,rho_subtree,h0,eps,minv,rng,nleapfrog,lsw_subtree,sum_metro_prob);
+      }else{
+	valid=nuts_build_tree<T,RICIAN_NOISE>(tg,depth,z_minus,z_propose,pbeg,p_minus,rho_subtree,h0,-eps,minv,rng,nleapfrog,lsw_subtree,sum_metro_prob);
+      }
+      if(!valid) break;
+
+      // Biased progressive sampling: the new subtree is preferred
+      if(lsw_subtree>log_sum_weight){
+	z_sample=z_propose;
+      }else if(rng.uniform()<exp(lsw_subtree-log_sum_weight)){
+	z_sample=z_propose;
+      }
+      log_sum_weight=hmc_log_sum_exp(log_sum_weight,lsw_subtree);
+
+      for(int p=0;p<NPARAMS;p++) rho[p]+=rho_subtree[p];
+      if(!nuts_no_uturn(rho,p_minus,p_plus,minv)) break;
+    }
+    z=z_sample;
+    if(nleapfrog==0) return 0.0;
+    return sum_metro_prob/nleapfrog;
+  }
+
+  /**
+   * Initial state of the adaptation: mass matrix from the size of the proposals of the Metropolis sampler (a tenth of the parameters) and the windows of the estimation of the mass matrix during burn-in
+   */
+  template <typename T>
+  inline void hmc_adapt_init(hmc_adaptation<T>& ad, int nburnin, const hmc_point<T>& z, const hmc_target<T>& tg){
+    T dtransf[NPARAMS];
+    T phi[NPARAMS];
+    for(int p=0;p<NPARAMS;p++){
+      dtransf[p]=(T)1.0;
+      phi[p]=z.phi[p];
+    }
+    derivative_transf(phi,dtransf,tg.bound_types,tg.bounds_min,tg.bounds_max);
+    for(int p=0;p<NPARAMS;p++){
+      if(tg.fixed[p]){
+	ad.minv[p]=(T)0.0;
+	continue;
+      }
+      double sd=fabs((double)z.params[p])/10.0/fabs((double)dtransf[p]);
+      double var=sd*sd;
+      if(!(var>0.0) || !std::isfinite(var)) var=1.0;
+      ad.minv[p]=(T)var;
+    }
+    ad.eps=(T)1.0;
+    ad.mu=log(10.0);
+    ad.Hbar=0.0;
+    ad.logeps_bar=0.0;
+    ad.m=0;
+    ad.wn=0;
+    for(int p=0;p<NPARAMS;p++){
+      ad.wmean[p]=0.0;
+      ad.wm2[p]=0.0;
+    }
+    // Windows as Stan: 75 iterations of only step size adaptation, windows of 25, 50, 100... iterations and 50 final iterations
+    ad.nburnin=nburnin;
+    ad.init_buffer=75;
+    ad.term_buffer=50;
+    ad.window_size=25;
+    if(nburnin<20){
+      // only the step size is adapted
+      ad.init_buffer=nburnin;
+      ad.term_buffer=0;
+    }else if(ad.init_buffer+ad.window_size+ad.term_buffer>nburnin){
+      ad.init_buffer=(int)(0.15*nburnin);
+      ad.term_buffer=(int)(0.1*nburnin);
+      ad.window_size=nburnin-ad.init_buffer-ad.term_buffer;
+    }
+    ad.window_end=ad.init_buffer+ad.window_size-1;
+  }
+
+  // Restart of the dual averaging with a new step size
+  template <typename T>
+  inline void hmc_adapt_restart(hmc_adaptation<T>& ad){
+    ad.mu=log(10.0*(double)ad.eps);
+    ad.Hbar=0.0;
+    ad.logeps_bar=0.0;
+    ad.m=0;
+  }
+
+  // Dual averaging of the step size (Hoffman and Gelman, Algorithm 5)
+  template <typename T>
+  inline void hmc_adapt_stepsize(hmc_adaptation<T>& ad, double accept){
+    const double gamma=0.05, t0=10.0, kappa=0.75;
+    if(accept>1.0) accept=1.0;
+    ad.m++;
+    double eta=1.0/(ad.m+t0);
+    ad.Hbar=(1.0-eta)*ad.Hbar+eta*(HMC_TARGET_ACCEPTANCE-accept);
+    double logeps=ad.mu-sqrt((double)ad.m)/gamma*ad.Hbar;
+    double x_eta=pow((double)ad.m,-kappa);
+    ad.logeps_bar=x_eta*logeps+(1.0-x_eta)*ad.logeps_bar;
+    ad.eps=(T)exp(logeps);
+  }
+
+  // Final step size of the burn-in
+  template <typename T>
+  inline void hmc_adapt_finish(hmc_adaptation<T>& ad){
+    if(ad.m>0) ad.eps=(T)exp(ad.logeps_bar);
+  }
+
+  /**
+   * Adds the transformed parameters of an iteration of burn-in to the variance of the current window
+   * @return true if the window finished and the mass matrix has been updated
+   */
+  template <typename T>
+  inline bool hmc_adapt_metric(hmc_adaptation<T>& ad, int iter, const T* phi, const int* fixed){
+    int last=ad.nburnin-ad.term_buffer-1; // last iteration of the last window
+    if(iter<ad.init_buffer || iter>last) return false;
+    ad.wn++;
+    for(int p=0;p<NPARAMS;p++){
+      double delta=phi[p]-ad.wmean[p];
+      ad.wmean[p]+=delta/ad.wn;
+      ad.wm2[p]+=delta*(phi[p]-ad.wmean[p]);
+    }
+    if(iter!=ad.window_end) return false;
+
+    // Regularised variance
+    double n=ad.wn;
+    for(int p=0;p<NPARAMS;p++){
+      if(!fixed[p] && n>1){
+	double var=ad.wm2[p]/(n-1.0);
+	var=(n/(n+5.0))*var+1e-3*(5.0/(n+5.0));
+	ad.minv[p]=(T)var;
+      }
+      ad.wmean[p]=0.0;
+      ad.wm2[p]=0.0;
+    }
+    ad.wn=0;
+
+    // Next window
+    if(ad.window_end<last){
+      ad.window_size*=2;
+      ad.window_end=iter+ad.window_size;
+      if(ad.window_end+2*ad.window_size>last) ad.window_end=last;
+    }
+    return true;
+  }
+
+  /**
+   * Step size with an acceptance probability of a leapfrog step around 0.8, doubling or halving it (as Stan)
+   */
+  template <typename T, bool RICIAN_NOISE>
+  inline void hmc_initial_stepsize(const hmc_target<T>& tg, const hmc_point<T>& z0, hmc_adaptation<T>& ad,
+				   const voxel_random& rnd, long counter){
+    hmc_random rng(rnd,counter,HMC_STEPSIZE_SLOT);
+    const double target=log(0.8);
+    int direction=0;
+    for(int k=0;k<100;k++){
+      hmc_point<T> z=z0;
+      hmc_momenta(z,ad.minv,rng);
+      double h0=hmc_hamiltonian(z,ad.minv);
+      hmc_leapfrog<T,RICIAN_NOISE>(tg,z,ad.minv,ad.eps);
+      double delta=h0-hmc_hamiltonian(z,ad.minv);
+      if(!std::isfinite(delta)) delta=-HUGE_VAL;
+      if(direction==0) direction=(delta>target)?1:-1;
+      if(direction==1 && !(delta>target)) break;
+      if(direction==-1 && !(delta<target)) break;
+      ad.eps=(direction==1)?ad.eps*(T)2.0:ad.eps/(T)2.0;
+      if(ad.eps>(T)1e7 || ad.eps<=(T)1e-30) break;
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,170 @@
+#ifndef CUDIMOT_MCMC_PRIORS_H_INCLUDED
+#define CUDIMOT_MCMC_PRIORS_H_INCLUDED
+
+/*  MCMC_priors.h
+
+    Priors, bounds and Rician log-Bessel function used by the MCMC algorithm (the log-Bessel function is also used by BIC_AIC). They are shared by the GPU version (bounds and priors in constant memory) and the CPU version (bounds and priors in host memory). It must be included after functions_gpu.h, modelparameters.h and modelfunctions.h
+
+    Moises Hernandez-Fernandez FMRIB Image Analysis Group (code moved from MCMC.cu), agent
+
+    Copyright (C) 2005, 2026 University of Oxford  */
+
+/*  CCOPYRIGHT  */
+
+#include "cudimot.h"
+
+namespace Cudimot{
+
+  // Returns the natural log of the 0th order modified Bessel function of first kind for an argument x
+  // Follows the exponential implementation of the Bessel function in Numerical Recipes, Ch. 6
+  FUNC float logIo(const float x){
+    float y,b;
+    b=fabsf(x);
+    if (b<3.75f){
+      float a=x/3.75f;
+      a*=a;
+      //Bessel function evaluation
+      y=1.0f+a*(3.5156229f+a*(3.0899424f+a*(1.2067492f+a*(0.2659732f+a*(0.0360768f+a*0.0045813f)))));
+      y=logf(y);
+    }else{
+      float a=3.75f/b;
+      //Logarithm of Bessel function
+      y=b+logf((0.39894228f+a*(0.01328592f+a*(0.00225319f+a*(-0.00157565f+a*(0.00916281f+a*(-0.02057706f+a*(0.02635537f+a*(-0.01647633f+a*0.00392377f))))))))/sqrt(b));
+    }
+    return y;
+  }
+
+  // Version for Double precision
+  FUNC double logIo(const double x){
+    double y,b;
+    b=fabs(x);
+    if (b<3.75){
+      double a=x/3.75;
+      a*=a;
+      //Bessel function evaluation
+      y=1.0+a*(3.5156229+a*(3.0899424+a*(1.2067492+a*(0.2659732+a*(0.0360768+a*0.0045813)))));
+      y=log(y);
+    }
+    else{
+      double a=3.75/b;
+      //Logarithm of Bessel function
+      y=b+log((0.39894228+a*(0.01328592+a*(0.00225319+a*(-0.00157565+a*(0.00916281+a*(-0.02057706+a*(0.02635537+a*(-0.01647633+a*0.00392377))))))))/sqrt(b));
+    }
+    return y;
+  }
+
+  template <typename T>
+  FUNC void Compute_TotalPrior(T* priors, T* TotalPrior){
+    *TotalPrior=(T)0.0;
+#ifdef __CUDACC__
+    #pragma unroll
+#endif
+    for(int p=0;p<NPARAMS;p++){
+      *TotalPrior += priors[p];
+    }
+  }
+
+  template <typename T>
+  FUNC void Initialize_priors_params(T* params, T* priors, int nmeas, T* CFP, T* FixP,
+				     const int* bound_types, const float* bounds_min, const float* bounds_max,
+				     const int* prior_types, const float* priors_a, const float* priors_b){
+#ifdef __CUDACC__
+    #pragma unroll
+#endif
+    for(int p=0;p<NPARAMS;p++){
+      if(bound_types[p]==BMIN){
+	// Bounded with only min
+	if (params[p] < bounds_min[p])
+	  params[p]=bounds_min[p];
+      }else if(bound_types[p]==BMAX){
+	// Bounded with only max
+	if (params[p] > bounds_max[p])
+	  params[p]=bounds_max[p];
+      }else if(bound_types[p]==BMINMAX){
+	// Bounded with min & max
+	if (params[p] < bounds_min[p])
+	  params[p]=bounds_min[p];
+	else if (params[p] > bounds_max[p])
+	  params[p]=bounds_max[p];
+      }
+      // Initialise priors
+      if(prior_types[p]==1){
+	// Gaussian(mean,std)
+	T std2= priors_b[p]*priors_b[p]; //variance*variance
+	priors[p]=(params[p]-priors_a[p])*(params[p]-priors_a[p])/(2*std2);
+	//prior=(param-mean)*(param-mean)/(2*var*var)
+      }else if(prior_types[p]==2){
+	// Gamma(alpha,beta)
+	priors[p]= ((T)1.0-priors_a[p])* log_gpu(params[p]) + priors_b[p]*params[p];
+      }else if(prior_types[p]==3){
+	// ARD(fudge_factor)
+	priors[p]=priors_a[p]*log_gpu(params[p]);
+	//fudgefactor*log(param)
+      }else if(prior_types[p]==4){
+	// sin()
+	priors[p]=-log_gpu(fabs_gpu(sin_gpu(params[p])/(T)2.0));
+      }else if(prior_types[p]==5){
+	// custom() .. defined by the user in modelfunctions.h
+	priors[p]=custom_priors(p,params,nmeas,CFP,FixP);
+      }else{
+	priors[p]=0;
+      }
+    }
+  }
+
+  template <typename T>
+  FUNC int Check_bounds_constraints(int idpar, T* params,
+				    const int* bound_types, const float* bounds_min, const float* bounds_max){
+    // Check Designer Constraints
+    if(!ConstraintsMCMC(NPARAMS,params)) return 0;
+    if(bound_types[idpar]==BMIN){
+      // Bounded with only min
+      if (params[idpar] < bounds_min[idpar]) return 0;
+      return 1;
+    }else if(bound_types[idpar]==BMAX){
+      // Bounded with only max
+      if (params[idpar] > bounds_max[idpar]) return 0;
+      return 1;
+    }else if(bound_types[idpar]==BMINMAX){
+      // Bounded with min & max
+      if (params[idpar] < bounds_min[idpar]) return 0;
+      if (params[idpar] > bounds_max[idpar]) return 0;
+      return 1;
+    }
+    return 1;
+  }
+
+  template <typename T>
+  FUNC void Compute_prior(int idpar, T* params, T* priors, T* old_prior, int nmeas, T* CFP, T* FixP,
+			  const int* prior_types, const float* priors_a, const float* priors_b){
+    *old_prior = priors[idpar];
+    if(prior_types[idpar]==GAUSSPRIOR){
+      // Gaussian(mean,std)
+      T std2= priors_b[idpar]*priors_b[idpar]; //std*std
+      priors[idpar]=(params[idpar]-priors_a[idpar])*(params[idpar]-priors_a[idpar])/(2*std2);
+      //prior=(param-mean)*(param-mean)/(2*std*std)
+
+    }else if(prior_types[idpar]==GAMMAPRIOR){
+      // Gamma(alpha,beta)
+      priors[idpar]= ((T)1.0-priors_a[idpar])* log_gpu(params[idpar]) + priors_b[idpar]*params[idpar];
+
+    }else if(prior_types[idpar]==ARDPRIOR){
+      // ARD(fudge_factor)
+      priors[idpar]=priors_a[idpar]*log_gpu(params[idpar]);
+      //fudgefactor*log(param)
+
+    }else if(prior_types[idpar]==SINPRIOR){
+      // sin()
+      priors[idpar]=-log_gpu(fabs_gpu(sin_gpu(params[idpar])/(T)2.0));
+
+    }else if(prior_types[idpar]==CUSTOM){
+      // custom() .. defined by the user in modelfunctions.h
+      priors[idpar]=custom_priors(idpar,params,nmeas,CFP,FixP);
+
+    }else{
+      priors[idpar]=0;
+    }
+  }
+}
+
+#endif
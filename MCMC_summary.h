@@ -0,0 +1,143 @@
+#ifndef CUDIMOT_MCMC_SUMMARY_H_INCLUDED
+#define CUDIMOT_MCMC_SUMMARY_H_INCLUDED
+
+/*  MCMC_summary.h
+
+    Summaries of the samples of MCMC (--summary_only). Instead of keeping every sample, each recorded sample of a parameter (and of tau with Rician noise) updates a summary of constant size: the number of samples, the mean and the sum of squares of the deviations from the mean (Welford), and an estimate of each quantile of SUMMARY_QUANTILE(k) with the P-square algorithm (Jain and Chlamtac, Communications of the ACM 28, 1985): 5 markers whose heights are adjusted with a piecewise-parabolic formula when their positions drift from the desired ones. The first 5 samples are stored in the markers, and the quantiles of up to 5 samples are interpolated from them.
+
+    The summary of a voxel (SUMMARY_VOXEL_SIZE values) has one block of SUMMARY_SIZE values for each parameter and one for tau. At the end, the mean, the standard deviation and the quantiles (SUMMARY_NOUTPUTS values) of each block are written.
+
+    They are shared by the GPU version (MCMC.cu, only the leader thread of a voxel), the CPU version (MCMC_cpu.cc) and Parameters.cu. It must be included after functions_gpu.h
+
+    agent
+
+    Copyright (C) 2026 University of Oxford  */
+
+/*  CCOPYRIGHT  */
+
+#include "modelparameters.h"
+
+// Quantiles estimated: 2.5%, median and 97.5%
+#define SUMMARY_NQUANTILES 3
+#define SUMMARY_QUANTILE(k) ((k)==0?0.025:((k)==1?0.5:0.975))
+
+// Summary of a parameter
+#define SUMMARY_COUNT 0 // Number of samples
+#define SUMMARY_MEAN 1 // Mean of the samples
+#define SUMMARY_M2 2 // Sum of the squares of the deviations from the mean
+#define SUMMARY_MARKERS 3 // For each quantile: heights [5] and positions [5] of the markers
+#define SUMMARY_SIZE (SUMMARY_MARKERS+10*SUMMARY_NQUANTILES)
+#define SUMMARY_VOXEL_SIZE ((NPARAMS+1)*SUMMARY_SIZE) // parameters and tau
+
+// Values written for each parameter: mean, standard deviation and quantiles
+#define SUMMARY_NOUTPUTS (2+SUMMARY_NQUANTILES)
+
+namespace Cudimot{
+
+  template <typename T>
+  HOSTDEVICE void summary_init(T* summary){
+    for(int i=0;i<SUMMARY_SIZE;i++){
+      summary[i]=(T)0.0;
+    }
+  }
+
+  // P-square update of the markers of the quantile p with the sample x. count: number of samples before x
+  template <typename T>
+  HOSTDEVICE void summary_psquare(T* q, T* n, double p, int count, T x){
+    if(count<5){
+      // Insertion of the first samples, sorted
+      int i=count;
+      while(i>0 && q[i-1]>x){
+	q[i]=q[i-1];
+	i--;
+      }
+      q[i]=x;
+      n[count]=(T)(count+1);
+      return;
+    }
+    int k;
+    if(x<q[0]){
+      q[0]=x;
+      k=0;
+    }else if(x>=q[4]){
+      q[4]=x;
+      k=3;
+    }else{
+      k=0;
+      while(k<3 && x>=q[k+1]) k++;
+    }
+    for(int i=k+1;i<5;i++){
+      n[i]+=(T)1.0;
+    }
+    // Desired positions of the markers after count+1 samples
+    double desired[3]={1.0+count*p/2.0, 1.0+count*p, 1.0+count*(1.0+p)/2.0};
+    for(int i=1;i<=3;i++){
+      double d=desired[i-1]-n[i];
+      if((d>=1.0 && n[i+1]-n[i]>(T)1.0) || (d<=-1.0 && n[i-1]-n[i]<(T)-1.0)){
+	T s=(d>0.0)?(T)1.0:(T)-1.0;
+	T qp=q[i]+s/(n[i+1]-n[i-1])*((n[i]-n[i-1]+s)*(q[i+1]-q[i])/(n[i+1]-n[i])
+				     +(n[i+1]-n[i]-s)*(q[i]-q[i-1])/(n[i]-n[i-1]));
+	if(q[i-1]<qp && qp<q[i+1]){
+	  q[i]=qp;
+	}else{
+	  // linear formula if the parabolic one is not monotone
+	  int j=i+(int)s;
+	  q[i]=q[i]+s*(q[j]-q[i])/(n[j]-n[i]);
+	}
+	n[i]+=s;
+      }
+    }
+  }
+
+  // Adds a sample to the summary of a parameter
+  template <typename T>
+  HOSTDEVICE void summary_add(T* summary, T x){
+    int count=(int)summary[SUMMARY_COUNT];
+    T delta=x-summary[SUMMARY_MEAN];
+    summary[SUMMARY_COUNT]=(T)(count+1);
+    summary[SUMMARY_MEAN]+=delta/(T)(count+1);
+    summary[SUMMARY_M2]+=delta*(x-summary[SUMMARY_MEAN]);
+    for(int k=0;k<SUMMARY_NQUANTILES;k++){
+      T* markers=&summary[SUMMARY_MARKERS+10*k];
+      summary_psquare(markers,&markers[5],SUMMARY_QUANTILE(k),count,x);
+    }
+  }
+
+  // Adds the current state of a chain to the summary of a voxel
+  template <typename T>
+  HOSTDEVICE void summary_record(T* summary, const T* params, T tau, bool rician){
+    for(int par=0;par<NPARAMS;par++){
+      summary_add(&summary[par*SUMMARY_SIZE],params[par]);
+    }
+    if(rician){
+      summary_add(&summary[NPARAMS*SUMMARY_SIZE],tau);
+    }
+  }
+
+  // Mean, standard deviation and quantiles of a parameter
+  template <typename T>
+  HOSTDEVICE void summary_finalise(const T* summary, T* out){
+    int count=(int)summary[SUMMARY_COUNT];
+    out[0]=summary[SUMMARY_MEAN];
+    out[1]=(count>1)?sqrt(summary[SUMMARY_M2]/(T)(count-1)):(T)0.0;
+    for(int k=0;k<SUMMARY_NQUANTILES;k++){
+      const T* q=&summary[SUMMARY_MARKERS+10*k];
+      if(count>5){
+	out[2+k]=q[2];
+      }else if(count>0){
+	// interpolation between the samples, which are sorted
+	double pos=SUMMARY_QUANTILE(k)*(count-1);
+	int i=(int)pos;
+	if(i>=count-1){
+	  out[2+k]=q[count-1];
+	}else{
+	  out[2+k]=q[i]+(T)(pos-i)*(q[i+1]-q[i]);
+	}
+      }else{
+	out[2+k]=(T)0.0;
+      }
+    }
+  }
+}
+
+#endif
@@ -358,6 +358,7 @@ namespace Cudimot{
     for(int i=0;i<NPARAMS;i++){
       if(gridTmp[i].size()){
 				gridParams.push_back(i);
+				gridSizes.push_back(gridTmp[i].size());
 				nGridParams++;
 				gridCombs*=gridTmp[i].size();
       }
@@ -482,6 +483,11 @@ namespace Cudimot{
     return gridParams;
   }
 
+  template <typename T>
+  vector<int> Model<T>::getGridSizes(){
+    return gridSizes;
+  }
+
   template <typename T>
   T* Model<T>::getGrid(){
     return grid;
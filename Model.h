@@ -157,6 +157,11 @@ namespace Cudimot{
      */
     std::vector<int> gridParams;
 
+    /**
+     * Number of values of each parameter in the grid
+     */
+    std::vector<int> gridSizes;
+
     /**
      * Number of parameters in each combination of the grid
      */
@@ -264,6 +269,11 @@ namespace Cudimot{
      * @return Array of paramer
      */
     std::vector<int> getGridParams();
+
+    /*
+     * @return Number of values of each parameter in the grid
+     */
+    std::vector<int> getGridSizes();
     
     /*
      * @return Number of combinations in the grid
@@ -7,6 +7,11 @@
 /* CCOPYRIGHT */
 
 #include "Parameters.h"
+#include "init_gpu.h"
+#include "protocol_cache.h"
+#include "tensor_init.h"
+#include "functions_gpu.h"
+#include "MCMC_summary.h"
 
 using namespace NEWMAT;
 using MISCMATHS::read_ascii_matrix;
@@ -17,7 +22,7 @@ namespace Cudimot{
   Parameters<T>::Parameters(Model<T> model,dMRI_Data<T> dMRI_data):
     nparams(model.nparams),
     nFixP(model.nFixP), FixP_Tsize(model.FixP_Tsize),
-    nCFP(model.nCFP),CFP_Tsize(model.CFP_Tsize),
+    nCFP(model.nCFP),CFP_Tsize(model.CFP_Tsize+NPROTOCOL),
     nvox(dMRI_data.nvox), nmeas(dMRI_data.nmeas),nparts(dMRI_data.nparts),
     size_part(dMRI_data.size_part),size_last_part(dMRI_data.size_last_part),
     nvoxFit_part(dMRI_data.nvoxFit_part),bic_aic(dMRI_data.nvoxFit_part)
@@ -135,11 +140,37 @@ namespace Cudimot{
       }
     }else{
       // No CFP provided 
-      if(CFP_Tsize){
+      if(model.CFP_Tsize){
 	cerr << "CUDIMOT Error: The user must provide a file with a list of common fixed parameters for this model: Use option --CFP" << endl;
 	exit(-1);
       }
     }
+    
+    // Values of the model that only depend on the CFP (see protocol_cache.h)
+    shells.resize(nmeas);
+    nshells=prepare_protocol(nmeas,CFP_Tsize,CFP_host,shells.data());
+    if(NPROTOCOL){
+      cout << "Protocol values precomputed for " << nshells << " shells" << endl;
+    }
+
+    // Parameters initialised with a diffusion tensor fit (see tensor_init.h)
+    if(opts.init_tensor.value()){
+#ifdef TENSOR_BVECS
+      vector<T> meas(nvox*nmeas);
+      for(int v=0;v<nvox;v++){
+	for(int m=0;m<nmeas;m++){
+	  meas[v*nmeas+m]=dMRI_data.dataM(m+1,v+1);
+	}
+      }
+      vector<int> bound_types=model.getBound_types();
+      vector<T> bounds_min=model.getBounds_min();
+      vector<T> bounds_max=model.getBounds_max();
+      int ninit=tensor_initialisation(nvox,nmeas,CFP_Tsize,CFP_host,meas.data(),params_host,bound_types.data(),bounds_min.data(),bounds_max.data());
+      cout << "Parameters initialised with a diffusion tensor fit in " << ninit << " of " << nvox << " voxels" << endl;
+#else
+      cerr << "CUDIMOT Warning: This model does not define TENSOR_BVECS and TENSOR_BVALS (see tensor_init.h). The option --init_tensor is ignored" << endl;
+#endif
+    }
     //////////////////////////////////////////////////////
     
 
@@ -201,22 +232,20 @@ namespace Cudimot{
     //////////////////////////////////////////////////////
     //////////////////////////////////////////////////////
     
-    /// Allocate GPU memory
-    cudaMalloc((void**)&params_gpu,nvoxFit_part*nparams*sizeof(T));
-    cudaMalloc((void**)&CFP_gpu,CFP_Tsize*nmeas*sizeof(T));
-    cudaMalloc((void**)&FixP_gpu,nvoxFit_part*FixP_Tsize*sizeof(T));
+    /// Allocate GPU memory (host memory with the CPU backend)
+    allocate_part((void**)&params_gpu,nvoxFit_part*nparams*sizeof(T),"Allocating Model Parameters on GPU\n");
+    allocate_part((void**)&CFP_gpu,CFP_Tsize*nmeas*sizeof(T),"Allocating Model Parameters on GPU\n");
+    allocate_part((void**)&FixP_gpu,nvoxFit_part*FixP_Tsize*sizeof(T),"Allocating Model Parameters on GPU\n");
     if(opts.getPredictedSignal.value()){
-      cudaMalloc((void**)&predSignal_gpu,nvoxFit_part*nmeas*sizeof(T));
+      allocate_part((void**)&predSignal_gpu,nvoxFit_part*nmeas*sizeof(T),"Allocating Model Parameters on GPU\n");
     }
     if(opts.BIC_AIC.value()){
-      cudaMalloc((void**)&BIC_gpu,nvoxFit_part*sizeof(T));
-      cudaMalloc((void**)&AIC_gpu,nvoxFit_part*sizeof(T));
+      allocate_part((void**)&BIC_gpu,nvoxFit_part*sizeof(T),"Allocating Model Parameters on GPU\n");
+      allocate_part((void**)&AIC_gpu,nvoxFit_part*sizeof(T),"Allocating Model Parameters on GPU\n");
     }
-    sync_check("Allocating Model Parameters on GPU\n");
     
     // Copy Fixed Common Parameters from host to GPU
-    cudaMemcpy(CFP_gpu,CFP_host,CFP_Tsize*nmeas*sizeof(T),cudaMemcpyHostToDevice);
-    sync_check("Copying Common-Fixed Model Parameters to GPU\n");
+    copy_host2part(CFP_gpu,CFP_host,CFP_Tsize*nmeas*sizeof(T),"Copying Common-Fixed Model Parameters to GPU\n");
         
     /// If MCMC: allocate memory in host and GPU for samples;
     if(opts.runMCMC.value()){
@@ -224,13 +253,32 @@ namespace Cudimot{
     }else{
       nsamples=1;
     }
+    summary_gpu=NULL;
+    if(opts.runMCMC.value() && opts.summary_only.value()){
+      // Only the summaries of the samples are kept: a single sample per voxel, the mean (for the predicted signal and BIC/AIC)
+      nsamples=1;
+      summary_host=new T[(nparams+1)*SUMMARY_NOUTPUTS*nvox];
+      allocate_part((void**)&summary_gpu,nvoxFit_part*SUMMARY_VOXEL_SIZE*sizeof(T),"Allocating Summaries of the Samples on GPU\n");
+    }
     samples_host = new T[nsamples*nparams*nvox];
-    cudaMalloc((void**)&samples_gpu,nvoxFit_part*nparams*nsamples*sizeof(T));
+    allocate_part((void**)&samples_gpu,nvoxFit_part*nparams*nsamples*sizeof(T),"Allocating Samples on GPU\n");
     if(opts.rician.value()){
       tau_samples_host=new T[nsamples*nvox];
-      cudaMalloc((void**)&tau_samples_gpu,nvoxFit_part*nsamples*sizeof(T));
+      allocate_part((void**)&tau_samples_gpu,nvoxFit_part*nsamples*sizeof(T),"Allocating Samples on GPU\n");
+    }
+    convergence_gpu=NULL;
+    if(opts.runMCMC.value() && opts.nchains.value()>1){
+      convergence_host=new T[MCMC_NDIAGNOSTICS*nvox];
+      allocate_part((void**)&convergence_gpu,nvoxFit_part*MCMC_NDIAGNOSTICS*sizeof(T),"Allocating Convergence Diagnostics on GPU\n");
+    }
+
+    /// If several starting points for Levenberg-Marquardt (--multistart): allocate memory for them
+    nstarts=1;
+    starts_gpu=NULL;
+    if(opts.gridSearch.value()!="" && !opts.no_LevMar.value() && opts.multistart.value()>1){
+      nstarts=opts.multistart.value();
+      allocate_part((void**)&starts_gpu,nvoxFit_part*nparams*nstarts*sizeof(T),"Allocating Starting Points on GPU\n");
     }
-    sync_check("Allocating Samples on GPU\n");
   }
   
   template <typename T>
@@ -248,8 +296,7 @@ namespace Cudimot{
     if(part==(nparts-1)) 
       size=size_last_part; // last part
     // Copy from host to GPU
-    cudaMemcpy(params_gpu,&params_host[initial_pos],size*nparams*sizeof(T),cudaMemcpyHostToDevice);
-    sync_check("Copying Model Parameters to GPU\n");
+    copy_host2part(params_gpu,&params_host[initial_pos],size*nparams*sizeof(T),"Copying Model Parameters to GPU\n");
 
     return params_gpu;
   }
@@ -259,6 +306,16 @@ namespace Cudimot{
     return samples_gpu;
   }
 
+  template <typename T>
+  int Parameters<T>::getNstarts(){
+    return nstarts;
+  }
+
+  template <typename T>
+  T* Parameters<T>::getStarts(){
+    return starts_gpu;
+  }
+
   template <typename T>
   int Parameters<T>::getTsize_CFP(){
     return CFP_Tsize;
@@ -287,8 +344,7 @@ namespace Cudimot{
       size=size_last_part; // last part
 
     // Copy Fixed Parameters from host to GPU
-    cudaMemcpy(FixP_gpu,&FixP_host[initial_pos],size*FixP_Tsize*sizeof(T),cudaMemcpyHostToDevice);
-    sync_check("Copying Fixed Model Parameters to GPU\n");
+    copy_host2part(FixP_gpu,&FixP_host[initial_pos],size*FixP_Tsize*sizeof(T),"Copying Fixed Model Parameters to GPU\n");
     return FixP_gpu;
   }
   
@@ -307,8 +363,7 @@ namespace Cudimot{
     }
     int initial_pos=part*size_part*nparams;
     
-    cudaMemcpy(&params_host[initial_pos],params_gpu,size*nparams*sizeof(T),cudaMemcpyDeviceToHost);
-    sync_check("Copying Model Parameters from GPU\n");
+    copy_part2host(&params_host[initial_pos],params_gpu,size*nparams*sizeof(T),"Copying Model Parameters from GPU\n");
   }
   
   template <typename T>
@@ -325,35 +380,29 @@ namespace Cudimot{
       size=size_last_part; // this ignores the extra voxels added
     }
 
-    if(opts.getPredictedSignal.value()){
-      if(mode==0){
-	// Calculate Predicted Signal of this part from parameters
-	PredictedSignal.run(nvoxFit_part,nmeas,1,CFP_Tsize,FixP_Tsize,params_gpu,CFP_gpu,getFixP_part(part),predSignal_gpu);
-      }else{
-	// Calculate Predicted Signal of this part from samples (MCMC)
-	PredictedSignal.run(nvoxFit_part,nmeas,nsamples,CFP_Tsize,FixP_Tsize,samples_gpu,CFP_gpu,getFixP_part(part),predSignal_gpu);
+    // From the parameters (GridSearch or LevMar) or from the samples (MCMC)
+    T* estimates=params_gpu;
+    int nestimates=1;
+    if(mode!=0){
+      estimates=samples_gpu;
+      nestimates=nsamples;
+    }
 
-      }
+    if(opts.getPredictedSignal.value()){
+      // Calculate Predicted Signal of this part
+      PredictedSignal.run(size,nmeas,nestimates,CFP_Tsize,FixP_Tsize,estimates,CFP_gpu,getFixP_part(part),predSignal_gpu);
       // Copy Predicted Signal to host
       initial_pos=part*size_part*nmeas;
-      cudaMemcpy(&predSignal_host[initial_pos],predSignal_gpu,size*nmeas*sizeof(T),cudaMemcpyDeviceToHost);
-      sync_check("Copying Predicted Signal from GPU\n");
+      copy_part2host(&predSignal_host[initial_pos],predSignal_gpu,size*nmeas*sizeof(T),"Copying Predicted Signal from GPU\n");
     }
 
     if(opts.BIC_AIC.value()){
-      if(mode==0){
-	// Calculate BIC/AIC of this part from parameters
-	bic_aic.run(nvoxFit_part,nmeas,1,CFP_Tsize,FixP_Tsize,meas,params_gpu,CFP_gpu,getFixP_part(part),BIC_gpu,AIC_gpu,tau_samples_gpu);
-      }else{
-	// Calculate BIC/AIC of this part from samples (MCMC)
-	bic_aic.run(nvoxFit_part,nmeas,nsamples,CFP_Tsize,FixP_Tsize,meas,samples_gpu,CFP_gpu,getFixP_part(part),BIC_gpu,AIC_gpu,tau_samples_gpu);
-	
-      }
+      // Calculate BIC/AIC of this part
+      bic_aic.run(size,nmeas,nestimates,CFP_Tsize,FixP_Tsize,meas,estimates,CFP_gpu,getFixP_part(part),BIC_gpu,AIC_gpu,tau_samples_gpu);
       // Copy Predicted Signal to host
       initial_pos=part*size_part;
-      cudaMemcpy(&BIC_host[initial_pos],BIC_gpu,size*sizeof(T),cudaMemcpyDeviceToHost);
-      cudaMemcpy(&AIC_host[initial_pos],AIC_gpu,size*sizeof(T),cudaMemcpyDeviceToHost);
-      sync_check("Copying BIC/AIC from GPU\n");
+      copy_part2host(&BIC_host[initial_pos],BIC_gpu,size*sizeof(T),"Copying BIC/AIC from GPU\n");
+      copy_part2host(&AIC_host[initial_pos],AIC_gpu,size*sizeof(T),"Copying BIC/AIC from GPU\n");
     }
   }
  
@@ -369,15 +418,42 @@ namespace Cudimot{
     if(part==(nparts-1)){
       size=size_last_part; // this ignores the extra voxels added
     }
+    if(summary_gpu!=NULL){
+      // Mean, standard deviation and quantiles. The mean is the sample of the part used for the predicted signal and BIC/AIC
+      T* summary_part=new T[size*SUMMARY_VOXEL_SIZE];
+      T* means_part=new T[size*(nparams+1)];
+      copy_part2host(summary_part,summary_gpu,size*SUMMARY_VOXEL_SIZE*sizeof(T),"Copying Summaries of the Samples from GPU\n");
+      for(int vox=0;vox<size;vox++){
+	for(int par=0;par<=nparams;par++){
+	  T* out=&summary_host[((part*size_part+vox)*(nparams+1)+par)*SUMMARY_NOUTPUTS];
+	  summary_finalise(&summary_part[vox*SUMMARY_VOXEL_SIZE+par*SUMMARY_SIZE],out);
+	  if(par<nparams){
+	    means_part[vox*nparams+par]=out[0];
+	  }else{
+	    means_part[size*nparams+vox]=out[0];
+	  }
+	}
+      }
+      copy_host2part(samples_gpu,means_part,size*nparams*sizeof(T),"Copying Mean of the Samples to GPU\n");
+      if(opts.rician.value()){
+	copy_host2part(tau_samples_gpu,&means_part[size*nparams],size*sizeof(T),"Copying Mean of the Tau Samples to GPU\n");
+      }
+      delete[] summary_part;
+      delete[] means_part;
+    }
+
     int initial_pos=part*size_part*nparams*nsamples;
     
-    cudaMemcpy(&samples_host[initial_pos],samples_gpu,size*nparams*nsamples*sizeof(T),cudaMemcpyDeviceToHost);
-    sync_check("Copying Samples from GPU\n");
+    copy_part2host(&samples_host[initial_pos],samples_gpu,size*nparams*nsamples*sizeof(T),"Copying Samples from GPU\n");
 
     if(opts.rician.value()){
       initial_pos=part*size_part*nsamples;
-      cudaMemcpy(&tau_samples_host[initial_pos],tau_samples_gpu,size*nsamples*sizeof(T),cudaMemcpyDeviceToHost);
-      sync_check("Copying Tau Samples from GPU\n");
+      copy_part2host(&tau_samples_host[initial_pos],tau_samples_gpu,size*nsamples*sizeof(T),"Copying Tau Samples from GPU\n");
+    }
+
+    if(convergence_gpu!=NULL){
+      initial_pos=part*size_part*MCMC_NDIAGNOSTICS;
+      copy_part2host(&convergence_host[initial_pos],convergence_gpu,size*MCMC_NDIAGNOSTICS*sizeof(T),"Copying Convergence Diagnostics from GPU\n");
     }
   }
   
@@ -386,63 +462,101 @@ namespace Cudimot{
     Log& logger = LogSingleton::getInstance();
     cudimotOptions& opts = cudimotOptions::getInstance();
 
-    // Create a Matrix [nsamples X nvoxels] for each parameter
-    vector<Matrix> samples;
-    samples.resize(nparams);
-    
-    for(int par=0;par<nparams;par++){
-      samples[par].ReSize(nsamples,nvox);
-      samples[par]=0;
-    }
-    // Copy samples to each Matrix
-    for(int vox=0;vox<nvox;vox++){  
+    if(summary_gpu!=NULL){
+      // Summaries of the samples (--summary_only): mean, standard deviation and quantiles of each parameter and tau
+      const char* names[3]={"_mean","_std","_quantiles"}; // outputs from the first value of each one
+      int nvalues[3]={1,1,SUMMARY_NQUANTILES};
+      int nsummaries=opts.rician.value()?nparams+1:nparams;
+      for(int par=0;par<nsummaries;par++){
+	for(int o=0;o<3;o++){
+	  int nm=nvalues[o];
+	  Matrix SummaryM;
+	  SummaryM.ReSize(nm,nvox);
+	  SummaryM=0;
+	  for(int vox=0;vox<nvox;vox++){
+	    for(int m=0;m<nm;m++){
+	      SummaryM(m+1,vox+1)=summary_host[(vox*(nparams+1)+par)*SUMMARY_NOUTPUTS+o+m];
+	    }
+	  }
+	  string file_name;
+	  file_name.append(opts.partsdir.value());
+	  file_name.append("/part_");
+	  file_name.append(num2str(opts.idPart.value()));
+	  if(par<nparams){
+	    file_name.append("/Param_"+num2str(par));
+	  }else{
+	    file_name.append("/Tau");
+	  }
+	  file_name.append(names[o]);
+	  ofstream out;
+	  out.open(file_name.data(), ios::out | ios::binary);
+	  out.write((char*)&nvox,4); // number of voxels
+	  out.write((char*)&nm,4); // number of measurements
+	  long size=nvox*nm*sizeof(Real); //need Real here (NEWMAT Object!)
+	  out.write((char*)&size,sizeof(long)); // number of bytes
+	  out.write((char*)&SummaryM(1,1),size);
+	  out.close();
+	}
+      }
+    }else{
+      // Create a Matrix [nsamples X nvoxels] for each parameter
+      vector<Matrix> samples;
+      samples.resize(nparams);
+  
       for(int par=0;par<nparams;par++){
-	for(int sam=0;sam<nsamples;sam++){
-	  samples[par](sam+1,vox+1)=samples_host[vox*nparams*nsamples+par*nsamples+sam];
+	samples[par].ReSize(nsamples,nvox);
+	samples[par]=0;
+      }
+      // Copy samples to each Matrix
+      for(int vox=0;vox<nvox;vox++){  
+	for(int par=0;par<nparams;par++){
+	  for(int sam=0;sam<nsamples;sam++){
+	    samples[par](sam+1,vox+1)=samples_host[vox*nparams*nsamples+par*nsamples+sam];
+	  }
 	}
       }
-    }
-    
-    // Write to file
-    for(int par=0;par<nparams;par++){
-      string file_name;
-      file_name.append(opts.partsdir.value());
-      file_name.append("/part_");
-      file_name.append(num2str(opts.idPart.value()));
-      file_name.append("/Param_"+num2str(par)+"_samples");
-      ofstream out;
-      out.open(file_name.data(), ios::out | ios::binary);
-      out.write((char*)&nvox,4); // number of voxels
-      out.write((char*)&nsamples,4); // number of measurements
-      long size=nvox*nsamples*sizeof(Real); //need Real here (NEWMAT Object!)
-      out.write((char*)&size,sizeof(long)); // number of bytes
-      out.write((char*)&samples[par](1,1),size);
-      out.close();
-    }
+  
+      // Write to file
+      for(int par=0;par<nparams;par++){
+	string file_name;
+	file_name.append(opts.partsdir.value());
+	file_name.append("/part_");
+	file_name.append(num2str(opts.idPart.value()));
+	file_name.append("/Param_"+num2str(par)+"_samples");
+	ofstream out;
+	out.open(file_name.data(), ios::out | ios::binary);
+	out.write((char*)&nvox,4); // number of voxels
+	out.write((char*)&nsamples,4); // number of measurements
+	long size=nvox*nsamples*sizeof(Real); //need Real here (NEWMAT Object!)
+	out.write((char*)&size,sizeof(long)); // number of bytes
+	out.write((char*)&samples[par](1,1),size);
+	out.close();
+      }
 
-    // Rician Noise: Write tau samples
-    if(opts.rician.value()){
-      Matrix tau_samples;
-      tau_samples.ReSize(nsamples,nvox);
-      tau_samples=0;
-      for(int vox=0;vox<nvox;vox++){  
-	for(int sam=0;sam<nsamples;sam++){
-	  tau_samples(sam+1,vox+1)=tau_samples_host[vox*nsamples+sam];
+      // Rician Noise: Write tau samples
+      if(opts.rician.value()){
+	Matrix tau_samples;
+	tau_samples.ReSize(nsamples,nvox);
+	tau_samples=0;
+	for(int vox=0;vox<nvox;vox++){  
+	  for(int sam=0;sam<nsamples;sam++){
+	    tau_samples(sam+1,vox+1)=tau_samples_host[vox*nsamples+sam];
+	  }
 	}
+	string file_name;
+	file_name.append(opts.partsdir.value());
+	file_name.append("/part_");
+	file_name.append(num2str(opts.idPart.value()));
+	file_name.append("/Tau_samples");
+	ofstream out;
+	out.open(file_name.data(), ios::out | ios::binary);
+	out.write((char*)&nvox,4); // number of voxels
+	out.write((char*)&nsamples,4); // number of measurements
+	long size=nvox*nsamples*sizeof(Real); //need Real here (NEWMAT Object!)
+	out.write((char*)&size,sizeof(long)); // number of bytes
+	out.write((char*)&tau_samples(1,1),size);
+	out.close();
       }
-      string file_name;
-      file_name.append(opts.partsdir.value());
-      file_name.append("/part_");
-      file_name.append(num2str(opts.idPart.value()));
-      file_name.append("/Tau_samples");
-      ofstream out;
-      out.open(file_name.data(), ios::out | ios::binary);
-      out.write((char*)&nvox,4); // number of voxels
-      out.write((char*)&nsamples,4); // number of measurements
-      long size=nvox*nsamples*sizeof(Real); //need Real here (NEWMAT Object!)
-      out.write((char*)&size,sizeof(long)); // number of bytes
-      out.write((char*)&tau_samples(1,1),size);
-      out.close();
     }
 
     if(opts.getPredictedSignal.value()){
@@ -509,12 +623,50 @@ namespace Cudimot{
       out.write((char*)&AICM(1,1),size);
       out.close();
     }
+
+    // MCMC with several chains: write R-hat, effective sample size and burn-in of each voxel
+    if(convergence_gpu!=NULL){
+      const char* names[MCMC_NDIAGNOSTICS]={"Rhat","ESS","BurnIn"};
+      for(int d=0;d<MCMC_NDIAGNOSTICS;d++){
+	Matrix DiagM;
+	DiagM.ReSize(1,nvox);
+	DiagM=0;
+	for(int vox=0;vox<nvox;vox++){
+	  DiagM(1,vox+1)=convergence_host[vox*MCMC_NDIAGNOSTICS+d];
+	}
+	string file_name;
+	file_name.append(opts.partsdir.value());
+	file_name.append("/part_");
+	file_name.append(num2str(opts.idPart.value()));
+	file_name.append("/");
+	file_name.append(names[d]);
+	ofstream out;
+	out.open(file_name.data(), ios::out | ios::binary);
+	out.write((char*)&nvox,4); // number of voxels
+	int nm=1;
+	out.write((char*)&nm,4); // number of measurements
+	long size=nvox*1*sizeof(Real); //need Real here (NEWMAT Object!)
+	out.write((char*)&size,sizeof(long)); // number of bytes
+	out.write((char*)&DiagM(1,1),size);
+	out.close();
+      }
+    }
   }
 
   template <typename T>
   T* Parameters<T>::getTauSamples(){
     return tau_samples_gpu;
   }
+
+  template <typename T>
+  T* Parameters<T>::getConvergence(){
+    return convergence_gpu;
+  }
+
+  template <typename T>
+  T* Parameters<T>::getSummary(){
+    return summary_gpu;
+  }
   
   // Explicit Instantiations of the template
   template class Parameters<float>;
@@ -8,6 +8,7 @@
  * \brief A class for managing the Parameters of a Model
  *
  * This class contains the value of the estimated parameters of a diffusion MRI model. It also contains the value of fixed parameters of the model.
+ * The arrays of a part with the suffix _gpu are allocated in host memory if the fitting routines run on the CPU (--backend).
  *
  * \author Moises Hernandez-Fernandez - FMRIB Image Analysis Group
  *
@@ -80,7 +81,7 @@ namespace Cudimot{
     int nCFP;
  
     /**
-     * Total size of Common Fixed Parameters (without counting measurements)
+     * Total size of Common Fixed Parameters (without counting measurements), including the values precomputed by the model (NPROTOCOL)
      */
     int CFP_Tsize;
 
@@ -95,6 +96,16 @@ namespace Cudimot{
      */
     T* CFP_gpu;
 
+    /**
+     * Number of shells: measurements with the same values precomputed from the CFP (see protocol_cache.h)
+     */
+    int nshells;
+
+    /**
+     * Shell of each measurement
+     */
+    std::vector<int> shells;
+
     /////////////////////////////////////////////////////////////////
     /////////////////////////////////////////////////////////////////
     
@@ -207,6 +218,36 @@ namespace Cudimot{
      */
     T* tau_samples_gpu;
 
+    /**
+     * Convergence diagnostics of MCMC with several chains (--nchains): split R-hat, effective sample size and iterations of burn-in of each voxel (MCMC_NDIAGNOSTICS values per voxel) on the host.
+     */
+    T* convergence_host;
+
+    /**
+     * Convergence diagnostics of MCMC with several chains of each voxel of a part on the GPU (host memory: only with the CPU backend). NULL with one chain
+     */
+    T* convergence_gpu;
+
+    /**
+     * Summaries of the samples of MCMC (--summary_only): mean, standard deviation and quantiles of each parameter and tau (SUMMARY_NOUTPUTS values each, see MCMC_summary.h) of each voxel on the host.
+     */
+    T* summary_host;
+
+    /**
+     * Summaries of the samples being recorded by MCMC of each voxel of a part on the GPU (SUMMARY_VOXEL_SIZE values per voxel, host memory: only with the CPU backend). NULL if all the samples are kept
+     */
+    T* summary_gpu;
+
+    /**
+     * Number of starting points of Levenberg-Marquardt for each voxel (--multistart). 1 without GridSearch or Levenberg-Marquardt
+     */
+    int nstarts;
+
+    /**
+     * Starting points of Levenberg-Marquardt of the voxels in a single part, allocated on the GPU: start s of voxel v at (s*nvoxFit_part+v)*nparams. NULL if nstarts is 1
+     */
+    T* starts_gpu;
+
     
   public:
 
@@ -233,6 +274,16 @@ namespace Cudimot{
      */
     T* getSamples();
 
+    /**
+     * @return Number of starting points of Levenberg-Marquardt for each voxel (--multistart)
+     */
+    int getNstarts();
+
+    /**
+     * @return A pointer to the starting points of Levenberg-Marquardt of a part, written by GridSearch (on the GPU). NULL if there is only one
+     */
+    T* getStarts();
+
     /**
      * @return Total size of Common Fixed Parameters (without counting measurements)
      */
@@ -265,13 +316,13 @@ namespace Cudimot{
     void copyParams2Samples();
 
     /**
-     * Copies the samples of the parameters of a part from GPU to the host array with all the samples values (at its correct position)
+     * Copies the samples of the parameters of a part from GPU to the host array with all the samples values (at its correct position). With --summary_only, it finalises the summaries of the part and keeps the mean of the samples as the only sample of each parameter
      * @param part A number to identify a part of the data
      */
     void copySamplesPartGPU2Host(int part);
 
     /**
-     * Writes to a binary file the samples of the parameters, Including tau (rician noise), the predicted signal, the BIC and AIC if requested.
+     * Writes to a binary file the samples of the parameters (or their summaries with --summary_only), Including tau (rician noise), the predicted signal, the BIC and AIC if requested and the convergence diagnostics of MCMC with several chains.
      */
     void writeSamples();
 
@@ -280,6 +331,16 @@ namespace Cudimot{
      */ 
     T* getTauSamples();
 
+    /**
+     * @return A pointer to the convergence diagnostics of MCMC of each voxel of the part, NULL if there is only one chain per voxel
+     */
+    T* getConvergence();
+
+    /**
+     * @return A pointer to the summaries of the samples of MCMC of each voxel of the part, NULL if all the samples are kept
+     */
+    T* getSummary();
+
     /**
      * If the user ask for the predicted signal or BIC/AIC, calculates the predicted signal or/and the BIC/AIC for this part.
      * @param mode 0: from GridSearch or LevMar (1 sample), from MCMC (several samples, needs to calculate the mean)
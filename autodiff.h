@@ -0,0 +1,281 @@
+#ifndef CUDIMOT_AUTODIFF_H_INCLUDED
+#define CUDIMOT_AUTODIFF_H_INCLUDED
+
+/*  autodiff.h
+
+    Forward-mode automatic differentiation of the model functions. Dual<T> holds a value and its derivative with respect to each of the NPARAMS parameters of the model, so a single evaluation of Predicted_Signal with Dual<T> gives the exact derivatives of all the parameters. With NUMERICAL(idpar) each parameter costs two evaluations of Predicted_Signal and has a truncation error.
+
+    Use the keyword "AUTODIFF(CFP_size,FixP_size)" in Partial_Derivatives (CFP_size and FixP_size are the total sizes of the common fixed parameters and of the fixed parameters of the model, see modelparameters.cc). It fills derivatives[0..NPARAMS-1], and the derivatives with an analytic expression can then be overwritten. Predicted_Signal (and the functions it calls) must only use the type T, arithmetic operators, comparisons and the functions of functions_gpu.h. The libm names exp, log, sqrt, sin, cos, atan, acos and fabs are also accepted.
+
+    It is included by macro_numerical.h
+
+    agent
+
+    Copyright (C) 2026 University of Oxford  */
+
+/*  CCOPYRIGHT  */
+
+template <typename T>
+struct Dual{
+  T v;          // value
+  T d[NPARAMS]; // derivative with respect to each parameter of the model
+
+  FUNC Dual(){}
+
+  // Constant: all the derivatives are 0
+  FUNC Dual(T value){
+    v=value;
+    for(int i=0;i<NPARAMS;i++) d[i]=(T)0.0;
+  }
+
+  // Change of precision (e.g. functions evaluated in double precision by single precision models)
+  template <typename U>
+  FUNC Dual(const Dual<U>& x){
+    v=(T)x.v;
+    for(int i=0;i<NPARAMS;i++) d[i]=(T)x.d[i];
+  }
+
+  // Parameter idpar of the model: derivative 1 with respect to itself
+  FUNC static Dual variable(T value, int idpar){
+    Dual x(value);
+    x.d[idpar]=(T)1.0;
+    return x;
+  }
+
+  friend FUNC Dual operator-(const Dual& a){
+    Dual r;
+    r.v=-a.v;
+    for(int i=0;i<NPARAMS;i++) r.d[i]=-a.d[i];
+    return r;
+  }
+
+  friend FUNC Dual operator+(const Dual& a, const Dual& b){
+    Dual r;
+    r.v=a.v+b.v;
+    for(int i=0;i<NPARAMS;i++) r.d[i]=a.d[i]+b.d[i];
+    return r;
+  }
+  friend FUNC Dual operator+(const Dual& a, T b){
+    Dual r=a;
+    r.v+=b;
+    return r;
+  }
+  friend FUNC Dual operator+(T a, const Dual& b){
+    return b+a;
+  }
+
+  friend FUNC Dual operator-(const Dual& a, const Dual& b){
+    Dual r;
+    r.v=a.v-b.v;
+    for(int i=0;i<NPARAMS;i++) r.d[i]=a.d[i]-b.d[i];
+    return r;
+  }
+  friend FUNC Dual operator-(const Dual& a, T b){
+    Dual r=a;
+    r.v-=b;
+    return r;
+  }
+  friend FUNC Dual operator-(T a, const Dual& b){
+    Dual r=-b;
+    r.v+=a;
+    return r;
+  }
+
+  friend FUNC Dual operator*(const Dual& a, const Dual& b){
+    Dual r;
+    r.v=a.v*b.v;
+    for(int i=0;i<NPARAMS;i++) r.d[i]=a.d[i]*b.v+a.v*b.d[i];
+    return r;
+  }
+  friend FUNC Dual operator*(const Dual& a, T b){
+    Dual r;
+    r.v=a.v*b;
+    for(int i=0;i<NPARAMS;i++) r.d[i]=a.d[i]*b;
+    return r;
+  }
+  friend FUNC Dual operator*(T a, const Dual& b){
+    return b*a;
+  }
+
+  friend FUNC Dual operator/(const Dual& a, const Dual& b){
+    Dual r;
+    T inv=(T)1.0/b.v;
+    r.v=a.v*inv;
+    for(int i=0;i<NPARAMS;i++) r.d[i]=(a.d[i]-r.v*b.d[i])*inv;
+    return r;
+  }
+  friend FUNC Dual operator/(const Dual& a, T b){
+    return a*((T)1.0/b);
+  }
+  friend FUNC Dual operator/(T a, const Dual& b){
+    Dual r;
+    T inv=(T)1.0/b.v;
+    r.v=a*inv;
+    for(int i=0;i<NPARAMS;i++) r.d[i]=-r.v*b.d[i]*inv;
+    return r;
+  }
+
+  FUNC Dual& operator+=(const Dual& b){ *this=*this+b; return *this; }
+  FUNC Dual& operator-=(const Dual& b){ *this=*this-b; return *this; }
+  FUNC Dual& operator*=(const Dual& b){ *this=*this*b; return *this; }
+  FUNC Dual& operator/=(const Dual& b){ *this=*this/b; return *this; }
+
+  // Comparisons use the value
+  friend FUNC bool operator<(const Dual& a, const Dual& b){ return a.v<b.v; }
+  friend FUNC bool operator<(const Dual& a, T b){ return a.v<b; }
+  friend FUNC bool operator<(T a, const Dual& b){ return a<b.v; }
+  friend FUNC bool operator>(const Dual& a, const Dual& b){ return a.v>b.v; }
+  friend FUNC bool operator>(const Dual& a, T b){ return a.v>b; }
+  friend FUNC bool operator>(T a, const Dual& b){ return a>b.v; }
+  friend FUNC bool operator<=(const Dual& a, const Dual& b){ return a.v<=b.v; }
+  friend FUNC bool operator<=(const Dual& a, T b){ return a.v<=b; }
+  friend FUNC bool operator<=(T a, const Dual& b){ return a<=b.v; }
+  friend FUNC bool operator>=(const Dual& a, const Dual& b){ return a.v>=b.v; }
+  friend FUNC bool operator>=(const Dual& a, T b){ return a.v>=b; }
+  friend FUNC bool operator>=(T a, const Dual& b){ return a>=b.v; }
+  friend FUNC bool operator==(const Dual& a, const Dual& b){ return a.v==b.v; }
+  friend FUNC bool operator==(const Dual& a, T b){ return a.v==b; }
+  friend FUNC bool operator==(T a, const Dual& b){ return a==b.v; }
+  friend FUNC bool operator!=(const Dual& a, const Dual& b){ return a.v!=b.v; }
+  friend FUNC bool operator!=(const Dual& a, T b){ return a.v!=b; }
+  friend FUNC bool operator!=(T a, const Dual& b){ return a!=b.v; }
+};
+
+// f(x) with f(x.v)=value and f'(x.v)=derivative: chain rule
+template <typename T>
+FUNC Dual<T> chain_dual(const Dual<T>& x, T value, T derivative){
+  Dual<T> r;
+  r.v=value;
+  for(int i=0;i<NPARAMS;i++) r.d[i]=derivative*x.d[i];
+  return r;
+}
+
+template <typename T>
+FUNC Dual<T> exp_gpu(const Dual<T>& x){
+  T e=(T)exp_gpu(x.v);
+  return chain_dual(x,e,e);
+}
+
+template <typename T>
+FUNC Dual<T> log_gpu(const Dual<T>& x){
+  return chain_dual(x,(T)log_gpu(x.v),(T)1.0/x.v);
+}
+
+template <typename T>
+FUNC Dual<T> fabs_gpu(const Dual<T>& x){
+  return (x.v<(T)0.0) ? -x : x;
+}
+
+template <typename T>
+FUNC Dual<T> sin_gpu(const Dual<T>& x){
+  return chain_dual(x,(T)sin_gpu(x.v),(T)cos_gpu(x.v));
+}
+
+template <typename T>
+FUNC Dual<T> cos_gpu(const Dual<T>& x){
+  return chain_dual(x,(T)cos_gpu(x.v),-(T)sin_gpu(x.v));
+}
+
+template <typename T>
+FUNC Dual<T> tan_gpu(const Dual<T>& x){
+  T t=(T)tan_gpu(x.v);
+  return chain_dual(x,t,(T)1.0+t*t);
+}
+
+template <typename T>
+FUNC Dual<T> atan_gpu(const Dual<T>& x){
+  return chain_dual(x,(T)atan_gpu(x.v),(T)1.0/((T)1.0+x.v*x.v));
+}
+
+template <typename T>
+FUNC Dual<T> sqrt_gpu(const Dual<T>& x){
+  T s=(T)sqrt_gpu(x.v);
+  return chain_dual(x,s,(T)0.5/s);
+}
+
+template <typename T>
+FUNC Dual<T> acos_gpu(const Dual<T>& x){
+  return chain_dual(x,(T)acos_gpu(x.v),-(T)1.0/(T)sqrt_gpu((T)1.0-x.v*x.v));
+}
+
+template <typename T>
+FUNC Dual<T> atan2_gpu(const Dual<T>& y, const Dual<T>& x){
+  Dual<T> r;
+  T inv=(T)1.0/(x.v*x.v+y.v*y.v);
+  r.v=(T)atan2_gpu(y.v,x.v);
+  for(int i=0;i<NPARAMS;i++) r.d[i]=(x.v*y.d[i]-y.v*x.d[i])*inv;
+  return r;
+}
+
+// x^y = exp(y*log(x)). The derivative with respect to x does not need log(x), so negative bases with integer exponents work
+template <typename T>
+FUNC Dual<T> pow_gpu(const Dual<T>& x, const Dual<T>& y){
+  Dual<T> r;
+  r.v=(T)pow_gpu(x.v,y.v);
+  T dx=y.v*(T)pow_gpu(x.v,y.v-(T)1.0);
+  T dy=(T)0.0;
+  bool depends_y=false;
+  for(int i=0;i<NPARAMS;i++) depends_y= depends_y || (y.d[i]!=(T)0.0);
+  if(depends_y) dy=r.v*(T)log_gpu(x.v);
+  for(int i=0;i<NPARAMS;i++) r.d[i]=dx*x.d[i]+dy*y.d[i];
+  return r;
+}
+template <typename T>
+FUNC Dual<T> pow_gpu(const Dual<T>& x, T y){
+  return chain_dual(x,(T)pow_gpu(x.v,y),y*(T)pow_gpu(x.v,y-(T)1.0));
+}
+
+template <typename T>
+FUNC Dual<T> min_gpu(const Dual<T>& x1, const Dual<T>& x2){
+  return (x2.v<x1.v) ? x2 : x1;
+}
+
+template <typename T>
+FUNC Dual<T> max_gpu(const Dual<T>& x1, const Dual<T>& x2){
+  return (x2.v>x1.v) ? x2 : x1;
+}
+
+// libm names, used by some helper functions of the models
+template <typename T> FUNC Dual<T> exp(const Dual<T>& x){ return exp_gpu(x); }
+template <typename T> FUNC Dual<T> log(const Dual<T>& x){ return log_gpu(x); }
+template <typename T> FUNC Dual<T> sqrt(const Dual<T>& x){ return sqrt_gpu(x); }
+template <typename T> FUNC Dual<T> sin(const Dual<T>& x){ return sin_gpu(x); }
+template <typename T> FUNC Dual<T> cos(const Dual<T>& x){ return cos_gpu(x); }
+template <typename T> FUNC Dual<T> atan(const Dual<T>& x){ return atan_gpu(x); }
+template <typename T> FUNC Dual<T> acos(const Dual<T>& x){ return acos_gpu(x); }
+template <typename T> FUNC Dual<T> fabs(const Dual<T>& x){ return fabs_gpu(x); }
+
+/**
+ * Type used by the helper functions of a model that are always evaluated in double precision: double for the values, Dual<double> for the dual numbers
+ */
+template <typename T>
+struct double_precision{ typedef double type; };
+template <typename T>
+struct double_precision< Dual<T> >{ typedef Dual<double> type; };
+
+// Derivatives of the predicted signal with respect to all the parameters, in a single evaluation of Predicted_Signal with dual numbers
+template <int CFP_SIZE, int FIXP_SIZE, typename T>
+FUNC void autodiff(T* P,
+		   T* CFP,
+		   T* FixP,
+		   T* derivatives)
+{
+  Dual<T> dual_P[NPARAMS];
+  Dual<T> dual_CFP[(CFP_SIZE>0)?CFP_SIZE:1];
+  Dual<T> dual_FixP[(FIXP_SIZE>0)?FIXP_SIZE:1];
+  for(int i=0;i<NPARAMS;i++){
+    dual_P[i]=Dual<T>::variable(P[i],i);
+  }
+  for(int i=0;i<CFP_SIZE;i++){
+    dual_CFP[i]=Dual<T>(CFP[i]);
+  }
+  for(int i=0;i<FIXP_SIZE;i++){
+    dual_FixP[i]=Dual<T>(FixP[i]);
+  }
+  Dual<T> signal=Predicted_Signal(NPARAMS,dual_P,dual_CFP,dual_FixP);
+  for(int i=0;i<NPARAMS;i++){
+    derivatives[i]=signal.d[i];
+  }
+}
+
+#endif
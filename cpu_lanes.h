@@ -0,0 +1,207 @@
+#ifndef CUDIMOT_CPU_LANES_H_INCLUDED
+#define CUDIMOT_CPU_LANES_H_INCLUDED
+
+/*  cpu_lanes.h
+
+    Evaluation of the model functions for several voxels at once on the CPU, one voxel per SIMD lane
+
+    The values of a batch of CPU_LANES voxels are stored as structure-of-arrays: value[i][lane]. The loops over the lanes are vectorized by the compiler when the model functions are branch-free (see MODEL_CPU_LANES below): Predicted_Signal and Signal_And_Derivatives are inlined in the loop, so the same measurement is evaluated for all the voxels of the batch with vector instructions. All the lanes are always computed, the lanes that are not active (converged, or beyond the last voxel of the part) are masked when the results are used. Every lane executes the same instructions, so the result of a voxel does not depend on the other voxels of the batch.
+
+    The loops that copy a lane to a private array (the model functions take a pointer to the parameters) use "#pragma GCC ivdep": with "#pragma omp simd" GCC privatizes the array per lane and does not vectorize the loop. The rest of the loops use "#pragma omp simd" (flag -fopenmp-simd). The model and math functions must be inlined (not libm calls, see functions_host.h) for these loops to be vectorized, so these functions are flattened.
+
+    It must be included after functions_gpu.h, modelparameters.h and modelfunctions.h
+
+    agent
+
+    Copyright (C) 2026 University of Oxford  */
+
+/*  CCOPYRIGHT  */
+
+#ifndef CPU_LANES
+#define CPU_LANES 8 // Voxels per batch: 8 fills AVX2 (float) and AVX-512 (double) registers, use 16 for AVX-512 in single precision
+#endif
+
+// Models whose functions have data-dependent branches, loops or libm calls (e.g. NODDI) are not vectorized by the compiler ("control flow in loop" with -fopt-info-vec-missed): the lanes are evaluated one after the other and only add copies. Such a model sets MODEL_CPU_LANES in modelparameters.h, usually 1, which overrides the CPU_LANES of the Makefile
+#ifdef MODEL_CPU_LANES
+#undef CPU_LANES
+#define CPU_LANES MODEL_CPU_LANES
+#endif
+
+namespace Cudimot{
+
+  /**
+   * Copies the values of one lane to an array
+   * @param lanes Values of all the lanes [n][CPU_LANES]
+   * @param n Number of values per lane
+   * @param lane Lane to copy
+   * @param values Output array with n values
+   */
+  template <typename T>
+  inline void get_lane(T lanes[][CPU_LANES], int n, int lane, T* values){
+    for(int i=0;i<n;i++){
+      values[i]=lanes[i][lane];
+    }
+  }
+
+  /**
+   * Copies an array to the values of one lane
+   */
+  template <typename T>
+  inline void set_lane(T lanes[][CPU_LANES], int n, int lane, const T* values){
+    for(int i=0;i<n;i++){
+      lanes[i][lane]=values[i];
+    }
+  }
+
+  /**
+   * @return true if any lane is active
+   */
+  inline bool any_lane(const bool* active){
+    for(int l=0;l<CPU_LANES;l++){
+      if(active[l]) return true;
+    }
+    return false;
+  }
+
+  /**
+   * Per-voxel precomputation of the model (see voxel_cache.h) for all the lanes. Called once each time the parameters change
+   * @param params Parameters of the model [NPARAMS][CPU_LANES]
+   * @param FixP Fixed parameters of the voxel of each lane
+   * @param cache Output: values precomputed for each lane [CACHE_SIZE][CPU_LANES]
+   */
+  template <typename T>
+  inline void __attribute__((flatten)) Prepare_Voxel_lanes(T params[][CPU_LANES], T* const* FixP, T cache[][CPU_LANES]){
+    #pragma GCC ivdep
+    for(int l=0;l<CPU_LANES;l++){
+      T p[NPARAMS];
+      T c[CACHE_SIZE];
+      for(int k=0;k<NPARAMS;k++){
+	p[k]=params[k][l];
+      }
+      Prepare_Voxel(p,FixP[l],c);
+      for(int k=0;k<CACHE_SIZE;k++){
+	cache[k][l]=c[k];
+      }
+    }
+  }
+
+  /**
+   * Predicted signal of one measurement for all the lanes
+   * @param params Parameters of the model [NPARAMS][CPU_LANES]
+   * @param cache Values precomputed by Prepare_Voxel_lanes [CACHE_SIZE][CPU_LANES]
+   * @param CFP Common fixed parameters of the measurement
+   * @param FixP Fixed parameters of the voxel of each lane
+   * @param signal Output: predicted signal of each lane
+   */
+  template <typename T>
+  inline void __attribute__((flatten)) Predicted_Signal_lanes(T params[][CPU_LANES], T cache[][CPU_LANES], T* CFP, T* const* FixP, T* signal){
+    #pragma GCC ivdep
+    for(int l=0;l<CPU_LANES;l++){
+      T p[NPARAMS];
+      T c[CACHE_SIZE];
+      for(int k=0;k<NPARAMS;k++){
+	p[k]=params[k][l];
+      }
+      for(int k=0;k<CACHE_SIZE;k++){
+	c[k]=cache[k][l];
+      }
+      signal[l]=Predicted_Signal(NPARAMS,p,CFP,FixP[l],c);
+    }
+  }
+
+  /**
+   * Predicted signal and its partial derivatives of one measurement for all the lanes (see signal_derivatives.h)
+   * @param signal Output: predicted signal of each lane
+   * @param derivatives Output: derivative of each parameter for each lane [NPARAMS][CPU_LANES]
+   */
+  template <typename T>
+  inline void __attribute__((flatten)) Signal_And_Derivatives_lanes(T params[][CPU_LANES], T cache[][CPU_LANES], T* CFP, T* const* FixP, T* signal, T derivatives[][CPU_LANES]){
+    #pragma GCC ivdep
+    for(int l=0;l<CPU_LANES;l++){
+      T p[NPARAMS];
+      T c[CACHE_SIZE];
+      T d[NPARAMS];
+      for(int k=0;k<NPARAMS;k++){
+	p[k]=params[k][l];
+      }
+      for(int k=0;k<CACHE_SIZE;k++){
+	c[k]=cache[k][l];
+      }
+      T s;
+      Signal_And_Derivatives(NPARAMS,p,CFP,FixP[l],c,s,d);
+      signal[l]=s;
+      for(int k=0;k<NPARAMS;k++){
+	derivatives[k][l]=d[k];
+      }
+    }
+  }
+
+#if NLINEAR>0
+  /**
+   * Solves the linear parameters of the model (see linear_parameters.h) for the current nonlinear parameters of the lanes in mask, with one pass over the measurements
+   * @param measurements Measurements of the lanes [nmeas][CPU_LANES]
+   * @param params Parameters of the model [NPARAMS][CPU_LANES]. The linear parameters of the lanes in mask are modified
+   * @param mask Lanes to solve
+   * @param solved Output: true for the lanes whose linear parameters have been modified
+   */
+  template <typename T>
+  inline void __attribute__((flatten)) Solve_Linear_lanes(int nmeas, int CFP_Tsize, T* measurements, T params[][CPU_LANES], T* CFP, T* const* FixP, const bool* mask, bool* solved,
+							  const int* bound_types, const float* bounds_min, const float* bounds_max){
+    T BtB[NLINEAR*NLINEAR][CPU_LANES];
+    T Bty[NLINEAR][CPU_LANES];
+    T cache[CACHE_SIZE][CPU_LANES];
+    Prepare_Voxel_lanes(params,FixP,cache);
+    for(int j=0;j<NLINEAR;j++){
+      for(int l=0;l<CPU_LANES;l++){
+	Bty[j][l]=(T)0.0;
+      }
+      for(int k=0;k<NLINEAR;k++){
+	for(int l=0;l<CPU_LANES;l++){
+	  BtB[j*NLINEAR+k][l]=(T)0.0;
+	}
+      }
+    }
+    for(int idMeasurement=0;idMeasurement<nmeas;idMeasurement++){
+      T* myCFP = &CFP[idMeasurement*CFP_Tsize];
+      T* mymeas = &measurements[idMeasurement*CPU_LANES];
+      #pragma GCC ivdep
+      for(int l=0;l<CPU_LANES;l++){
+	T p[NPARAMS];
+	T c[CACHE_SIZE];
+	T basis[NLINEAR];
+	for(int k=0;k<NPARAMS;k++){
+	  p[k]=params[k][l];
+	}
+	for(int k=0;k<CACHE_SIZE;k++){
+	  c[k]=cache[k][l];
+	}
+	Linear_Basis(NPARAMS,p,myCFP,FixP[l],c,basis);
+	for(int j=0;j<NLINEAR;j++){
+	  for(int k=j;k<NLINEAR;k++){
+	    BtB[j*NLINEAR+k][l]+=basis[j]*basis[k];
+	  }
+	  Bty[j][l]+=basis[j]*mymeas[l];
+	}
+      }
+    }
+    for(int l=0;l<CPU_LANES;l++){
+      solved[l]=false;
+      if(!mask[l]) continue;
+      T myBtB[NLINEAR*NLINEAR];
+      T myBty[NLINEAR];
+      T coeffs[NLINEAR];
+      get_lane(BtB,NLINEAR*NLINEAR,l,myBtB);
+      get_lane(Bty,NLINEAR,l,myBty);
+      if(nnls_linear(myBtB,myBty,coeffs)){
+	T p[NPARAMS];
+	get_lane(params,NPARAMS,l,p);
+	set_linear_parameters(coeffs,p,bound_types,bounds_min,bounds_max);
+	set_lane(params,NPARAMS,l,p);
+	solved[l]=true;
+      }
+    }
+  }
+#endif
+}
+
+#endif
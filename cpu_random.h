@@ -0,0 +1,94 @@
+#ifndef CUDIMOT_CPU_RANDOM_H_INCLUDED
+#define CUDIMOT_CPU_RANDOM_H_INCLUDED
+
+/*  cpu_random.h
+
+    Counter-based random numbers for the fitting routines that run on the CPU (--backend=cpu)
+
+    Philox4x32-10 (Salmon et al., Parallel random numbers: as easy as 1, 2, 3. SC 2011) has no state: the numbers are a function of a key and a counter. The MCMC keys the generator with the seed and the index of the voxel in the whole dataset, and uses the iteration, the proposal and the chain (--nchains) as the counter. The samples of a voxel are therefore the same whatever the number of threads, the number of parts (--nParts) or the size of the parts.
+
+    agent
+
+    Copyright (C) 2026 University of Oxford  */
+
+/*  CCOPYRIGHT  */
+
+#include <stdint.h>
+#include <math.h>
+
+namespace Cudimot{
+
+  /**
+   * Philox4x32 with 10 rounds
+   * @param ctr Counter (4 words)
+   * @param key Key (2 words)
+   * @param out 4 random words
+   */
+  inline void philox4x32_10(const uint32_t ctr[4], const uint32_t key[2], uint32_t out[4]){
+    const uint32_t M0=0xD2511F53, M1=0xCD9E8D57;
+    const uint32_t W0=0x9E3779B9, W1=0xBB67AE85;
+    uint32_t c0=ctr[0], c1=ctr[1], c2=ctr[2], c3=ctr[3];
+    uint32_t k0=key[0], k1=key[1];
+    for(int round=0;round<10;round++){
+      if(round>0){
+	k0+=W0;
+	k1+=W1;
+      }
+      uint64_t p0=(uint64_t)M0*c0;
+      uint64_t p1=(uint64_t)M1*c2;
+      uint32_t hi0=(uint32_t)(p0>>32), lo0=(uint32_t)p0;
+      uint32_t hi1=(uint32_t)(p1>>32), lo1=(uint32_t)p1;
+      c0=hi1^c1^k0;
+      c1=lo1;
+      c2=hi0^c3^k1;
+      c3=lo0;
+    }
+    out[0]=c0; out[1]=c1; out[2]=c2; out[3]=c3;
+  }
+
+  /**
+   * Uniform number in (0,1) from a 32 bits word. It never returns 0 or 1
+   */
+  inline double uniform_from_word(uint32_t w){
+    return ((double)w+0.5)*(1.0/4294967296.0);
+  }
+
+  /**
+   * Random numbers of one voxel
+   */
+  class voxel_random{
+
+  private:
+    uint32_t key[2];
+    uint32_t chain;
+
+  public:
+    /**
+     * @param seed Seed given by the user (--seed)
+     * @param voxel Index of the voxel in the whole dataset (mask order)
+     * @param chain Chain of the voxel (several chains per voxel: --nchains). The numbers of the chain 0 do not depend on the number of chains
+     */
+    voxel_random(int seed, long voxel, int chain=0){
+      key[0]=(uint32_t)seed;
+      key[1]=(uint32_t)voxel;
+      this->chain=(uint32_t)chain;
+    }
+
+    /**
+     * Numbers needed by one proposal of the Metropolis algorithm: a standard normal (Box-Muller) and a uniform for the acceptance test
+     * @param iter Iteration of the chain, counting the burn-in iterations
+     * @param slot Proposal inside the iteration (0: tau, 1+p: parameter p)
+     */
+    void draw(long iter, int slot, double& normal, double& uniform) const{
+      uint32_t ctr[4]={(uint32_t)iter,(uint32_t)((uint64_t)iter>>32),(uint32_t)slot,chain};
+      uint32_t r[4];
+      philox4x32_10(ctr,key,r);
+      double u1=uniform_from_word(r[0]);
+      double u2=uniform_from_word(r[1]);
+      normal=sqrt(-2.0*log(u1))*cos(6.283185307179586*u2);
+      uniform=uniform_from_word(r[2]);
+    }
+  };
+}
+
+#endif
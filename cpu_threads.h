@@ -0,0 +1,206 @@
+#ifndef CUDIMOT_CPU_THREADS_H_INCLUDED
+#define CUDIMOT_CPU_THREADS_H_INCLUDED
+
+/*  cpu_threads.h
+
+    Distribution of the voxels of a part among CPU threads, used by the fitting routines when they run on the CPU (--backend=cpu)
+
+    The convergence of the fitting routines varies a lot between voxels, so a static partition leaves cores idle at the end of each part. Each thread starts with a contiguous range of voxels and takes small batches from the front of it. When its range is empty, the thread steals the back half of the range of another thread.
+
+    agent
+
+    Copyright (C) 2026 University of Oxford  */
+
+/*  CCOPYRIGHT  */
+
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include "utils/log.h"
+#if defined(__SSE2__)
+#include <xmmintrin.h>
+#endif
+
+namespace Cudimot{
+
+  /**
+   * @param requested Number of threads requested by the user (--nthreads). 0 means all the available cores
+   * @return Number of CPU threads to use
+   */
+  inline int cpu_nthreads(int requested){
+    if(requested>0) return requested;
+    int ncores=std::thread::hardware_concurrency();
+    if(ncores<1) ncores=1;
+    return ncores;
+  }
+
+  /**
+   * Timing of the threads in a call to parallel_voxels
+   */
+  struct cpu_threads_stats{
+    double wall;                 // Elapsed time of the whole call (seconds)
+    std::vector<double> busy;    // Time each thread spent processing voxels (seconds)
+    std::vector<int> voxels;     // Voxels processed by each thread
+    std::vector<int> steals;     // Ranges stolen by each thread
+  };
+
+  /**
+   * Flushes subnormal numbers to zero (flags FTZ and DAZ of x86) in the current thread while the object exists. Trial steps of the fitting routines produce subnormal values (e.g. exp(-700)), and each operation with them costs around a hundred cycles
+   */
+  class cpu_flush_subnormals{
+#if defined(__SSE2__)
+    unsigned int saved;
+  public:
+    cpu_flush_subnormals(){
+      saved=_mm_getcsr();
+      _mm_setcsr(saved|0x8040);
+    }
+    ~cpu_flush_subnormals(){
+      _mm_setcsr(saved);
+    }
+#endif
+  };
+
+  /**
+   * Range of voxels [begin,end) still pending in the queue of one thread
+   */
+  struct cpu_voxel_queue{
+    std::mutex lock;
+    int begin;
+    int end;
+  };
+
+  /**
+   * Processes nvox voxels with a pool of threads. Each thread calls work(next) once. The function next(first,last) gives the thread small batches of consecutive voxels [first,last) taken from its own queue, and steals from the other queues when its queue is empty. It returns false when there are no voxels left. The fitting routines that iterate several voxels in lockstep take new voxels as soon as some of them have finished
+   * @param nvox Number of voxels to process
+   * @param batch Number of voxels taken by a thread each time
+   * @param nthreads Number of threads
+   * @param work Function that processes the voxels returned by next
+   * @return Busy and idle time of each thread
+   */
+  template <typename Work>
+  cpu_threads_stats parallel_voxel_stream(int nvox, int batch, int nthreads, Work work){
+    typedef std::chrono::steady_clock clock;
+
+    cpu_threads_stats stats;
+    stats.busy.assign(nthreads,0.0);
+    stats.voxels.assign(nthreads,0);
+    stats.steals.assign(nthreads,0);
+
+    std::vector<cpu_voxel_queue> queues(nthreads);
+    for(int t=0;t<nthreads;t++){
+      queues[t].begin=(int)(((long)nvox*t)/nthreads);
+      queues[t].end=(int)(((long)nvox*(t+1))/nthreads);
+    }
+
+    auto worker = [&](int id){
+      cpu_flush_subnormals ftz;
+      cpu_voxel_queue& own=queues[id];
+      auto next = [&](int& first, int& last) -> bool {
+	while(true){
+	  first=0;
+	  last=0;
+	  {
+	    std::lock_guard<std::mutex> guard(own.lock);
+	    if(own.begin<own.end){
+	      first=own.begin;
+	      last=first+batch;
+	      if(last>own.end) last=own.end;
+	      own.begin=last;
+	    }
+	  }
+	  if(first<last){
+	    stats.voxels[id]+=last-first;
+	    return true;
+	  }
+	  // Own queue is empty: steal the back half of another queue
+	  int stolen_begin=0, stolen_end=0;
+	  for(int k=1;k<nthreads && stolen_begin==stolen_end;k++){
+	    cpu_voxel_queue& victim=queues[(id+k)%nthreads];
+	    std::lock_guard<std::mutex> guard(victim.lock);
+	    int remaining=victim.end-victim.begin;
+	    if(remaining>0){
+	      int half=remaining/2;
+	      if(half<batch) half=remaining;
+	      stolen_begin=victim.end-half;
+	      stolen_end=victim.end;
+	      victim.end=stolen_begin;
+	    }
+	  }
+	  if(stolen_begin==stolen_end) return false; // nothing left
+	  stats.steals[id]++;
+	  std::lock_guard<std::mutex> guard(own.lock);
+	  own.begin=stolen_begin;
+	  own.end=stolen_end;
+	}
+      };
+      clock::time_point start=clock::now();
+      work(next);
+      stats.busy[id]=std::chrono::duration<double>(clock::now()-start).count();
+    };
+
+    clock::time_point start=clock::now();
+    std::vector<std::thread> pool;
+    for(int t=1;t<nthreads;t++){
+      pool.push_back(std::thread(worker,t));
+    }
+    worker(0); // the calling thread also works
+    for(unsigned int t=0;t<pool.size();t++){
+      pool[t].join();
+    }
+    stats.wall=std::chrono::duration<double>(clock::now()-start).count();
+    return stats;
+  }
+
+  /**
+   * Processes nvox voxels with a pool of threads. Each thread calls work(first,last) with small batches of consecutive voxels [first,last) taken from its own queue, and steals from the other queues when its queue is empty
+   * @param nvox Number of voxels to process
+   * @param batch Number of voxels taken by a thread each time
+   * @param nthreads Number of threads
+   * @param work Function that processes the voxels of a batch
+   * @return Busy and idle time of each thread
+   */
+  template <typename Work>
+  cpu_threads_stats parallel_voxels(int nvox, int batch, int nthreads, Work work){
+    return parallel_voxel_stream(nvox,batch,nthreads,[&](auto& next){
+	int first, last;
+	while(next(first,last)){
+	  work(first,last);
+	}
+      });
+  }
+
+  /**
+   * Prints a summary of the busy and idle time of the threads, and writes the values of each thread to the log file
+   * @param method Name of the fitting routine
+   * @param stats Timing returned by parallel_voxels
+   */
+  inline void report_cpu_threads(const std::string& method, const cpu_threads_stats& stats){
+    int nthreads=stats.busy.size();
+    double min_busy=stats.wall, max_busy=0.0, sum_busy=0.0;
+    int total_steals=0;
+    for(int t=0;t<nthreads;t++){
+      if(stats.busy[t]<min_busy) min_busy=stats.busy[t];
+      if(stats.busy[t]>max_busy) max_busy=stats.busy[t];
+      sum_busy+=stats.busy[t];
+      total_steals+=stats.steals[t];
+    }
+    double idle=stats.wall*nthreads-sum_busy;
+    double idle_percent=0.0;
+    if(stats.wall>0) idle_percent=100.0*idle/(stats.wall*nthreads);
+
+    std::streamsize precision=std::cout.precision();
+    std::cout << method << " on " << nthreads << " CPU threads: " << stats.wall << " seconds. Busy time per thread (min/mean/max): " << min_busy << "/" << sum_busy/nthreads << "/" << max_busy << " seconds. Idle: " << std::fixed << std::setprecision(1) << idle_percent << std::defaultfloat << std::setprecision(precision) << "%. Stolen ranges: " << total_steals << std::endl;
+
+    Utilities::Log& logger = Utilities::LogSingleton::getInstance();
+    logger.str() << method << " on the CPU: " << stats.wall << " seconds" << std::endl;
+    for(int t=0;t<nthreads;t++){
+      logger.str() << "  Thread " << t << ": busy " << stats.busy[t] << " s, idle " << stats.wall-stats.busy[t] << " s, " << stats.voxels[t] << " voxels, " << stats.steals[t] << " stolen ranges" << std::endl;
+    }
+  }
+}
+
+#endif
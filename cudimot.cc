@@ -18,6 +18,7 @@
 #include "GridSearch.h"
 #include "Levenberg_Marquardt.h"
 #include "MCMC.h"
+#include "tables.h"
 
 using namespace Cudimot;
 
@@ -36,13 +37,27 @@ int main(int argc, char *argv[]){
   opts.parse_command_line(argc,argv,logger);
   srand(opts.seed.value());  //randoms seed
   
-  init_gpu();
-
   // Check if GridSearch, MCMC or LevMar flags
   if(opts.gridSearch.value()=="" && opts.no_LevMar.value() && !opts.runMCMC.value()){
     cerr << "CUDIMOT Error: You must select at least one method to fit the model: GridSearch, Levenberg_Marquardt or MCMC" << endl;
     exit(-1);
   }
+  if(opts.multistart.value()>1 && (opts.gridSearch.value()=="" || opts.no_LevMar.value())){
+    cout << "The starting points of Levenberg-Marquardt are the best combinations of GridSearch: --multistart is ignored without GridSearch and Levenberg-Marquardt" << endl;
+  }
+
+  // The CUDA runtime is only initialised if the fitting routines run on the GPU (--backend)
+  init_backend();
+
+  // Interpolation tables of the special functions of the model (--tables)
+  init_tables();
+
+  // Closed-form solution of the linear parameters of the model (--varpro, see linear_parameters.h)
+#if !defined(NLINEAR) || NLINEAR==0
+  if(opts.varpro.value()){
+    cout << "The model does not have linear parameters: --varpro is ignored" << endl;
+  }
+#endif
 
   // Encapsulate dMRI data
   dMRI_Data<MyType> data;
@@ -59,6 +74,7 @@ int main(int argc, char *argv[]){
 
   GridSearch<MyType> methodGridSearch(model.getNGridParams(),
   				      model.getGridParams(),
+  				      model.getGridSizes(),
   				      model.getGridCombs(),
   				      model.getGrid(),
 				      model.getBound_types(),
@@ -92,7 +108,8 @@ int main(int argc, char *argv[]){
 			   params.getTsize_FixP(),
 			   meas,parameters_part,
 			   params.getCFP(),
-			   params.getFixP_part(part));
+			   params.getFixP_part(part),
+			   params.getNstarts(),params.getStarts());
     }
 
     if(!opts.no_LevMar.value()){
@@ -101,7 +118,8 @@ int main(int argc, char *argv[]){
 		   params.getTsize_FixP(),
 		   meas,parameters_part,
 		   params.getCFP(),
-		   params.getFixP_part(part));
+		   params.getFixP_part(part),
+		   params.getNstarts(),params.getStarts());
     }
     
     if(!opts.runMCMC.value()){
@@ -115,7 +133,10 @@ int main(int argc, char *argv[]){
 		     params.getCFP(),
 		     params.getFixP_part(part),
 		     params.getSamples(),
-		     params.getTauSamples());
+		     params.getTauSamples(),
+		     params.getSummary(),
+		     params.getConvergence(),
+		     data.getFirstVoxelPart(part));
       
       params.copyParamsPartGPU2Host(part);
       params.copySamplesPartGPU2Host(part);
@@ -127,6 +148,10 @@ int main(int argc, char *argv[]){
     params.copyParams2Samples();
   }
   params.writeSamples();
+  if(opts.runMCMC.value() && opts.checkpoint.value()>0){
+    // the part has finished, the checkpoint is not needed
+    remove(checkpoint_file().data());
+  }
   
   gettimeofday(&t2,NULL);
   time=timeval_diff(&t2,&t1);
@@ -17,5 +17,8 @@
 enum bound{NOBOUNDS,BMIN,BMAX,BMINMAX};
 enum prior{NOPRIOR,GAUSSPRIOR,GAMMAPRIOR,ARDPRIOR,SINPRIOR,CUSTOM};
 
+// Convergence diagnostics of each voxel with several chains of MCMC (--nchains): split R-hat, effective sample size and iterations of burn-in
+#define MCMC_NDIAGNOSTICS 3
+
 #endif
 
@@ -41,6 +41,15 @@ namespace Cudimot {
     Option<int> sampleevery;
     Option<int> updateproposalevery;
     Option<bool> no_updateproposal;
+    Option<std::string> sampler;
+    Option<int> hmc_steps;
+    Option<int> nuts_depth;
+    Option<int> nchains;
+    Option<float> rhat;
+    Option<float> min_ess;
+    Option<bool> summary_only;
+    Option<float> checkpoint;
+    Option<bool> resume;
     Option<int> seed;
     Option<bool> no_LevMar;
     Option<bool> no_Marquardt;
@@ -54,8 +63,19 @@ namespace Cudimot {
     Option<std::string> FixP;
     Option<std::string> fixed;
     Option<std::string> init_params;
+    Option<bool> init_tensor;
     Option<std::string> debug;
     Option<bool> BIC_AIC;
+    Option<std::string> backend;
+    Option<int> nthreads;
+    Option<float> tables;
+    Option<bool> validate_tables;
+    Option<bool> varpro;
+    Option<bool> dictionary;
+    Option<std::string> dictionary_dir;
+    Option<int> gridLevels;
+    Option<int> gridKeep;
+    Option<int> multistart;
     FmribOption<std::string> priorsfile;
     
     void parse_command_line(int argc, char** argv,  Log& logger);
@@ -120,6 +140,33 @@ namespace Cudimot {
 	no_updateproposal(std::string("--no_updateproposal"),false,
 		std::string("Do not update the proposal density std during the recording step of MCMC"),
 		false,no_argument),
+	sampler(std::string("--sampler"),std::string("metropolis"),
+		std::string("\tSampler of MCMC: metropolis (a proposal for each parameter in turn), adaptive_block (joint proposals of all the parameters with the covariance learnt during burn-in), hmc or nuts (Hamiltonian Monte Carlo with the derivatives of the model, only with --backend=cpu; each iteration is a whole trajectory, so far fewer iterations are needed, e.g. --bi=500 --nj=500 --se=2). Default metropolis"),
+		false,requires_argument),
+	hmc_steps(std::string("--hmc_steps"),10,
+		std::string("\tNumber of leapfrog steps of each iteration of the hmc sampler (default is 10)"),
+		false,requires_argument),
+	nuts_depth(std::string("--nuts_depth"),8,
+		std::string("\tMaximum depth of the trajectories of the nuts sampler: at most 2^depth leapfrog steps per iteration (default is 8)"),
+		false,requires_argument),
+	nchains(std::string("--nchains"),1,
+		std::string("\tNumber of chains of MCMC per voxel, only with --backend=cpu. With several chains the burn-in of a voxel stops when the chains have converged (--rhat, --min_ess), so --bi is the maximum, and the samples are divided among the chains (default is 1)"),
+		false,requires_argument),
+	rhat(std::string("--rhat"),1.05,
+		std::string("\tMaximum split R-hat of the parameters to stop the burn-in of a voxel with several chains (default is 1.05)"),
+		false,requires_argument),
+	min_ess(std::string("--min_ess"),50,
+		std::string("\tMinimum effective sample size of the parameters, in the last half of the burn-in states of all the chains (one state every --se jumps), to stop the burn-in of a voxel with several chains (default is 50)"),
+		false,requires_argument),
+	summary_only(std::string("--summary_only"),false,
+		std::string("Do not keep the samples of MCMC: write only the mean, the standard deviation and the 2.5%, 50% and 97.5% quantiles of each parameter (Param_N_mean, Param_N_std and Param_N_quantiles), computed while sampling"),
+		false,no_argument),
+	checkpoint(std::string("--checkpoint"),0,
+		std::string("Seconds between checkpoints of MCMC in the directory of the part, to continue the part with --resume if it is stopped. With --backend=cpu the voxels finished are saved. On the GPU the state of the chains (and the samples recorded) is saved, and the part is saved when it finishes (default is 0: no checkpoints)"),
+		false,requires_argument),
+	resume(std::string("--resume"),false,
+		std::string("\tContinue MCMC from the checkpoint of a previous run of the part (--checkpoint) with the same options. The samples are the same than without stopping"),
+		false,no_argument),
 	seed(std::string("--seed"),8219,
 		std::string("\t\tSeed for pseudo random number generator"),
 		false,requires_argument),
@@ -159,12 +206,45 @@ namespace Cudimot {
 	init_params(std::string("--init_params"), std::string(""),
 		std::string("\tFile with a list of NIfTI files for the initialization of the model parameters"),
 		false, requires_argument),
+	init_tensor(std::string("--init_tensor"), false,
+		std::string("\tInitialise the parameters of the model (e.g. S0, orientations, fractions) with a weighted least-squares diffusion tensor fit of each voxel, instead of dtifit"),
+		false, no_argument),
         debug(std::string("--debug"), std::string(""),
 		std::string("\t\tSpecify a voxel for debugging. Some variables at certain steps of the algorithms will be printed (use few iterations)"),
 		false, requires_argument),
 	BIC_AIC(std::string("--BIC_AIC"), false,
 	        std::string("\tCalculate Bayesian and Akaike Information Criteria at the end"),
 		false, no_argument),
+	backend(std::string("--backend"), std::string("auto"),
+	        std::string("\tHardware for the fitting routines: cuda, cpu (multithreaded) or auto (the GPU if there is one, otherwise the CPU). Default auto"),
+		false, requires_argument),
+	nthreads(std::string("--nthreads"),0,
+		std::string("\tNumber of threads of the CPU backend (default is 0: all the available cores)"),
+		false,requires_argument),
+	tables(std::string("--tables"),0,
+		std::string("\tEvaluate the special functions of the model with interpolation tables built at startup, with this maximum relative error (e.g. 1e-6). Default 0: exact routines"),
+		false,requires_argument),
+	validate_tables(std::string("--validate_tables"),false,
+		std::string("Compare the interpolation tables (--tables) against the exact routines at startup"),
+		false,no_argument),
+	varpro(std::string("--varpro"),false,
+		std::string("\tSolve the linear parameters of the model (e.g. S0 and the volume fractions) in closed form in GridSearch and Levenberg-Marquardt. Only the nonlinear parameters are searched and optimised"),
+		false,no_argument),
+	dictionary(std::string("--dictionary"),false,
+		std::string("\tGridSearch with a dictionary of the predicted signals of the grid, computed once: each voxel only needs the dot products of its measurements with the dictionary"),
+		false,no_argument),
+	dictionary_dir(std::string("--dictionary_dir"), std::string(""),
+		std::string("\tDirectory where the dictionary of GridSearch (--dictionary) is saved and read from, identified by a hash of the protocol and the grid"),
+		false, requires_argument),
+	gridLevels(std::string("--gridLevels"),1,
+		std::string("\tCoarse-to-fine GridSearch: a coarse grid (every 2^(L-1) values of each parameter) is evaluated first, and the best combinations of each voxel are refined in L-1 levels (default is 1: all the combinations of the grid)"),
+		false,requires_argument),
+	gridKeep(std::string("--gridKeep"),4,
+		std::string("\tNumber of best combinations of each voxel refined in each level of the coarse-to-fine GridSearch (--gridLevels). Default 4"),
+		false,requires_argument),
+	multistart(std::string("--multistart"),1,
+		std::string("\tRun Levenberg-Marquardt from the k best combinations of GridSearch of each voxel and keep the result with the lowest cost (default is 1: only the best combination)"),
+		false,requires_argument),
 	priorsfile(std::string("--priors"), std::string(""),
 		std::string("\tFile with parameters information (initialization, bounds and priors)"),
 		false, requires_argument),
@@ -187,6 +267,15 @@ namespace Cudimot {
 	options.add(sampleevery);
 	options.add(updateproposalevery);
 	options.add(no_updateproposal);
+	options.add(sampler);
+	options.add(hmc_steps);
+	options.add(nuts_depth);
+	options.add(nchains);
+	options.add(rhat);
+	options.add(min_ess);
+	options.add(summary_only);
+	options.add(checkpoint);
+	options.add(resume);
 	options.add(seed);
 	options.add(gridSearch); 
 	options.add(runMCMC); 
@@ -200,8 +289,19 @@ namespace Cudimot {
 	options.add(FixP);
 	options.add(fixed);
 	options.add(init_params);
+	options.add(init_tensor);
 	options.add(debug);
 	options.add(BIC_AIC);
+	options.add(backend);
+	options.add(nthreads);
+	options.add(tables);
+	options.add(validate_tables);
+	options.add(varpro);
+	options.add(dictionary);
+	options.add(dictionary_dir);
+	options.add(gridLevels);
+	options.add(gridKeep);
+	options.add(multistart);
 	options.add(priorsfile);
      }
      catch(X_OptionError& e) {
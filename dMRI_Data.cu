@@ -7,6 +7,7 @@
 /* CCOPYRIGHT */
 
 #include "dMRI_Data.h"
+#include "init_gpu.h"
 
 using namespace std;
 
@@ -63,6 +64,28 @@ namespace Cudimot{
     dataM.ReSize(nmeas,nvox);
     in.read((char*)&dataM(1,1),nbytes);
     in.close();
+
+    // Read the index of the first voxel (not present if the parts were generated by an older split_parts)
+    first_voxel=0;
+    string file_first;
+    file_first.append(opts.partsdir.value());
+    file_first.append("/part_");
+    file_first.append(num2str(opts.idPart.value()));
+    file_first.append("/FirstVoxel");
+    in.open(file_first.data(), ios::in | ios::binary);
+    if(in.is_open()){
+      int nv,nm;
+      long nb;
+      Real first;
+      in.read((char*)&nv, 4);
+      in.read((char*)&nm, 4);
+      in.read((char*)&nb, sizeof(long));
+      in.read((char*)&first, sizeof(Real));
+      in.close();
+      first_voxel=int(first);
+    }else if(opts.runMCMC.value()){
+      cerr << "CUDIMOT Warning: File " << file_first << " not found. The checkpoints of MCMC identify the part by its first voxel, and on the CPU the random numbers of each voxel depend on it: they will not be the same if the data is split in a different number of parts" << endl;
+    }
     
     // Data is divided into parts
     nparts=nvox/SIZE_PART;
@@ -86,8 +109,7 @@ namespace Cudimot{
     nvoxFit_part=int(max_nvox/MAX_VOXELS_BLOCK)*MAX_VOXELS_BLOCK;
     if(max_nvox%MAX_VOXELS_BLOCK) nvoxFit_part=nvoxFit_part+MAX_VOXELS_BLOCK;
     meas_host=new T[nvoxFit_part*nmeas];
-    cudaMalloc((void**)&meas_gpu,nvoxFit_part*nmeas*sizeof(T));
-    sync_check("Allocating dMRI_Data on the GPU");
+    allocate_part((void**)&meas_gpu,nvoxFit_part*nmeas*sizeof(T),"Allocating dMRI_Data on the GPU");
   }
   
   template <typename T>
@@ -147,12 +169,16 @@ namespace Cudimot{
     }
     
     // Copy from host to GPU
-    cudaMemcpy(meas_gpu,meas_host,nvoxFit_part*nmeas*sizeof(T),cudaMemcpyHostToDevice);
-    sync_check("Copying dMRI_Data to GPU");
+    copy_host2part(meas_gpu,meas_host,nvoxFit_part*nmeas*sizeof(T),"Copying dMRI_Data to GPU");
     sp=nvoxFit_part; 
     return meas_gpu;
   }
   
+  template <typename T>
+  int dMRI_Data<T>::getFirstVoxelPart(int part) const{
+    return first_voxel+part*size_part;
+  }
+  
   template class dMRI_Data<float>;
   template class dMRI_Data<double>;
 }
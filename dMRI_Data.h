@@ -69,6 +69,11 @@ namespace Cudimot{
      */
     Matrix dataM;
 
+    /**
+     * Index (mask order) of the first voxel of this part of the data (generated in split_parts)
+     */
+    int first_voxel;
+
     /**
      * The number of voxels in a part can be a non-multiple of voxels per block, so some threads could access to non-allocated memory. We use the closest upper multiple. The added voxels will be ignored.
      */
@@ -81,7 +86,7 @@ namespace Cudimot{
     T* meas_host;
     
     /**
-     * Measurements of the voxels in a single part allocated on the GPU
+     * Measurements of the voxels in a single part allocated on the GPU (in host memory with the CPU backend)
      */
     T* meas_gpu;
     
@@ -123,6 +128,12 @@ namespace Cudimot{
      * @return The measurements of a part of the data (on the GPU)
     */
     T* getMeasPart(int part, int &part_size);
+
+    /**
+     * @param part A number to identify a part of the data
+     * @return Index (mask order) in the whole dataset of the first voxel of the part
+     */
+    int getFirstVoxelPart(int part) const;
   };
 }
 
@@ -0,0 +1,350 @@
+/* dictionary.cc
+
+   Dictionary of the predicted signals of the grid of GridSearch, built once per protocol (see dictionary.h).
+
+   This file is compiled with the host compiler (not nvcc), so the model functions are compiled as host functions.
+
+   agent
+
+   Copyright (C) 2026 University of Oxford */
+
+/* CCOPYRIGHT */
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <unistd.h>
+#include "cudimot.h"
+#include "cudimotoptions.h"
+#include "functions_gpu.h"
+#include "modelparameters.h"
+#include "dictionary.h"
+#include "macro_numerical.h"
+#include "modelfunctions.h"
+#include "cpu_threads.h"
+
+using namespace std;
+
+namespace Cudimot{
+
+  // Identifies the files of --dictionary_dir. Change the version if the format changes
+  static const char dictionary_magic[8]={'C','U','D','I','M','O','T','D'};
+#define DICTIONARY_FILE_VERSION 1
+  // Maximum difference between the first atom of a file and the atom computed again
+#define DICTIONARY_FILE_TOLERANCE 1e-4
+
+  template <typename T>
+  Dictionary<T>::Dictionary(int nGP, const int* gP, int gC, const T* g,
+			    const int* bou_types, const float* bou_min, const float* bou_max):
+    nGridParams(nGP),gridParams(gP),gridCombs(gC),grid(g),
+    bound_types(bou_types),bounds_min(bou_min),bounds_max(bou_max),
+    natoms(0),nmeas(0),version(0),file_hash(0)
+  {}
+
+  template <typename T>
+  void Dictionary<T>::predicted_signals(int comb, int CFP_Tsize, const T* CFP, T* signals)
+  {
+    T P[NPARAMS];
+    vector<T> FixP(reference.begin()+NPARAMS,reference.end());
+    FixP.push_back((T)0.0); // not empty without fixed parameters
+    for(int p=0;p<NPARAMS;p++){
+      P[p]=reference[p];
+    }
+    for(int i=0;i<nGridParams;i++){
+      P[gridParams[i]]=grid[comb*nGridParams+i];
+    }
+#ifdef SCALE_PARAM
+    P[SCALE_PARAM]=(T)1.0;
+#endif
+#ifdef SCALE_FIXP
+    FixP[SCALE_FIXP]=(T)1.0;
+#endif
+    T cache[CACHE_SIZE];
+    Prepare_Voxel(P,FixP.data(),cache);
+    for(int m=0;m<nmeas;m++){
+      signals[m]=Predicted_Signal(NPARAMS,P,const_cast<T*>(&CFP[m*CFP_Tsize]),FixP.data(),cache);
+    }
+  }
+
+  template <typename T>
+  void Dictionary<T>::build(int nm, int CFP_Tsize, const T* CFP)
+  {
+    cudimotOptions& opts = cudimotOptions::getInstance();
+    int nthreads=cpu_nthreads(opts.nthreads.value());
+    nmeas=nm;
+
+    // All the combinations are evaluated in parallel and the ones outside the bounds are removed after
+    atoms.assign((size_t)gridCombs*nmeas,(T)0.0);
+    norms.assign(gridCombs,(T)0.0);
+    vector<char> valid(gridCombs,0);
+
+    cpu_threads_stats stats=parallel_voxels(gridCombs,16,nthreads,[&](int first, int last){
+	for(int comb=first;comb<last;comb++){
+	  T P[NPARAMS];
+	  for(int p=0;p<NPARAMS;p++){
+	    P[p]=reference[p];
+	  }
+	  for(int i=0;i<nGridParams;i++){
+	    P[gridParams[i]]=grid[comb*nGridParams+i];
+	  }
+	  bool inside=true;
+	  for(int p=0;p<NPARAMS;p++){
+#ifdef SCALE_PARAM
+	    if(p==SCALE_PARAM) continue; // solved for each voxel
+#endif
+	    if((bound_types[p]==BMIN || bound_types[p]==BMINMAX) && P[p]<bounds_min[p]) inside=false;
+	    if((bound_types[p]==BMAX || bound_types[p]==BMINMAX) && P[p]>bounds_max[p]) inside=false;
+	  }
+	  if(!inside) continue;
+
+	  T* signals=&atoms[(size_t)comb*nmeas];
+	  predicted_signals(comb,CFP_Tsize,CFP,signals);
+	  double norm=0.0;
+	  for(int m=0;m<nmeas;m++){
+	    norm+=(double)signals[m]*signals[m];
+	  }
+	  norm=sqrt(norm);
+	  // The cost of a combination with a NaN signal is never the lowest
+	  if(!std::isfinite(norm)) continue;
+	  if(norm>0.0){
+	    for(int m=0;m<nmeas;m++){
+	      signals[m]=(T)(signals[m]/norm);
+	    }
+	  }
+	  norms[comb]=(T)norm;
+	  valid[comb]=1;
+	}
+      });
+
+    natoms=0;
+    combs.clear();
+    for(int comb=0;comb<gridCombs;comb++){
+      if(!valid[comb]) continue;
+      if(natoms!=comb){
+	for(int m=0;m<nmeas;m++){
+	  atoms[(size_t)natoms*nmeas+m]=atoms[(size_t)comb*nmeas+m];
+	}
+	norms[natoms]=norms[comb];
+      }
+      combs.push_back(comb);
+      natoms++;
+    }
+    atoms.resize((size_t)natoms*nmeas);
+    atoms.shrink_to_fit();
+    norms.resize(natoms);
+
+    cout << "GridSearch dictionary: " << natoms << " atoms (combinations of the grid inside the bounds) of " << nmeas << " measurements built in " << stats.wall << " seconds" << endl;
+  }
+
+  template <typename T>
+  unsigned long long Dictionary<T>::hash(int CFP_Tsize, const T* CFP)
+  {
+    // FNV-1a
+    unsigned long long h=14695981039346656037ULL;
+    auto add = [&h](const void* data, size_t size){
+      const unsigned char* bytes=(const unsigned char*)data;
+      for(size_t i=0;i<size;i++){
+	h^=bytes[i];
+	h*=1099511628211ULL;
+      }
+    };
+    cudimotOptions& opts = cudimotOptions::getInstance();
+    int header[5]={DICTIONARY_FILE_VERSION,(int)sizeof(T),NPARAMS,nmeas,CFP_Tsize};
+#ifdef SCALE_PARAM
+    header[0]+=100*(SCALE_PARAM+1);
+#endif
+#ifdef SCALE_FIXP
+    header[0]+=10000*(SCALE_FIXP+1);
+#endif
+    float tables=opts.tables.value();
+    add(header,sizeof(header));
+    add(&tables,sizeof(tables));
+    add(CFP,(size_t)nmeas*CFP_Tsize*sizeof(T));
+    add(&nGridParams,sizeof(int));
+    add(gridParams,nGridParams*sizeof(int));
+    add(&gridCombs,sizeof(int));
+    add(grid,(size_t)gridCombs*nGridParams*sizeof(T));
+    add(bound_types,NPARAMS*sizeof(int));
+    add(bounds_min,NPARAMS*sizeof(float));
+    add(bounds_max,NPARAMS*sizeof(float));
+    add(reference.data(),reference.size()*sizeof(T));
+    return h;
+  }
+
+  template <typename T>
+  bool Dictionary<T>::read(const string& file, int CFP_Tsize, const T* CFP)
+  {
+    ifstream in(file.c_str(),ios::in|ios::binary);
+    if(!in.is_open()) return false;
+
+    char magic[8];
+    unsigned long long header_hash;
+    int header[4]; // sizeof(T), natoms, nmeas, gridCombs
+    in.read(magic,8);
+    in.read((char*)&header_hash,sizeof(header_hash));
+    in.read((char*)header,sizeof(header));
+    if(!in || !equal(magic,magic+8,dictionary_magic) || header_hash!=file_hash ||
+       header[0]!=(int)sizeof(T) || header[2]!=nmeas || header[3]!=gridCombs || header[1]<0 || header[1]>gridCombs){
+      cerr << "Warning: the dictionary file " << file << " does not match this protocol and grid. It is built again" << endl;
+      return false;
+    }
+    int n=header[1];
+    vector<int> file_combs(n);
+    vector<T> file_norms(n);
+    vector<T> file_atoms((size_t)n*nmeas);
+    in.read((char*)file_combs.data(),n*sizeof(int));
+    in.read((char*)file_norms.data(),n*sizeof(T));
+    in.read((char*)file_atoms.data(),file_atoms.size()*sizeof(T));
+    if(!in){
+      cerr << "Warning: the dictionary file " << file << " is truncated. It is built again" << endl;
+      return false;
+    }
+
+    if(n>0){
+      // The first atom is computed again: the file must have been written by the same model
+      if(file_combs[0]<0 || file_combs[0]>=gridCombs) return false;
+      vector<T> signals(nmeas);
+      predicted_signals(file_combs[0],CFP_Tsize,CFP,signals.data());
+      double norm=0.0;
+      for(int m=0;m<nmeas;m++){
+	norm+=(double)signals[m]*signals[m];
+      }
+      norm=sqrt(norm);
+      bool same=fabs(norm-(double)file_norms[0])<=DICTIONARY_FILE_TOLERANCE*norm;
+      for(int m=0;m<nmeas && same && norm>0.0;m++){
+	same=fabs(signals[m]/norm-(double)file_atoms[m])<=DICTIONARY_FILE_TOLERANCE;
+      }
+      if(!same){
+	cerr << "Warning: the dictionary file " << file << " was written by a different model. It is built again" << endl;
+	return false;
+      }
+    }
+    natoms=n;
+    combs.swap(file_combs);
+    norms.swap(file_norms);
+    atoms.swap(file_atoms);
+    cout << "GridSearch dictionary: " << natoms << " atoms of " << nmeas << " measurements read from " << file << endl;
+    return true;
+  }
+
+  template <typename T>
+  void Dictionary<T>::write(const string& file)
+  {
+    // Several parts may run at the same time: the file is written with another name and renamed
+    stringstream tmp;
+    tmp << file << ".tmp" << getpid();
+    {
+      ofstream out(tmp.str().c_str(),ios::out|ios::binary|ios::trunc);
+      if(!out.is_open()){
+	cerr << "Warning: the dictionary cannot be written to " << file << endl;
+	return;
+      }
+      int header[4]={(int)sizeof(T),natoms,nmeas,gridCombs};
+      out.write(dictionary_magic,8);
+      out.write((const char*)&file_hash,sizeof(file_hash));
+      out.write((const char*)header,sizeof(header));
+      out.write((const char*)combs.data(),natoms*sizeof(int));
+      out.write((const char*)norms.data(),natoms*sizeof(T));
+      out.write((const char*)atoms.data(),atoms.size()*sizeof(T));
+      if(!out){
+	cerr << "Warning: the dictionary cannot be written to " << file << endl;
+	out.close();
+	remove(tmp.str().c_str());
+	return;
+      }
+    }
+    if(rename(tmp.str().c_str(),file.c_str())!=0){
+      cerr << "Warning: the dictionary cannot be written to " << file << endl;
+      remove(tmp.str().c_str());
+      return;
+    }
+    cout << "GridSearch dictionary written to " << file << endl;
+  }
+
+  template <typename T>
+  bool Dictionary<T>::prepare(int nvox, int nm, int CFP_Tsize, int FixP_Tsize,
+			      const T* CFP, const T* params, const T* FixP)
+  {
+    if(nvox<1) return false;
+
+    // Values of the first voxel. The values in the grid and the scale are not used
+    vector<bool> used(NPARAMS+FixP_Tsize,true);
+    for(int i=0;i<nGridParams;i++){
+      used[gridParams[i]]=false;
+    }
+#ifdef SCALE_PARAM
+    used[SCALE_PARAM]=false;
+#endif
+#ifdef SCALE_FIXP
+    used[NPARAMS+SCALE_FIXP]=false;
+#endif
+    vector<T> values(NPARAMS+FixP_Tsize,(T)0.0);
+    for(int p=0;p<NPARAMS;p++){
+      if(used[p]) values[p]=params[p];
+    }
+    for(int i=0;i<FixP_Tsize;i++){
+      if(used[NPARAMS+i]) values[NPARAMS+i]=FixP[i];
+    }
+
+    for(int v=1;v<nvox;v++){
+      for(int p=0;p<NPARAMS;p++){
+	if(used[p] && params[v*NPARAMS+p]!=values[p]){
+	  cout << "GridSearch: the parameter " << p << " is not in the grid and its initial value is not the same in all the voxels. The dictionary is not used" << endl;
+	  return false;
+	}
+      }
+      for(int i=0;i<FixP_Tsize;i++){
+	if(used[NPARAMS+i] && FixP[v*FixP_Tsize+i]!=values[NPARAMS+i]){
+	  cout << "GridSearch: the fixed parameters are not the same in all the voxels and the model does not define them as a scale (SCALE_FIXP). The dictionary is not used" << endl;
+	  return false;
+	}
+      }
+    }
+
+    if(version>0 && nm==nmeas && values==reference) return true; // built for a previous part
+
+    reference.swap(values);
+    nmeas=nm;
+    version++;
+
+    cudimotOptions& opts = cudimotOptions::getInstance();
+    string file;
+    if(opts.dictionary_dir.value()!=""){
+      file_hash=hash(CFP_Tsize,CFP);
+      stringstream name;
+      name << opts.dictionary_dir.value() << "/dictionary_" << hex << setw(16) << setfill('0') << file_hash << ".bin";
+      file=name.str();
+      if(read(file,CFP_Tsize,CFP)) return true;
+    }
+    build(nm,CFP_Tsize,CFP);
+    if(file!="") write(file);
+    return true;
+  }
+
+  template <typename T>
+  void Dictionary<T>::set_parameters(int atom, T dot, T* params) const
+  {
+    int comb=combs[atom];
+    for(int i=0;i<nGridParams;i++){
+      params[gridParams[i]]=grid[comb*nGridParams+i];
+    }
+#ifdef SCALE_PARAM
+    T scale=(T)0.0;
+    if(norms[atom]>(T)0.0) scale=dot/norms[atom];
+    const int p=SCALE_PARAM;
+    if((bound_types[p]==BMIN || bound_types[p]==BMINMAX) && scale<(T)bounds_min[p]) scale=bounds_min[p];
+    if((bound_types[p]==BMAX || bound_types[p]==BMINMAX) && scale>(T)bounds_max[p]) scale=bounds_max[p];
+    params[p]=scale;
+#endif
+  }
+
+  // Explicit Instantiations of the template
+  template class Dictionary<float>;
+  template class Dictionary<double>;
+}
@@ -0,0 +1,168 @@
+#ifndef CUDIMOT_DICTIONARY_H_INCLUDED
+#define CUDIMOT_DICTIONARY_H_INCLUDED
+
+/*  dictionary.h
+
+    Dictionary of the predicted signals of the grid of GridSearch (--dictionary). The parameters outside the grid usually have the same initial value in all the voxels, so the predicted signal of a combination of the grid is the same for all the voxels. It is computed once per protocol, normalised, and each voxel only needs the dot products of its measurements with the normalised signals (atoms). The cost of a combination is |y|^2 - score, with:
+
+      score = 2*S*norm*dot - S^2*norm^2
+
+    where dot is the dot product of the measurements y with the atom, norm the norm of the predicted signal and S the scale of the voxel. A model can define in modelparameters.h the parameter that multiplies the predicted signal:
+
+      #define SCALE_PARAM 0 // Id of the parameter that scales the signal (e.g. S0)
+      #define SCALE_FIXP 0 // or id of the fixed parameter that scales the signal (e.g. S0 in NODDI)
+
+    With SCALE_FIXP, S is the fixed parameter of the voxel and the atoms are computed with a unit scale. With SCALE_PARAM, the scale is solved for each atom: the atoms are computed with a unit scale, the score is dot (only positive dot products) and the scale is set to dot/norm, inside its bounds. Without any of them, S is 1 and the fixed parameters must be the same for all the voxels.
+
+    The dictionary is only used if the parameters outside the grid (and the fixed parameters that are not the scale) are the same for all the voxels of a part, otherwise GridSearch evaluates the grid for every voxel. It is built again if they change in another part. With --dictionary_dir, the dictionary is written to a file named with a hash of the protocol, the grid and the values of the other parameters, and read in the next runs with the same protocol. The first atom of the file is computed again and compared, so a file written by another model is not used.
+
+    It is included after functions_gpu.h by GridSearch.cu, GridSearch_cpu.cc and dictionary.cc. The dictionary is built on the host (dictionary.cc)
+
+    agent
+
+    Copyright (C) 2026 University of Oxford  */
+
+/*  CCOPYRIGHT  */
+
+#include <vector>
+#include <string>
+#include "modelparameters.h"
+
+// Atoms evaluated together with each measurement in the dot products
+#define DICTIONARY_BLOCK 4
+
+namespace Cudimot{
+
+  /**
+   * Score of an atom for a voxel (|y|^2 minus the cost), see above
+   * @param dot Dot product of the measurements with the atom
+   * @param norm Norm of the predicted signal of the atom
+   * @param scale Scale of the voxel (SCALE_FIXP) or 1
+   */
+  template <typename T>
+  HOSTDEVICE T dictionary_score(T dot, T norm, T scale){
+#ifdef SCALE_PARAM
+    return dot;
+#else
+    return (T)2.0*scale*norm*dot-scale*scale*norm*norm;
+#endif
+  }
+
+  // Score below the score of any atom: with SCALE_PARAM, the atoms with a negative dot product are not used
+  template <typename T>
+  HOSTDEVICE T dictionary_min_score(){
+#ifdef SCALE_PARAM
+    return (T)0.0;
+#else
+    return (T)-9e20;
+#endif
+  }
+
+  template <typename T>
+  class Dictionary{
+
+  private:
+
+    int nGridParams;
+    const int* gridParams;
+    int gridCombs;
+    const T* grid;
+    const int* bound_types;
+    const float* bounds_min;
+    const float* bounds_max;
+
+    /**
+     * Number of atoms: combinations of the grid inside the bounds
+     */
+    int natoms;
+
+    /**
+     * Number of measurements of each atom
+     */
+    int nmeas;
+
+    /**
+     * Combination of the grid of each atom [natoms]
+     */
+    std::vector<int> combs;
+
+    /**
+     * Normalised predicted signal of each atom [natoms][nmeas]
+     */
+    std::vector<T> atoms;
+
+    /**
+     * Norm of the predicted signal of each atom [natoms]
+     */
+    std::vector<T> norms;
+
+    /**
+     * Parameters [NPARAMS] and fixed parameters [FixP_Tsize] of the voxels used to build the dictionary. The values in the grid and the scale are not used
+     */
+    std::vector<T> reference;
+
+    /**
+     * Incremented every time the dictionary is built or read, so the copies on the GPU are updated
+     */
+    int version;
+
+    /**
+     * Hash of the protocol, the grid and the reference values (--dictionary_dir)
+     */
+    unsigned long long file_hash;
+
+    // Computes the atoms of the combinations of the grid
+    void build(int nmeas, int CFP_Tsize, const T* CFP);
+
+    // Reads the atoms from the file of --dictionary_dir. Returns false if there is no valid file
+    bool read(const std::string& file, int CFP_Tsize, const T* CFP);
+
+    // Writes the atoms to a file of --dictionary_dir
+    void write(const std::string& file);
+
+    // Hash of the protocol, the grid and the reference values that identifies the file of the dictionary
+    unsigned long long hash(int CFP_Tsize, const T* CFP);
+
+    // Predicted signals of the combination of the grid with the reference values (unit scale)
+    void predicted_signals(int comb, int CFP_Tsize, const T* CFP, T* signals);
+
+  public:
+
+    /**
+     * Constructor. The dictionary is built by prepare
+     * @param nGridParams Number of parameters in each combination of the grid
+     * @param gridParams Ids of parameters in the grid
+     * @param gridCombs Number of combinations in the grid
+     * @param grid All the combinations of the grid
+     * @param bound_types Type of the bounds of each parameter
+     * @param bounds_min Lower bound of each parameter
+     * @param bounds_max Upper bound of each parameter
+     */
+    Dictionary(int nGridParams, const int* gridParams, int gridCombs, const T* grid,
+	       const int* bound_types, const float* bounds_min, const float* bounds_max);
+
+    /**
+     * Makes the dictionary usable for the voxels of a part: it is built (or read with --dictionary_dir) the first time or if the values of the parameters outside the grid are not the ones used to build it. All the pointers are in host memory
+     * @return false if the parameters outside the grid (or the fixed parameters that are not the scale) are not the same for all the voxels: the dictionary cannot be used
+     */
+    bool prepare(int nvox, int nmeas, int CFP_Tsize, int FixP_Tsize,
+		 const T* CFP, const T* params, const T* FixP);
+
+    /**
+     * Sets the parameters of a voxel from its best atom: the values of the grid and, with SCALE_PARAM, the scale
+     * @param atom Best atom of the voxel
+     * @param dot Dot product of the measurements of the voxel with the atom
+     * @param params Parameters of the voxel [NPARAMS]
+     */
+    void set_parameters(int atom, T dot, T* params) const;
+
+    int getNatoms() const { return natoms; }
+    int getNmeas() const { return nmeas; }
+    int getVersion() const { return version; }
+    const T* getAtoms() const { return atoms.data(); }
+    const T* getNorms() const { return norms.data(); }
+    const int* getCombs() const { return combs.data(); }
+  };
+}
+
+#endif
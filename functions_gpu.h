@@ -1,9 +1,23 @@
 //http://docs.nvidia.com/cuda/cuda-math-api/group__CUDA__MATH__SINGLE.html#group__CUDA__MATH__SINGLE
 //http://docs.nvidia.com/cuda/cuda-c-programming-guide/#mathematical-functions-appendix
 
+// When compiled by nvcc the model layer is device code. When compiled by a
+// plain host compiler (CPU backend) the same functions become host inline
+// functions, so modelfunctions.h can be evaluated on CPU-only nodes.
+#ifdef __CUDACC__
 #define FUNC __device__ inline
+#define HOSTDEVICE __host__ __device__ inline
+#else
+#include <math.h>
+#define FUNC inline
+#define HOSTDEVICE inline
+#endif
 #define FULL_MASK 0xFFFFFFFF
 
+#if !defined(__CUDACC__) && !defined(HOST_MATH_LIBM)
+// Host compiler: inline polynomial versions that are vectorized (HOST_MATH)
+#include "functions_host.h"
+#else
 FUNC float log_gpu(float x){return logf(x);}
 FUNC double log_gpu(double x){return log(x);}
 FUNC float exp_gpu(float x){return expf(x);}
@@ -39,9 +53,10 @@ FUNC double acos_gpu(double x){return acos(x);}
 FUNC double pow_gpu(float x1, float x2){return pow(x1,x2);}
 FUNC double pow_gpu(double x1, double x2){return pow(x1,x2);}
 //pow() always in double precision (single 8 range error)
+#endif
 
 
-
+#ifdef __CUDACC__
 // shfl_down function for double precision
 FUNC double shfl_down(double x, uint s){
   int lo, hi;
@@ -76,3 +91,4 @@ FUNC float shfl(float x, uint s){
 FUNC int shfl(int x, int s){
   return __shfl_sync(FULL_MASK,x,s);
 } 
+#endif
@@ -0,0 +1,526 @@
+#ifndef CUDIMOT_FUNCTIONS_HOST_H_INCLUDED
+#define CUDIMOT_FUNCTIONS_HOST_H_INCLUDED
+
+/*  functions_host.h
+
+    Math functions of the models (exp_gpu, log_gpu, sin_gpu, ...) when they are compiled by the host compiler (CPU engines)
+
+    The libm functions are external calls, so the compiler cannot vectorize the loops over voxel lanes (cpu_lanes.h). These versions are inline polynomials with branch-free range reduction (only arithmetic, comparisons and bit operations on integers), so they can be vectorized with the rest of the model. The double precision versions are evaluated in double precision and the single precision versions in single precision, with 32 bits integers, so a single precision model fills twice as many lanes of a SIMD register. Unlike the GPU versions, tan_gpu, sqrt_gpu, atan2_gpu, acos_gpu and pow_gpu return float for float arguments. The exception is pow(float), evaluated in double precision: in single precision exp(y*log(x)) would lose about |y*log(x)| ulp.
+
+    The accuracy is selected at compile time (HOST_MATH in the Makefile). Maximum errors measured against the long double libm functions with 2e6 random arguments in the domain below:
+      HOST_MATH_FULL (default): within 4 ulp (3.7 ulp for tan, 2.7 ulp for pow in double precision, 3.5 ulp for tan in single precision)
+      HOST_MATH_PRECISE: relative error below 3e-9 in double precision, the same as HOST_MATH_FULL in single precision
+      HOST_MATH_FAST: relative error below 1e-4
+      HOST_MATH_LIBM: libm functions, not vectorized (same results as previous versions)
+
+    pow() is computed as exp(y*log(x)). With HOST_MATH_FULL, log(x) and y*log(x) are kept with about 70 bits, so the error does not grow with |y*log(x)|. With HOST_MATH_PRECISE and HOST_MATH_FAST the relative error is below 3e-9*(1+|y*log(x)|) and 1e-4*(1+|y*log(x)|). pow(x,2) is exactly x*x.
+
+    Domain: the trigonometric functions are accurate for |x| < 1e6 (|x| < 6000 in single precision). exp() returns 0 instead of a subnormal number for x < -708.39 (x < -87.34 in single precision).
+
+    It is included by functions_gpu.h, do not include it directly.
+
+    agent
+
+    Copyright (C) 2026 University of Oxford  */
+
+/*  CCOPYRIGHT  */
+
+#include <stdint.h>
+#include <string.h>
+
+#if !defined(HOST_MATH_FULL) && !defined(HOST_MATH_PRECISE) && !defined(HOST_MATH_FAST)
+#define HOST_MATH_FULL
+#endif
+
+// Terms of the polynomials for each accuracy
+#if defined(HOST_MATH_FULL)
+#define HM_EXP_TERMS 13
+#define HM_LOG_TERMS 9
+#define HM_SIN_TERMS 7
+#define HM_COS_TERMS 8
+#define HM_ATAN_TERMS 13
+#define HM_EXPF_TERMS 7
+#define HM_LOGF_TERMS 4
+#define HM_SINF_TERMS 4
+#define HM_COSF_TERMS 5
+#define HM_ATANF_TERMS 5
+#elif defined(HOST_MATH_PRECISE)
+#define HM_EXP_TERMS 8
+#define HM_LOG_TERMS 4
+#define HM_SIN_TERMS 4
+#define HM_COS_TERMS 5
+#define HM_ATAN_TERMS 6
+#define HM_EXPF_TERMS 7
+#define HM_LOGF_TERMS 4
+#define HM_SINF_TERMS 4
+#define HM_COSF_TERMS 5
+#define HM_ATANF_TERMS 5
+#else
+#define HM_EXP_TERMS 5
+#define HM_LOG_TERMS 2
+#define HM_SIN_TERMS 2
+#define HM_COS_TERMS 3
+#define HM_ATAN_TERMS 3
+#define HM_EXPF_TERMS 4
+#define HM_LOGF_TERMS 2
+#define HM_SINF_TERMS 2
+#define HM_COSF_TERMS 3
+#define HM_ATANF_TERMS 2
+#endif
+
+// Always inlined: a call inside the loop over the lanes prevents its vectorization
+#define HM_INLINE inline __attribute__((always_inline))
+#define HM_FUNC HM_INLINE
+
+namespace host_math{
+
+  const double ROUND_MAGIC=6755399441055744.0; // 1.5*2^52: x+ROUND_MAGIC rounds x to an integer stored in the low bits
+  const double LN2_HI=6.93147180369123816490e-01;
+  const double LN2_LO=1.90821492927058770002e-10;
+  const double LOG2E=1.44269504088896338700e+00;
+  const double PIO2_1=1.57079632673412561417e+00; // pi/2 in 3 parts (Cody-Waite)
+  const double PIO2_2=6.07710050630396597660e-11;
+  const double PIO2_3=2.02226624871116645580e-21;
+  const double TWO_OVER_PI=6.36619772367581382433e-01;
+  const double PI=3.14159265358979311600e+00;
+  const double PI_2=1.57079632679489655800e+00;
+  const double PI_6=5.23598775598298815658e-01;
+  const double SQRT3=1.73205080756887719318e+00;
+  const double TAN_PI_12=2.67949192431122696e-01;
+  const double SQRT2=1.41421356237309514547e+00;
+
+  // Single precision
+  const float ROUND_MAGICF=12582912.0f; // 1.5*2^23
+  const float LN2_HIF=6.93145751953125e-01f; // 15 bits: k*LN2_HIF is exact
+  const float LN2_LOF=1.428606765330187e-06f;
+  const float LOG2EF=1.44269502162933349609e+00f;
+  const float PIO2_1F=1.5703125e+00f; // pi/2 in 4 parts of 12 bits (Cody-Waite): k*PIO2_NF is exact for |k| < 4096
+  const float PIO2_2F=4.837512969970703125e-04f;
+  const float PIO2_3F=7.549533620476723e-08f;
+  const float PIO2_4F=2.5633440682570896e-12f;
+  const float TWO_OVER_PIF=6.36619746685028076172e-01f;
+  const float PIF=3.14159274101257324219e+00f;
+  const float PI_2F=1.57079637050628662109e+00f;
+  const float PI_6F=5.23598790168762207031e-01f;
+  const float SQRT3F=1.73205077648162841797e+00f;
+  const float TAN_PI_12F=2.67949193716049194336e-01f;
+  const float SQRT2F=1.41421353816986083984e+00f;
+
+  HM_INLINE uint64_t as_bits(double x){
+    uint64_t u;
+    memcpy(&u,&x,sizeof(u));
+    return u;
+  }
+
+  HM_INLINE double as_double(uint64_t u){
+    double x;
+    memcpy(&x,&u,sizeof(x));
+    return x;
+  }
+
+  HM_INLINE uint32_t as_bits(float x){
+    uint32_t u;
+    memcpy(&u,&x,sizeof(u));
+    return u;
+  }
+
+  HM_INLINE float as_float(uint32_t u){
+    float x;
+    memcpy(&x,&u,sizeof(x));
+    return x;
+  }
+
+  // x with the sign of s
+  HM_INLINE double copy_sign(double x, double s){
+    return as_double((as_bits(x)&0x7fffffffffffffffULL)|(as_bits(s)&0x8000000000000000ULL));
+  }
+
+  HM_INLINE float copy_sign(float x, float s){
+    return as_float((as_bits(x)&0x7fffffffU)|(as_bits(s)&0x80000000U));
+  }
+
+  // Rounding error of a*b: a*b = p + error exactly, with p=a*b rounded
+  HM_INLINE double product_error(double a, double b, double p){
+#ifdef __FMA__
+    return __builtin_fma(a,b,-p);
+#else
+    // Dekker: splits of 26 bits
+    double ca=134217729.0*a, cb=134217729.0*b;
+    double ah=ca-(ca-a), bh=cb-(cb-b);
+    double al=a-ah, bl=b-bh;
+    return ((ah*bh-p)+ah*bl+al*bh)+al*bl;
+#endif
+  }
+
+  // exp(x+lo), with |lo| much smaller than the ulp of x (lo=0 for exp)
+  HM_INLINE double exp_extended(double x, double lo){
+    // x = k*ln2 + r, |r| <= ln2/2
+    double xc= x>709.782712893384 ? 709.782712893384 : (x< -708.39 ? -708.39 : x);
+    double big=xc*LOG2E+ROUND_MAGIC;
+    double k=big-ROUND_MAGIC;
+    double r=((xc-k*LN2_HI)-k*LN2_LO)+lo;
+    // Taylor series in Horner form: 1 + r(1 + r/2(1 + r/3(...)))
+    double p=1.0;
+    for(int i=HM_EXP_TERMS;i>=1;i--){
+      p=1.0+p*r*(1.0/i);
+    }
+    // 2^k, as 2^(k-1)*2 for k=1024
+    bool top= k>1023.0;
+    double scale=as_double((as_bits(big)+(top ? 1022 : 1023))<<52);
+    double y=p*scale;
+    y= top ? y*2.0 : y;
+    y= x>709.782712893384 ? __builtin_inf() : y;
+    y= x< -708.39 ? 0.0 : y;
+    return y; // NaN propagates through r
+  }
+
+  HM_INLINE double exp(double x){
+    return exp_extended(x,0.0);
+  }
+
+  HM_INLINE float exp(float x){
+    // x = k*ln2 + r, |r| <= ln2/2
+    float xc= x>88.7228394f ? 88.7228394f : (x< -87.3365479f ? -87.3365479f : x);
+    float big=xc*LOG2EF+ROUND_MAGICF;
+    float k=big-ROUND_MAGICF;
+    float r=(xc-k*LN2_HIF)-k*LN2_LOF;
+    float p=1.0f;
+    for(int i=HM_EXPF_TERMS;i>=1;i--){
+      p=1.0f+p*r*(1.0f/i);
+    }
+    // 2^k, as 2^(k-1)*2 for k=128
+    bool top= k>127.0f;
+    float scale=as_float((as_bits(big)+(top ? 126U : 127U))<<23);
+    float y=p*scale;
+    y= top ? y*2.0f : y;
+    y= x>88.7228394f ? __builtin_inff() : y;
+    y= x< -87.3365479f ? 0.0f : y;
+    return y;
+  }
+
+  HM_INLINE double log(double x){
+    // Subnormal numbers are scaled by 2^54
+    bool subnormal= x<2.2250738585072014e-308;
+    double xs= subnormal ? x*18014398509481984.0 : x;
+    uint64_t u=as_bits(xs);
+    // exponent as a double without int64->double conversion
+    double e=as_double(0x4330000000000000ULL|((u>>52)&0x7ff))-4503599627370496.0-1023.0;
+    e= subnormal ? e-54.0 : e;
+    double m=as_double((u&0x000fffffffffffffULL)|0x3ff0000000000000ULL); // [1,2)
+    bool high= m>SQRT2;
+    m= high ? m*0.5 : m;
+    e= high ? e+1.0 : e;
+    // log(1+f) = f - hfsq + s*(hfsq+R), s=f/(2+f), R= 2/3 s^2 + 2/5 s^4 + ...
+    double f=m-1.0;
+    double s=f/(2.0+f);
+    double z=s*s;
+    double R=0.0;
+    for(int i=HM_LOG_TERMS;i>=1;i--){
+      R=z*(2.0/(2*i+1)+R);
+    }
+    double hfsq=0.5*f*f;
+    double y=e*LN2_HI-((hfsq-(s*(hfsq+R)+e*LN2_LO))-f);
+    y= x==0.0 ? -__builtin_inf() : y;
+    y= x<0.0 ? __builtin_nan("") : y;
+    y= x==__builtin_inf() ? x : y;
+    y= x!=x ? x : y;
+    return y;
+  }
+
+  // log(x) = hi + lo with about 70 bits, for pow. x must be positive and finite
+  HM_INLINE double log_extended(double x, double& lo){
+    bool subnormal= x<2.2250738585072014e-308;
+    double xs= subnormal ? x*18014398509481984.0 : x;
+    uint64_t u=as_bits(xs);
+    double e=as_double(0x4330000000000000ULL|((u>>52)&0x7ff))-4503599627370496.0-1023.0;
+    e= subnormal ? e-54.0 : e;
+    double m=as_double((u&0x000fffffffffffffULL)|0x3ff0000000000000ULL);
+    bool high= m>SQRT2;
+    m= high ? m*0.5 : m;
+    e= high ? e+1.0 : e;
+    // log(1+f) = 2s + s*R, s=f/(2+f), with s = s_hi + s_lo. f and 2s are exact
+    double f=m-1.0;
+    double d=2.0+f;
+    double d_lo=(2.0-d)+f;
+    double s=f/d;
+    double sd=s*d;
+    double s_lo=(((f-sd)-product_error(s,d,sd))-s*d_lo)/d;
+    double z=s*s;
+    double R=0.0;
+    for(int i=HM_LOG_TERMS;i>=1;i--){
+      R=z*(2.0/(2*i+1)+R);
+    }
+    // e*LN2_HI is exact
+    double a=e*LN2_HI;
+    double b=2.0*s;
+    double hi=a+b;
+    double bv=hi-a;
+    double error=(a-(hi-bv))+(b-bv);
+    lo=error+(2.0*s_lo+(s*R+e*LN2_LO));
+    double y=hi+lo;
+    lo=lo-(y-hi);
+    return y;
+  }
+
+  HM_INLINE float log(float x){
+    // Subnormal numbers are scaled by 2^25
+    bool subnormal= x<1.17549435e-38f;
+    float xs= subnormal ? x*33554432.0f : x;
+    uint32_t u=as_bits(xs);
+    float e=(float)((int32_t)((u>>23)&0xff)-127);
+    e= subnormal ? e-25.0f : e;
+    float m=as_float((u&0x007fffffU)|0x3f800000U); // [1,2)
+    bool high= m>SQRT2F;
+    m= high ? m*0.5f : m;
+    e= high ? e+1.0f : e;
+    float f=m-1.0f;
+    float s=f/(2.0f+f);
+    float z=s*s;
+    float R=0.0f;
+    for(int i=HM_LOGF_TERMS;i>=1;i--){
+      R=z*(2.0f/(2*i+1)+R);
+    }
+    float hfsq=0.5f*f*f;
+    float y=e*LN2_HIF-((hfsq-(s*(hfsq+R)+e*LN2_LOF))-f);
+    y= x==0.0f ? -__builtin_inff() : y;
+    y= x<0.0f ? __builtin_nanf("") : y;
+    y= x==__builtin_inff() ? x : y;
+    y= x!=x ? x : y;
+    return y;
+  }
+
+  // Reduction for sin, cos and tan: x = k*pi/2 + r, |r| <= pi/4. Returns k mod 4
+  HM_INLINE uint64_t reduce_pio2(double x, double& r){
+    double big=x*TWO_OVER_PI+ROUND_MAGIC;
+    double k=big-ROUND_MAGIC;
+    r=((x-k*PIO2_1)-k*PIO2_2)-k*PIO2_3;
+    return as_bits(big)&3;
+  }
+
+  HM_INLINE double sin_poly(double r){
+    double z=r*r;
+    double p=1.0;
+    for(int i=HM_SIN_TERMS;i>=1;i--){
+      p=1.0-z*p*(1.0/((2*i)*(2*i+1)));
+    }
+    return r*p;
+  }
+
+  HM_INLINE double cos_poly(double r){
+    double z=r*r;
+    double p=1.0;
+    for(int i=HM_COS_TERMS;i>=1;i--){
+      p=1.0-z*p*(1.0/((2*i-1)*(2*i)));
+    }
+    return p;
+  }
+
+  HM_INLINE double sin(double x){
+    double r;
+    uint64_t q=reduce_pio2(x,r);
+    double s=sin_poly(r);
+    double c=cos_poly(r);
+    double y= (q&1) ? c : s;
+    return (q&2) ? -y : y;
+  }
+
+  HM_INLINE double cos(double x){
+    double r;
+    uint64_t q=reduce_pio2(x,r);
+    double s=sin_poly(r);
+    double c=cos_poly(r);
+    double y= (q&1) ? s : c;
+    return ((q+1)&2) ? -y : y;
+  }
+
+  HM_INLINE double tan(double x){
+    double r;
+    uint64_t q=reduce_pio2(x,r);
+    double s=sin_poly(r);
+    double c=cos_poly(r);
+    return (q&1) ? -c/s : s/c;
+  }
+
+  HM_INLINE uint32_t reduce_pio2(float x, float& r){
+    float big=x*TWO_OVER_PIF+ROUND_MAGICF;
+    float k=big-ROUND_MAGICF;
+    r=(((x-k*PIO2_1F)-k*PIO2_2F)-k*PIO2_3F)-k*PIO2_4F;
+    return as_bits(big)&3;
+  }
+
+  HM_INLINE float sin_poly(float r){
+    float z=r*r;
+    float p=1.0f;
+    for(int i=HM_SINF_TERMS;i>=1;i--){
+      p=1.0f-z*p*(1.0f/((2*i)*(2*i+1)));
+    }
+    return r*p;
+  }
+
+  HM_INLINE float cos_poly(float r){
+    float z=r*r;
+    float p=1.0f;
+    for(int i=HM_COSF_TERMS;i>=1;i--){
+      p=1.0f-z*p*(1.0f/((2*i-1)*(2*i)));
+    }
+    return p;
+  }
+
+  HM_INLINE float sin(float x){
+    float r;
+    uint32_t q=reduce_pio2(x,r);
+    float s=sin_poly(r);
+    float c=cos_poly(r);
+    float y= (q&1) ? c : s;
+    return (q&2) ? -y : y;
+  }
+
+  HM_INLINE float cos(float x){
+    float r;
+    uint32_t q=reduce_pio2(x,r);
+    float s=sin_poly(r);
+    float c=cos_poly(r);
+    float y= (q&1) ? s : c;
+    return ((q+1)&2) ? -y : y;
+  }
+
+  HM_INLINE float tan(float x){
+    float r;
+    uint32_t q=reduce_pio2(x,r);
+    float s=sin_poly(r);
+    float c=cos_poly(r);
+    return (q&1) ? -c/s : s/c;
+  }
+
+  HM_INLINE double atan(double x){
+    double t= x<0.0 ? -x : x;
+    bool inverse= t>1.0;
+    double a= inverse ? 1.0/t : t;
+    // atan(a) = pi/6 + atan((a*sqrt3-1)/(a+sqrt3))
+    bool shift= a>TAN_PI_12;
+    a= shift ? (a*SQRT3-1.0)/(a+SQRT3) : a;
+    double z=a*a;
+    double p=0.0;
+    for(int i=HM_ATAN_TERMS;i>=1;i--){
+      p=z*(1.0/(2*i+1)-p);
+    }
+    double y=a-a*p; // a - a^3/3 + a^5/5 - ...
+    y= shift ? PI_6+y : y;
+    y= inverse ? PI_2-y : y;
+    return copy_sign(y,x);
+  }
+
+  HM_INLINE float atan(float x){
+    float t= x<0.0f ? -x : x;
+    bool inverse= t>1.0f;
+    float a= inverse ? 1.0f/t : t;
+    bool shift= a>TAN_PI_12F;
+    a= shift ? (a*SQRT3F-1.0f)/(a+SQRT3F) : a;
+    float z=a*a;
+    float p=0.0f;
+    for(int i=HM_ATANF_TERMS;i>=1;i--){
+      p=z*(1.0f/(2*i+1)-p);
+    }
+    float y=a-a*p;
+    y= shift ? PI_6F+y : y;
+    y= inverse ? PI_2F-y : y;
+    return copy_sign(y,x);
+  }
+
+  HM_INLINE double atan2(double y, double x){
+    double ax= x<0.0 ? -x : x;
+    double ay= y<0.0 ? -y : y;
+    double t=atan(ay/ax);
+    t= (ax==0.0 && ay==0.0) ? 0.0 : t;
+    t= (as_bits(x)>>63) ? PI-t : t;
+    t= (ax==__builtin_inf() && ay==__builtin_inf()) ? ((as_bits(x)>>63) ? 3.0*PI/4.0 : PI/4.0) : t;
+    t= (x!=x || y!=y) ? x+y : t;
+    return copy_sign(t,y);
+  }
+
+  HM_INLINE float atan2(float y, float x){
+    float ax= x<0.0f ? -x : x;
+    float ay= y<0.0f ? -y : y;
+    float t=atan(ay/ax);
+    t= (ax==0.0f && ay==0.0f) ? 0.0f : t;
+    t= (as_bits(x)>>31) ? PIF-t : t;
+    t= (ax==__builtin_inff() && ay==__builtin_inff()) ? ((as_bits(x)>>31) ? 3.0f*PIF/4.0f : PIF/4.0f) : t;
+    t= (x!=x || y!=y) ? x+y : t;
+    return copy_sign(t,y);
+  }
+
+  HM_INLINE double acos(double x){
+    // acos(x) = 2*atan(sqrt((1-x)/(1+x)))
+    return 2.0*atan(__builtin_sqrt((1.0-x)/(1.0+x)));
+  }
+
+  HM_INLINE float acos(float x){
+    return 2.0f*atan(__builtin_sqrtf((1.0f-x)/(1.0f+x)));
+  }
+
+  // Special cases of pow(x,y), p=pow(|x|,y)
+  HM_INLINE double pow_cases(double x, double y, double p){
+    // negative base: only integer exponents
+    double yi=(y+ROUND_MAGIC)-ROUND_MAGIC;
+    bool integer= (yi==y) && (y<9007199254740992.0) && (y>-9007199254740992.0);
+    bool odd= integer && (as_bits(y+ROUND_MAGIC)&1);
+    p= (x<0.0 && odd) ? -p : p;
+    p= (x<0.0 && !integer) ? __builtin_nan("") : p;
+    p= (x==0.0) ? (y>0.0 ? 0.0 : (y==0.0 ? 1.0 : __builtin_inf())) : p;
+    p= (y==0.0) ? 1.0 : p;
+    p= (y==2.0) ? x*x : p;
+    return p;
+  }
+
+  HM_INLINE double pow(double x, double y){
+    double ax= x<0.0 ? -x : x;
+    // y*log(x) with about 70 bits, otherwise the error of exp grows with |y*log(x)|
+    double lo;
+    double l=log_extended(ax,lo);
+    double yl=y*l;
+    double yl_lo=product_error(y,l,yl)+y*lo;
+    double p=exp_extended(yl,yl_lo);
+    // log_extended does not deal with 0, inf and NaN
+    p= (ax==__builtin_inf()) ? (y>0.0 ? __builtin_inf() : 0.0) : p;
+    p= (x!=x || y!=y) ? x+y : p;
+    return pow_cases(x,y,p);
+  }
+
+  HM_INLINE float pow(float x, float y){
+    // In double precision the error of exp(y*log(x)) is far below the ulp of the single precision result
+    double ax= x<0.0f ? -(double)x : (double)x;
+    double p=exp((double)y*log(ax));
+    return (float)pow_cases(x,y,p);
+  }
+}
+
+HM_FUNC float log_gpu(float x){return host_math::log(x);}
+HM_FUNC double log_gpu(double x){return host_math::log(x);}
+HM_FUNC float exp_gpu(float x){return host_math::exp(x);}
+HM_FUNC double exp_gpu(double x){return host_math::exp(x);}
+HM_FUNC float fabs_gpu(float x){return __builtin_fabsf(x);}
+HM_FUNC double fabs_gpu(double x){return __builtin_fabs(x);}
+HM_FUNC float sin_gpu(float x){return host_math::sin(x);}
+HM_FUNC double sin_gpu(double x){return host_math::sin(x);}
+HM_FUNC float cos_gpu(float x){return host_math::cos(x);}
+HM_FUNC double cos_gpu(double x){return host_math::cos(x);}
+HM_FUNC float atan_gpu(float x){return host_math::atan(x);}
+HM_FUNC double atan_gpu(double x){return host_math::atan(x);}
+HM_FUNC float min_gpu(float x1, float x2){return fminf(x1,x2);}
+HM_FUNC double min_gpu(double x1, double x2){return fmin(x1,x2);}
+HM_FUNC float max_gpu(float x1, float x2){return fmaxf(x1,x2);}
+HM_FUNC double max_gpu(double x1, double x2){return fmax(x1,x2);}
+
+// Unlike the GPU versions, the single precision versions are evaluated and returned in single precision
+HM_FUNC float tan_gpu(float x){return host_math::tan(x);}
+HM_FUNC double tan_gpu(double x){return host_math::tan(x);}
+HM_FUNC float sqrt_gpu(float x){return __builtin_sqrtf(x);}
+HM_FUNC double sqrt_gpu(double x){return __builtin_sqrt(x);}
+HM_FUNC float atan2_gpu(float x,float y){return host_math::atan2(x,y);}
+HM_FUNC double atan2_gpu(double x,double y){return host_math::atan2(x,y);}
+HM_FUNC float acos_gpu(float x){return host_math::acos(x);}
+HM_FUNC double acos_gpu(double x){return host_math::acos(x);}
+HM_FUNC float pow_gpu(float x1, float x2){return host_math::pow(x1,x2);}
+HM_FUNC double pow_gpu(double x1, double x2){return host_math::pow(x1,x2);}
+
+#endif
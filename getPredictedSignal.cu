@@ -13,6 +13,7 @@
 #include "modelparameters.h"
 #include "macro_numerical.h"
 #include "modelfunctions.h"
+#include "init_gpu.h"
 
 namespace Cudimot{
 
@@ -83,9 +84,11 @@ namespace Cudimot{
     int nmeas2compute = nmeas/THREADS_VOXEL;
     if (idSubVOX<(nmeas%THREADS_VOXEL)) nmeas2compute++;
     
+    T cache[CACHE_SIZE];
+    Prepare_Voxel(meanSamples,FixP,cache);
     for(int iter=0;iter<nmeas2compute;iter++){
       T* myCFP = &CFP[idMeasurement*CFP_Tsize];
-      T pred=Predicted_Signal(NPARAMS,meanSamples,myCFP,FixP);
+      T pred=Predicted_Signal(NPARAMS,meanSamples,myCFP,FixP,cache);
       PredictedSignal[idMeasurement]=pred;
       idMeasurement+=THREADS_VOXEL;
     }
@@ -100,7 +103,21 @@ namespace Cudimot{
 				  int nvox, int nmeas, int nsamples,
 				  int CFP_size, int FixP_size,
 				  T* samples, T* CFP, T* FixP,
-				  T* PredictedSignal) 
+				  T* PredictedSignal)
+  {
+    if(cpu_backend()){
+      run_cpu(nvox,nmeas,nsamples,CFP_size,FixP_size,samples,CFP,FixP,PredictedSignal);
+    }else{
+      run_gpu(nvox,nmeas,nsamples,CFP_size,FixP_size,samples,CFP,FixP,PredictedSignal);
+    }
+  }
+
+  template <typename T>
+  void getPredictedSignal<T>::run_gpu(
+				      int nvox, int nmeas, int nsamples,
+				      int CFP_size, int FixP_size,
+				      T* samples, T* CFP, T* FixP,
+				      T* PredictedSignal)
   {
     
     long int amount_shared_mem = 0;
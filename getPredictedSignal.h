@@ -5,7 +5,7 @@
  *
  * \class getPredictedSignal
  *
- * \brief A class for calculating the signal predicted by a model after been fitted on the GPU.
+ * \brief A class for calculating the signal predicted by a model after been fitted, on the GPU or on the CPU.
  *
  * \author Moises Hernandez-Fernandez - FMRIB Image Analysis Group
  *
@@ -36,6 +36,12 @@ namespace Cudimot{
      */
     getPredictedSignal();
 
+    /**
+     * Run the method to get the model predicted signal on the backend selected with --backend (see cpu_backend): run_gpu() or run_cpu(). The pointers are in the memory of the part, on the GPU or on the host (see allocate_part)
+     */
+    void run( int nvox, int nmeas, int nsamples, int CFP_size, int FixP_size,
+	      T* samples,T* CFP, T* FixP, T* PredictedSignal);
+
     /**
      * Run the method to get the model predicted signal on the GPU
      * @param nvox Number of voxels in the dataset
@@ -48,8 +54,14 @@ namespace Cudimot{
      * @param FixP Fixed parameters of the model (on GPU). FixP_size*nvoxels
      * @param PredictedSignal The result values of the model predicted signal (on GPU)
      */
-    void run( int nvox, int nmeas, int nsamples, int CFP_size, int FixP_size,
-	      T* samples,T* CFP, T* FixP, T* PredictedSignal);
+    void run_gpu( int nvox, int nmeas, int nsamples, int CFP_size, int FixP_size,
+		  T* samples,T* CFP, T* FixP, T* PredictedSignal);
+
+    /**
+     * Run the method to get the model predicted signal on the CPU. The voxels are distributed among several threads (--nthreads). Same arguments than run_gpu(), but all the pointers are in host memory
+     */
+    void run_cpu( int nvox, int nmeas, int nsamples, int CFP_size, int FixP_size,
+		  T* samples,T* CFP, T* FixP, T* PredictedSignal);
   };
 }
 
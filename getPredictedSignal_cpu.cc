@@ -0,0 +1,89 @@
+/* getPredictedSignal_cpu.cc
+
+   Model predicted signal on the CPU, given the estimated parameters (the mean of the samples if MCMC is used). Same method as the GPU version (getPredictedSignal.cu). The voxels are distributed among a pool of threads in batches of CPU_LANES voxels, one voxel per SIMD lane (cpu_lanes.h).
+
+   This file is compiled with the host compiler (not nvcc), so the model functions are compiled as host functions.
+
+   agent
+
+   Copyright (C) 2026 University of Oxford */
+
+/* CCOPYRIGHT */
+
+#include "getPredictedSignal.h"
+#include "cudimotoptions.h"
+#include "functions_gpu.h"
+#include "modelparameters.h"
+#include "macro_numerical.h"
+#include "modelfunctions.h"
+#include "cpu_threads.h"
+#include "cpu_lanes.h"
+
+namespace Cudimot{
+
+  // Predicted signal of the voxels [first_voxel,first_voxel+nvox_batch), one voxel per lane. nvox_batch <= CPU_LANES
+  template <typename T>
+  void getPredictedSignal_lanes_cpu(
+				    int first_voxel,
+				    int nvox_batch,
+				    int nmeas, // nmeasurements
+				    int nsamples,
+				    int CFP_Tsize, //size*M-measurements
+				    int FixP_Tsize, // fixed params: size*N-voxels
+				    T* samples, // samples of estimated parameters
+				    T* CFP, // common fixed model parameters
+				    T* FixP, // fixed model parameters
+				    T* PredictedSignal)
+  {
+    T meanSamples[NPARAMS][CPU_LANES];
+    T* lane_FixP[CPU_LANES];
+    T signal[CPU_LANES];
+    T cache[CACHE_SIZE][CPU_LANES];
+
+    // Lanes beyond the last voxel of the batch replicate its first voxel. They are never written
+    for(int l=0;l<CPU_LANES;l++){
+      int idVOX=first_voxel+((l<nvox_batch)?l:0);
+      T* mysamples=&samples[idVOX*NPARAMS*nsamples];
+      for(int par=0;par<NPARAMS;par++){
+	T value=0;
+	for(int samp=0;samp<nsamples;samp++){
+	  value+= mysamples[par*nsamples+samp];
+	}
+	meanSamples[par][l]=value/nsamples;
+      }
+      lane_FixP[l]=&FixP[idVOX*FixP_Tsize];
+    }
+
+    Prepare_Voxel_lanes(meanSamples,lane_FixP,cache);
+    for(int idMeasurement=0;idMeasurement<nmeas;idMeasurement++){
+      T* myCFP = &CFP[idMeasurement*CFP_Tsize];
+      Predicted_Signal_lanes(meanSamples,cache,myCFP,lane_FixP,signal);
+      for(int l=0;l<nvox_batch;l++){
+	PredictedSignal[(first_voxel+l)*nmeas+idMeasurement]=signal[l];
+      }
+    }
+  }
+
+  template <typename T>
+  void getPredictedSignal<T>::run_cpu(
+				      int nvox, int nmeas, int nsamples,
+				      int CFP_size, int FixP_size,
+				      T* samples, T* CFP, T* FixP,
+				      T* PredictedSignal)
+  {
+    cudimotOptions& opts = cudimotOptions::getInstance();
+    int nthreads=cpu_nthreads(opts.nthreads.value());
+
+    cpu_threads_stats stats=parallel_voxels(nvox,CPU_LANES,nthreads,[&](int first, int last){
+	for(int batch=first;batch<last;batch+=CPU_LANES){
+	  int nvox_batch=min(CPU_LANES,last-batch);
+	  getPredictedSignal_lanes_cpu<T>(batch,nvox_batch,nmeas,nsamples,CFP_size,FixP_size,samples,CFP,FixP,PredictedSignal);
+	}
+      });
+    report_cpu_threads("PredictedSignal",stats);
+  }
+
+  // Explicit Instantiations of the template
+  template void getPredictedSignal<float>::run_cpu(int,int,int,int,int,float*,float*,float*,float*);
+  template void getPredictedSignal<double>::run_cpu(int,int,int,int,int,double*,double*,double*,double*);
+}
@@ -0,0 +1,112 @@
+#ifndef CUDIMOT_GRID_LEVELS_H_INCLUDED
+#define CUDIMOT_GRID_LEVELS_H_INCLUDED
+
+/*  grid_levels.h
+
+    Coarse-to-fine GridSearch (--gridLevels=L). The grid of the file of --gridSearch (the Cartesian product of the values of each parameter) has exponential cost with the number of parameters. With L levels, only the indices of the values that are multiples of the stride S=2^(L-1) are evaluated first (the coarse grid). In each of the next levels the stride is halved, and the neighbours at the new stride of the best --gridKeep combinations of the voxel (3^nGridParams-1 for each one) are evaluated. At the last level the stride is 1, so every combination of the grid is reachable: a voxel gets the combination of the dense grid if its cost does not have another minimum within S values of it.
+
+    All the combinations evaluated before a level are on the lattice of its previous stride. A neighbour at the new stride is not on that lattice in at least one parameter, so it was not evaluated before. Two best combinations of a voxel may share neighbours: a neighbour of an earlier one is skipped.
+
+    A combination is identified by its index in the grid of the model (Model::set_grid), where the last parameter varies faster.
+
+    It is included after functions_gpu.h by GridSearch.cu and GridSearch_cpu.cc
+
+    agent
+
+    Copyright (C) 2026 University of Oxford  */
+
+/*  CCOPYRIGHT  */
+
+#include "modelparameters.h"
+
+// Maximum number of best combinations kept for each voxel (--gridKeep)
+#define GRID_MAX_KEEP 32
+
+namespace Cudimot{
+
+  // Index in the grid of the combination with the values index[i] of each parameter
+  HOSTDEVICE int grid_comb(int nGridParams, const int* sizes, const int* index){
+    int comb=0;
+    for(int i=0;i<nGridParams;i++){
+      comb=comb*sizes[i]+index[i];
+    }
+    return comb;
+  }
+
+  // Values of each parameter of a combination of the grid
+  HOSTDEVICE void grid_index(int nGridParams, const int* sizes, int comb, int* index){
+    for(int i=nGridParams-1;i>=0;i--){
+      index[i]=comb%sizes[i];
+      comb/=sizes[i];
+    }
+  }
+
+  // Number of combinations of the coarse grid
+  HOSTDEVICE int grid_ncoarse(int nGridParams, const int* sizes, int stride){
+    int n=1;
+    for(int i=0;i<nGridParams;i++){
+      n*=(sizes[i]+stride-1)/stride;
+    }
+    return n;
+  }
+
+  // Index in the grid of the combination c of the coarse grid
+  HOSTDEVICE int grid_coarse(int nGridParams, const int* sizes, int stride, int c){
+    int index[NPARAMS];
+    for(int i=nGridParams-1;i>=0;i--){
+      int n=(sizes[i]+stride-1)/stride;
+      index[i]=(c%n)*stride;
+      c/=n;
+    }
+    return grid_comb(nGridParams,sizes,index);
+  }
+
+  /**
+   * Neighbour of a best combination of the voxel at a distance of stride values in each parameter
+   * @param centres Best combinations of the voxel before the level (-1: none)
+   * @param j Best combination to refine
+   * @param o Neighbour [0,3^nGridParams): the offset of each parameter is -stride, 0 or +stride
+   * @return Index in the grid, or -1 if it is outside the grid, it is the combination itself or it is also a neighbour of an earlier best combination
+   */
+  HOSTDEVICE int grid_neighbour(int nGridParams, const int* sizes, int stride, const int* centres, int j, int o){
+    if(centres[j]<0) return -1;
+    int index[NPARAMS];
+    grid_index(nGridParams,sizes,centres[j],index);
+    bool centre=true;
+    for(int i=nGridParams-1;i>=0;i--){
+      int offset=(o%3)-1;
+      o/=3;
+      if(offset!=0) centre=false;
+      index[i]+=offset*stride;
+      if(index[i]<0 || index[i]>=sizes[i]) return -1;
+    }
+    if(centre) return -1;
+    for(int c=0;c<j;c++){
+      if(centres[c]<0) continue;
+      int other[NPARAMS];
+      grid_index(nGridParams,sizes,centres[c],other);
+      bool near=true;
+      for(int i=0;i<nGridParams;i++){
+	int d=index[i]-other[i];
+	if(d>stride || d<-stride) near=false;
+      }
+      if(near) return -1;
+    }
+    return grid_comb(nGridParams,sizes,index);
+  }
+
+  // Inserts a combination in the list of best combinations of the voxel, sorted by cost. With the same cost, the combination evaluated first is kept first
+  HOSTDEVICE void grid_keep_best(int keep, double* best_cost, int* best_comb, double cost, int comb){
+    if(!(cost<best_cost[keep-1])) return;
+    int i=keep-1;
+    while(i>0 && cost<best_cost[i-1]){
+      best_cost[i]=best_cost[i-1];
+      best_comb[i]=best_comb[i-1];
+      i--;
+    }
+    best_cost[i]=cost;
+    best_comb[i]=comb;
+  }
+}
+
+#endif
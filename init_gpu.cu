@@ -8,6 +8,13 @@
 
 #include "checkcudacalls.h"
 #include <fstream>
+#include <cstring>
+#include "init_gpu.h"
+#include "cudimotoptions.h"
+#include "tables.h"
+
+// Tables of the special functions of the model (tables.h), read by the model functions on the GPU
+__constant__ Cudimot::Table tables_gpu[NTABLES_SIZE];
 
 void init_gpu(){
   int *q;
@@ -22,3 +29,87 @@ void init_gpu(){
   sync_check("init_gpu");
 } 
 
+void init_backend(){
+  if(!cpu_backend()){
+    init_gpu();
+  }
+}
+
+bool cpu_backend(){
+  static int backend=-1; // -1: not resolved yet, 0: CUDA, 1: CPU
+  if(backend<0){
+    Cudimot::cudimotOptions& opts = Cudimot::cudimotOptions::getInstance();
+    std::string requested=opts.backend.value();
+    if(requested=="cpu"){
+      backend=1;
+    }else if(requested=="cuda"){
+      backend=0;
+    }else if(requested=="auto"){
+      int ndevices=0;
+      cudaError_t error=cudaGetDeviceCount(&ndevices);
+      if(error!=cudaSuccess || ndevices==0){
+	cudaGetLastError(); // clear the error of the probe
+	printf("\n...................No GPU available (%s): running on the CPU...................\n",(error!=cudaSuccess)?cudaGetErrorString(error):"no devices");
+	backend=1;
+      }else{
+	backend=0;
+      }
+    }else{
+      std::cerr << "CUDIMOT Error: Unknown backend '" << requested << "'. The options of --backend are cpu, cuda and auto" << std::endl;
+      exit(-1);
+    }
+  }
+  return backend==1;
+}
+
+
+void allocate_part(void** ptr, size_t bytes, const char* message){
+  if(cpu_backend()){
+    *ptr=malloc(bytes);
+    if(*ptr==NULL && bytes){
+      fprintf(stderr,"ERROR: %s: Not enough host memory\n",message);
+      exit(-1);
+    }
+  }else{
+    cudaMalloc(ptr,bytes);
+    sync_check(message);
+  }
+}
+
+void copy_host2part(void* part, const void* host, size_t bytes, const char* message){
+  if(cpu_backend()){
+    memcpy(part,host,bytes);
+  }else{
+    cudaMemcpy(part,host,bytes,cudaMemcpyHostToDevice);
+    sync_check(message);
+  }
+}
+
+void copy_part2host(void* host, const void* part, size_t bytes, const char* message){
+  if(cpu_backend()){
+    memcpy(host,part,bytes);
+  }else{
+    cudaMemcpy(host,part,bytes,cudaMemcpyDeviceToHost);
+    sync_check(message);
+  }
+}
+
+void copy_tables_gpu(){
+  if(cpu_backend()) return; // the model functions read tables_host
+  Cudimot::Table tables[NTABLES_SIZE];
+  for(int id=0;id<NTABLES_SIZE;id++){
+    tables[id]=tables_host[id];
+    if(tables[id].ndims==0) continue;
+    size_t bytes=(size_t)tables[id].nknots[0]*tables[id].nvalues*sizeof(double);
+    if(tables[id].ndims==1){
+      bytes*=2;
+    }else{
+      bytes*=tables[id].nknots[1]*4;
+    }
+    cudaMalloc((void**)&tables[id].data,bytes);
+    cudaMemcpy(tables[id].data,tables_host[id].data,bytes,cudaMemcpyHostToDevice);
+    sync_check("Copying the tables to the GPU");
+  }
+  cudaMemcpyToSymbol(tables_gpu,tables,sizeof(tables));
+  sync_check("Copying the tables to the GPU");
+}
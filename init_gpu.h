@@ -6,5 +6,35 @@
 
 /*  CCOPYRIGHT  */
 
+#include <cstddef>
+
 void init_gpu();
 
+/**
+ * Initialises the hardware of the fitting routines (--backend): the CUDA runtime with the GPU backend, nothing with the CPU backend
+ */
+void init_backend();
+
+/**
+ * Hardware used by the fitting routines (--backend). It is resolved the first time this function is called: with "auto", the CUDA runtime is asked for a device and the CPU is used if there is none, so the binary also runs on nodes without a GPU
+ * @return true if the fitting routines run on the CPU
+ */
+bool cpu_backend();
+
+/**
+ * Allocates memory for the data of a part. It is allocated on the GPU, or on the host with the CPU backend
+ * @param ptr Returns the pointer to the allocated memory
+ * @param bytes Amount of memory
+ * @param message Message printed if there is an error
+ */
+void allocate_part(void** ptr, size_t bytes, const char* message);
+
+/**
+ * Copies data from the host to the memory of a part (GPU or host)
+ */
+void copy_host2part(void* part, const void* host, size_t bytes, const char* message);
+
+/**
+ * Copies data from the memory of a part (GPU or host) to the host
+ */
+void copy_part2host(void* host, const void* part, size_t bytes, const char* message);
@@ -0,0 +1,165 @@
+#ifndef CUDIMOT_LINEAR_PARAMETERS_H_INCLUDED
+#define CUDIMOT_LINEAR_PARAMETERS_H_INCLUDED
+
+/*  linear_parameters.h
+
+    Optional closed-form solution of the parameters that enter the predicted signal linearly (variable projection, --varpro). In many models the signal is a linear combination of a few basis functions that only depend on the other parameters, e.g. in Ball & Sticks: S0*(1-f)*isoterm + S0*f*anisoterm. A model can define in modelparameters.h:
+
+      #define NLINEAR n // Number of linear parameters
+      #define LINEAR_PARAMS 0,2 // Ids of the linear parameters
+
+    and provide in modelfunctions.h:
+
+      // Values of the n basis functions for a measurement: signal = sum coeffs[j]*basis[j]. They must not depend on the linear parameters
+      MACRO void Linear_Basis(int npar, T* P, T* CFP, T* FixP, T* cache, T* basis);
+      // Sets the linear parameters of P from the n non-negative coefficients of the basis functions
+      MACRO void Linear_Parameters(int npar, T* coeffs, T* P);
+
+    The cache is the output of Prepare_Voxel (see voxel_cache.h), not used if the model does not define NCACHE.
+
+    With --varpro, GridSearch and Levenberg-Marquardt solve the coefficients for the current nonlinear parameters with non-negative least squares, from the normal equations accumulated in one pass over the measurements, and set the linear parameters. GridSearch then only needs a grid of the nonlinear parameters. Levenberg-Marquardt computes the step of the nonlinear parameters with the Jacobian of all the parameters (the Kaufman approximation of the variable projection Jacobian spans the same space) and replaces the step of the linear parameters by their solution at the proposed nonlinear parameters. The linear parameters are kept inside their bounds.
+
+    It is included by macro_numerical.h
+
+    agent
+
+    Copyright (C) 2026 University of Oxford  */
+
+/*  CCOPYRIGHT  */
+
+#include "cudimot.h"
+
+#ifndef NLINEAR
+#define NLINEAR 0
+#endif
+
+#if NLINEAR>0
+
+MACRO void Linear_Basis(int npar, T* P, T* CFP, T* FixP, T* cache, T* basis);
+MACRO void Linear_Parameters(int npar, T* coeffs, T* P);
+
+// Distance of the linear parameters to their bounds, as avoidErrors in the Levenberg-Marquardt transformations
+#define LINEAR_BOUNDS_MARGIN 1e-4
+
+namespace Cudimot{
+
+  // Id of the i-th linear parameter
+  HOSTDEVICE int linear_param(int i){
+    const int ids[NLINEAR]={LINEAR_PARAMS};
+    return ids[i];
+  }
+
+  /**
+   * Adds a measurement to the normal equations of the coefficients: B^T B (upper triangle) and B^T y
+   * @param basis Values of the basis functions for the measurement
+   * @param measurement Measured signal
+   */
+  template <typename T>
+  FUNC void accumulate_linear(const T* basis, T measurement, T* BtB, T* Bty){
+    for(int j=0;j<NLINEAR;j++){
+      for(int k=j;k<NLINEAR;k++){
+	BtB[j*NLINEAR+k]+=basis[j]*basis[k];
+      }
+      Bty[j]+=basis[j]*measurement;
+    }
+  }
+
+  // Least-squares coefficients of the basis functions in the subset (bit j: coefficient j) with a Cholesky factorization
+  // Returns false if the system is singular or a coefficient is not positive
+  template <typename T>
+  FUNC bool solve_linear_subset(const T* BtB, const T* Bty, int subset, T* coeffs){
+    int ids[NLINEAR]={0};
+    int n=0;
+    for(int j=0;j<NLINEAR;j++){
+      if(subset&(1<<j)) ids[n++]=j;
+    }
+    T L[NLINEAR*NLINEAR];
+    T y[NLINEAR];
+    for(int col=0;col<n;col++){
+      T diag=BtB[ids[col]*NLINEAR+ids[col]];
+      for(int k=0;k<col;k++){
+	diag-=L[col*NLINEAR+k]*L[col*NLINEAR+k];
+      }
+      // Also catches NaN
+      if(!(diag>(T)0.0)) return false;
+      diag=(T)sqrt_gpu(diag);
+      L[col*NLINEAR+col]=diag;
+      for(int row=col+1;row<n;row++){
+	T value=BtB[ids[col]*NLINEAR+ids[row]];
+	for(int k=0;k<col;k++){
+	  value-=L[row*NLINEAR+k]*L[col*NLINEAR+k];
+	}
+	L[row*NLINEAR+col]=value/diag;
+      }
+    }
+    for(int row=0;row<n;row++){
+      T value=Bty[ids[row]];
+      for(int k=0;k<row;k++){
+	value-=L[row*NLINEAR+k]*y[k];
+      }
+      y[row]=value/L[row*NLINEAR+row];
+    }
+    for(int j=0;j<NLINEAR;j++){
+      coeffs[j]=(T)0.0;
+    }
+    for(int row=n-1;row>=0;row--){
+      T value=y[row];
+      for(int k=row+1;k<n;k++){
+	value-=L[k*NLINEAR+row]*coeffs[ids[k]];
+      }
+      value/=L[row*NLINEAR+row];
+      if(!(value>(T)0.0)) return false;
+      coeffs[ids[row]]=value;
+    }
+    return true;
+  }
+
+  /**
+   * Non-negative least squares: minimises |y - B*coeffs|^2 with coeffs >= 0, given B^T B (upper triangle) and B^T y
+   * The non-negative solution is the unconstrained solution of its positive coefficients, so every subset of coefficients is solved (2^NLINEAR-1 small systems) and the positive solution with the lowest cost is kept. At the least-squares solution of a subset the cost is |y|^2 - coeffs^T B^T y
+   * @return false if no subset has a positive solution: coeffs is not written
+   */
+  template <typename T>
+  FUNC bool nnls_linear(const T* BtB, const T* Bty, T* coeffs){
+    T best=(T)0.0; // reduction of the cost, 0 with all the coefficients null
+    bool found=false;
+    for(int subset=1;subset<(1<<NLINEAR);subset++){
+      T c[NLINEAR];
+      if(!solve_linear_subset(BtB,Bty,subset,c)) continue;
+      T reduction=(T)0.0;
+      for(int j=0;j<NLINEAR;j++){
+	reduction+=c[j]*Bty[j];
+      }
+      if(reduction>best){
+	best=reduction;
+	found=true;
+	for(int j=0;j<NLINEAR;j++){
+	  coeffs[j]=c[j];
+	}
+      }
+    }
+    return found;
+  }
+
+  /**
+   * Sets the linear parameters from the coefficients and keeps them inside their bounds
+   */
+  template <typename T>
+  FUNC void set_linear_parameters(T* coeffs, T* P, const int* bound_types,
+				  const float* bounds_min, const float* bounds_max){
+    Linear_Parameters(NPARAMS,coeffs,P);
+    for(int i=0;i<NLINEAR;i++){
+      int p=linear_param(i);
+      if((bound_types[p]==BMIN || bound_types[p]==BMINMAX) && P[p]<(T)bounds_min[p]+(T)LINEAR_BOUNDS_MARGIN){
+	P[p]=(T)bounds_min[p]+(T)LINEAR_BOUNDS_MARGIN;
+      }
+      if((bound_types[p]==BMAX || bound_types[p]==BMINMAX) && P[p]>(T)bounds_max[p]-(T)LINEAR_BOUNDS_MARGIN){
+	P[p]=(T)bounds_max[p]-(T)LINEAR_BOUNDS_MARGIN;
+      }
+    }
+  }
+}
+
+#endif
+
+#endif
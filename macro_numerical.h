@@ -1,5 +1,11 @@
+#ifdef __CUDACC__
 #define MACRO template <typename T> __device__ inline
+#else
+#define MACRO template <typename T> inline
+#endif
 #define NUMERICAL(idpar) numerical(idpar,P,CFP,FixP);
+//Derivatives of all the parameters with automatic differentiation (autodiff.h)
+#define AUTODIFF(CFP_size,FixP_size) autodiff<CFP_size,FixP_size>(P,CFP,FixP,derivatives);
 //Used for numerical differentiation
 #define TINY 1e-5    
 #define MAXSTEP 0.2
@@ -26,3 +32,9 @@ MACRO T numerical(
   P[idpar]=save_param;
   return (signalA-signalB)/step;
 }
+
+#include "voxel_cache.h"
+#include "signal_derivatives.h"
+#include "linear_parameters.h"
+#include "autodiff.h"
+#include "tables.h"
@@ -104,11 +104,25 @@ int main(int argc, char *argv[])
   string path_out;
   path_out.append(opts.outputdir.value());
 
-  for(int par=0;par<nparams;par++){
-    string file_name = "Param_" + num2str(par) + "_samples";
-    std::string output_file=path_out+"/"+file_name;
+  if(opts.runMCMC.value()&&opts.summary_only.value()){
+    // Summaries of the samples: mean, standard deviation and quantiles of each parameter (and tau if Rician noise)
+    int nsummaries=opts.rician.value()?nparams+1:nparams;
+    const char* names[3]={"_mean","_std","_quantiles"};
+    for(int par=0;par<nsummaries;par++){
+      for(int o=0;o<3;o++){
+	string file_name = (par<nparams?"Param_" + num2str(par):string("Tau")) + names[o];
+	std::string output_file=path_out+"/"+file_name;
+	// the number of quantiles is taken from the first part
+	join_Parts(mask,path_in,file_name,output_file,o<2?1:-1,opts.nParts.value(),-10,-10);
+      }
+    }
+  }else{
+    for(int par=0;par<nparams;par++){
+      string file_name = "Param_" + num2str(par) + "_samples";
+      std::string output_file=path_out+"/"+file_name;
             
-    join_Parts(mask,path_in,file_name,output_file,nsamples,opts.nParts.value(),-10,-10);
+      join_Parts(mask,path_in,file_name,output_file,nsamples,opts.nParts.value(),-10,-10);
+    }
   }
 
   // If getPredictedSignal, join the different parts
@@ -131,8 +145,18 @@ int main(int argc, char *argv[])
     
   }
 
+  // If several chains of MCMC, join the convergence diagnostics
+  if(opts.runMCMC.value()&&opts.nchains.value()>1){
+    const char* names[MCMC_NDIAGNOSTICS]={"Rhat","ESS","BurnIn"};
+    for(int d=0;d<MCMC_NDIAGNOSTICS;d++){
+      string file_name = names[d];
+      std::string output_file=path_out+"/"+file_name;
+      join_Parts(mask,path_in,file_name,output_file,1,opts.nParts.value(),-10,-10);
+    }
+  }
+
   // If Rician Noise, join tau samples
-  if(opts.rician.value()&&opts.runMCMC.value()){
+  if(opts.rician.value()&&opts.runMCMC.value()&&!opts.summary_only.value()){
     string file_name = "Tau_samples";
     std::string output_file=path_out+"/"+file_name;
     
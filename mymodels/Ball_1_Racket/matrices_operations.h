@@ -1,4 +1,6 @@
+#ifndef MACRO
 #define MACRO template <typename T> __device__ inline
+#endif
 
 MACRO void transpose_square_matrix(int N, T* A, T* C){
 	for(int row=0;row<N;row++){
@@ -102,23 +102,19 @@ MACRO void Partial_Derivatives(
 			       T* FixP, // Fixed Parameters for each voxel
 			       T* derivatives) // Derivative respect each model estimated parameter
 {
-  T isoterm = exp_gpu(-P[0]*CFP[3]); // exp(-d*bvals)
-  T anisoterm = Calculate_Anisoterm(P,CFP);
-  
-   // d
-  derivatives[0]= NUMERICAL(0)
-
-  // df/dfaniso
-  derivatives[1]= FixP[0]*(-isoterm + anisoterm); // analytic
-  //S0*(-isoterm + anisoterm) 
+  // d,f,k1,k2,th,ph,psi
+  // automatic differentiation: CFP bvecs(3)+bvals(1), FixP S0(1)
+  AUTODIFF(4,1)
+}
 
-  // k1,k2,th,ph,psi
-  // numerical differentiation
-  derivatives[2]= NUMERICAL(2); 
-  derivatives[3]= NUMERICAL(3);
-  derivatives[4]= NUMERICAL(4);
-  derivatives[5]= NUMERICAL(5);
-  derivatives[6]= NUMERICAL(6);
+// Initialisation with a diffusion tensor fit (--init_tensor, see tensor_init.h)
+MACRO void Tensor_Initialisation(
+				 T* tensor, // S0, eigenvalues, MD, FA and orientations of the tensor of the voxel
+				 T* P) // Estimated parameters
+{
+  P[4]=tensor[6]; // th: V1
+  P[5]=tensor[7]; // ph: V1
+  P[6]=tensor[10]; // psi: V2 around V1
 }
 
 // Constraints run after LevenbergMarquardt (if LevenbergMarquardt is used)
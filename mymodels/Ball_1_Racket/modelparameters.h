@@ -6,6 +6,9 @@ typedef double MyType;
 #define NPARAMS 7 // d, faniso, k1, k2, th, ph, psi
 #define NCFP 2 // bvecs, bvals
 #define NFIXP 1 // S0
+#define SCALE_FIXP 0 // S0 (fixed) scales the predicted signal (see dictionary.h)
+#define TENSOR_BVECS 0 // bvecs: CFP[0:2], for the tensor fit of --init_tensor (see tensor_init.h)
+#define TENSOR_BVALS 3 // bvals: CFP[3]
 /////////////////////
 
 ///// Do not edit this /////
@@ -36,25 +36,35 @@ MACRO bool ConstraintsMCMC(
 	return true;
 }
 
-// Partial derivatives respect each model parameter
-MACRO void Partial_Derivatives(
-			       int npar, // Number of Parameters to estimate
-			       T* P, // Estimated parameters, use P*
-			       T* CFP, // Fixed Parameters common to all the voxels
-			       T* FixP, // Fixed Parameters for each voxel
-			       T* derivatives) // Derivative respect each model estimated parameter
+// Predicted signal and partial derivatives respect each model parameter
+// The exponentials and the trigonometric functions are shared by the signal and the derivatives
+MACRO void Signal_And_Derivatives(
+				  int npar, // Number of Parameters to estimate
+				  T* P, // Estimated parameters, use P*
+				  T* CFP, // Fixed Parameters common to all the voxels
+				  T* FixP, // Fixed Parameters for each voxel
+				  T& signal, // Predicted signal
+				  T* derivatives) // Derivative respect each model estimated parameter
 {
+  T sinth=sin_gpu(P[3]);
+  T costh=cos_gpu(P[3]);
+  T sinph=sin_gpu(P[4]);
+  T cosph=cos_gpu(P[4]);
+
   T isoterm= exp_gpu(-P[1]*CFP[3]); 	// exp(-d*bval)
 
-  T xv = CFP[0]*sin_gpu(P[3])*cos_gpu(P[4])	// (bvec(1)*sinth*cosph
-	+ CFP[1]*sin_gpu(P[3])*sin_gpu(P[4])	// + bvec(2)*sinth*sinph
-	+ CFP[2]*cos_gpu(P[3]);			// + bvec(3)*costh)
+  T xv = CFP[0]*sinth*cosph	// (bvec(1)*sinth*cosph
+	+ CFP[1]*sinth*sinph	// + bvec(2)*sinth*sinph
+	+ CFP[2]*costh;		// + bvec(3)*costh)
 		
   T anisoterm= exp_gpu(-P[1]*CFP[3]*xv*xv);	// exp(-d*bval* (pow(xv,2))
 
   // df/dS0
   derivatives[0]= (((T)1.0-P[2])*isoterm + P[2]*anisoterm); // (1-f)*isoterm + f*anisoterm
 
+  signal= P[0]*derivatives[0];
+  // S0*((1-f)*isoterm + f*anisoterm)
+
   // df/dd
   derivatives[1]= -(P[0]*CFP[3])* (((T)1.0-P[2])*isoterm + P[2]*xv*xv*anisoterm);   
   //-S0*bval* ((1-f)*isoterm + (pow(xv,2))*f*anisoterm)
@@ -64,18 +74,57 @@ MACRO void Partial_Derivatives(
   //S0*(-isoterm + anisoterm) 
 
   // df/dth
-  T xv1= cos_gpu(P[3])*(cos_gpu(P[4])*CFP[0] + sin_gpu(P[4])*CFP[1]) -sin_gpu(P[3])*CFP[2];
+  T xv1= costh*(cosph*CFP[0] + sinph*CFP[1]) -sinth*CFP[2];
   //d xv/dth
   derivatives[3]= -(T)2.0*P[0]*P[1]*P[2]*CFP[3]*xv*xv1*anisoterm;
   // -2 * S0 * d * f * bval * xv * xv1 * anisoterm
 
   // df/dph
-  xv1= sin_gpu(P[3])*(-sin_gpu(P[4])*CFP[0] + cos_gpu(P[4])*CFP[1]);
-  //d xv/dth
+  xv1= sinth*(-sinph*CFP[0] + cosph*CFP[1]);
+  //d xv/dph
   derivatives[4]= -(T)2.0*P[0]*P[1]*P[2]*CFP[3]*xv*xv1*anisoterm;
   // -2 * S0 * d * f * bval * xv * xv1 * anisoterm
 }
 
+// Linear parameters (--varpro): signal = coeffs[0]*isoterm + coeffs[1]*anisoterm
+MACRO void Linear_Basis(
+			int npar, // Number of Parameters to estimate
+			T* P, // Estimated parameters
+			T* CFP, // Fixed Parameters common to all the voxels
+			T* FixP, // Fixed Parameters for each voxel
+			T* cache, // Not used
+			T* basis) // Basis functions
+{
+  basis[0]= exp_gpu(-P[1]*CFP[3]); 	// exp(-d*bval)
+
+  T xv = CFP[0]*sin_gpu(P[3])*cos_gpu(P[4])	// (bvec(1)*sinth*cosph
+	+ CFP[1]*sin_gpu(P[3])*sin_gpu(P[4])   	// + bvec(2)*sinth*sinph
+	+ CFP[2]*cos_gpu(P[3]);			// + bvec(3)*costh)
+
+  basis[1]= exp_gpu(-P[1]*CFP[3]*xv*xv);	// exp(-d*bval* (pow(xv,2))
+}
+
+MACRO void Linear_Parameters(
+			     int npar, // Number of Parameters to estimate
+			     T* coeffs, // Coefficients of the basis functions
+			     T* P) // Estimated parameters
+{
+  P[0]= coeffs[0]+coeffs[1]; // S0 = S0*(1-f) + S0*f
+  P[2]= coeffs[1]/P[0]; // f
+}
+
+// Initialisation with a diffusion tensor fit (--init_tensor, see tensor_init.h)
+MACRO void Tensor_Initialisation(
+				 T* tensor, // S0, eigenvalues, MD, FA and orientations of the tensor of the voxel
+				 T* P) // Estimated parameters
+{
+  P[0]=tensor[0]; // S0
+  P[1]=tensor[1]; // d: L1
+  P[2]=tensor[5]; // f: FA
+  P[3]=tensor[6]; // th: V1
+  P[4]=tensor[7]; // ph: V1
+}
+
 // Constraints run after LevenbergMarquardt (if Levenberg-Marquardt is used)
 MACRO void FixConstraintsLM(	
 			    int npar, // Number of Parameters to estimate
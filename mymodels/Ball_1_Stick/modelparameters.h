@@ -6,6 +6,12 @@ typedef double MyType;
 #define NPARAMS 5	// S0, d, f, th ph
 #define NCFP 2		// bvecs, bvals
 #define NFIXP 0
+#define SIGNAL_AND_DERIVATIVES // The signal and the derivatives are computed together (see signal_derivatives.h)
+#define NLINEAR 2 // S0, f: solved in closed form with --varpro (see linear_parameters.h)
+#define LINEAR_PARAMS 0,2
+#define SCALE_PARAM 0 // S0 scales the predicted signal: solved by GridSearch with --dictionary (see dictionary.h)
+#define TENSOR_BVECS 0 // bvecs: CFP[0:2], for the tensor fit of --init_tensor (see tensor_init.h)
+#define TENSOR_BVALS 3 // bvals: CFP[3]
 /////////////////////
 
 ///// Do not edit this /////
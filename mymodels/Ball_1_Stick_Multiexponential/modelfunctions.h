@@ -102,6 +102,18 @@ MACRO void Partial_Derivatives(
     (((T)-2.0*P[1]*P[2]*P[2]*CFP[3]*xv_1*xv_1_d)/(denlogtermAniso1*denlogtermAniso1));
 }
 
+// Initialisation with a diffusion tensor fit (--init_tensor, see tensor_init.h)
+MACRO void Tensor_Initialisation(
+				 T* tensor, // S0, eigenvalues, MD, FA and orientations of the tensor of the voxel
+				 T* P) // Estimated parameters
+{
+  P[0]=tensor[0]; // S0
+  P[1]=tensor[1]; // d: L1
+  P[3]=tensor[5]; // f: FA
+  P[4]=tensor[6]; // th: V1
+  P[5]=tensor[7]; // ph: V1
+}
+
 // Constraints run after LevenbergMarquardt (if LevenbergMarquardt is used)
 MACRO void FixConstraintsLM(	
 		       int npar, // Number of Parameters to estimate
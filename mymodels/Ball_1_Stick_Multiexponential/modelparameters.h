@@ -6,6 +6,9 @@ typedef double MyType;
 #define NPARAMS 6 // S0, d, d_std, f1,th1,ph1
 #define NCFP 2 // bvecs, bvals
 #define NFIXP 0
+#define SCALE_PARAM 0 // S0 scales the predicted signal: solved by GridSearch with --dictionary (see dictionary.h)
+#define TENSOR_BVECS 0 // bvecs: CFP[0:2], for the tensor fit of --init_tensor (see tensor_init.h)
+#define TENSOR_BVALS 3 // bvals: CFP[3]
 /////////////////////
 
 ///// Do not edit this /////
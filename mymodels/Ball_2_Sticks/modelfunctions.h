@@ -4,21 +4,40 @@
 // CFP[0:2] are bvecs 
 // CFP[3] are bvals
 
+// The orientations only depend on the parameters of the voxel (see voxel_cache.h)
+// cache[0:3]: sinth1, costh1, sinph1, cosph1
+// cache[4:7]: sinth2, costh2, sinph2, cosph2
+MACRO void Prepare_Voxel(
+			 T* P, 		// Estimated parameters
+			 T* FixP, 	// Fixed Parameters for each voxel
+			 T* cache) 	// Values precomputed for the voxel
+{
+  cache[0]=sin_gpu(P[3]);
+  cache[1]=cos_gpu(P[3]);
+  cache[2]=sin_gpu(P[4]);
+  cache[3]=cos_gpu(P[4]);
+  cache[4]=sin_gpu(P[6]);
+  cache[5]=cos_gpu(P[6]);
+  cache[6]=sin_gpu(P[7]);
+  cache[7]=cos_gpu(P[7]);
+}
+
 MACRO T Predicted_Signal(
 			 int npar, 	// Number of Parameters to estimate
 			 T* P, 		// Estimated parameters
 			 T* CFP, 	// Fixed Parameters common to all the voxels
-			 T* FixP) 	// Fixed Parameters for each voxel
+			 T* FixP, 	// Fixed Parameters for each voxel
+			 T* cache) 	// Values precomputed for the voxel
 {
   T isoterm= exp_gpu(-P[1]*CFP[3]); 		// exp(-d*bval)
 
-  T xv_1 = CFP[0]*sin_gpu(P[3])*cos_gpu(P[4])   // (bvec(1)*sinth1*cosph1
-	+ CFP[1]*sin_gpu(P[3])*sin_gpu(P[4]) 	// + bvec(2)*sinth1*sinph1
-	+ CFP[2]*cos_gpu(P[3]);			// + bvec(3)*costh1)
+  T xv_1 = CFP[0]*cache[0]*cache[3]   // (bvec(1)*sinth1*cosph1
+	+ CFP[1]*cache[0]*cache[2] 	// + bvec(2)*sinth1*sinph1
+	+ CFP[2]*cache[1];			// + bvec(3)*costh1)
 
-  T xv_2 = CFP[0]*sin_gpu(P[6])*cos_gpu(P[7])	// (bvec(1)*sinth2*cosph2
-	+ CFP[1]*sin_gpu(P[6])*sin_gpu(P[7]) 	// + bvec(2)*sinth2*sinph2
-	+ CFP[2]*cos_gpu(P[6]);			// + bvec(3)*costh2)
+  T xv_2 = CFP[0]*cache[4]*cache[7]	// (bvec(1)*sinth2*cosph2
+	+ CFP[1]*cache[4]*cache[6] 	// + bvec(2)*sinth2*sinph2
+	+ CFP[2]*cache[5];			// + bvec(3)*costh2)
 		
   T anisoterm_1= exp_gpu(-P[1]*CFP[3]*xv_1*xv_1);	// exp(-d*bval* (pow(xv1,2))
   T anisoterm_2= exp_gpu(-P[1]*CFP[3]*xv_2*xv_2);	// exp(-d*bval* (pow(xv2,2))
@@ -47,17 +66,18 @@ MACRO void Partial_Derivatives(
 			       T* P, 		// Estimated parametersß
 			       T* CFP, 		// Fixed Parameters common to all the voxels
 			       T* FixP, 	// Fixed Parameters for each voxel
+			       T* cache, 	// Values precomputed for the voxel
 			       T* derivatives)  // Derivative respect each model estimated parameter
 {
   T isoterm= exp_gpu(-P[1]*CFP[3]); 		// exp(-d*bval)
 
-  T xv_1 = CFP[0]*sin_gpu(P[3])*cos_gpu(P[4])	// (bvec(1)*sinth1*cosph1
-	+ CFP[1]*sin_gpu(P[3])*sin_gpu(P[4]) 	// + bvec(2)*sinth1*sinph1
-	+ CFP[2]*cos_gpu(P[3]);			// + bvec(3)*costh1)
+  T xv_1 = CFP[0]*cache[0]*cache[3]	// (bvec(1)*sinth1*cosph1
+	+ CFP[1]*cache[0]*cache[2] 	// + bvec(2)*sinth1*sinph1
+	+ CFP[2]*cache[1];			// + bvec(3)*costh1)
 
-  T xv_2 = CFP[0]*sin_gpu(P[6])*cos_gpu(P[7])	// (bvec(1)*sinth2*cosph2
-	+ CFP[1]*sin_gpu(P[6])*sin_gpu(P[7]) 	// + bvec(2)*sinth2*sinph2
-	+ CFP[2]*cos_gpu(P[6]);			// + bvec(3)*costh2)
+  T xv_2 = CFP[0]*cache[4]*cache[7]	// (bvec(1)*sinth2*cosph2
+	+ CFP[1]*cache[4]*cache[6] 	// + bvec(2)*sinth2*sinph2
+	+ CFP[2]*cache[5];			// + bvec(3)*costh2)
 		
   T anisoterm_1= exp_gpu(-P[1]*CFP[3]*xv_1*xv_1);	// exp(-d*bval* (pow(xv1,2))
   T anisoterm_2= exp_gpu(-P[1]*CFP[3]*xv_2*xv_2);	// exp(-d*bval* (pow(xv2,2))
@@ -76,13 +96,13 @@ MACRO void Partial_Derivatives(
 
   // d/dth1
   //d xv_1/dth1
-  T xv_1_d= cos_gpu(P[3])*(cos_gpu(P[4])*CFP[0] + sin_gpu(P[4])*CFP[1]) -sin_gpu(P[3])*CFP[2];
+  T xv_1_d= cache[1]*(cache[3]*CFP[0] + cache[2]*CFP[1]) -cache[0]*CFP[2];
   derivatives[3]= -2*P[0]*P[1]*P[2]*CFP[3]*xv_1_d*xv_1*anisoterm_1;
   // -2 * S0 * d * f1 * bval * xv_1_d * xv_1 * anisoterm_1
 
   // d/dph1
   //d xv_1/dph1
-  xv_1_d= sin_gpu(P[3])*(-sin_gpu(P[4])*CFP[0] + cos_gpu(P[4])*CFP[1]);
+  xv_1_d= cache[0]*(-cache[2]*CFP[0] + cache[3]*CFP[1]);
   derivatives[4]= -2*P[0]*P[1]*P[2]*CFP[3]*xv_1_d*xv_1*anisoterm_1;
   // -2 * S0 * d * f1 * bval * xv_1_d * xv_1 * anisoterm_1
 
@@ -92,17 +112,65 @@ MACRO void Partial_Derivatives(
 
   // d/dth2
   //d xv_2/dth2
-  T xv_2_d= cos_gpu(P[6])*(cos_gpu(P[7])*CFP[0] + sin_gpu(P[7])*CFP[1]) -sin_gpu(P[6])*CFP[2];
+  T xv_2_d= cache[5]*(cache[7]*CFP[0] + cache[6]*CFP[1]) -cache[4]*CFP[2];
   derivatives[6]= -2*P[0]*P[1]*P[5]*CFP[3]*xv_2_d*xv_2*anisoterm_2;
   // -2 * S0 * d * f2 * bval * xv_2_d * xv_2 * anisoterm_2
 
   // d/dph2
   //d xv_2/dph2
-  xv_1_d= sin_gpu(P[6])*(-sin_gpu(P[7])*CFP[0] + cos_gpu(P[7])*CFP[1]);
+  xv_1_d= cache[4]*(-cache[6]*CFP[0] + cache[7]*CFP[1]);
   derivatives[7]= -2*P[0]*P[1]*P[5]*CFP[3]*xv_2_d*xv_2*anisoterm_2;
   // -2 * S0 * d * f2 * bval * xv_2_d * xv_2 * anisoterm_2
 }
 
+// Linear parameters (--varpro): signal = coeffs[0]*isoterm + coeffs[1]*anisoterm_1 + coeffs[2]*anisoterm_2
+MACRO void Linear_Basis(
+			int npar, 	// Number of Parameters to estimate
+			T* P, 		// Estimated parameters
+			T* CFP, 	// Fixed Parameters common to all the voxels
+			T* FixP, 	// Fixed Parameters for each voxel
+			T* cache, 	// Values precomputed for the voxel
+			T* basis) 	// Basis functions
+{
+  basis[0]= exp_gpu(-P[1]*CFP[3]); 		// exp(-d*bval)
+
+  T xv_1 = CFP[0]*cache[0]*cache[3]   // (bvec(1)*sinth1*cosph1
+	+ CFP[1]*cache[0]*cache[2] 	// + bvec(2)*sinth1*sinph1
+	+ CFP[2]*cache[1];			// + bvec(3)*costh1)
+
+  T xv_2 = CFP[0]*cache[4]*cache[7]	// (bvec(1)*sinth2*cosph2
+	+ CFP[1]*cache[4]*cache[6] 	// + bvec(2)*sinth2*sinph2
+	+ CFP[2]*cache[5];			// + bvec(3)*costh2)
+
+  basis[1]= exp_gpu(-P[1]*CFP[3]*xv_1*xv_1);	// exp(-d*bval* (pow(xv1,2))
+  basis[2]= exp_gpu(-P[1]*CFP[3]*xv_2*xv_2);	// exp(-d*bval* (pow(xv2,2))
+}
+
+MACRO void Linear_Parameters(
+			     int npar, 	// Number of Parameters to estimate
+			     T* coeffs, // Coefficients of the basis functions
+			     T* P) 	// Estimated parameters
+{
+  P[0]= coeffs[0]+coeffs[1]+coeffs[2]; // S0
+  P[2]= coeffs[1]/P[0]; // f1
+  P[5]= coeffs[2]/P[0]; // f2
+}
+
+// Initialisation with a diffusion tensor fit (--init_tensor, see tensor_init.h)
+MACRO void Tensor_Initialisation(
+				 T* tensor, // S0, eigenvalues, MD, FA and orientations of the tensor of the voxel
+				 T* P) // Estimated parameters
+{
+  P[0]=tensor[0]; // S0
+  P[1]=tensor[1]; // d: L1
+  P[2]=tensor[5]; // f1: FA
+  P[3]=tensor[6]; // th1: V1
+  P[4]=tensor[7]; // ph1: V1
+  P[5]=tensor[5]/(T)4.0; // f2: FA/4
+  P[6]=tensor[8]; // th2: V2
+  P[7]=tensor[9]; // ph2: V2
+}
+
 // Constraints run after LevenbergMarquardt (if LevenbergMarquardt is used)
 MACRO void FixConstraintsLM(	
 		       int npar, // Number of Parameters to estimate
@@ -7,6 +7,13 @@ typedef double MyType;
 //S0, d, f1,th1,ph1, f2,th2,ph2 
 #define NCFP 2
 #define NFIXP 0
+#define NCACHE 8
+// sinth1,costh1,sinph1,cosph1, sinth2,costh2,sinph2,cosph2
+#define NLINEAR 3 // S0, f1, f2: solved in closed form with --varpro (see linear_parameters.h)
+#define LINEAR_PARAMS 0,2,5
+#define SCALE_PARAM 0 // S0 scales the predicted signal: solved by GridSearch with --dictionary (see dictionary.h)
+#define TENSOR_BVECS 0 // bvecs: CFP[0:2], for the tensor fit of --init_tensor (see tensor_init.h)
+#define TENSOR_BVALS 3 // bvals: CFP[3]
 /////////////////////
 
 ///// Do not edit this /////
@@ -57,59 +57,77 @@ MACRO bool ConstraintsMCMC(
   return true;
 }
 
-// Partial derivatives respect each model parameter
-MACRO void Partial_Derivatives(
-			       int npar, // Number of Parameters to estimate
-			       T* P, // Estimated parametersß
-			       T* CFP, // Fixed Parameters common to all the voxels
-			       T* FixP, // Fixed Parameters for each voxel
-			       T* derivatives) // Derivative respect each model estimated parameter
+// Predicted signal and partial derivatives respect each model parameter
+// The logarithms, exponentials and trigonometric functions are shared by the signal and the derivatives
+MACRO void Signal_And_Derivatives(
+				  int npar, // Number of Parameters to estimate
+				  T* P, // Estimated parameters
+				  T* CFP, // Fixed Parameters common to all the voxels
+				  T* FixP, // Fixed Parameters for each voxel
+				  T& signal, // Predicted signal
+				  T* derivatives) // Derivative respect each model estimated parameter
 {
-  T isoterm = exp_gpu( ((P[1]*P[1])/(P[2]*P[2])) * log_gpu(P[1]/(P[1]+P[2]*P[2]*CFP[3])) );
-  // exp( d*d/d_std*d_std * log(d/(d+d_std*d_std*bval)) )
+  T sinth1=sin_gpu(P[4]);
+  T costh1=cos_gpu(P[4]);
+  T sinph1=sin_gpu(P[5]);
+  T cosph1=cos_gpu(P[5]);
+  T sinth2=sin_gpu(P[7]);
+  T costh2=cos_gpu(P[7]);
+  T sinph2=sin_gpu(P[8]);
+  T cosph2=cos_gpu(P[8]);
+  T ratio=((P[1]*P[1])/(P[2]*P[2]));
+  // d*d/d_std*d_std
+
   T denlogtermIso = (P[1] + P[2]*P[2]*CFP[3]);
   // d + dstd * dstd * bval
+  T logtermIso = log_gpu(P[1]/denlogtermIso);
+  T isoterm = exp_gpu(ratio*logtermIso);
+  // exp( d*d/d_std*d_std * log(d/(d+d_std*d_std*bval)) )
 
-  T xv_1 = CFP[0]*sin_gpu(P[4])*cos_gpu(P[5])	// (bvec(1)*sinth1*cosph1
-	+ CFP[1]*sin_gpu(P[4])*sin_gpu(P[5]) 	// + bvec(2)*sinth1*sinph1
-	+ CFP[2]*cos_gpu(P[4]);			// + bvec(3)*costh1)
+  T xv_1 = CFP[0]*sinth1*cosph1	// (bvec(1)*sinth1*cosph1
+	+ CFP[1]*sinth1*sinph1 	// + bvec(2)*sinth1*sinph1
+	+ CFP[2]*costh1;	// + bvec(3)*costh1)
+
+  T xv_2 = CFP[0]*sinth2*cosph2	// (bvec(1)*sinth2*cosph2
+	+ CFP[1]*sinth2*sinph2 	// + bvec(2)*sinth2*sinph2
+	+ CFP[2]*costh2;	// + bvec(3)*costh2)
 
-  T xv_2 = CFP[0]*sin_gpu(P[7])*cos_gpu(P[8])	// (bvec(1)*sinth2*cosph2
-	+ CFP[1]*sin_gpu(P[7])*sin_gpu(P[8]) 	// + bvec(2)*sinth2*sinph2
-	+ CFP[2]*cos_gpu(P[7]);			// + bvec(3)*costh2)
-		
-  T anisoterm_1 = exp_gpu( ((P[1]*P[1])/(P[2]*P[2])) * log_gpu(P[1]/(P[1]+P[2]*P[2]*CFP[3]*xv_1*xv_1)) );
-  // exp( d*d/d_std*d_std * log(d/(d+d_std*d_std*bval*xv_1*xv_1)) )
   T denlogtermAniso1 = (P[1] + P[2]*P[2]*CFP[3]*xv_1*xv_1);
   // d + dstd * dstd * bval * xv_1*xv_1
+  T logtermAniso1 = log_gpu(P[1]/denlogtermAniso1);
+  T anisoterm_1 = exp_gpu(ratio*logtermAniso1);
+  // exp( d*d/d_std*d_std * log(d/(d+d_std*d_std*bval*xv_1*xv_1)) )
 
-  T anisoterm_2 = exp_gpu( ((P[1]*P[1])/(P[2]*P[2])) * log_gpu(P[1]/(P[1]+P[2]*P[2]*CFP[3]*xv_2*xv_2)) );
-  // exp( d*d/d_std*d_std * log(d/(d+d_std*d_std*bval*xv_2*xv_2)) )
   T denlogtermAniso2 = (P[1] + P[2]*P[2]*CFP[3]*xv_2*xv_2);
   // d + dstd * dstd * bval * xv_2*xv_2
-
+  T logtermAniso2 = log_gpu(P[1]/denlogtermAniso2);
+  T anisoterm_2 = exp_gpu(ratio*logtermAniso2);
+  // exp( d*d/d_std*d_std * log(d/(d+d_std*d_std*bval*xv_2*xv_2)) )
 
   // d/dS0
   derivatives[0]= (((T)1.0-P[3]-P[6])*isoterm + P[3]*anisoterm_1 + P[6]*anisoterm_2); 
   // ((1-f1-f2)*isoterm + f1*anisoterm_1 + f2*anisoterm_2)				
 
+  signal = P[0]*derivatives[0];
+  // S0*((1-f1-f2)*isoterm + f1*anisoterm_1 + f2*anisoterm_2)
+
   // d/dd
   // from isoterm
-  derivatives[1]= ((T)1.0-P[3]-P[6]) * (isoterm *( (((T)2.0*P[1])/(P[1]*P[1]))*log_gpu(P[1]/denlogtermIso) + ((P[1]*P[1])/(P[2]*P[2]))*(denlogtermIso/P[1])*((denlogtermIso-P[1])/(denlogtermIso*denlogtermIso)) ) );  
+  derivatives[1]= ((T)1.0-P[3]-P[6]) * (isoterm *( (((T)2.0*P[1])/(P[1]*P[1]))*logtermIso + ratio*(denlogtermIso/P[1])*((denlogtermIso-P[1])/(denlogtermIso*denlogtermIso)) ) );  
   // from anisoterm1
-  derivatives[1]+= P[3] * (anisoterm_1 *( (((T)2.0*P[1])/(P[1]*P[1]))*log_gpu(P[1]/denlogtermAniso1) + ((P[1]*P[1])/(P[2]*P[2]))*(denlogtermAniso1/P[1])*((denlogtermAniso1-P[1])/(denlogtermAniso1*denlogtermAniso1)) ) );  
+  derivatives[1]+= P[3] * (anisoterm_1 *( (((T)2.0*P[1])/(P[1]*P[1]))*logtermAniso1 + ratio*(denlogtermAniso1/P[1])*((denlogtermAniso1-P[1])/(denlogtermAniso1*denlogtermAniso1)) ) );  
   // from anisoterm2
-  derivatives[1]+= (P[6]) * (anisoterm_2 *( (((T)2.0*P[1])/(P[1]*P[1]))*log_gpu(P[1]/denlogtermAniso2) + ((P[1]*P[1])/(P[2]*P[2]))*(denlogtermAniso2/P[1])*((denlogtermAniso2-P[1])/(denlogtermAniso2*denlogtermAniso2)) ) );  
+  derivatives[1]+= (P[6]) * (anisoterm_2 *( (((T)2.0*P[1])/(P[1]*P[1]))*logtermAniso2 + ratio*(denlogtermAniso2/P[1])*((denlogtermAniso2-P[1])/(denlogtermAniso2*denlogtermAniso2)) ) );  
   // * S0
   derivatives[1]*=P[0];
 
   // d/dd_std
   // from isoterm
-  derivatives[2]= ((T)1.0-P[3]-P[6]) * (isoterm *( (((T)-2.0*P[1]*P[1])/(P[1]*P[1]*P[1]))*log_gpu(P[1]/denlogtermIso) + ((P[1]*P[1])/(P[2]*P[2]))*(denlogtermIso/P[1])*(((T)-2.0*P[2]*CFP[3]*P[1])/(denlogtermIso*denlogtermIso)) ) ); 
+  derivatives[2]= ((T)1.0-P[3]-P[6]) * (isoterm *( (((T)-2.0*P[1]*P[1])/(P[1]*P[1]*P[1]))*logtermIso + ratio*(denlogtermIso/P[1])*(((T)-2.0*P[2]*CFP[3]*P[1])/(denlogtermIso*denlogtermIso)) ) ); 
   // from anisoterm1
-  derivatives[2]+= P[3] * (anisoterm_1 *( (((T)-2.0*P[1]*P[1])/(P[1]*P[1]*P[1]))*log_gpu(P[1]/denlogtermAniso1) + ((P[1]*P[1])/(P[2]*P[2]))*(denlogtermAniso1/P[1])*(((T)-2.0*P[2]*CFP[3]*xv_1*xv_1*P[1])/(denlogtermAniso1*denlogtermAniso1)) ) ); 
+  derivatives[2]+= P[3] * (anisoterm_1 *( (((T)-2.0*P[1]*P[1])/(P[1]*P[1]*P[1]))*logtermAniso1 + ratio*(denlogtermAniso1/P[1])*(((T)-2.0*P[2]*CFP[3]*xv_1*xv_1*P[1])/(denlogtermAniso1*denlogtermAniso1)) ) ); 
   // from anisoterm2
-  derivatives[2]+= P[6] * (anisoterm_2 *( (((T)-2.0*P[1]*P[1])/(P[1]*P[1]*P[1]))*log_gpu(P[1]/denlogtermAniso2) + ((P[1]*P[1])/(P[2]*P[2]))*(denlogtermAniso2/P[1])*(((T)-2.0*P[2]*CFP[3]*xv_2*xv_2*P[1])/(denlogtermAniso2*denlogtermAniso2)) ) ); 
+  derivatives[2]+= P[6] * (anisoterm_2 *( (((T)-2.0*P[1]*P[1])/(P[1]*P[1]*P[1]))*logtermAniso2 + ratio*(denlogtermAniso2/P[1])*(((T)-2.0*P[2]*CFP[3]*xv_2*xv_2*P[1])/(denlogtermAniso2*denlogtermAniso2)) ) ); 
   // * S0
   derivatives[2]*=P[0];
 
@@ -119,14 +137,14 @@ MACRO void Partial_Derivatives(
 
   // d/dth1
   //d xv_1/dth1
-  T xv_1_d= cos_gpu(P[4])*(cos_gpu(P[5])*CFP[0] + sin_gpu(P[5])*CFP[1]) -sin_gpu(P[4])*CFP[2];
-  derivatives[4]= P[0]*P[3]*anisoterm_1*((P[1]*P[1])/(P[2]*P[2]))*(denlogtermAniso1/P[1])* 
+  T xv_1_d= costh1*(cosph1*CFP[0] + sinph1*CFP[1]) -sinth1*CFP[2];
+  derivatives[4]= P[0]*P[3]*anisoterm_1*ratio*(denlogtermAniso1/P[1])* 
     (((T)-2.0*P[1]*P[2]*P[2]*CFP[3]*xv_1*xv_1_d)/(denlogtermAniso1*denlogtermAniso1));
 
   // d/dph1
   //d xv_1/dph1
-  xv_1_d= sin_gpu(P[4])*(-sin_gpu(P[5])*CFP[0] + cos_gpu(P[5])*CFP[1]);
-  derivatives[5]= P[0]*P[3]*anisoterm_1*((P[1]*P[1])/(P[2]*P[2]))*(denlogtermAniso1/P[1])* 
+  xv_1_d= sinth1*(-sinph1*CFP[0] + cosph1*CFP[1]);
+  derivatives[5]= P[0]*P[3]*anisoterm_1*ratio*(denlogtermAniso1/P[1])* 
     (((T)-2.0*P[1]*P[2]*P[2]*CFP[3]*xv_1*xv_1_d)/(denlogtermAniso1*denlogtermAniso1));
 
    // df/df2
@@ -135,17 +153,32 @@ MACRO void Partial_Derivatives(
 
   // d/dth2
   //d xv_2/dth2
-  T xv_2_d= cos_gpu(P[7])*(cos_gpu(P[8])*CFP[0] + sin_gpu(P[8])*CFP[1]) -sin_gpu(P[7])*CFP[2];
-  derivatives[7]= P[0]*P[6]*anisoterm_2*((P[1]*P[1])/(P[2]*P[2]))*(denlogtermAniso2/P[1])* 
+  T xv_2_d= costh2*(cosph2*CFP[0] + sinph2*CFP[1]) -sinth2*CFP[2];
+  derivatives[7]= P[0]*P[6]*anisoterm_2*ratio*(denlogtermAniso2/P[1])* 
     (((T)-2.0*P[1]*P[2]*P[2]*CFP[3]*xv_2*xv_2_d)/(denlogtermAniso2*denlogtermAniso2));	
 
   // d/dph2
   //d xv_2/dph2
-  xv_2_d= sin_gpu(P[7])*(-sin_gpu(P[8])*CFP[0] + cos_gpu(P[8])*CFP[1]);
-  derivatives[8]= P[0]*P[6]*anisoterm_2*((P[1]*P[1])/(P[2]*P[2]))*(denlogtermAniso2/P[1])* 
+  xv_2_d= sinth2*(-sinph2*CFP[0] + cosph2*CFP[1]);
+  derivatives[8]= P[0]*P[6]*anisoterm_2*ratio*(denlogtermAniso2/P[1])* 
     (((T)-2.0*P[1]*P[2]*P[2]*CFP[3]*xv_2*xv_2_d)/(denlogtermAniso2*denlogtermAniso2));
 }
 
+// Initialisation with a diffusion tensor fit (--init_tensor, see tensor_init.h)
+MACRO void Tensor_Initialisation(
+				 T* tensor, // S0, eigenvalues, MD, FA and orientations of the tensor of the voxel
+				 T* P) // Estimated parameters
+{
+  P[0]=tensor[0]; // S0
+  P[1]=tensor[1]; // d: L1
+  P[3]=tensor[5]; // f1: FA
+  P[4]=tensor[6]; // th1: V1
+  P[5]=tensor[7]; // ph1: V1
+  P[6]=tensor[5]/(T)2.0; // f2: FA/2
+  P[7]=tensor[8]; // th2: V2
+  P[8]=tensor[9]; // ph2: V2
+}
+
 // Constraints run after LevenbergMarquardt (if LevenbergMarquardt is used)
 MACRO void FixConstraintsLM(	
 		       int npar, // Number of Parameters to estimate
@@ -6,6 +6,10 @@ typedef double MyType;
 #define NPARAMS 9 // S0, d, d_std, f1,th1,ph1, f2,th2,ph2
 #define NCFP 2 // bvecs, bvals
 #define NFIXP 0
+#define SIGNAL_AND_DERIVATIVES // The signal and the derivatives are computed together (see signal_derivatives.h)
+#define SCALE_PARAM 0 // S0 scales the predicted signal: solved by GridSearch with --dictionary (see dictionary.h)
+#define TENSOR_BVECS 0 // bvecs: CFP[0:2], for the tensor fit of --init_tensor (see tensor_init.h)
+#define TENSOR_BVALS 3 // bvals: CFP[3]
 /////////////////////
 
 ///// Do not edit this /////
@@ -1,4 +1,6 @@
+#ifndef MACRO
 #define MACRO template <typename T> __device__ inline
+#endif
 
 // In DTI model the parameters P are:
 // S0: 0
@@ -113,6 +115,60 @@ MACRO void Partial_Derivatives(
     * (-CFP[3]*pow_gpu(CFP[2],2));
 }
 
+// Linear parameters (--varpro): signal = coeffs[0]*exp(-bval*g^T D g)
+MACRO void Linear_Basis(
+			int npar, // Number of Parameters to estimate
+			T* P, // Estimated parameters
+			T* CFP, // Fixed Parameters common to all the voxels
+			T* FixP, // Fixed Parameters for each voxel
+			T* cache, // Not used
+			T* basis) // Basis functions
+{
+  basis[0]= exp(-CFP[3]*pow_gpu(CFP[0],2)*P[1] 
+		- CFP[3]*pow_gpu(CFP[1],2)*P[4] 
+		- CFP[3]*pow_gpu(CFP[2],2)*P[6] 
+		- 2*CFP[3]*CFP[0]*CFP[1]*P[2] 
+		- 2*CFP[3]*CFP[0]*CFP[2]*P[3] 
+		- 2*CFP[3]*CFP[1]*CFP[2]*P[5]);
+}
+
+MACRO void Linear_Parameters(
+			     int npar, // Number of Parameters to estimate
+			     T* coeffs, // Coefficients of the basis functions
+			     T* P) // Estimated parameters
+{
+  P[0]= coeffs[0]; // S0
+}
+
+// Initialisation with a diffusion tensor fit (--init_tensor, see tensor_init.h)
+// D = L1*V1*V1' + L2*V2*V2' + L3*V3*V3', with V3 = V1 x V2
+MACRO void Tensor_Initialisation(
+				 T* tensor, // S0, eigenvalues, MD, FA and orientations of the tensor of the voxel
+				 T* P) // Estimated parameters
+{
+  T V[3][3];
+  V[0][0]=sin_gpu(tensor[6])*cos_gpu(tensor[7]);
+  V[0][1]=sin_gpu(tensor[6])*sin_gpu(tensor[7]);
+  V[0][2]=cos_gpu(tensor[6]);
+  V[1][0]=sin_gpu(tensor[8])*cos_gpu(tensor[9]);
+  V[1][1]=sin_gpu(tensor[8])*sin_gpu(tensor[9]);
+  V[1][2]=cos_gpu(tensor[8]);
+  V[2][0]=V[0][1]*V[1][2]-V[0][2]*V[1][1];
+  V[2][1]=V[0][2]*V[1][0]-V[0][0]*V[1][2];
+  V[2][2]=V[0][0]*V[1][1]-V[0][1]*V[1][0];
+
+  P[0]=tensor[0]; // S0
+  P[1]=(T)0.0; P[2]=(T)0.0; P[3]=(T)0.0; P[4]=(T)0.0; P[5]=(T)0.0; P[6]=(T)0.0;
+  for(int i=0;i<3;i++){
+    P[1]+=tensor[1+i]*V[i][0]*V[i][0]; // Dxx
+    P[2]+=tensor[1+i]*V[i][0]*V[i][1]; // Dxy
+    P[3]+=tensor[1+i]*V[i][0]*V[i][2]; // Dxz
+    P[4]+=tensor[1+i]*V[i][1]*V[i][1]; // Dyy
+    P[5]+=tensor[1+i]*V[i][1]*V[i][2]; // Dyz
+    P[6]+=tensor[1+i]*V[i][2]*V[i][2]; // Dzz
+  }
+}
+
 // Constraints run after LevenbergMarquardt (if LevenbergMarquardt is used)
 MACRO void FixConstraintsLM(	
 			    int npar, // Number of Parameters to estimate
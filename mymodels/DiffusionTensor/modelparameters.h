@@ -6,6 +6,11 @@ typedef double MyType;
 #define NPARAMS 7 // S0,Dxx,Dxy,Dxz,Dyy,Dyz,Dzz
 #define NCFP 2
 #define NFIXP 0
+#define NLINEAR 1 // S0: solved in closed form with --varpro (see linear_parameters.h)
+#define LINEAR_PARAMS 0
+#define SCALE_PARAM 0 // S0 scales the predicted signal: solved by GridSearch with --dictionary (see dictionary.h)
+#define TENSOR_BVECS 0 // bvecs: CFP[0:2], for the tensor fit of --init_tensor (see tensor_init.h)
+#define TENSOR_BVALS 3 // bvals: CFP[3]
 /////////////////////
 
 ///// Do not edit this /////
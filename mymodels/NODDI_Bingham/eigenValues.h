@@ -1,4 +1,6 @@
+#ifndef MACRO
 #define MACRO template <typename T> __device__ inline
+#endif
 
 #define MPI 3.14159265358979323846
 #define SQR(x) ((x)*(x)) // x^2
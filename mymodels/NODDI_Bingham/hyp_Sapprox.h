@@ -1,4 +1,6 @@
+#ifndef MACRO
 #define MACRO template <typename T> __device__ inline
+#endif
 
 #define MPI 3.14159265358979323846
 #define MSQRT3 1.73205080756887729352744634151
@@ -1,10 +1,15 @@
+#ifndef MACRO
 #define MACRO template <typename T> __device__ inline
+#endif
 
 #define MPI 3.14159265358979323846
 #define MSQRT3 1.73205080756887729352744634151
 #define MINV3 0.33333333333333333
 #define MINV54 0.018518518518519
 
+// Id of the interpolation table (see tables.h)
+#define TABLE_BINGHAM_NC 0
+
 MACRO T croot_doublePrecision(T x){
   if (x>=0.0){ 
     return exp(log(x)*MINV3);
@@ -61,12 +66,12 @@ MACRO double find_t_doublePrecision(T x1, T x2, T x3){
       z3=z2;
     }
   }
-  z1=min(z1,z2); 
-  z1=min(z1,z3);
+  z1=min_gpu(z1,z2); 
+  z1=min_gpu(z1,z3);
   return z1;
 }
 
-MACRO T hyp_Sapprox_doublePrecision(T x1, T x2, T x3){
+MACRO T hyp_Sapprox_doublePrecision_exact(T x1, T x2, T x3){
   // Saddlepoint approximation of hypergeometric function of a matrix argument
   // Vector x has the eigenvalues 
   
@@ -129,3 +134,20 @@ MACRO T hyp_Sapprox_doublePrecision(T x1, T x2, T x3){
   
   return c1;
 }
+
+MACRO T hyp_Sapprox_doublePrecision(T x1, T x2, T x3){
+  // hyp(x) = exp(m)*hyp(x-m), with m the largest eigenvalue. The table is a function of the square roots of the two differences m-x that are not 0 (symmetric)
+  T m = max_gpu(x1,max_gpu(x2,x3));
+  T d1 = m-x1;
+  T d2 = m-x2;
+  T d3 = m-x3;
+  T dmax = max_gpu(d1,max_gpu(d2,d3));
+  T su = sqrt_gpu(dmax);
+  T sv = sqrt_gpu(d1+d2+d3-dmax);
+  T shifted;
+  // hyp_Sapprox_doublePrecision_exact returns 1 if all the eigenvalues are 0
+  if((m!=0 || dmax!=0) && table_2d(TABLE_BINGHAM_NC,su,sv,&shifted)){
+    return exp_gpu(m)*shifted;
+  }
+  return hyp_Sapprox_doublePrecision_exact(x1,x2,x3);
+}
@@ -17,14 +17,58 @@
 
 // FixP[0] is S0
 
-MACRO T Calculate_ExtraCellular(T* P,
-				T* CFP,
-				T &xv,
-				T &gradXLocal,
-				T &gradYLocal)
+#ifdef TABULATE
+// Special functions tabulated with --tables (see tables.h), only compiled on the host
+inline void BinghamNC_table(double su, double sv, double* values){
+  // su, sv: square roots of the differences of the eigenvalues with the largest one
+  // hyp_Sapprox returns exactly 1 at the origin, the table uses the limit of the approximation
+  if(su==0.0 && sv==0.0) su=1e-6;
+  values[0]=hyp_Sapprox_doublePrecision_exact(0.0,-su*su,-sv*sv);
+}
+
+inline void Tabulate_Functions(){
+  // differences of the eigenvalues of the Bingham matrix up to 96: kappa<=64 plus bval*dPar
+  Cudimot::tabulate_2d(TABLE_BINGHAM_NC,"Bingham normaliser",0.0,sqrt(96.0),0.0,sqrt(96.0),1,BinghamNC_table);
+}
+#endif
+
+// Values that only depend on the bvals (see protocol_cache.h), stored in CFP[4]
+// protocol[0]: isotropic signal
+MACRO void Prepare_Protocol(
+			    T* CFP, // Fixed Parameters common to all the voxels (one measurement)
+			    T* protocol) // Values precomputed for the measurement
 {
-  // Calculate Signal from ExtraCellular compartment //
-  
+  protocol[0] = exp_gpu(-CFP[3]*Diso); 	// exp(-bval*d)
+}
+
+// Values of the voxel that do not depend on the measurement (see voxel_cache.h)
+// cache[0:2]: fibredir
+// cache[3:5]: fanningdir
+// cache[6:8]: cross(fanningdir,fibredir)
+// cache[9:11]: hindered diffusivities dPar, dPerp1, dPerp2
+// cache[12]: 1/normaliser of the Bingham distribution
+MACRO void Prepare_Voxel(
+			 T* P, 	// Estimated parameters
+			 T* FixP, // Fixed Parameters for each voxel
+			 T* cache) // Values precomputed for the voxel
+{
+  // fibredir = [sinTheta.*cosPhi sinTheta.*sinPhi cosTheta]';
+  T* fibredir=&cache[0];
+  fibredir[0] = sin_gpu(P[4])*cos_gpu(P[5]);
+  fibredir[1] = sin_gpu(P[4])*sin_gpu(P[5]);
+  fibredir[2] = cos_gpu(P[4]);
+
+  // fanningdir = [ -cosPsi.*sinPhi - cosTheta.*cosPhi.*sinPsi cosPhi.*cosPsi - cosTheta.*sinPhi.*sinPsi sinTheta.*sinPsi]';
+  T* fanningdir=&cache[3];
+  fanningdir[0] = -cos_gpu(P[6])*sin_gpu(P[5]) - cos_gpu(P[4])*cos_gpu(P[5])*sin_gpu(P[6]);
+  fanningdir[1] = cos_gpu(P[5])*cos_gpu(P[6]) - cos_gpu(P[4])*sin_gpu(P[5])*sin_gpu(P[6]);
+  fanningdir[2] = sin_gpu(P[4])*sin_gpu(P[6]);
+
+  T* crossProduct_fanfib=&cache[6];
+  crossProduct_fanfib[0] = fanningdir[1]*fibredir[2] - fanningdir[2]*fibredir[1];
+  crossProduct_fanfib[1] = fanningdir[2]*fibredir[0] - fanningdir[0]*fibredir[2];
+  crossProduct_fanfib[2] = fanningdir[0]*fibredir[1] - fanningdir[1]*fibredir[0];
+
   //dPerp = dPar*(1-f);
   T Dperpendicular = Dparallel*(1-P[1]);
 
@@ -49,6 +93,25 @@ MACRO T Calculate_ExtraCellular(T* P,
   dPerp2 = Dparallel + 2*Dperpendicular - dPar - dPerp1;
   ////////
 
+  cache[9] = dPar;
+  cache[10] = dPerp1;
+  cache[11] = dPerp2;
+  cache[12] = 1/nc;
+}
+
+MACRO T Calculate_ExtraCellular(T* P,
+				T* CFP,
+				T* cache,
+				T &xv,
+				T &gradXLocal,
+				T &gradYLocal)
+{
+  // Calculate Signal from ExtraCellular compartment //
+  
+  T dPar = cache[9]; // diffusivity along the dominant orientation
+  T dPerp1 = cache[10]; // diffusivity along the fanning direction
+  T dPerp2 = cache[11]; // diffusivity along the final direction
+
   T cosThetaSq = xv*xv;
   T sinThetaSq = 1-(cosThetaSq);
   T phi= atan2_gpu(gradYLocal, gradXLocal);
@@ -63,6 +126,7 @@ MACRO T Calculate_ExtraCellular(T* P,
 
 MACRO T Calculate_IntraCellular(T* P,
 				T* CFP,
+				T* cache,
 				T& xv,
 				T &gradXLocal,
 				T &gradYLocal)
@@ -72,7 +136,7 @@ MACRO T Calculate_IntraCellular(T* P,
   T parComp =-CFP[3]*Dparallel; // Parallel component: -bval * dintra
   // Radius is 0, so no Perpendicular Component
 
-  T BinghamNC = 1/hyp_Sapprox_doublePrecision(P[2],P[3],(T)0.0);
+  T BinghamNC = cache[12];
 
   T Matrix[9];
   // matrix = [0 0 0; 0 beta 0; 0 0 kappa];
@@ -97,49 +161,34 @@ MACRO T Calculate_IntraCellular(T* P,
 }
 
 MACRO void get_GradLocals(
-		       T* P,
 		       T* CFP,
-		       T* fibredir,
+		       T* cache,
 		       T* gradsLocal)
 {  
   // gradYLocal = grad_dirs*fanningdir;
-  // fanningdir = [ -cosPsi.*sinPhi - cosTheta.*cosPhi.*sinPsi cosPhi.*cosPsi - cosTheta.*sinPhi.*sinPsi sinTheta.*sinPsi]';
-  T fanningdir[3];
-  fanningdir[0] = -cos_gpu(P[6])*sin_gpu(P[5]) - cos_gpu(P[4])*cos(P[5])*sin_gpu(P[6]);
-  fanningdir[1] = cos_gpu(P[5])*cos_gpu(P[6]) - cos_gpu(P[4])*sin_gpu(P[5])*sin_gpu(P[6]);
-  fanningdir[2] = sin_gpu(P[4])*sin_gpu(P[6]);
-
-  gradsLocal[1] =  CFP[0]*fanningdir[0] +  CFP[1]*fanningdir[1] + CFP[2]*fanningdir[2];
-  
-  T crossProduct_fanfib[3];
-  crossProduct_fanfib[0] = fanningdir[1]*fibredir[2] - fanningdir[2]*fibredir[1];
-  crossProduct_fanfib[1] = fanningdir[2]*fibredir[0] - fanningdir[0]*fibredir[2];
-  crossProduct_fanfib[2] = fanningdir[0]*fibredir[1] - fanningdir[1]*fibredir[0];
+  gradsLocal[1] =  CFP[0]*cache[3] +  CFP[1]*cache[4] + CFP[2]*cache[5];
   
   // gradXLocal = grad_dirs*cross(fanningdir,fibredir);
-  gradsLocal[0] =  CFP[0]*crossProduct_fanfib[0] +  CFP[1]*crossProduct_fanfib[1] + CFP[2]*crossProduct_fanfib[2];
+  gradsLocal[0] =  CFP[0]*cache[6] +  CFP[1]*cache[7] + CFP[2]*cache[8];
 }
 
 MACRO T Predicted_Signal(
 			 int npar, // Number of Parameters to estimate
 			 T* P, 	// Estimated parameters
 			 T* CFP, // Fixed Parameters common to all the voxels
-			 T* FixP) // Fixed Parameters for each voxel
+			 T* FixP, // Fixed Parameters for each voxel
+			 T* cache) // Values precomputed for the voxel
 {
-  T isoterm = exp_gpu(-CFP[3]*Diso); 	// exp(-bval*d)
+  T isoterm = CFP[4]; 	// exp(-bval*d), see Prepare_Protocol
 
   // cosTheta
-  T fibredir[3];
-  fibredir[0] = sin_gpu(P[4])*cos_gpu(P[5]);
-  fibredir[1] = sin_gpu(P[4])*sin_gpu(P[5]);
-  fibredir[2] = cos_gpu(P[4]);
-  T xv = CFP[0]*fibredir[0] + CFP[1]*fibredir[1] + CFP[2]*fibredir[2];
+  T xv = CFP[0]*cache[0] + CFP[1]*cache[1] + CFP[2]*cache[2];
 
   T gradsLocal[2];
-  get_GradLocals(P,CFP,fibredir,gradsLocal);
+  get_GradLocals(CFP,cache,gradsLocal);
 
-  T ExtraCell = Calculate_ExtraCellular(P,CFP,xv,gradsLocal[0],gradsLocal[1]);
-  T IntraCell = Calculate_IntraCellular(P,CFP,xv,gradsLocal[0],gradsLocal[1]);
+  T ExtraCell = Calculate_ExtraCellular(P,CFP,cache,xv,gradsLocal[0],gradsLocal[1]);
+  T IntraCell = Calculate_IntraCellular(P,CFP,cache,xv,gradsLocal[0],gradsLocal[1]);
     		
   T anisoterm = (1-P[1])*ExtraCell+P[1]*IntraCell;
       
@@ -166,22 +215,19 @@ MACRO void Partial_Derivatives(
 			       T* P, // Estimated parameters, use P*
 			       T* CFP, // Fixed Parameters common to all the voxels
 			       T* FixP, // Fixed Parameters for each voxel
+			       T* cache, // Values precomputed for the voxel
 			       T* derivatives) // Derivative respect each model estimated parameter
 {
-  T isoterm = exp_gpu(-CFP[3]*Diso); 	// exp(-bval*d)
+  T isoterm = CFP[4]; 	// exp(-bval*d), see Prepare_Protocol
 
   // cosTheta
-  T fibredir[3];
-  fibredir[0] = sin_gpu(P[4])*cos_gpu(P[5]);
-  fibredir[1] = sin_gpu(P[4])*sin_gpu(P[5]);
-  fibredir[2] = cos_gpu(P[4]);
-  T xv = CFP[0]*fibredir[0] + CFP[1]*fibredir[1] + CFP[2]*fibredir[2];
+  T xv = CFP[0]*cache[0] + CFP[1]*cache[1] + CFP[2]*cache[2];
 
   T gradsLocal[2];
-  get_GradLocals(P,CFP,fibredir,gradsLocal);
+  get_GradLocals(CFP,cache,gradsLocal);
 
-  T ExtraCell = Calculate_ExtraCellular(P,CFP,xv,gradsLocal[0],gradsLocal[1]);
-  T IntraCell = Calculate_IntraCellular(P,CFP,xv,gradsLocal[0],gradsLocal[1]);
+  T ExtraCell = Calculate_ExtraCellular(P,CFP,cache,xv,gradsLocal[0],gradsLocal[1]);
+  T IntraCell = Calculate_IntraCellular(P,CFP,cache,xv,gradsLocal[0],gradsLocal[1]);
   
   T anisoterm = (1-P[1])*ExtraCell+P[1]*IntraCell;
 
@@ -207,6 +253,16 @@ MACRO void Partial_Derivatives(
   derivatives[6]=NUMERICAL(6);
 }
 
+// Initialisation with a diffusion tensor fit (--init_tensor, see tensor_init.h)
+MACRO void Tensor_Initialisation(
+				 T* tensor, // S0, eigenvalues, MD, FA and orientations of the tensor of the voxel
+				 T* P) // Estimated parameters
+{
+  P[4]=tensor[6]; // th: V1
+  P[5]=tensor[7]; // ph: V1
+  P[6]=tensor[10]; // psi: V2 around V1
+}
+
 // Constraints run after LevenbergMarquardt (if LevenbergMarquardt is used)
 MACRO void FixConstraintsLM(	
 			    int npar, // Number of Parameters to estimate
@@ -6,6 +6,14 @@ typedef double MyType;
 #define NPARAMS 7 // fiso, fintra, kappa, beta, th, ph, psi
 #define NCFP 2 // bvecs, bvals
 #define NFIXP 1 // S0
+#define NCACHE 13 // fibre, fanning and normal directions(9), hindered diffusivities(3), Bingham normaliser(1)
+#define NPROTOCOL 1 // isotropic signal: CFP[4]
+#define PROTOCOL_SHELL 3 // it only depends on the bvals
+#define NTABLES 1 // Bingham normaliser (--tables)
+#define SCALE_FIXP 0 // S0 (fixed) scales the predicted signal (see dictionary.h)
+#define TENSOR_BVECS 0 // bvecs: CFP[0:2], for the tensor fit of --init_tensor (see tensor_init.h)
+#define TENSOR_BVALS 3 // bvals: CFP[3]
+#define MODEL_CPU_LANES 1 // the branches of the special functions are not vectorized: one voxel at a time on the CPU (see cpu_lanes.h)
 /////////////////////
 
 ///// Do not edit this /////
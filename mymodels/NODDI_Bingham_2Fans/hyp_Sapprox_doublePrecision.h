@@ -1,4 +1,6 @@
+#ifndef MACRO
 #define MACRO template <typename T> __device__ inline
+#endif
 
 #define MPI 3.14159265358979323846
 #define MSQRT3 1.73205080756887729352744634151
@@ -61,8 +63,8 @@ MACRO double find_t_doublePrecision(T x1, T x2, T x3){
       z3=z2;
     }
   }
-  z1=min(z1,z2); 
-  z1=min(z1,z3);
+  z1=min_gpu(z1,z2); 
+  z1=min_gpu(z1,z3);
   return z1;
 }
 
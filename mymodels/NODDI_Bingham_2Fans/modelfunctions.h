@@ -309,6 +309,19 @@ MACRO void Partial_Derivatives(
   derivatives[13]=NUMERICAL(13);
 }
 
+// Initialisation with a diffusion tensor fit (--init_tensor, see tensor_init.h)
+MACRO void Tensor_Initialisation(
+				 T* tensor, // S0, eigenvalues, MD, FA and orientations of the tensor of the voxel
+				 T* P) // Estimated parameters
+{
+  P[5]=tensor[6]; // th1: V1
+  P[6]=tensor[7]; // ph1: V1
+  P[7]=tensor[10]; // psi1: V2 around V1
+  P[11]=tensor[8]; // th2: V2
+  P[12]=tensor[9]; // ph2: V2
+  P[13]=tensor[10]; // psi2: as psi1
+}
+
 // Constraints run after LevenbergMarquardt (if LevenbergMarquardt is used)
 MACRO void FixConstraintsLM(	
 			    int npar, // Number of Parameters to estimate
@@ -10,6 +10,10 @@ typedef double MyType;
 // fintra2, kappa2, beta2, th2, ph2, psi2
 #define NCFP 2 // bvecs, bvals
 #define NFIXP 1 // S0
+#define SCALE_FIXP 0 // S0 (fixed) scales the predicted signal (see dictionary.h)
+#define TENSOR_BVECS 0 // bvecs: CFP[0:2], for the tensor fit of --init_tensor (see tensor_init.h)
+#define TENSOR_BVALS 3 // bvals: CFP[3]
+#define MODEL_CPU_LANES 1 // the branches of the special functions are not vectorized: one voxel at a time on the CPU (see cpu_lanes.h)
 /////////////////////
 
 ///// Do not edit this /////
@@ -1,36 +1,48 @@
+#ifndef MACRO
 #define MACRO template <typename T> __device__ inline
+#endif
 
 #define MN 7
 
+// Id of the interpolation table (see tables.h)
+#define TABLE_LEGENDRE 2
+
+//legendre gaussian integrals, order 6, exact expression used for x>0.05
+MACRO void legendreGaussianIntegral_exact(T x, T* L)
+{
+  T I[MN];
+  T sqrtx = sqrt_gpu(x);
+  I[0] = sqrt_gpu((T)MPI)*erff(sqrtx)/sqrtx;
+  T dx = (T)1.0/x;
+  T emx = -exp_gpu(-x);
+  for (int i=1;i<MN;i++){
+    I[i] = emx + ((i+1)-(T)1.5)*I[i-1];
+    I[i] = I[i]*dx;
+  }
+  
+  L[0] = I[0];
+
+  L[1] = -(T)0.5*I[0] + (T)1.5*I[1];
+
+  L[2] = (T)0.375*I[0] - (T)3.75*I[1] + (T)4.375*I[2];
+
+  L[3] = -(T)0.3125*I[0] + (T)6.5625*I[1] - (T)19.6875*I[2] + (T)14.4375*I[3];
+
+  L[4] = (T)0.2734375*I[0] - (T)9.84375*I[1] + (T)54.140625*I[2] - (T)93.84375*I[3] + (T)50.2734375*I[4];
+  
+  L[5] = -((T)63.0/(T)256.0)*I[0] + ((T)3465.0/(T)256.0)*I[1] - ((T)30030.0/(T)256.0)*I[2] + ((T)90090.0/(T)256.0)*I[3] - ((T)109395.0/(T)256.0)*I[4] + ((T)46189.0/(T)256.0)*I[5];
+  
+  L[6] = ((T)231.0/(T)1024.0)*I[0] - ((T)18018.0/(T)1024.0)*I[1] + ((T)225225.0/(T)1024.0)*I[2] - ((T)1021020.0/(T)1024.0)*I[3] + ((T)2078505.0/(T)1024.0)*I[4] - ((T)1939938.0/(T)1024.0)*I[5] + ((T)676039.0/(T)1024.0)*I[6];
+}
+
 //legendre gaussian integrals, order 6
 MACRO void legendreGaussianIntegral(T x, T* L)
 {
   if(x>(T)0.05){
     //exact
-    T I[MN];
-    T sqrtx = sqrt_gpu(x);
-    I[0] = sqrt_gpu((T)MPI)*erff(sqrtx)/sqrtx;
-    T dx = (T)1.0/x;
-    T emx = -exp_gpu(-x);
-    for (int i=1;i<MN;i++){
-      I[i] = emx + ((i+1)-(T)1.5)*I[i-1];
-      I[i] = I[i]*dx;
+    if(!table_1d(TABLE_LEGENDRE,x,L)){
+      legendreGaussianIntegral_exact(x,L);
     }
-    
-    L[0] = I[0];
-	
-    L[1] = -(T)0.5*I[0] + (T)1.5*I[1];
-	
-    L[2] = (T)0.375*I[0] - (T)3.75*I[1] + (T)4.375*I[2];
-   
-    L[3] = -(T)0.3125*I[0] + (T)6.5625*I[1] - (T)19.6875*I[2] + (T)14.4375*I[3];
-	
-    L[4] = (T)0.2734375*I[0] - (T)9.84375*I[1] + (T)54.140625*I[2] - (T)93.84375*I[3] + (T)50.2734375*I[4];
-    
-    L[5] = -((T)63.0/(T)256.0)*I[0] + ((T)3465.0/(T)256.0)*I[1] - ((T)30030.0/(T)256.0)*I[2] + ((T)90090.0/(T)256.0)*I[3] - ((T)109395.0/(T)256.0)*I[4] + ((T)46189.0/(T)256.0)*I[5];
-    
-    L[6] = ((T)231.0/(T)1024.0)*I[0] - ((T)18018.0/(T)1024.0)*I[1] + ((T)225225.0/(T)1024.0)*I[2] - ((T)1021020.0/(T)1024.0)*I[3] + ((T)2078505.0/(T)1024.0)*I[4] - ((T)1939938.0/(T)1024.0)*I[5] + ((T)676039.0/(T)1024.0)*I[6];
-   
   }else{
     // x<=0.05, approx
     // Computing the legendre gaussian integrals for small x
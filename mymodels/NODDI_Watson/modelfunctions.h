@@ -23,19 +23,68 @@ MACRO T step_size(T param, T scale){
   return step;
 }
 
+#ifdef TABULATE
+// Special functions tabulated with --tables (see tables.h), only compiled on the host
+inline void WatsonSHCoeff_table(double k, double* values){
+  double coeff[7];
+  WatsonSHCoeff_exact(k,coeff);
+  for(int i=0;i<6;i++) values[i]=coeff[i+1];
+}
+
+inline void dawson_table(double x, double* values){
+  values[0]=dawson(x);
+}
+
+inline void Tabulate_Functions(){
+  // kappa, in the range of the exact expression of WatsonSHCoeff
+  Cudimot::tabulate_1d(TABLE_WATSON_SH,"Watson SH coefficients",1.5,30.0,6,WatsonSHCoeff_table);
+  // sqrt(kappa), kappa<=64
+  Cudimot::tabulate_1d(TABLE_DAWSON,"dawson",0.0,8.0,1,dawson_table);
+  // bval*d_par
+  Cudimot::tabulate_1d(TABLE_LEGENDRE,"Legendre gaussian integrals",4.0,64.0,7,legendreGaussianIntegral_exact<double>);
+}
+#endif
+
+// Values that only depend on the bvals (see protocol_cache.h), stored in CFP[4]
+// protocol[0]: isotropic signal
+MACRO void Prepare_Protocol(
+			    T* CFP, // Fixed Parameters common to all the voxels (one measurement)
+			    T* protocol) // Values precomputed for the measurement
+{
+  protocol[0] = exp_gpu(-CFP[3]*Diso); 	// exp(-bval*d)
+}
+
+// Values of the voxel that do not depend on the measurement (see voxel_cache.h)
+// cache[0:2]: fibre orientation (sinth*cosph, sinth*sinph, costh)
+// cache[3:4]: hindered diffusivities, parallel and perpendicular
+// cache[5:11]: spherical harmonic coefficients of the Watson's distribution
+MACRO void Prepare_Voxel(
+			 T* P, 	// Estimated parameters
+			 T* FixP, // Fixed Parameters for each voxel
+			 T* cache) // Values precomputed for the voxel
+{
+  cache[0]=sin_gpu(P[3])*cos_gpu(P[4]);
+  cache[1]=sin_gpu(P[3])*sin_gpu(P[4]);
+  cache[2]=cos_gpu(P[3]);
+
+  //dPerp = dPar*(1-f);
+  T Dperpendicular = P[5]*(1-P[1]);
+  
+  WatsonHinderedDiffusionCoeff(P[2],P[5],Dperpendicular,cache[3],cache[4]);
+  
+  // Compute the spherical harmonic coefficients of the Watson's distribution
+  WatsonSHCoeff(P[2],&cache[5]);
+}
+
 MACRO T Calculate_ExtraCellular(T* P,
 				T* CFP,
+				T* cache,
 				T& xv)
 {
   // Calculate Signal from ExtraCellular compartment //
   
-  //dPerp = dPar*(1-f);
-  T Dperpendicular = P[5]*(1-P[1]);
-  
-  T Dpar_equivalent;
-  T Dperp_equivalent;
-  
-  WatsonHinderedDiffusionCoeff(P[2],P[5],Dperpendicular,Dpar_equivalent,Dperp_equivalent);
+  T Dpar_equivalent=cache[3];
+  T Dperp_equivalent=cache[4];
   
   //exp(-bval.*((dPar - dPerp)*cosThetaSq + dPerp));
   T ExtraCell = exp_gpu(-CFP[3]*((Dpar_equivalent - Dperp_equivalent)*xv*xv + Dperp_equivalent));
@@ -45,6 +94,7 @@ MACRO T Calculate_ExtraCellular(T* P,
 
 MACRO T Calculate_IntraCellular(T* P,
 				T* CFP,
+				T* cache,
 				T& xv)
 {
   // Calculate Signal from IntraCellular compartment //
@@ -56,9 +106,8 @@ MACRO T Calculate_IntraCellular(T* P,
   T lgi[7]; // legendre  gaussian integral
   legendreGaussianIntegral(-parComp,lgi);
   
-  // Compute the spherical harmonic coefficients of the Watson's distribution
-  T coeff[7];
-  WatsonSHCoeff(P[2],coeff);
+  // Spherical harmonic coefficients of the Watson's distribution
+  T* coeff=&cache[5];
   
   for(int i=0;i<7;i++){
     lgi[i]*=coeff[i];
@@ -90,16 +139,17 @@ MACRO T Predicted_Signal(
 			 int npar, // Number of Parameters to estimate
 			 T* P, 	// Estimated parameters
 			 T* CFP, // Fixed Parameters common to all the voxels
-			 T* FixP) // Fixed Parameters for each voxel
+			 T* FixP, // Fixed Parameters for each voxel
+			 T* cache) // Values precomputed for the voxel
 {
-  T isoterm = exp_gpu(-CFP[3]*Diso); 	// exp(-bval*d)
+  T isoterm = CFP[4]; 	// exp(-bval*d), see Prepare_Protocol
 
-  T xv = CFP[0]*sin_gpu(P[3])*cos_gpu(P[4])	// (bvec(1)*sinth*cosph
-	+ CFP[1]*sin_gpu(P[3])*sin_gpu(P[4]) 	// + bvec(2)*sinth*sinph
-	+ CFP[2]*cos_gpu(P[3]);			// + bvec(3)*costh)
+  T xv = CFP[0]*cache[0]	// (bvec(1)*sinth*cosph
+	+ CFP[1]*cache[1] 	// + bvec(2)*sinth*sinph
+	+ CFP[2]*cache[2];	// + bvec(3)*costh)
 
-  T ExtraCell = Calculate_ExtraCellular(P,CFP,xv);
-  T IntraCell = Calculate_IntraCellular(P,CFP,xv);
+  T ExtraCell = Calculate_ExtraCellular(P,CFP,cache,xv);
+  T IntraCell = Calculate_IntraCellular(P,CFP,cache,xv);
 		
   T anisoterm = (1-P[1])*ExtraCell+P[1]*IntraCell;
   
@@ -122,16 +172,17 @@ MACRO void Partial_Derivatives(
 			       T* P, // Estimated parameters, use P*
 			       T* CFP, // Fixed Parameters common to all the voxels
 			       T* FixP, // Fixed Parameters for each voxel
+			       T* cache, // Values precomputed for the voxel
 			       T* derivatives) // Derivative respect each model estimated parameter
 {
-  T isoterm = exp_gpu(-CFP[3]*Diso); 	// exp(-bval*d)
+  T isoterm = CFP[4]; 	// exp(-bval*d), see Prepare_Protocol
 
-  T xv = CFP[0]*sin_gpu(P[3])*cos_gpu(P[4])	// (bvec(1)*sinth*cosph
-	+ CFP[1]*sin_gpu(P[3])*sin_gpu(P[4]) 	// + bvec(2)*sinth*sinph
-	+ CFP[2]*cos_gpu(P[3]);			// + bvec(3)*costh)
+  T xv = CFP[0]*cache[0]	// (bvec(1)*sinth*cosph
+	+ CFP[1]*cache[1] 	// + bvec(2)*sinth*sinph
+	+ CFP[2]*cache[2];	// + bvec(3)*costh)
 
-  T ExtraCell = Calculate_ExtraCellular(P,CFP,xv);
-  T IntraCell = Calculate_IntraCellular(P,CFP,xv);
+  T ExtraCell = Calculate_ExtraCellular(P,CFP,cache,xv);
+  T IntraCell = Calculate_IntraCellular(P,CFP,cache,xv);
 		
   T anisoterm = (1-P[1])*ExtraCell+P[1]*IntraCell;
   
@@ -156,6 +207,15 @@ MACRO void Partial_Derivatives(
   derivatives[4]=NUMERICAL(4);
 }
 
+// Initialisation with a diffusion tensor fit (--init_tensor, see tensor_init.h)
+MACRO void Tensor_Initialisation(
+				 T* tensor, // S0, eigenvalues, MD, FA and orientations of the tensor of the voxel
+				 T* P) // Estimated parameters
+{
+  P[3]=tensor[6]; // th: V1
+  P[4]=tensor[7]; // ph: V1
+}
+
 // Constraints run after LevenbergMarquardt (if LevenbergMarquardt is used)
 MACRO void FixConstraintsLM(	
 			    int npar, // Number of Parameters to estimate
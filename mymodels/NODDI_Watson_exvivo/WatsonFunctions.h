@@ -1,4 +1,6 @@
+#ifndef MACRO
 #define MACRO template <typename T> __device__ inline
+#endif
 
 #define MPI 3.14159265358979323846
 #define M_SQRT_PI 1.772453850905516
@@ -10,20 +12,18 @@
 
 #include "diffusivities.h"
 
+// Ids of the interpolation tables (see tables.h)
+#define TABLE_WATSON_SH 0
+#define TABLE_DAWSON 1
+
 MACRO T dawson(T x){  // From Numerical Recipes in C
 //Returns Dawson’s integral for any real x
 
   int i,n0;
   T d1,d2,e1,e2,sum,x2,xp,xx,ans;
-  T c[NMAX+1];
-  int init=0; // Flag is 0 if we need to initialize, else 1
-  if (init==0){
-    init=1;
-    for(i=0;i<NMAX;i++){
-      c[i]=((T)2.0*(i+1)-(T)1.0)*(T)H;
-      c[i]=exp_gpu(-c[i]*c[i]);
-    }
-  }
+  // c[i]=exp(-((2*i+1)*H)^2)
+  const T c[NMAX]={(T)0.8521437889662113,(T)0.23692775868212165,(T)0.01831563888873418,
+		   (T)0.0003936690406550776,(T)2.352575200009771e-06,(T)3.90893843426485e-09};
   if(fabs_gpu(x) < (T)0.2){  // Use series expansion.
     x2=x*x;
     ans=x*((T)1.0-(T)A1*x2*((T)1.0-(T)A2*x2*((T)1.0-(T)A3*x2)));
@@ -73,13 +73,15 @@ MACRO void WatsonHinderedDiffusionCoeff(//input
 
   }else{
     T sk;
-    T dawsonf;
+    T dawsonf=(T)0.0;
     //if(kapppa<0){
     // never. kappa is always >=0
     //}else{
     sk = sqrt_gpu(kappa);
     //dawsonf= (T)0.5*exp_gpu(-kappa)*sqrt_gpu(M_PI)*erfi_sk;
-    dawsonf=dawson(sk);
+    if(!table_1d(TABLE_DAWSON,sk,&dawsonf)){
+      dawsonf=dawson(sk);
+    }
     
     T factor = sk/dawsonf;
     
@@ -88,6 +90,70 @@ MACRO void WatsonHinderedDiffusionCoeff(//input
   }
 }
 
+MACRO void WatsonSHCoeff_exact(T k, T* coeff)
+{
+  // SH coefficients of the Watson's distribution, exact expression used for 0.1<k<=30 (coeff[1:6])
+
+  T sk = sqrt_gpu(k);
+  T sk2 = sk*k;
+  T sk3 = sk2*k;
+  T sk4 = sk3*k;
+  T sk5 = sk4*k;
+  T sk6 = sk5*k;
+  //T sk7 = sk6*k;
+
+  T k2 = k*k;
+  T k3 = k2*k;
+  T k4 = k3*k;
+  T k5 = k4*k;
+  T k6 = k5*k;
+  //T k7 = k6*k;
+
+  T dawsonk = dawson(sk);
+  T erfik = ((T)2.0/(T)M_SQRT_PI)*exp_gpu(sk*sk)*dawsonk;
+  //erfi(x) = 2/sqrt(pi) * exp(x*x) * dawson(x)
+      
+  T ierfik = (T)1.0/erfik;
+  T ek = exp_gpu(k);
+  //T dawsonk = (T)0.5*sqrt_gpu((T)MPI)*erfik/ek;
+
+  coeff[1] = (T)3.0*sk - ((T)3.0 + (T)2.0*k)*dawsonk;
+  coeff[1] = sqrt_gpu((T)5.0)*coeff[1]*ek;
+  coeff[1] = coeff[1]*ierfik/k;
+  
+  coeff[2] = ((T)105.0 + (T)60.0*k + (T)12.0*k2)*dawsonk;
+  coeff[2] = coeff[2] -(T)105.0*sk + (T)10.0*sk2;
+  coeff[2] = (T)0.375*coeff[2]*ek/k2;
+  coeff[2] = coeff[2]*ierfik;
+  
+  coeff[3] = -(T)3465.0 - (T)1890.0*k - (T)420.0*k2 - (T)40.0*k3;
+  coeff[3] = coeff[3]*dawsonk;
+  coeff[3] = coeff[3] + (T)3465.0*sk - (T)420.0*sk2 + (T)84.0*sk3;
+  coeff[3] = coeff[3]*sqrt_gpu((T)13.0*(T)MPI)/(T)64.0/k3;
+  coeff[3] = coeff[3]/dawsonk;
+  
+  coeff[4] = (T)675675.0 + (T)360360.0*k + (T)83160.0*k2 + (T)10080.0*k3 + (T)560.0*k4;
+  coeff[4] = coeff[4]*dawsonk;
+  coeff[4] = coeff[4] - (T)675675.0*sk + (T)90090.0*sk2 - (T)23100.0*sk3 + (T)744.0*sk4;
+  coeff[4] = sqrt((T)17.0)*coeff[4]*ek;
+  coeff[4] = coeff[4]/(T)512.0/k4;
+  coeff[4] = coeff[4]*ierfik;
+
+  coeff[5] = -(T)43648605.0 - (T)22972950.0*k - (T)5405400.0*k2 - (T)720720.0*k3 - (T)55440.0*k4 - (T)2016.0*k5;
+  coeff[5] = coeff[5]*dawsonk;
+  coeff[5] = coeff[5] + (T)43648605.0*sk - (T)6126120.0*sk2 + (T)1729728.0*sk3 - (T)82368.0*sk4 + (T)5104.0*sk5;
+  coeff[5] = sqrt((T)21.0*(T)MPI)*coeff[5]/(T)4096.0/k5;
+  coeff[5] = coeff[5]/dawsonk;
+      
+  coeff[6] = (T)7027425405.0 + (T)3666482820.0*k + (T)872972100.0*k2 + (T)122522400.0*k3  + (T)10810800.0*k4 + (T)576576.0*k5 + (T)14784.0*k6;
+  coeff[6] = coeff[6]*dawsonk;
+  coeff[6] = coeff[6] - (T)7027425405.0*sk + (T)1018467450.0*sk2 - (T)302630328.0*sk3 + (T)17153136.0*sk4 - (T)1553552.0*sk5 + (T)25376.0*sk6;
+  coeff[6] = (T)5.0*coeff[6]*ek;
+  coeff[6] = coeff[6]/(T)16384.0/k6;
+  coeff[6] = coeff[6]*ierfik;
+  
+}
+
 MACRO void WatsonSHCoeff(T k, T* coeff)
 {
   //commputes the spherical harmonic (SH) coefficients of the Watson's distribution with the concentration parameter k (kappa) and 12th order
@@ -111,65 +177,9 @@ MACRO void WatsonSHCoeff(T k, T* coeff)
 
   }else if(k>0.1){
     //exact
-
-    T sk = sqrt_gpu(k);
-    T sk2 = sk*k;
-    T sk3 = sk2*k;
-    T sk4 = sk3*k;
-    T sk5 = sk4*k;
-    T sk6 = sk5*k;
-    //T sk7 = sk6*k;
-
-    T k2 = k*k;
-    T k3 = k2*k;
-    T k4 = k3*k;
-    T k5 = k4*k;
-    T k6 = k5*k;
-    //T k7 = k6*k;
-
-    T dawsonk = dawson(sk);
-    T erfik = ((T)2.0/(T)M_SQRT_PI)*exp_gpu(sk*sk)*dawsonk;
-    //erfi(x) = 2/sqrt(pi) * exp(x*x) * dawson(x)
-        
-    T ierfik = (T)1.0/erfik;
-    T ek = exp_gpu(k);
-    //T dawsonk = (T)0.5*sqrt_gpu((T)MPI)*erfik/ek;
-
-    coeff[1] = (T)3.0*sk - ((T)3.0 + (T)2.0*k)*dawsonk;
-    coeff[1] = sqrt_gpu((T)5.0)*coeff[1]*ek;
-    coeff[1] = coeff[1]*ierfik/k;
-    
-    coeff[2] = ((T)105.0 + (T)60.0*k + (T)12.0*k2)*dawsonk;
-    coeff[2] = coeff[2] -(T)105.0*sk + (T)10.0*sk2;
-    coeff[2] = (T)0.375*coeff[2]*ek/k2;
-    coeff[2] = coeff[2]*ierfik;
-    
-    coeff[3] = -(T)3465.0 - (T)1890.0*k - (T)420.0*k2 - (T)40.0*k3;
-    coeff[3] = coeff[3]*dawsonk;
-    coeff[3] = coeff[3] + (T)3465.0*sk - (T)420.0*sk2 + (T)84.0*sk3;
-    coeff[3] = coeff[3]*sqrt_gpu((T)13.0*(T)MPI)/(T)64.0/k3;
-    coeff[3] = coeff[3]/dawsonk;
-    
-    coeff[4] = (T)675675.0 + (T)360360.0*k + (T)83160.0*k2 + (T)10080.0*k3 + (T)560.0*k4;
-    coeff[4] = coeff[4]*dawsonk;
-    coeff[4] = coeff[4] - (T)675675.0*sk + (T)90090.0*sk2 - (T)23100.0*sk3 + (T)744.0*sk4;
-    coeff[4] = sqrt((T)17.0)*coeff[4]*ek;
-    coeff[4] = coeff[4]/(T)512.0/k4;
-    coeff[4] = coeff[4]*ierfik;
-
-    coeff[5] = -(T)43648605.0 - (T)22972950.0*k - (T)5405400.0*k2 - (T)720720.0*k3 - (T)55440.0*k4 - (T)2016.0*k5;
-    coeff[5] = coeff[5]*dawsonk;
-    coeff[5] = coeff[5] + (T)43648605.0*sk - (T)6126120.0*sk2 + (T)1729728.0*sk3 - (T)82368.0*sk4 + (T)5104.0*sk5;
-    coeff[5] = sqrt((T)21.0*(T)MPI)*coeff[5]/(T)4096.0/k5;
-    coeff[5] = coeff[5]/dawsonk;
-        
-    coeff[6] = (T)7027425405.0 + (T)3666482820.0*k + (T)872972100.0*k2 + (T)122522400.0*k3  + (T)10810800.0*k4 + (T)576576.0*k5 + (T)14784.0*k6;
-    coeff[6] = coeff[6]*dawsonk;
-    coeff[6] = coeff[6] - (T)7027425405.0*sk + (T)1018467450.0*sk2 - (T)302630328.0*sk3 + (T)17153136.0*sk4 - (T)1553552.0*sk5 + (T)25376.0*sk6;
-    coeff[6] = (T)5.0*coeff[6]*ek;
-    coeff[6] = coeff[6]/(T)16384.0/k6;
-    coeff[6] = coeff[6]*ierfik;
-    
+    if(!table_1d(TABLE_WATSON_SH,k,&coeff[1])){
+      WatsonSHCoeff_exact(k,coeff);
+    }
   }else{
     // K<=0.1 approx
     
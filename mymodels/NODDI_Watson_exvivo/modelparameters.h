@@ -6,6 +6,14 @@ typedef double MyType;
 #define NPARAMS 6 // fiso, fintra, kappa, th, ph, irFrac
 #define NCFP 2 // bvecs, bvals
 #define NFIXP 1 // S0
+#define NCACHE 12 // fibre direction(3), hindered diffusivities(2), Watson SH coefficients(7)
+#define NPROTOCOL 8 // isotropic signal(1), Legendre Gaussian integrals(7): CFP[4:11]
+#define PROTOCOL_SHELL 3 // they only depend on the bvals
+#define NTABLES 2 // Watson SH coefficients, dawson (--tables)
+#define SCALE_FIXP 0 // S0 (fixed) scales the predicted signal (see dictionary.h)
+#define TENSOR_BVECS 0 // bvecs: CFP[0:2], for the tensor fit of --init_tensor (see tensor_init.h)
+#define TENSOR_BVALS 3 // bvals: CFP[3]
+#define MODEL_CPU_LANES 1 // the branches of the special functions are not vectorized: one voxel at a time on the CPU (see cpu_lanes.h)
 /////////////////////
 
 ///// Do not edit this /////
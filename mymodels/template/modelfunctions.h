@@ -4,6 +4,13 @@
 // - Partial derivatives for Levenberg-Marquardt (Optional)
 // - Constraints after Levenberg-Marquardt (Optional)
 // - custom priors function (Optional)
+// Optionally, the values that only depend on the parameters of the voxel can be computed once per voxel with Prepare_Voxel (see voxel_cache.h and Ball_2_Sticks)
+// and the values that only depend on the common fixed parameters once per run with Prepare_Protocol (see protocol_cache.h and NODDI_Watson_exvivo)
+// Expensive special functions can be interpolated from tables built at startup with --tables (see tables.h and NODDI_Bingham)
+// The predicted signal and the partial derivatives can be computed together in Signal_And_Derivatives, sharing their common terms (see signal_derivatives.h and Ball_1_Stick)
+// The parameters that enter the signal linearly can be solved in closed form with --varpro, given Linear_Basis and Linear_Parameters (see linear_parameters.h and Ball_1_Stick)
+// GridSearch can use a dictionary of the predicted signals of the grid with --dictionary, computed once per protocol. It does not need any function (see dictionary.h and SCALE_PARAM)
+// The parameters can be initialised with a diffusion tensor fit with --init_tensor, given Tensor_Initialisation (see tensor_init.h and Ball_1_Stick)
 
 // Using as example a simple model, Ball & 1-Stick with parameters:
 // P[0]: S0
@@ -50,6 +57,7 @@ MACRO bool ConstraintsMCMC(
 // Partial derivatives respect each model parameter
 // If Levenberg–Marquardt algorithm is used, the value of the partial derivative for each parameter has to be stored in the outpu array derivatives
 // You can use Numerical differentiation using the keyword "NUMERICAL"
+// or automatic differentiation of all the parameters using the keyword "AUTODIFF(CFP_size,FixP_size)" (see autodiff.h)
 MACRO void Partial_Derivatives(
 			       int npar, // Number of Parameters to estimate
 			       T* P, // Estimated parameters, use P*
@@ -11,6 +11,33 @@ typedef double MyType;
 
 // NFIXP specifies the number of fixed parameters that are different for each voxel (such as S0, T1, ...), in this case 0
 #define NFIXP 0
+
+// NCACHE (optional) specifies the number of values that depend only on the parameters of a voxel and are computed once by Prepare_Voxel instead of for every measurement (see voxel_cache.h)
+//#define NCACHE 4
+
+// NPROTOCOL (optional) specifies the number of values per measurement that depend only on the common fixed parameters and are computed once per run by Prepare_Protocol (see protocol_cache.h). With PROTOCOL_SHELL they only depend on CFP[PROTOCOL_SHELL] (e.g. bvals) and are computed once per shell
+//#define NPROTOCOL 1
+//#define PROTOCOL_SHELL 3
+
+// NTABLES (optional) specifies the number of special functions of the model evaluated with interpolation tables built at startup with --tables (see tables.h)
+//#define NTABLES 1
+
+// SIGNAL_AND_DERIVATIVES (optional) specifies that the model provides Signal_And_Derivatives instead of Partial_Derivatives, computing the predicted signal and its derivatives together (see signal_derivatives.h)
+//#define SIGNAL_AND_DERIVATIVES
+
+// NLINEAR (optional) specifies the number of parameters that enter the predicted signal linearly (e.g. S0 and the volume fractions), and LINEAR_PARAMS their ids. With --varpro they are solved in closed form by GridSearch and Levenberg-Marquardt (see linear_parameters.h)
+//#define NLINEAR 2
+//#define LINEAR_PARAMS 0,2
+
+// SCALE_PARAM (optional) specifies the parameter that multiplies the predicted signal (e.g. S0), or SCALE_FIXP the fixed parameter that multiplies it. With --dictionary, GridSearch computes the predicted signals of the grid once and solves the scale of each voxel (see dictionary.h)
+//#define SCALE_PARAM 0
+
+// TENSOR_BVECS and TENSOR_BVALS (optional) specify the position of the bvecs (3 values) and the bvals in the common fixed parameters. With --init_tensor, the parameters are initialised by Tensor_Initialisation with a diffusion tensor fit of each voxel (see tensor_init.h)
+//#define TENSOR_BVECS 0
+//#define TENSOR_BVALS 3
+
+// MODEL_CPU_LANES (optional) specifies the number of voxels evaluated together on the CPU (--backend=cpu), instead of CPU_LANES of the Makefile. Use 1 if the loops over the lanes of cpu_lanes.h are not vectorized, for instance because of branches that depend on the parameters (see cpu_lanes.h)
+//#define MODEL_CPU_LANES 1
 /////////////////////
 
 ///// Do not edit this /////
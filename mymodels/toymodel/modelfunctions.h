@@ -35,6 +35,7 @@ MACRO bool ConstraintsMCMC(
 // Partial derivatives respect each model parameter
 // If Levenberg–Marquardt algorithm is used, the value of the partial derivative for each parameter has to be stored in the outpu array derivatives
 // You can use Numerical differentiation using the keyword "NUMERICAL"
+// or automatic differentiation of all the parameters using the keyword "AUTODIFF(CFP_size,FixP_size)" (see autodiff.h)
 MACRO void Partial_Derivatives(
 			       int npar, // Number of Parameters to estimate
 			       T* P, // Estimated parameters, use P*
@@ -46,6 +47,7 @@ MACRO void Partial_Derivatives(
   derivatives[1]=-P[0]*CFP[0]*exp_gpu(-P[1]*CFP[0]);
   //derivatives[0]=NUMERICAL(0);
   //derivatives[1]=NUMERICAL(1);
+  //AUTODIFF(1,0);
 
 }
 
@@ -0,0 +1,60 @@
+/* protocol_cache.cc
+
+   Values of the model that only depend on the common fixed parameters, computed once per run (see protocol_cache.h).
+
+   This file is compiled with the host compiler (not nvcc), so the model functions are compiled as host functions.
+
+   agent
+
+   Copyright (C) 2026 University of Oxford */
+
+/* CCOPYRIGHT */
+
+#include <vector>
+#include "protocol_cache.h"
+#include "functions_gpu.h"
+#include "macro_numerical.h"
+#include "modelfunctions.h"
+
+using namespace std;
+
+namespace Cudimot{
+
+  template <typename T>
+  int prepare_protocol(int nmeas, int CFP_Tsize, T* CFP, int* shells)
+  {
+    const int CFP_size=CFP_Tsize-NPROTOCOL; // common fixed parameters provided by the user
+    int nshells=0;
+    vector<int> first_meas; // first measurement of each shell
+
+    for(int m=0;m<nmeas;m++){
+      int shell=nshells;
+#ifdef PROTOCOL_SHELL
+      for(int s=0;s<nshells;s++){
+	if(CFP[first_meas[s]*CFP_Tsize+PROTOCOL_SHELL]==CFP[m*CFP_Tsize+PROTOCOL_SHELL]){
+	  shell=s;
+	  break;
+	}
+      }
+#endif
+      shells[m]=shell;
+      T* protocol=&CFP[m*CFP_Tsize+CFP_size];
+      if(shell==nshells){
+	first_meas.push_back(m);
+	nshells++;
+#if NPROTOCOL>0
+	Prepare_Protocol(&CFP[m*CFP_Tsize],protocol);
+#endif
+      }else{
+	T* shell_protocol=&CFP[first_meas[shell]*CFP_Tsize+CFP_size];
+	for(int i=0;i<NPROTOCOL;i++){
+	  protocol[i]=shell_protocol[i];
+	}
+      }
+    }
+    return nshells;
+  }
+
+  template int prepare_protocol<float>(int,int,float*,int*);
+  template int prepare_protocol<double>(int,int,double*,int*);
+}
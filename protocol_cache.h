@@ -0,0 +1,45 @@
+#ifndef CUDIMOT_PROTOCOL_CACHE_H_INCLUDED
+#define CUDIMOT_PROTOCOL_CACHE_H_INCLUDED
+
+/*  protocol_cache.h
+
+    Optional precomputation of the values of a model that depend only on the common fixed parameters (e.g. bvals and bvecs), once per run instead of for every voxel. A model can define in modelparameters.h:
+
+      #define NPROTOCOL n // Number of values precomputed per measurement
+      #define PROTOCOL_SHELL k // Optional: the values only depend on CFP[k] (e.g. the b-value)
+
+    and provide in modelfunctions.h:
+
+      MACRO void Prepare_Protocol(T* CFP, T* protocol);
+
+    Prepare_Protocol receives the common fixed parameters of one measurement and writes its NPROTOCOL values. The values are stored after the common fixed parameters of each measurement, so the model functions read them as CFP[CFP_size ... CFP_size+NPROTOCOL-1], where CFP_size is the total size of the common fixed parameters of the model (see modelparameters.cc). The engines do not need any change: the size of the common fixed parameters per measurement (CFP_Tsize) includes the NPROTOCOL values. With AUTODIFF, the size of the common fixed parameters given to AUTODIFF must also include them.
+
+    With PROTOCOL_SHELL, the measurements with the same value of CFP[PROTOCOL_SHELL] form a shell and Prepare_Protocol is evaluated once per shell: a multi-shell protocol with 3 shells and 300 directions evaluates it 3 times.
+
+    agent
+
+    Copyright (C) 2026 University of Oxford  */
+
+/*  CCOPYRIGHT  */
+
+#include "modelparameters.h"
+
+#ifndef NPROTOCOL
+#define NPROTOCOL 0
+#endif
+
+namespace Cudimot{
+
+  /**
+   * Computes the values of Prepare_Protocol for all the measurements. Compiled with the host compiler
+   * @param nmeas Number of measurements
+   * @param CFP_Tsize Size of the common fixed parameters per measurement, including the NPROTOCOL values
+   * @param CFP Common fixed parameters [nmeas][CFP_Tsize]. The last NPROTOCOL values of each measurement are written
+   * @param shells Output: shell of each measurement [nmeas]. Without PROTOCOL_SHELL, each measurement is its own shell
+   * @return Number of shells
+   */
+  template <typename T>
+  int prepare_protocol(int nmeas, int CFP_Tsize, T* CFP, int* shells);
+}
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef CUDIMOT_SIGNAL_DERIVATIVES_H_INCLUDED
+#define CUDIMOT_SIGNAL_DERIVATIVES_H_INCLUDED
+
+/*  signal_derivatives.h
+
+    Optional evaluation of the predicted signal and its partial derivatives in a single function. Levenberg-Marquardt needs both for every measurement, and the derivatives of most models recompute the exponentials and the angular terms of the signal. A model can define in modelparameters.h:
+
+      #define SIGNAL_AND_DERIVATIVES
+
+    and provide in modelfunctions.h, instead of Partial_Derivatives:
+
+      MACRO void Signal_And_Derivatives(int npar, T* P, T* CFP, T* FixP, T& signal, T* derivatives);
+
+    or, if the model also defines NCACHE (see voxel_cache.h):
+
+      MACRO void Signal_And_Derivatives(int npar, T* P, T* CFP, T* FixP, T* cache, T& signal, T* derivatives);
+
+    The model still provides Predicted_Signal, used when the derivatives are not needed. Partial_Derivatives is defined here with Signal_And_Derivatives.
+
+    If the model does not define SIGNAL_AND_DERIVATIVES, Signal_And_Derivatives is defined here and calls Predicted_Signal and Partial_Derivatives, so the engines always call Signal_And_Derivatives.
+
+    It is included by macro_numerical.h, after voxel_cache.h
+
+    agent
+
+    Copyright (C) 2026 University of Oxford  */
+
+/*  CCOPYRIGHT  */
+
+#ifdef SIGNAL_AND_DERIVATIVES
+
+#ifdef NCACHE
+
+MACRO void Signal_And_Derivatives(int npar, T* P, T* CFP, T* FixP, T* cache, T& signal, T* derivatives);
+
+MACRO void Partial_Derivatives(int npar, T* P, T* CFP, T* FixP, T* cache, T* derivatives){
+  T signal;
+  Signal_And_Derivatives(npar,P,CFP,FixP,cache,signal,derivatives);
+}
+
+MACRO void Signal_And_Derivatives(int npar, T* P, T* CFP, T* FixP, T& signal, T* derivatives){
+  T cache[NCACHE];
+  Prepare_Voxel(P,FixP,cache);
+  Signal_And_Derivatives(npar,P,CFP,FixP,cache,signal,derivatives);
+}
+
+#else
+
+MACRO void Signal_And_Derivatives(int npar, T* P, T* CFP, T* FixP, T& signal, T* derivatives);
+
+MACRO void Partial_Derivatives(int npar, T* P, T* CFP, T* FixP, T* derivatives){
+  T signal;
+  Signal_And_Derivatives(npar,P,CFP,FixP,signal,derivatives);
+}
+
+MACRO void Signal_And_Derivatives(int npar, T* P, T* CFP, T* FixP, T* cache, T& signal, T* derivatives){
+  Signal_And_Derivatives(npar,P,CFP,FixP,signal,derivatives);
+}
+
+#endif
+
+#else
+
+MACRO void Signal_And_Derivatives(int npar, T* P, T* CFP, T* FixP, T* cache, T& signal, T* derivatives){
+  signal=Predicted_Signal(npar,P,CFP,FixP,cache);
+  Partial_Derivatives(npar,P,CFP,FixP,cache,derivatives);
+}
+
+MACRO void Signal_And_Derivatives(int npar, T* P, T* CFP, T* FixP, T& signal, T* derivatives){
+  signal=Predicted_Signal(npar,P,CFP,FixP);
+  Partial_Derivatives(npar,P,CFP,FixP,derivatives);
+}
+
+#endif
+
+#endif
@@ -94,6 +94,13 @@ int main(int argc, char *argv[]){
   // last part
   data_part = dataM.SubMatrix(1,nmeas,(opts.nParts.value()-1)*size_part+1,nvoxels);
   save_part(data_part,out_path,out_name,(opts.nParts.value()-1));
+
+  // Index (mask order) of the first voxel of each part. The CPU MCMC uses it to select the random numbers of each voxel
+  Matrix first_voxel(1,1);
+  for(int i=0;i<opts.nParts.value();i++){
+    first_voxel(1,1)=i*size_part;
+    save_part(first_voxel,out_path,"FirstVoxel",i);
+  }
   
   //////////////////////////////////////////////////////
   /// Initialization of parameters
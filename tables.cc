@@ -0,0 +1,282 @@
+/* tables.cc
+
+   Interpolation tables of the special functions of the model, built once at startup with --tables (see tables.h).
+
+   This file is compiled with the host compiler (not nvcc), so the model functions are compiled as host functions.
+
+   agent
+
+   Copyright (C) 2026 University of Oxford */
+
+/* CCOPYRIGHT */
+
+#include <vector>
+#include <iostream>
+#include <cmath>
+#include "tables.h"
+#include "cudimotoptions.h"
+#include "functions_gpu.h"
+#include "macro_numerical.h"
+#define TABULATE
+#include "modelfunctions.h"
+
+// Tables used by the model functions on the host. The knots are stored in tables_data
+Cudimot::Table tables_host[NTABLES_SIZE];
+
+using namespace std;
+
+namespace Cudimot{
+
+  // Knots in each dimension: the first grid and the limit of the refinement
+#define TABLE_KNOTS_INIT 17
+#define TABLE_KNOTS_MAX_1D 1048577
+#define TABLE_KNOTS_MAX_2D 1025
+  // Points per cell compared with --validate_tables
+#define TABLE_VALIDATION_POINTS 7
+  // Step of the finite differences, relative to the distance between knots
+#define TABLE_FD_STEP (1.0/64.0)
+
+  static vector<double> tables_data[NTABLES_SIZE];
+
+  static void check_table_id(int id, const char* name){
+    if(id<0 || id>=NTABLES){
+      cerr << "CUDIMOT Error: Table '" << name << "' has the id " << id << ". The ids of the tables must be in [0,NTABLES) (NTABLES=" << NTABLES << ")" << endl;
+      exit(-1);
+    }
+  }
+
+  // Error of the interpolated values of a function at a point, see tables.h
+  static double table_error(const vector<double>& approx, const vector<double>& exact){
+    double error=0.0;
+    double reference=0.0;
+    for(size_t v=0;v<exact.size();v++){
+      error=max(error,fabs(approx[v]-exact[v]));
+      reference=max(reference,fabs(exact[v]));
+    }
+    if(reference==0.0) return error;
+    return error/reference;
+  }
+
+  // Derivative at x with finite differences of 4th order
+  static void derivative_1d(void (*f)(double,double*), int nvalues, double x, double h, double* d){
+    vector<double> fp1(nvalues),fm1(nvalues),fp2(nvalues),fm2(nvalues);
+    f(x+h,&fp1[0]);
+    f(x-h,&fm1[0]);
+    f(x+2*h,&fp2[0]);
+    f(x-2*h,&fm2[0]);
+    for(int v=0;v<nvalues;v++){
+      d[v]=(8.0*(fp1[v]-fm1[v])-(fp2[v]-fm2[v]))/(12.0*h);
+    }
+  }
+
+  static void fill_table_1d(Table& table, vector<double>& data, void (*f)(double,double*)){
+    const int nv=table.nvalues;
+    const double step=1.0/table.inv_step[0];
+    data.resize((size_t)table.nknots[0]*nv*2);
+    vector<double> value(nv),d(nv);
+    for(int i=0;i<table.nknots[0];i++){
+      double x=table.xmin[0]+i*step;
+      f(x,&value[0]);
+      derivative_1d(f,nv,x,step*TABLE_FD_STEP,&d[0]);
+      for(int v=0;v<nv;v++){
+	data[((size_t)i*nv+v)*2]=value[v];
+	data[((size_t)i*nv+v)*2+1]=d[v]*step;
+      }
+    }
+    table.data=&data[0];
+  }
+
+  // Maximum error of the table at npoints points inside each cell. Returns in worst the position of the maximum
+  static double error_table_1d(int id, void (*f)(double,double*), int npoints, double& worst){
+    const Table& table=tables_host[id];
+    const int nv=table.nvalues;
+    const double step=1.0/table.inv_step[0];
+    vector<double> approx(nv),exact(nv);
+    double error=0.0;
+    for(int i=0;i<table.nknots[0]-1;i++){
+      for(int p=1;p<=npoints;p++){
+	double x=table.xmin[0]+(i+p/(double)(npoints+1))*step;
+	table_1d(id,x,&approx[0]);
+	f(x,&exact[0]);
+	double e=table_error(approx,exact);
+	if(e>error){
+	  error=e;
+	  worst=x;
+	}
+      }
+    }
+    return error;
+  }
+
+  void tabulate_1d(int id, const char* name, double xmin, double xmax, int nvalues, void (*f)(double,double*)){
+    check_table_id(id,name);
+    cudimotOptions& opts = cudimotOptions::getInstance();
+    double maxerror=opts.tables.value();
+
+    Table& table=tables_host[id];
+    table.ndims=1;
+    table.nvalues=nvalues;
+    table.xmin[0]=xmin;
+    table.xmax[0]=xmax;
+    double error=0.0;
+    double worst=xmin;
+    for(int nknots=TABLE_KNOTS_INIT;nknots<=TABLE_KNOTS_MAX_1D;nknots=2*nknots-1){
+      table.nknots[0]=nknots;
+      table.inv_step[0]=(nknots-1)/(xmax-xmin);
+      fill_table_1d(table,tables_data[id],f);
+      error=error_table_1d(id,f,1,worst);
+      if(error<=maxerror) break;
+    }
+    if(error>maxerror){
+      cout << "Warning: the table of " << name << " does not reach the maximum error " << maxerror << " (error " << error << " at " << worst << "). The exact routine is used" << endl;
+      table.ndims=0;
+      vector<double>().swap(tables_data[id]);
+      return;
+    }
+    cout << "Table of " << name << " in [" << xmin << "," << xmax << "]: " << table.nknots[0] << " knots, error " << error << endl;
+
+    if(opts.validate_tables.value()){
+      double validation=error_table_1d(id,f,TABLE_VALIDATION_POINTS,worst);
+      cout << "Validation of the table of " << name << ": maximum error " << validation << " at " << worst << ((validation>maxerror)?" (above the maximum error)":"") << endl;
+    }
+  }
+
+  // Derivatives at (x,y): fx, fy with finite differences of 4th order and fxy of 2nd order
+  static void derivatives_2d(void (*f)(double,double,double*), int nvalues, double x, double y, double hx, double hy, double* fx, double* fy, double* fxy){
+    vector<double> a(nvalues),b(nvalues),c(nvalues),d(nvalues);
+    f(x+hx,y,&a[0]);
+    f(x-hx,y,&b[0]);
+    f(x+2*hx,y,&c[0]);
+    f(x-2*hx,y,&d[0]);
+    for(int v=0;v<nvalues;v++){
+      fx[v]=(8.0*(a[v]-b[v])-(c[v]-d[v]))/(12.0*hx);
+    }
+    f(x,y+hy,&a[0]);
+    f(x,y-hy,&b[0]);
+    f(x,y+2*hy,&c[0]);
+    f(x,y-2*hy,&d[0]);
+    for(int v=0;v<nvalues;v++){
+      fy[v]=(8.0*(a[v]-b[v])-(c[v]-d[v]))/(12.0*hy);
+    }
+    f(x+hx,y+hy,&a[0]);
+    f(x+hx,y-hy,&b[0]);
+    f(x-hx,y+hy,&c[0]);
+    f(x-hx,y-hy,&d[0]);
+    for(int v=0;v<nvalues;v++){
+      fxy[v]=(a[v]-b[v]-c[v]+d[v])/(4.0*hx*hy);
+    }
+  }
+
+  static void fill_table_2d(Table& table, vector<double>& data, void (*f)(double,double,double*)){
+    const int nv=table.nvalues;
+    const double stepx=1.0/table.inv_step[0];
+    const double stepy=1.0/table.inv_step[1];
+    data.resize((size_t)table.nknots[0]*table.nknots[1]*nv*4);
+    vector<double> value(nv),fx(nv),fy(nv),fxy(nv);
+    for(int j=0;j<table.nknots[1];j++){
+      double y=table.xmin[1]+j*stepy;
+      for(int i=0;i<table.nknots[0];i++){
+	double x=table.xmin[0]+i*stepx;
+	f(x,y,&value[0]);
+	derivatives_2d(f,nv,x,y,stepx*TABLE_FD_STEP,stepy*TABLE_FD_STEP,&fx[0],&fy[0],&fxy[0]);
+	double* knot=&data[((size_t)j*table.nknots[0]+i)*nv*4];
+	for(int v=0;v<nv;v++){
+	  knot[v*4]=value[v];
+	  knot[v*4+1]=fx[v]*stepx;
+	  knot[v*4+2]=fy[v]*stepy;
+	  knot[v*4+3]=fxy[v]*stepx*stepy;
+	}
+      }
+    }
+    table.data=&data[0];
+  }
+
+  // Maximum error of the table at a grid of npoints x npoints points inside each cell, or at the centre and the middle of the edges of each cell (npoints=0)
+  static double error_table_2d(int id, void (*f)(double,double,double*), int npoints, double& worstx, double& worsty){
+    const Table& table=tables_host[id];
+    const int nv=table.nvalues;
+    const double stepx=1.0/table.inv_step[0];
+    const double stepy=1.0/table.inv_step[1];
+    vector<double> offsets;
+    vector<double> approx(nv),exact(nv);
+    if(npoints==0){
+      // (s,t): centre, middle of the bottom edge, middle of the left edge. The other edges are checked by the next cells
+      const double centre[]={0.5,0.5, 0.5,0.0, 0.0,0.5};
+      offsets.assign(centre,centre+6);
+    }else{
+      for(int q=1;q<=npoints;q++){
+	for(int p=1;p<=npoints;p++){
+	  offsets.push_back(p/(double)(npoints+1));
+	  offsets.push_back(q/(double)(npoints+1));
+	}
+      }
+    }
+    double error=0.0;
+    for(int j=0;j<table.nknots[1]-1;j++){
+      for(int i=0;i<table.nknots[0]-1;i++){
+	for(size_t o=0;o<offsets.size();o+=2){
+	  double x=table.xmin[0]+(i+offsets[o])*stepx;
+	  double y=table.xmin[1]+(j+offsets[o+1])*stepy;
+	  table_2d(id,x,y,&approx[0]);
+	  f(x,y,&exact[0]);
+	  double e=table_error(approx,exact);
+	  if(e>error){
+	    error=e;
+	    worstx=x;
+	    worsty=y;
+	  }
+	}
+      }
+    }
+    return error;
+  }
+
+  void tabulate_2d(int id, const char* name, double xmin, double xmax, double ymin, double ymax, int nvalues, void (*f)(double,double,double*)){
+    check_table_id(id,name);
+    cudimotOptions& opts = cudimotOptions::getInstance();
+    double maxerror=opts.tables.value();
+
+    Table& table=tables_host[id];
+    table.ndims=2;
+    table.nvalues=nvalues;
+    table.xmin[0]=xmin;
+    table.xmax[0]=xmax;
+    table.xmin[1]=ymin;
+    table.xmax[1]=ymax;
+    double error=0.0;
+    double worstx=xmin;
+    double worsty=ymin;
+    for(int nknots=TABLE_KNOTS_INIT;nknots<=TABLE_KNOTS_MAX_2D;nknots=2*nknots-1){
+      table.nknots[0]=nknots;
+      table.nknots[1]=nknots;
+      table.inv_step[0]=(nknots-1)/(xmax-xmin);
+      table.inv_step[1]=(nknots-1)/(ymax-ymin);
+      fill_table_2d(table,tables_data[id],f);
+      error=error_table_2d(id,f,0,worstx,worsty);
+      if(error<=maxerror) break;
+    }
+    if(error>maxerror){
+      cout << "Warning: the table of " << name << " does not reach the maximum error " << maxerror << " (error " << error << " at " << worstx << "," << worsty << "). The exact routine is used" << endl;
+      table.ndims=0;
+      vector<double>().swap(tables_data[id]);
+      return;
+    }
+    cout << "Table of " << name << " in [" << xmin << "," << xmax << "]x[" << ymin << "," << ymax << "]: " << table.nknots[0] << "x" << table.nknots[1] << " knots, error " << error << endl;
+
+    if(opts.validate_tables.value()){
+      double validation=error_table_2d(id,f,TABLE_VALIDATION_POINTS,worstx,worsty);
+      cout << "Validation of the table of " << name << ": maximum error " << validation << " at " << worstx << "," << worsty << ((validation>maxerror)?" (above the maximum error)":"") << endl;
+    }
+  }
+}
+
+void init_tables(){
+  Cudimot::cudimotOptions& opts = Cudimot::cudimotOptions::getInstance();
+  if(opts.tables.value()<=0) return;
+#if NTABLES>0
+  Tabulate_Functions();
+  copy_tables_gpu();
+#else
+  cout << "The model does not have tabulated functions: --tables is ignored" << endl;
+#endif
+}
@@ -0,0 +1,186 @@
+#ifndef CUDIMOT_TABLES_H_INCLUDED
+#define CUDIMOT_TABLES_H_INCLUDED
+
+/*  tables.h
+
+    Optional interpolation tables of the special functions of a model, built at startup with --tables=maxerror. A model can define in modelparameters.h:
+
+      #define NTABLES n // Number of tabulated functions
+
+    and provide in modelfunctions.h, only compiled on the host (tables.cc defines TABULATE):
+
+      #ifdef TABULATE
+      inline void Tabulate_Functions(){
+        tabulate_1d(id,"name",xmin,xmax,nvalues,f); // f(x,values): exact routine
+        tabulate_2d(id,"name",xmin,xmax,ymin,ymax,nvalues,f); // f(x,y,values)
+      }
+      #endif
+
+    The model functions call table_1d(id,x,values) or table_2d(id,x,y,values), which interpolate the table and return true, or return false if the table is not built (without --tables) or the point is outside its domain. The model then evaluates the exact routine, so the model gives the same results without --tables.
+
+    A table interpolates the values of the function with cubic Hermite polynomials (bicubic in 2-D) on a uniform grid. The derivatives at the knots are computed with finite differences of the exact routine. The number of knots is doubled until the error of the table, measured at the centre of every cell (and the middle of its edges in 2-D), is below maxerror. The error at a point is the largest difference between the interpolated and the exact values, relative to the largest magnitude of the exact values of the function at that point. With --validate_tables, every table is also compared against the exact routine at 7 points inside every cell (7x7 in 2-D) and the maximum error is printed. The exact routine must not use the table, and it must be defined slightly outside the domain of the table, where the finite differences are evaluated.
+
+    agent
+
+    Copyright (C) 2026 University of Oxford  */
+
+/*  CCOPYRIGHT  */
+
+#include "modelparameters.h"
+
+#ifndef NTABLES
+#define NTABLES 0
+#endif
+#define NTABLES_SIZE (NTABLES>0?NTABLES:1)
+
+#ifndef FUNC
+#ifdef __CUDACC__
+#define FUNC __device__ inline
+#else
+#define FUNC inline
+#endif
+#endif
+
+namespace Cudimot{
+
+  struct Table{
+    int ndims; // 1 or 2. 0: the table is not built and the exact routine is used
+    int nvalues; // values of the function at each point
+    int nknots[2]; // knots in each dimension
+    double xmin[2]; // domain in each dimension
+    double xmax[2];
+    double inv_step[2]; // 1/distance between knots
+    // For each knot [nknots[1]][nknots[0]] and value, the value and its derivatives scaled by the steps:
+    // 1-D: f, f'*step. 2-D: f, fx*stepx, fy*stepy, fxy*stepx*stepy
+    double* data;
+  };
+}
+
+// Tables used by the model functions on the host (tables.cc) and on the GPU (init_gpu.cu)
+extern Cudimot::Table tables_host[NTABLES_SIZE];
+#ifdef __CUDACC__
+extern __constant__ Cudimot::Table tables_gpu[NTABLES_SIZE];
+#endif
+
+FUNC const Cudimot::Table& get_table(int id){
+#ifdef __CUDA_ARCH__
+  return tables_gpu[id];
+#else
+  return tables_host[id];
+#endif
+}
+
+// Hermite basis on [0,1]: h[0], h[1] weight the values at the knots 0 and 1, h[2], h[3] their scaled derivatives
+template <typename T>
+FUNC void hermite_basis(T s, T* h){
+  T s2=s*s;
+  T s3=s2*s;
+  h[0]=(T)2.0*s3-(T)3.0*s2+(T)1.0;
+  h[1]=-(T)2.0*s3+(T)3.0*s2;
+  h[2]=s3-(T)2.0*s2+s;
+  h[3]=s3-s2;
+}
+
+// Position of x in a dimension of the table: returns the cell and its local coordinate s in [0,1]
+template <typename T>
+FUNC int table_cell(const Cudimot::Table& table, int dim, T x, T& s){
+  T u=(x-(T)table.xmin[dim])*(T)table.inv_step[dim];
+  int cell=(int)u;
+  if(cell>table.nknots[dim]-2) cell=table.nknots[dim]-2;
+  s=u-cell;
+  return cell;
+}
+
+/**
+ * Interpolates a table of a function of one variable
+ * @param id Id of the table
+ * @param x Point
+ * @param values Output: the nvalues values of the function at x
+ * @return false if the table is not built or x is outside its domain: values are not written
+ */
+template <typename T>
+FUNC bool table_1d(int id, T x, T* values){
+  const Cudimot::Table& table=get_table(id);
+  if(table.ndims!=1 || !(x>=(T)table.xmin[0] && x<=(T)table.xmax[0])) return false;
+
+  T s;
+  int cell=table_cell(table,0,x,s);
+  T h[4];
+  hermite_basis(s,h);
+  const int nv=table.nvalues;
+  const double* k0=&table.data[cell*nv*2];
+  const double* k1=&k0[nv*2];
+  for(int v=0;v<nv;v++){
+    values[v]=h[0]*(T)k0[v*2]+h[1]*(T)k1[v*2]+h[2]*(T)k0[v*2+1]+h[3]*(T)k1[v*2+1];
+  }
+  return true;
+}
+
+/**
+ * Interpolates a table of a function of two variables
+ * @param id Id of the table
+ * @param x First variable
+ * @param y Second variable
+ * @param values Output: the nvalues values of the function at (x,y)
+ * @return false if the table is not built or (x,y) is outside its domain: values are not written
+ */
+template <typename T>
+FUNC bool table_2d(int id, T x, T y, T* values){
+  const Cudimot::Table& table=get_table(id);
+  if(table.ndims!=2 || !(x>=(T)table.xmin[0] && x<=(T)table.xmax[0] && y>=(T)table.xmin[1] && y<=(T)table.xmax[1])) return false;
+
+  T s,t;
+  int cellx=table_cell(table,0,x,s);
+  int celly=table_cell(table,1,y,t);
+  T hx[4],hy[4];
+  hermite_basis(s,hx);
+  hermite_basis(t,hy);
+  const int nv=table.nvalues;
+  const int row=table.nknots[0]*nv*4;
+  const double* k00=&table.data[(celly*table.nknots[0]+cellx)*nv*4];
+  const double* k10=&k00[nv*4];
+  const double* k01=&k00[row];
+  const double* k11=&k01[nv*4];
+  for(int v=0;v<nv;v++){
+    const int i=v*4;
+    // weights of the corners (x0,y0), (x1,y0), (x0,y1), (x1,y1)
+    values[v]=hy[0]*(hx[0]*(T)k00[i]+hx[1]*(T)k10[i]+hx[2]*(T)k00[i+1]+hx[3]*(T)k10[i+1])
+      + hy[1]*(hx[0]*(T)k01[i]+hx[1]*(T)k11[i]+hx[2]*(T)k01[i+1]+hx[3]*(T)k11[i+1])
+      + hy[2]*(hx[0]*(T)k00[i+2]+hx[1]*(T)k10[i+2]+hx[2]*(T)k00[i+3]+hx[3]*(T)k10[i+3])
+      + hy[3]*(hx[0]*(T)k01[i+2]+hx[1]*(T)k11[i+2]+hx[2]*(T)k01[i+3]+hx[3]*(T)k11[i+3]);
+  }
+  return true;
+}
+
+#ifndef __CUDACC__
+namespace Cudimot{
+
+  /**
+   * Builds the table of a function of one variable (host). Used by Tabulate_Functions
+   * @param id Id of the table [0,NTABLES)
+   * @param name Name printed in the messages
+   * @param xmin,xmax Domain of the table
+   * @param nvalues Values of the function at each point
+   * @param f Exact routine, f(x,values)
+   */
+  void tabulate_1d(int id, const char* name, double xmin, double xmax, int nvalues, void (*f)(double,double*));
+
+  /**
+   * Builds the table of a function of two variables (host). Used by Tabulate_Functions
+   * @param f Exact routine, f(x,y,values)
+   */
+  void tabulate_2d(int id, const char* name, double xmin, double xmax, double ymin, double ymax, int nvalues, void (*f)(double,double,double*));
+}
+#endif
+
+/**
+ * Builds the tables of the model with --tables and copies them to the GPU if the fitting routines run on it. Called once at startup (tables.cc)
+ */
+void init_tables();
+
+/**
+ * Copies the tables built on the host to the GPU (init_gpu.cu). Nothing is copied with the CPU backend
+ */
+void copy_tables_gpu();
+
+#endif
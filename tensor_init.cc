@@ -0,0 +1,280 @@
+/* tensor_init.cc
+
+   Initialisation of the parameters with a weighted least-squares fit of the diffusion tensor of each voxel (see tensor_init.h).
+
+   This file is compiled with the host compiler (not nvcc), so the model functions are compiled as host functions.
+
+   agent
+
+   Copyright (C) 2026 University of Oxford */
+
+/* CCOPYRIGHT */
+
+#include <vector>
+#include <cmath>
+#include "cudimot.h"
+#include "cudimotoptions.h"
+#include "tensor_init.h"
+#include "functions_gpu.h"
+#include "macro_numerical.h"
+#include "modelfunctions.h"
+#include "cpu_threads.h"
+
+using namespace std;
+
+namespace Cudimot{
+
+#ifdef TENSOR_BVECS
+  // Unknowns of the log-linear fit: ln(S0), Dxx, Dyy, Dzz, Dxy, Dxz, Dyz
+#define TENSOR_UNKNOWNS 7
+
+  // Solves A x = b (n x n) by Gaussian elimination with partial pivoting. A and b are modified
+  static bool tensor_solve(int n, double* A, double* b, double* x){
+    double scale=0.0;
+    for(int i=0;i<n;i++){
+      if(fabs(A[i*n+i])>scale) scale=fabs(A[i*n+i]);
+    }
+    for(int k=0;k<n;k++){
+      int pivot=k;
+      for(int i=k+1;i<n;i++){
+	if(fabs(A[i*n+k])>fabs(A[pivot*n+k])) pivot=i;
+      }
+      if(!(fabs(A[pivot*n+k])>1e-12*scale)) return false; // singular
+      if(pivot!=k){
+	for(int j=0;j<n;j++){
+	  double tmp=A[k*n+j]; A[k*n+j]=A[pivot*n+j]; A[pivot*n+j]=tmp;
+	}
+	double tmp=b[k]; b[k]=b[pivot]; b[pivot]=tmp;
+      }
+      for(int i=k+1;i<n;i++){
+	double factor=A[i*n+k]/A[k*n+k];
+	for(int j=k;j<n;j++){
+	  A[i*n+j]-=factor*A[k*n+j];
+	}
+	b[i]-=factor*b[k];
+      }
+    }
+    for(int i=n-1;i>=0;i--){
+      double sum=b[i];
+      for(int j=i+1;j<n;j++){
+	sum-=A[i*n+j]*x[j];
+      }
+      x[i]=sum/A[i*n+i];
+    }
+    return true;
+  }
+
+  // Eigenvalues L (in descending order) and eigenvectors (columns of V) of a symmetric 3x3 matrix, with Jacobi rotations
+  static void tensor_eigen(double D[3][3], double* L, double V[3][3]){
+    double A[3][3];
+    for(int i=0;i<3;i++){
+      for(int j=0;j<3;j++){
+	A[i][j]=D[i][j];
+	V[i][j]=(i==j)?1.0:0.0;
+      }
+    }
+    for(int sweep=0;sweep<50;sweep++){
+      double off=fabs(A[0][1])+fabs(A[0][2])+fabs(A[1][2]);
+      if(off<=1e-15*(fabs(A[0][0])+fabs(A[1][1])+fabs(A[2][2]))) break;
+      for(int p=0;p<2;p++){
+	for(int q=p+1;q<3;q++){
+	  if(A[p][q]==0.0) continue;
+	  double theta=(A[q][q]-A[p][p])/(2.0*A[p][q]);
+	  double t=(theta>=0?1.0:-1.0)/(fabs(theta)+sqrt(theta*theta+1.0));
+	  double c=1.0/sqrt(t*t+1.0);
+	  double s=t*c;
+	  for(int k=0;k<3;k++){
+	    double akp=A[k][p], akq=A[k][q];
+	    A[k][p]=c*akp-s*akq;
+	    A[k][q]=s*akp+c*akq;
+	  }
+	  for(int k=0;k<3;k++){
+	    double apk=A[p][k], aqk=A[q][k];
+	    A[p][k]=c*apk-s*aqk;
+	    A[q][k]=s*apk+c*aqk;
+	  }
+	  for(int k=0;k<3;k++){
+	    double vkp=V[k][p], vkq=V[k][q];
+	    V[k][p]=c*vkp-s*vkq;
+	    V[k][q]=s*vkp+c*vkq;
+	  }
+	}
+      }
+    }
+    int order[3]={0,1,2};
+    for(int i=0;i<2;i++){
+      for(int j=i+1;j<3;j++){
+	if(A[order[j]][order[j]]>A[order[i]][order[i]]){
+	  int tmp=order[i]; order[i]=order[j]; order[j]=tmp;
+	}
+      }
+    }
+    double W[3][3];
+    for(int i=0;i<3;i++){
+      L[i]=A[order[i]][order[i]];
+      for(int k=0;k<3;k++){
+	W[k][i]=V[k][order[i]];
+      }
+    }
+    for(int i=0;i<3;i++){
+      for(int k=0;k<3;k++){
+	V[k][i]=W[k][i];
+      }
+    }
+  }
+
+  /**
+   * Log-linear fit of the tensor of a voxel: least squares first, and weighted least squares with the squared predicted signals of the first fit
+   * @param X Design matrix [nmeas][TENSOR_UNKNOWNS]
+   * @param S Measurements of the voxel
+   * @param beta Output: ln(S0) and the elements of the tensor (divided by the scale of the b-values)
+   * @return false if there are less than TENSOR_UNKNOWNS positive measurements or the system is singular
+   */
+  template <typename T>
+  static bool tensor_fit(int nmeas, const double* X, const T* S, double* beta){
+    const int n=TENSOR_UNKNOWNS;
+    for(int pass=0;pass<2;pass++){
+      double A[n*n], r[n];
+      for(int i=0;i<n*n;i++) A[i]=0.0;
+      for(int i=0;i<n;i++) r[i]=0.0;
+      int used=0;
+      for(int m=0;m<nmeas;m++){
+	if(!(S[m]>0)) continue;
+	const double* x=&X[m*n];
+	double y=log((double)S[m]);
+	double w=1.0;
+	if(pass){
+	  // squared predicted signal, relative to S0 squared
+	  double pred=0.0;
+	  for(int i=1;i<n;i++) pred+=x[i]*beta[i];
+	  w=exp(2.0*pred);
+	}
+	for(int i=0;i<n;i++){
+	  r[i]+=w*x[i]*y;
+	  for(int j=0;j<n;j++){
+	    A[i*n+j]+=w*x[i]*x[j];
+	  }
+	}
+	used++;
+      }
+      if(used<n) return false;
+      if(!tensor_solve(n,A,r,beta)) return false;
+    }
+    return true;
+  }
+
+  // Polar angles of a unit vector, as cart2spherical
+  static void tensor_angles(const double* v, double& th, double& ph){
+    double z=v[2];
+    if(z>1.0) z=1.0;
+    if(z<-1.0) z=-1.0;
+    th=acos(z);
+    ph=atan2(v[1],v[0]);
+  }
+#endif
+
+  template <typename T>
+  int tensor_initialisation(int nvox, int nmeas, int CFP_Tsize, const T* CFP, const T* meas, T* params,
+			    const int* bound_types, const T* bounds_min, const T* bounds_max)
+  {
+#ifdef TENSOR_BVECS
+    cudimotOptions& opts = cudimotOptions::getInstance();
+    int nthreads=cpu_nthreads(opts.nthreads.value());
+
+    // The b-values are divided by the largest one, so all the unknowns have a similar scale
+    double bscale=0.0;
+    for(int m=0;m<nmeas;m++){
+      if(CFP[m*CFP_Tsize+TENSOR_BVALS]>bscale) bscale=CFP[m*CFP_Tsize+TENSOR_BVALS];
+    }
+    if(bscale<=0.0) return 0;
+
+    // The design matrix is the same for all the voxels
+    vector<double> X(nmeas*TENSOR_UNKNOWNS);
+    for(int m=0;m<nmeas;m++){
+      const T* g=&CFP[m*CFP_Tsize+TENSOR_BVECS];
+      double b=CFP[m*CFP_Tsize+TENSOR_BVALS]/bscale;
+      double* x=&X[m*TENSOR_UNKNOWNS];
+      x[0]=1.0;
+      x[1]=-b*g[0]*g[0];
+      x[2]=-b*g[1]*g[1];
+      x[3]=-b*g[2]*g[2];
+      x[4]=-2.0*b*g[0]*g[1];
+      x[5]=-2.0*b*g[0]*g[2];
+      x[6]=-2.0*b*g[1]*g[2];
+    }
+
+    vector<char> done(nvox,0);
+    parallel_voxels(nvox,64,nthreads,[&](int first, int last){
+	for(int v=first;v<last;v++){
+	  double beta[TENSOR_UNKNOWNS];
+	  if(!tensor_fit(nmeas,X.data(),&meas[v*nmeas],beta)) continue;
+
+	  double D[3][3];
+	  D[0][0]=beta[1]; D[1][1]=beta[2]; D[2][2]=beta[3];
+	  D[0][1]=D[1][0]=beta[4];
+	  D[0][2]=D[2][0]=beta[5];
+	  D[1][2]=D[2][1]=beta[6];
+	  double L[3], V[3][3];
+	  tensor_eigen(D,L,V);
+	  for(int i=0;i<3;i++) L[i]/=bscale;
+
+	  double V1[3]={V[0][0],V[1][0],V[2][0]};
+	  double V2[3]={V[0][1],V[1][1],V[2][1]};
+	  double MD=(L[0]+L[1]+L[2])/3.0;
+	  double num=(L[0]-MD)*(L[0]-MD)+(L[1]-MD)*(L[1]-MD)+(L[2]-MD)*(L[2]-MD);
+	  double den=L[0]*L[0]+L[1]*L[1]+L[2]*L[2];
+	  double FA=(den>0.0)?sqrt(1.5*num/den):0.0;
+
+	  double th1,ph1,th2,ph2;
+	  tensor_angles(V1,th1,ph1);
+	  tensor_angles(V2,th2,ph2);
+	  // V2 = cos(psi)*a + sin(psi)*c, with a and c orthogonal to V1 (see initialise_Psi and the fanning direction of NODDI_Bingham)
+	  double a[3]={-sin(ph1),cos(ph1),0.0};
+	  double c[3]={-cos(th1)*cos(ph1),-cos(th1)*sin(ph1),sin(th1)};
+	  double psi=atan2(V2[0]*c[0]+V2[1]*c[1]+V2[2]*c[2],V2[0]*a[0]+V2[1]*a[1]+V2[2]*a[2]);
+
+	  T tensor[TENSOR_VALUES];
+	  tensor[0]=(T)exp(beta[0]);
+	  tensor[1]=(T)L[0];
+	  tensor[2]=(T)L[1];
+	  tensor[3]=(T)L[2];
+	  tensor[4]=(T)MD;
+	  tensor[5]=(T)FA;
+	  tensor[6]=(T)th1;
+	  tensor[7]=(T)ph1;
+	  tensor[8]=(T)th2;
+	  tensor[9]=(T)ph2;
+	  tensor[10]=(T)psi;
+	  bool finite=true;
+	  for(int i=0;i<TENSOR_VALUES;i++){
+	    if(!std::isfinite((double)tensor[i])) finite=false;
+	  }
+	  if(!finite) continue;
+
+	  T* P=&params[v*NPARAMS];
+	  T P_tensor[NPARAMS];
+	  for(int p=0;p<NPARAMS;p++) P_tensor[p]=P[p];
+	  Tensor_Initialisation(tensor,P_tensor);
+	  for(int p=0;p<NPARAMS;p++){
+	    if(P_tensor[p]==P[p]) continue;
+	    if((bound_types[p]==BMIN || bound_types[p]==BMINMAX) && P_tensor[p]<bounds_min[p]) P_tensor[p]=bounds_min[p];
+	    if((bound_types[p]==BMAX || bound_types[p]==BMINMAX) && P_tensor[p]>bounds_max[p]) P_tensor[p]=bounds_max[p];
+	    P[p]=P_tensor[p];
+	  }
+	  done[v]=1;
+	}
+      });
+
+    int ndone=0;
+    for(int v=0;v<nvox;v++){
+      ndone+=done[v];
+    }
+    return ndone;
+#else
+    return 0;
+#endif
+  }
+
+  template int tensor_initialisation<float>(int,int,int,const float*,const float*,float*,const int*,const float*,const float*);
+  template int tensor_initialisation<double>(int,int,int,const double*,const double*,double*,const int*,const double*,const double*);
+}
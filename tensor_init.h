@@ -0,0 +1,60 @@
+#ifndef CUDIMOT_TENSOR_INIT_H_INCLUDED
+#define CUDIMOT_TENSOR_INIT_H_INCLUDED
+
+/*  tensor_init.h
+
+    Initialisation of the parameters with a diffusion tensor fit of each voxel (--init_tensor), instead of running dtifit and converting its output (Run_dtifit.sh, cart2spherical, initialise_Psi) before the model. A model can define in modelparameters.h the position of the gradient directions and the b-values in the common fixed parameters of a measurement:
+
+      #define TENSOR_BVECS 0 // CFP[0:2] are bvecs
+      #define TENSOR_BVALS 3 // CFP[3] are bvals
+
+    and provide in modelfunctions.h:
+
+      MACRO void Tensor_Initialisation(T* tensor, T* P);
+
+    The tensor is fitted on the host to the logarithm of the measurements: a least-squares fit gives the weights of a weighted least-squares fit (the squared predicted signals). The non-positive measurements are not used. Tensor_Initialisation receives the values of the tensor of a voxel and sets the parameters that are initialised with them:
+
+      tensor[0]: S0
+      tensor[1:3]: eigenvalues L1 >= L2 >= L3
+      tensor[4]: MD
+      tensor[5]: FA
+      tensor[6:7]: th and ph of the principal eigenvector V1
+      tensor[8:9]: th and ph of the second eigenvector V2
+      tensor[10]: psi, angle of V2 around V1 (as initialise_Psi, see NODDI_Bingham)
+
+    It runs after the values of --init_params (or the default values), so the parameters set by Tensor_Initialisation replace them. The values outside the bounds of a parameter are moved to the bound, and the voxels where the fit fails (less than 7 positive measurements or a singular system) keep their values.
+
+    The fit is computed in tensor_init.cc, compiled with the host compiler. The voxels are distributed among several threads (--nthreads)
+
+    agent
+
+    Copyright (C) 2026 University of Oxford  */
+
+/*  CCOPYRIGHT  */
+
+#include "modelparameters.h"
+
+// Number of values of the tensor of a voxel given to Tensor_Initialisation
+#define TENSOR_VALUES 11
+
+namespace Cudimot{
+
+  /**
+   * Fits the diffusion tensor of every voxel and initialises the parameters with Tensor_Initialisation. Compiled with the host compiler
+   * @param nvox Number of voxels
+   * @param nmeas Number of measurements
+   * @param CFP_Tsize Size of the common fixed parameters per measurement
+   * @param CFP Common fixed parameters [nmeas][CFP_Tsize]
+   * @param meas Measurements [nvox][nmeas]
+   * @param params Parameters of the voxels [nvox][NPARAMS]. The parameters set by Tensor_Initialisation are written
+   * @param bound_types Type of the bounds of each parameter
+   * @param bounds_min Lower bound of each parameter
+   * @param bounds_max Upper bound of each parameter
+   * @return Number of voxels initialised. 0 if the model does not define TENSOR_BVECS and TENSOR_BVALS
+   */
+  template <typename T>
+  int tensor_initialisation(int nvox, int nmeas, int CFP_Tsize, const T* CFP, const T* meas, T* params,
+			    const int* bound_types, const T* bounds_min, const T* bounds_max);
+}
+
+#endif
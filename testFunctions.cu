@@ -2,6 +2,8 @@
 
    A method to evaluate the model predicted signal and the derivatives given all the parameters (fixed and non-fixed). It evaluates the functions for just one set of parameters (does no accept volumes)
 
+   Compiled with nvcc the functions are evaluated in a GPU kernel. Compiled with a host compiler (-x c++) the same model functions are evaluated on the CPU.
+
    Moises Hernandez-Fernandez - FMRIB Image Analysis Group
    
    Copyright (C) 2005 University of Oxford */
@@ -10,21 +12,39 @@
 
 
 #include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#ifdef __CUDACC__
 #include "checkcudacalls.h"
+#endif
 #include "functions_gpu.h"
 #include "modelparameters.h"
+#include "protocol_cache.h"
 #include "macro_numerical.h"
 #include "modelfunctions.h"
 
 using namespace std;
 
+// The interpolation tables (tables.h) are not built here: the model functions use the exact routines
+Cudimot::Table tables_host[NTABLES_SIZE];
+#ifdef __CUDACC__
+__constant__ Cudimot::Table tables_gpu[NTABLES_SIZE];
+#endif
+
 template <typename T>
-__global__ void testFunctions_kernel(T* params,
+#ifdef __CUDACC__
+__global__
+#endif
+void testFunctions_kernel(T* params,
 				     T* CFP,
 				     T* FixP,
 				     int CFP_Tsize,
 				     int FixP_Tsize)
  {
+#if NPROTOCOL>0
+   // Values precomputed from the CFP, stored after them (see protocol_cache.h)
+   Prepare_Protocol(CFP,&CFP[CFP_Tsize]);
+#endif
    T pred;
    pred=Predicted_Signal(NPARAMS,params,CFP,FixP);
 
@@ -92,7 +112,7 @@ int main(int argc, char** argv){
   cout << "--- Test Model Functions ---" <<endl;
   
   MyType* params = new MyType[NPARAMS];
-  MyType* CFP = new MyType[CFP_Tsize];
+  MyType* CFP = new MyType[CFP_Tsize+NPROTOCOL];
   MyType* FixP = new MyType[FixP_Tsize];
   
   int par=1;
@@ -109,11 +129,12 @@ int main(int argc, char** argv){
     par++;
   }
 
+#ifdef __CUDACC__
   MyType* params_gpu;
   MyType* CFP_gpu;
   MyType* FixP_gpu;
   cudaMalloc((void**)&params_gpu,NPARAMS*sizeof(MyType));
-  cudaMalloc((void**)&CFP_gpu,CFP_Tsize*sizeof(MyType));
+  cudaMalloc((void**)&CFP_gpu,(CFP_Tsize+NPROTOCOL)*sizeof(MyType));
   cudaMalloc((void**)&FixP_gpu,FixP_Tsize*sizeof(MyType));
 
   cudaMemcpy(params_gpu,params,NPARAMS*sizeof(MyType),cudaMemcpyHostToDevice);
@@ -124,6 +145,9 @@ int main(int argc, char** argv){
 
   testFunctions_kernel<<<1,1>>>(params_gpu,CFP_gpu,FixP_gpu,CFP_Tsize,FixP_Tsize);
   sync_check("test_Functions Kernel\n");
+#else
+  testFunctions_kernel(params,CFP,FixP,CFP_Tsize,FixP_Tsize);
+#endif
 
   return 1;
 
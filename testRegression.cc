@@ -0,0 +1,793 @@
+/* testRegression.cc
+
+   Regression tests of the fitting routines of a model with a synthetic dataset. They are run by testRegression.sh ("make tests"):
+
+     testRegression_modelname mode [CUDIMOT options]
+
+     tables: only builds the tables of the model (--tables), that are validated with --validate_tables. testRegression.sh checks the messages
+     lm: Levenberg-Marquardt of the dataset on the GPU and on the CPU (--backend=cuda), from the same starting points. The exit status is 1 if the costs of the fits are different
+     grid: writes a grid for GridSearch around the parameters of the dataset (partsdir/gridSearch), for the tests of GridSearch (--gridSearch)
+     dictionary: GridSearch with a dictionary (--dictionary) and the brute-force GridSearch of the dataset. The exit status is 1 if the dictionary does not find the best combination of a voxel, or if the dictionary read from --dictionary_dir gives other parameters
+     levels: coarse-to-fine GridSearch (--gridLevels) and the brute-force GridSearch of the dataset with little noise. The exit status is 1 if the coarse-to-fine GridSearch does not find the best combination of the dense grid in a voxel
+     mcmc: MCMC of a part (--idPart, --nParts) of the dataset with the options given. The parameters and the samples (or the summaries) of each voxel are written in the part directory (partsdir/part_N/samples), so testRegression.sh can compare the runs
+     gaussian: MCMC of each parameter in turn, with the others fixed, with a dataset with little noise. The samples of each voxel must match the posterior of the parameter, which is close to a Gaussian (see posterior_param). The exit status is 1 if they do not match
+     summary: MCMC of the dataset keeping the samples and keeping only their summaries (--summary_only). The means, standard deviations and quantiles of the summaries must match those of the samples. The exit status is 1 if they do not match
+
+   The dataset has 6 measurements without diffusion weighting and 32 directions in two shells (b=1000 and b=2000 s/mm^2), so it is only built for the models whose common fixed parameters are the bvecs and the bvals. The parameters of every voxel are the initialisation of the priors file (P_init, --priors), the fixed parameters of the model are 1, and Gaussian noise is added to the predicted signal. The options --data and --maskfile are compulsory, but they are not read.
+
+   agent
+
+   Copyright (C) 2026 University of Oxford */
+
+/* CCOPYRIGHT */
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <random>
+#include <cmath>
+#include <algorithm>
+#include <cstdlib>
+#include <unistd.h>
+#include "cudimotoptions.h"
+#include "init_gpu.h"
+#include "Model.h"
+#include "GridSearch.h"
+#include "Levenberg_Marquardt.h"
+#include "MCMC.h"
+#include "tables.h"
+#include "functions_gpu.h"
+#include "modelparameters.h"
+#include "protocol_cache.h"
+#include "macro_numerical.h"
+#include "modelfunctions.h"
+#include "MCMC_summary.h"
+
+using namespace std;
+using namespace Cudimot;
+
+// Synthetic dataset
+#define TEST_NVOX 96 // Voxels of the dataset
+#define TEST_NB0 6 // Measurements without diffusion weighting
+#define TEST_NDIRS 32 // Directions of each shell
+#define TEST_NSHELLS 2 // Shells of b=1000, 2000 s/mm^2
+#define TEST_NOISE 0.02 // Standard deviation of the noise, relative to the signal without diffusion weighting
+#define TEST_NOISE_GAUSSIAN 0.005 // Noise of the test of the posterior: the signal is nearly linear in each parameter within its posterior
+// Tolerances of the test of the posterior (gaussian), averaged over the voxels
+#define TEST_GAUSSIAN_MEAN 0.05 // Error of the mean of the samples, relative to the standard deviation of the posterior
+#define TEST_GAUSSIAN_STD 0.05 // Relative error of the standard deviation of the samples
+#define TEST_GAUSSIAN_BOUND 6 // Minimum distance to a bound, in standard deviations of the posterior
+// Tolerances of the test of the summaries (summary), relative to the standard deviation of the samples
+#define TEST_SUMMARY_MOMENTS 1e-3 // Error of the mean and of the standard deviation in any voxel
+#define TEST_SUMMARY_QUANTILES 0.25 // Error of the quantiles estimated with the P-square algorithm, averaged over the voxels
+// Tolerances of the test of Levenberg-Marquardt (lm)
+#define TEST_LM_PERTURBATION 0.1 // Standard deviation of the perturbation of the starting points, relative to the true parameters
+#define TEST_LM_COST 1e-3 // Relative difference of the cost of a voxel between the GPU and the CPU
+// Grid of the tests of GridSearch (grid, dictionary, levels)
+#define TEST_GRID_NPARAMS 3 // Free parameters in the grid
+#define TEST_GRID_SIZE 9 // Values of each parameter
+#define TEST_GRID_STEP 0.125 // Step between the values, relative to the value in the dataset
+#define TEST_GRID_TRUE 3 // Index of the value of the dataset: with --gridLevels=3, it is not on the lattices of the first levels
+#define TEST_GRID_COST 1e-6 // Relative difference of the cost of a voxel with the brute-force GridSearch
+#define TEST_NOISE_LEVELS 0.005 // Noise of the test of the coarse-to-fine GridSearch (levels): the cost is smooth in the grid
+// Exit status of a test that cannot be run with this model
+#define TEST_SKIPPED 77
+
+struct synthetic_data{
+  int nvox;
+  int nmeas;
+  int CFP_Tsize; // Including the values precomputed from the protocol (NPROTOCOL)
+  int FixP_Tsize;
+  vector<MyType> CFP; // [nmeas][CFP_Tsize]
+  vector<MyType> FixP; // [nvox][FixP_Tsize]
+  vector<MyType> params; // True parameters of each voxel [nvox][NPARAMS]
+  vector<MyType> meas; // [nvox][nmeas]
+};
+
+/**
+ * Builds the synthetic dataset. The random numbers only depend on the seed (--seed), so every run of the tests has the same dataset
+ * @param noise Standard deviation of the noise, relative to the signal without diffusion weighting
+ */
+void synthetic_dataset(Model<MyType>& model, double noise, synthetic_data& data){
+  cudimotOptions& opts = cudimotOptions::getInstance();
+  if(NCFP!=2 || MODEL::CFP_size[0]!=3 || MODEL::CFP_size[1]!=1){
+    cout << "The synthetic dataset of the tests needs a model whose common fixed parameters are the bvecs and the bvals: the tests are not run" << endl;
+    exit(TEST_SKIPPED);
+  }
+  if(!model.initProvided()){
+    cerr << "CUDIMOT Error: The parameters of the synthetic dataset are the initialisation of the priors file (P_init), and it does not provide them" << endl;
+    exit(-1);
+  }
+  data.nvox=TEST_NVOX;
+  data.nmeas=TEST_NB0+TEST_NSHELLS*TEST_NDIRS;
+  data.CFP_Tsize=4+NPROTOCOL;
+  data.FixP_Tsize=0;
+  for(int i=0;i<NFIXP;i++){
+    data.FixP_Tsize+=MODEL::FixP_size[i];
+  }
+
+  mt19937 generator(opts.seed.value());
+  normal_distribution<double> normal(0.0,1.0);
+
+  // Protocol: bvecs and bvals
+  data.CFP.assign(data.nmeas*data.CFP_Tsize,(MyType)0.0);
+  for(int m=0;m<data.nmeas;m++){
+    MyType* cfp=&data.CFP[m*data.CFP_Tsize];
+    if(m<TEST_NB0){
+      cfp[0]=(MyType)1.0;
+      continue;
+    }
+    double dir[3],norm=0.0;
+    for(int i=0;i<3;i++){
+      dir[i]=normal(generator);
+      norm+=dir[i]*dir[i];
+    }
+    norm=sqrt(norm);
+    for(int i=0;i<3;i++){
+      cfp[i]=(MyType)(dir[i]/norm);
+    }
+    cfp[3]=(MyType)(1000.0*(1+(m-TEST_NB0)/TEST_NDIRS));
+  }
+  vector<int> shells(data.nmeas);
+  prepare_protocol(data.nmeas,data.CFP_Tsize,data.CFP.data(),shells.data());
+
+  data.FixP.assign(data.nvox*data.FixP_Tsize,(MyType)1.0);
+  data.params.resize(data.nvox*NPARAMS);
+  data.meas.resize(data.nvox*data.nmeas);
+  for(int v=0;v<data.nvox;v++){
+    MyType* params=&data.params[v*NPARAMS];
+    MyType* FixP=&data.FixP[v*data.FixP_Tsize];
+    for(int p=0;p<NPARAMS;p++){
+      params[p]=model.getParam_init(p);
+    }
+    double sigma=noise*fabs((double)Predicted_Signal(NPARAMS,params,&data.CFP[0],FixP));
+    for(int m=0;m<data.nmeas;m++){
+      data.meas[v*data.nmeas+m]=Predicted_Signal(NPARAMS,params,&data.CFP[m*data.CFP_Tsize],FixP)+(MyType)(sigma*normal(generator));
+    }
+  }
+}
+
+/**
+ * First voxel and number of voxels of a part of the dataset (--idPart, --nParts), divided as in split_parts
+ */
+void dataset_part(int nvox, int& first_voxel, int& size){
+  cudimotOptions& opts = cudimotOptions::getInstance();
+  int nparts=opts.nParts.value();
+  int part=opts.idPart.value();
+  if(nparts<1 || nvox<nparts || part<0 || part>=nparts){
+    cerr << "CUDIMOT Error: The synthetic dataset has " << nvox << " voxels: it cannot be divided in " << nparts << " parts, or the part " << part << " does not exist" << endl;
+    exit(-1);
+  }
+  int size_part=nvox/nparts;
+  first_voxel=part*size_part;
+  size=(part==nparts-1)?nvox-first_voxel:size_part;
+}
+
+/**
+ * Results of MCMC of some voxels, in host memory
+ */
+struct mcmc_results{
+  int nsamples;
+  vector<MyType> params; // [nvox][NPARAMS]
+  vector<MyType> samples; // [nvox][NPARAMS][nsamples]
+  vector<MyType> tau; // [nvox][nsamples]
+  vector<MyType> summary; // [nvox][SUMMARY_VOXEL_SIZE], --summary_only
+  vector<MyType> convergence; // [nvox][MCMC_NDIAGNOSTICS], several chains on the CPU
+};
+
+/**
+ * Runs MCMC with the backend selected (--backend) on the voxels [first_voxel,first_voxel+nvox) of the dataset, starting from the true parameters, as cudimot.cc runs a part
+ * @param fixed Fixed parameters of the model (--fixed)
+ * @param summary Keep the summaries of the samples instead of the samples (--summary_only)
+ */
+void run_mcmc(Model<MyType>& model, const synthetic_data& data, int first_voxel, int nvox, vector<int> fixed, bool summary, mcmc_results& results){
+  cudimotOptions& opts = cudimotOptions::getInstance();
+  if(!opts.runMCMC.value()){
+    cerr << "CUDIMOT Error: The tests of MCMC must be run with --runMCMC" << endl;
+    exit(-1);
+  }
+  int nsamples=opts.njumps.value()/opts.sampleevery.value();
+  int nmeas=data.nmeas;
+  results.nsamples=nsamples;
+  results.params.assign(data.params.begin()+first_voxel*NPARAMS,data.params.begin()+(first_voxel+nvox)*NPARAMS);
+  results.samples.assign(summary?0:nvox*NPARAMS*nsamples,(MyType)0.0);
+  results.tau.assign(summary?0:nvox*nsamples,(MyType)0.0);
+  results.summary.assign(summary?nvox*SUMMARY_VOXEL_SIZE:0,(MyType)0.0);
+  results.convergence.assign(nvox*MCMC_NDIAGNOSTICS,(MyType)0.0);
+
+  MCMC<MyType> methodMCMC(nvox,
+			  model.getBound_types(),
+			  model.getBounds_min(),
+			  model.getBounds_max(),
+			  model.getPrior_types(),
+			  model.getPriors_a(),
+			  model.getPriors_b(),
+			  fixed);
+
+  MyType *meas_part, *params_part, *CFP_part, *FixP_part, *samples_part, *tau_part, *summary_part=NULL;
+  int nsamples_part=summary?1:nsamples; // as in Parameters.cu
+  allocate_part((void**)&meas_part,nvox*nmeas*sizeof(MyType),"Allocating the measurements of the test");
+  allocate_part((void**)&params_part,nvox*NPARAMS*sizeof(MyType),"Allocating the parameters of the test");
+  allocate_part((void**)&CFP_part,nmeas*data.CFP_Tsize*sizeof(MyType),"Allocating the common fixed parameters of the test");
+  allocate_part((void**)&FixP_part,nvox*data.FixP_Tsize*sizeof(MyType),"Allocating the fixed parameters of the test");
+  allocate_part((void**)&samples_part,nvox*NPARAMS*nsamples_part*sizeof(MyType),"Allocating the samples of the test");
+  allocate_part((void**)&tau_part,nvox*nsamples_part*sizeof(MyType),"Allocating the samples of tau of the test");
+  if(summary){
+    allocate_part((void**)&summary_part,nvox*SUMMARY_VOXEL_SIZE*sizeof(MyType),"Allocating the summaries of the test");
+  }
+  copy_host2part(meas_part,data.meas.data()+first_voxel*nmeas,nvox*nmeas*sizeof(MyType),"Copying the measurements of the test");
+  copy_host2part(params_part,results.params.data(),nvox*NPARAMS*sizeof(MyType),"Copying the parameters of the test");
+  copy_host2part(CFP_part,data.CFP.data(),nmeas*data.CFP_Tsize*sizeof(MyType),"Copying the common fixed parameters of the test");
+  copy_host2part(FixP_part,data.FixP.data()+first_voxel*data.FixP_Tsize,nvox*data.FixP_Tsize*sizeof(MyType),"Copying the fixed parameters of the test");
+
+  methodMCMC.run(nvox,nmeas,data.CFP_Tsize,data.FixP_Tsize,
+		 meas_part,params_part,CFP_part,FixP_part,
+		 samples_part,tau_part,summary_part,
+		 results.convergence.data(),first_voxel);
+
+  copy_part2host(results.params.data(),params_part,nvox*NPARAMS*sizeof(MyType),"Copying the parameters of the test");
+  if(summary){
+    copy_part2host(results.summary.data(),summary_part,nvox*SUMMARY_VOXEL_SIZE*sizeof(MyType),"Copying the summaries of the test");
+  }else{
+    copy_part2host(results.samples.data(),samples_part,nvox*NPARAMS*nsamples*sizeof(MyType),"Copying the samples of the test");
+    copy_part2host(results.tau.data(),tau_part,nvox*nsamples*sizeof(MyType),"Copying the samples of tau of the test");
+  }
+}
+
+/**
+ * mcmc: writes the results of MCMC of the part, voxel by voxel, so the files of the parts can be concatenated
+ */
+int test_mcmc(Model<MyType>& model){
+  cudimotOptions& opts = cudimotOptions::getInstance();
+  synthetic_data data;
+  synthetic_dataset(model,TEST_NOISE,data);
+  int first_voxel, nvox;
+  dataset_part(data.nvox,first_voxel,nvox);
+
+  mcmc_results results;
+  run_mcmc(model,data,first_voxel,nvox,model.getFixed(),opts.summary_only.value(),results);
+
+  int nsamples=results.nsamples;
+  string file=opts.partsdir.value()+"/part_"+to_string(opts.idPart.value())+"/samples";
+  ofstream out;
+  out.open(file.data(), ios::out | ios::binary);
+  for(int v=0;v<nvox;v++){
+    out.write((char*)&results.params[v*NPARAMS],NPARAMS*sizeof(MyType));
+    if(opts.summary_only.value()){
+      out.write((char*)&results.summary[v*SUMMARY_VOXEL_SIZE],SUMMARY_VOXEL_SIZE*sizeof(MyType));
+    }else{
+      out.write((char*)&results.samples[v*NPARAMS*nsamples],NPARAMS*nsamples*sizeof(MyType));
+      if(opts.rician.value()){
+	out.write((char*)&results.tau[v*nsamples],nsamples*sizeof(MyType));
+      }
+    }
+    if(opts.nchains.value()>1){
+      out.write((char*)&results.convergence[v*MCMC_NDIAGNOSTICS],MCMC_NDIAGNOSTICS*sizeof(MyType));
+    }
+  }
+  out.close();
+  if(!out){
+    cerr << "CUDIMOT Error: The samples of the test cannot be written in " << file << endl;
+    exit(-1);
+  }
+  cout << "MCMC of the voxels [" << first_voxel << "," << first_voxel+nvox << ") written in " << file << endl;
+  return 0;
+}
+
+/**
+ * Predicted signal of a voxel with the parameter idpar set to value, in double precision
+ */
+double signal_param(const synthetic_data& data, int idVOX, int m, int idpar, double value){
+  double params[NPARAMS];
+  vector<double> CFP(data.CFP.begin()+m*data.CFP_Tsize,data.CFP.begin()+(m+1)*data.CFP_Tsize);
+  vector<double> FixP(data.FixP.begin()+idVOX*data.FixP_Tsize,data.FixP.begin()+(idVOX+1)*data.FixP_Tsize);
+  for(int p=0;p<NPARAMS;p++){
+    params[p]=data.params[idVOX*NPARAMS+p];
+  }
+  params[idpar]=value;
+  return Predicted_Signal(NPARAMS,params,CFP.data(),FixP.data());
+}
+
+/**
+ * Posterior of the parameter idpar of a voxel, with the other parameters fixed at their true values. The noise is marginalised in the likelihood of MCMC, so the posterior is proportional to SSE^(-nmeas/2). If the signal is linear in the parameter near the least-squares estimate, SSE = SSEmin + D*(x-mode)^2 and the posterior is a Student's t with nmeas-1 degrees of freedom (close to a Gaussian), with variance SSEmin/((nmeas-3)*D)
+ * @return false if the signal does not depend on the parameter
+ */
+bool posterior_param(const synthetic_data& data, int idVOX, int idpar, double& mode, double& std){
+  int nmeas=data.nmeas;
+  mode=data.params[idVOX*NPARAMS+idpar];
+  double SSE=0.0, D=0.0;
+  // Gauss-Newton with numerical derivatives
+  for(int iter=0;iter<50;iter++){
+    double h=1e-6*(mode!=0.0?fabs(mode):1.0);
+    double gradient=0.0;
+    SSE=0.0;
+    D=0.0;
+    for(int m=0;m<nmeas;m++){
+      double residual=data.meas[idVOX*nmeas+m]-signal_param(data,idVOX,m,idpar,mode);
+      double derivative=(signal_param(data,idVOX,m,idpar,mode+h)-signal_param(data,idVOX,m,idpar,mode-h))/(2.0*h);
+      SSE+=residual*residual;
+      D+=derivative*derivative;
+      gradient+=derivative*residual;
+    }
+    if(D==0.0) return false;
+    double step=gradient/D;
+    mode+=step;
+    if(fabs(step)<=1e-12*(fabs(mode)+h)) break;
+  }
+  std=sqrt(SSE/((nmeas-3)*D));
+  return true;
+}
+
+/**
+ * gaussian: each parameter of the model is sampled in turn with the others fixed at their true values (--sampler, usually hmc or nuts), with a dataset with little noise. The mean and the standard deviation of the samples of each voxel must match the posterior computed by posterior_param. The parameters with other priors than sin(), or whose posterior is near a bound, are not tested
+ */
+int test_gaussian(Model<MyType>& model){
+  synthetic_data data;
+  synthetic_dataset(model,TEST_NOISE_GAUSSIAN,data);
+  int nvox=data.nvox;
+  vector<int> bound_types=model.getBound_types();
+  vector<MyType> bounds_min=model.getBounds_min();
+  vector<MyType> bounds_max=model.getBounds_max();
+  vector<int> prior_types=model.getPrior_types();
+
+  int failed=0, tested=0;
+  for(int idpar=0;idpar<NPARAMS;idpar++){
+    if(prior_types[idpar]!=NOPRIOR && prior_types[idpar]!=SINPRIOR){
+      cout << "Parameter " << idpar << ": not tested, it has a prior" << endl;
+      continue;
+    }
+    vector<double> mode(nvox), std(nvox);
+    bool testable=true;
+    for(int v=0;v<nvox && testable;v++){
+      testable=posterior_param(data,v,idpar,mode[v],std[v]);
+      bool lower=(bound_types[idpar]==BMIN || bound_types[idpar]==BMINMAX);
+      bool upper=(bound_types[idpar]==BMAX || bound_types[idpar]==BMINMAX);
+      if(lower && mode[v]-TEST_GAUSSIAN_BOUND*std[v]<bounds_min[idpar]) testable=false;
+      if(upper && mode[v]+TEST_GAUSSIAN_BOUND*std[v]>bounds_max[idpar]) testable=false;
+    }
+    if(!testable){
+      cout << "Parameter " << idpar << ": not tested, the signal does not depend on it or its posterior is near a bound" << endl;
+      continue;
+    }
+
+    vector<int> fixed(NPARAMS,1);
+    fixed[idpar]=0;
+    mcmc_results results;
+    run_mcmc(model,data,0,nvox,fixed,false,results);
+
+    // Errors of the mean (relative to the standard deviation of the posterior) and of the standard deviation, averaged over the voxels
+    int nsamples=results.nsamples;
+    double error_mean=0.0, ratio_std=0.0;
+    for(int v=0;v<nvox;v++){
+      const MyType* samples=&results.samples[(v*NPARAMS+idpar)*nsamples];
+      double mean=0.0, var=0.0;
+      for(int s=0;s<nsamples;s++){
+	mean+=samples[s];
+      }
+      mean/=nsamples;
+      for(int s=0;s<nsamples;s++){
+	var+=(samples[s]-mean)*(samples[s]-mean);
+      }
+      var/=(nsamples-1);
+      error_mean+=(mean-mode[v])/std[v];
+      ratio_std+=sqrt(var)/std[v];
+    }
+    error_mean/=nvox;
+    ratio_std/=nvox;
+    bool ok=fabs(error_mean)<=TEST_GAUSSIAN_MEAN && fabs(ratio_std-1.0)<=TEST_GAUSSIAN_STD;
+    cout << "Parameter " << idpar << ": error of the mean " << error_mean << " std, std of the samples / std of the posterior " << ratio_std << (ok?"":" (too large)") << endl;
+    if(!ok) failed++;
+    tested++;
+  }
+  if(tested==0){
+    cerr << "CUDIMOT Error: No parameter of the model can be tested" << endl;
+    return 1;
+  }
+  return failed>0;
+}
+
+/**
+ * Sum of the squared residuals of each voxel of the dataset with some parameters
+ */
+vector<double> voxel_costs(const synthetic_data& data, vector<MyType> params){
+  vector<double> costs(data.nvox,0.0);
+  vector<MyType> CFP(data.CFP), FixP(data.FixP);
+  for(int v=0;v<data.nvox;v++){
+    for(int m=0;m<data.nmeas;m++){
+      double residual=data.meas[v*data.nmeas+m]-Predicted_Signal(NPARAMS,&params[v*NPARAMS],&CFP[m*data.CFP_Tsize],&FixP[v*data.FixP_Tsize]);
+      costs[v]+=residual*residual;
+    }
+  }
+  return costs;
+}
+
+/**
+ * lm: Levenberg-Marquardt on the GPU (--backend=cuda) and on the CPU from the same starting points, the true parameters perturbed. The fits of every voxel must have the same cost. The parameters may differ where the cost is flat (e.g. the orientations of a stick with little anisotropy), so their differences are only reported
+ */
+int test_lm(Model<MyType>& model){
+  cudimotOptions& opts = cudimotOptions::getInstance();
+  if(cpu_backend()){
+    cerr << "CUDIMOT Error: The test of Levenberg-Marquardt compares the GPU with the CPU: it must be run with --backend=cuda" << endl;
+    exit(-1);
+  }
+  synthetic_data data;
+  synthetic_dataset(model,TEST_NOISE,data);
+  int nvox=data.nvox;
+  int nmeas=data.nmeas;
+  vector<int> bound_types=model.getBound_types();
+  vector<MyType> bounds_min=model.getBounds_min();
+  vector<MyType> bounds_max=model.getBounds_max();
+  vector<int> fixed=model.getFixed();
+
+  // Starting points: each free parameter perturbed by 10%, inside its bounds
+  mt19937 generator(opts.seed.value()+1);
+  normal_distribution<double> normal(0.0,1.0);
+  vector<MyType> params_cpu(data.params);
+  for(int v=0;v<nvox;v++){
+    for(int p=0;p<NPARAMS;p++){
+      if(fixed[p]) continue;
+      double value=params_cpu[v*NPARAMS+p]*(1.0+TEST_LM_PERTURBATION*normal(generator));
+      if(bound_types[p]==BMIN || bound_types[p]==BMINMAX) value=max(value,(double)bounds_min[p]);
+      if(bound_types[p]==BMAX || bound_types[p]==BMINMAX) value=min(value,(double)bounds_max[p]);
+      params_cpu[v*NPARAMS+p]=(MyType)value;
+    }
+  }
+  vector<MyType> params_gpu(params_cpu);
+  vector<MyType> meas(data.meas), CFP(data.CFP), FixP(data.FixP);
+
+  Levenberg_Marquardt<MyType> methodLM(bound_types,bounds_min,bounds_max,fixed);
+  methodLM.run_cpu(nvox,nmeas,data.CFP_Tsize,data.FixP_Tsize,
+		   meas.data(),params_cpu.data(),CFP.data(),FixP.data(),1,NULL);
+
+  MyType *meas_gpu, *params_part, *CFP_gpu, *FixP_gpu;
+  allocate_part((void**)&meas_gpu,nvox*nmeas*sizeof(MyType),"Allocating the measurements of the test");
+  allocate_part((void**)&params_part,nvox*NPARAMS*sizeof(MyType),"Allocating the parameters of the test");
+  allocate_part((void**)&CFP_gpu,nmeas*data.CFP_Tsize*sizeof(MyType),"Allocating the common fixed parameters of the test");
+  allocate_part((void**)&FixP_gpu,nvox*data.FixP_Tsize*sizeof(MyType),"Allocating the fixed parameters of the test");
+  copy_host2part(meas_gpu,data.meas.data(),nvox*nmeas*sizeof(MyType),"Copying the measurements of the test");
+  copy_host2part(params_part,params_gpu.data(),nvox*NPARAMS*sizeof(MyType),"Copying the parameters of the test");
+  copy_host2part(CFP_gpu,data.CFP.data(),nmeas*data.CFP_Tsize*sizeof(MyType),"Copying the common fixed parameters of the test");
+  copy_host2part(FixP_gpu,data.FixP.data(),nvox*data.FixP_Tsize*sizeof(MyType),"Copying the fixed parameters of the test");
+  methodLM.run_gpu(nvox,nmeas,data.CFP_Tsize,data.FixP_Tsize,
+		   meas_gpu,params_part,CFP_gpu,FixP_gpu,1,NULL);
+  copy_part2host(params_gpu.data(),params_part,nvox*NPARAMS*sizeof(MyType),"Copying the parameters of the test");
+
+  vector<double> costs_cpu=voxel_costs(data,params_cpu);
+  vector<double> costs_gpu=voxel_costs(data,params_gpu);
+  int different=0;
+  double error_params=0.0;
+  for(int v=0;v<nvox;v++){
+    if(fabs(costs_gpu[v]-costs_cpu[v])>TEST_LM_COST*costs_cpu[v]){
+      cout << "Voxel " << v << ": cost on the GPU " << costs_gpu[v] << ", on the CPU " << costs_cpu[v] << endl;
+      different++;
+    }
+    for(int p=0;p<NPARAMS;p++){
+      double scale=max(fabs((double)params_cpu[v*NPARAMS+p]),1e-12);
+      error_params=max(error_params,fabs((double)(params_gpu[v*NPARAMS+p]-params_cpu[v*NPARAMS+p]))/scale);
+    }
+  }
+  cout << "Levenberg-Marquardt: " << different << " of " << nvox << " voxels with a different cost on the GPU and on the CPU. Maximum relative difference of the parameters " << error_params << endl;
+  return different>0;
+}
+
+/**
+ * grid: writes the grid of the tests of GridSearch to partsdir/gridSearch, in the format of --gridSearch. It has TEST_GRID_SIZE values of the first TEST_GRID_NPARAMS free parameters, at steps of TEST_GRID_STEP times their value in the dataset (or TEST_GRID_STEP if it is 0), that is the value TEST_GRID_TRUE. The parameter that scales the signal with --dictionary (SCALE_PARAM) is not in the grid
+ */
+int write_grid(Model<MyType>& model){
+  cudimotOptions& opts = cudimotOptions::getInstance();
+  string file=opts.partsdir.value()+"/gridSearch";
+  ofstream out(file.c_str());
+  if(!out.is_open()){
+    cerr << "CUDIMOT Error: Unable to write the grid of the tests: " << file << endl;
+    exit(-1);
+  }
+  vector<int> fixed=model.getFixed();
+  int nGridParams=0;
+  for(int p=0;p<NPARAMS && nGridParams<TEST_GRID_NPARAMS;p++){
+    if(fixed[p]) continue;
+#ifdef SCALE_PARAM
+    if(p==SCALE_PARAM) continue;
+#endif
+    double value=model.getParam_init(p);
+    out << "search[" << p << "]=(";
+    for(int i=0;i<TEST_GRID_SIZE;i++){
+      double step=TEST_GRID_STEP*((value!=0.0)?value:1.0);
+      out << value+(i-TEST_GRID_TRUE)*step << ((i<TEST_GRID_SIZE-1)?",":")\n");
+    }
+    nGridParams++;
+  }
+  cout << "Grid of the tests of GridSearch with " << nGridParams << " parameters written to " << file << endl;
+  return 0;
+}
+
+/**
+ * Runs GridSearch (--gridSearch) with the backend selected (--backend) on the dataset, starting from the parameters of params, as cudimot.cc runs a part. GridSearch is built for every run, so the dictionary (--dictionary) is built, or read from --dictionary_dir, every time
+ */
+void run_gridsearch(Model<MyType>& model, const synthetic_data& data, vector<MyType>& params){
+  int nvox=data.nvox;
+  int nmeas=data.nmeas;
+  GridSearch<MyType> methodGridSearch(model.getNGridParams(),
+				      model.getGridParams(),
+				      model.getGridSizes(),
+				      model.getGridCombs(),
+				      model.getGrid(),
+				      model.getBound_types(),
+				      model.getBounds_min(),
+				      model.getBounds_max());
+
+  MyType *meas_part, *params_part, *CFP_part, *FixP_part;
+  allocate_part((void**)&meas_part,nvox*nmeas*sizeof(MyType),"Allocating the measurements of the test");
+  allocate_part((void**)&params_part,nvox*NPARAMS*sizeof(MyType),"Allocating the parameters of the test");
+  allocate_part((void**)&CFP_part,nmeas*data.CFP_Tsize*sizeof(MyType),"Allocating the common fixed parameters of the test");
+  allocate_part((void**)&FixP_part,nvox*data.FixP_Tsize*sizeof(MyType),"Allocating the fixed parameters of the test");
+  copy_host2part(meas_part,data.meas.data(),nvox*nmeas*sizeof(MyType),"Copying the measurements of the test");
+  copy_host2part(params_part,params.data(),nvox*NPARAMS*sizeof(MyType),"Copying the parameters of the test");
+  copy_host2part(CFP_part,data.CFP.data(),nmeas*data.CFP_Tsize*sizeof(MyType),"Copying the common fixed parameters of the test");
+  copy_host2part(FixP_part,data.FixP.data(),nvox*data.FixP_Tsize*sizeof(MyType),"Copying the fixed parameters of the test");
+  methodGridSearch.run(nvox,nmeas,data.CFP_Tsize,data.FixP_Tsize,
+		       meas_part,params_part,CFP_part,FixP_part,1,NULL);
+  copy_part2host(params.data(),params_part,nvox*NPARAMS*sizeof(MyType),"Copying the parameters of the test");
+}
+
+/**
+ * Brute-force GridSearch of a voxel: the cost of every combination of the grid, with the other parameters of params. The combinations outside the bounds have an infinite cost
+ * @param solve_scale The parameter that scales the signal (SCALE_PARAM) has its least-squares value for each combination, as with --dictionary
+ */
+vector<double> grid_costs(Model<MyType>& model, const synthetic_data& data, int idVOX, const MyType* params, bool solve_scale){
+  int nGridParams=model.getNGridParams();
+  vector<int> gridParams=model.getGridParams();
+  int gridCombs=model.getGridCombs();
+  const MyType* grid=model.getGrid();
+  vector<int> bound_types=model.getBound_types();
+  vector<MyType> bounds_min=model.getBounds_min();
+  vector<MyType> bounds_max=model.getBounds_max();
+  MyType* CFP=const_cast<MyType*>(data.CFP.data());
+  MyType* FixP=const_cast<MyType*>(&data.FixP[idVOX*data.FixP_Tsize]);
+  const MyType* meas=&data.meas[idVOX*data.nmeas];
+
+  vector<double> costs(gridCombs,INFINITY);
+  for(int comb=0;comb<gridCombs;comb++){
+    MyType P[NPARAMS];
+    for(int p=0;p<NPARAMS;p++){
+      P[p]=params[p];
+    }
+    for(int i=0;i<nGridParams;i++){
+      P[gridParams[i]]=grid[comb*nGridParams+i];
+    }
+    bool inside=true;
+    for(int p=0;p<NPARAMS;p++){
+#ifdef SCALE_PARAM
+      if(solve_scale && p==SCALE_PARAM) continue;
+#endif
+      if((bound_types[p]==BMIN || bound_types[p]==BMINMAX) && P[p]<bounds_min[p]) inside=false;
+      if((bound_types[p]==BMAX || bound_types[p]==BMINMAX) && P[p]>bounds_max[p]) inside=false;
+    }
+    if(!inside) continue;
+#ifdef SCALE_PARAM
+    if(solve_scale){
+      double dot=0.0, norm2=0.0;
+      P[SCALE_PARAM]=(MyType)1.0;
+      for(int m=0;m<data.nmeas;m++){
+	double signal=Predicted_Signal(NPARAMS,P,&CFP[m*data.CFP_Tsize],FixP);
+	dot+=meas[m]*signal;
+	norm2+=signal*signal;
+      }
+      P[SCALE_PARAM]=(MyType)((norm2>0.0)?dot/norm2:0.0);
+    }
+#endif
+    double cost=0.0;
+    for(int m=0;m<data.nmeas;m++){
+      double residual=meas[m]-Predicted_Signal(NPARAMS,P,&CFP[m*data.CFP_Tsize],FixP);
+      cost+=residual*residual;
+    }
+    if(!std::isnan(cost)) costs[comb]=cost;
+  }
+  return costs;
+}
+
+/**
+ * Combination of the grid with the values of the parameters of a voxel, -1 if there is none
+ */
+int grid_comb_of(Model<MyType>& model, const MyType* params){
+  int nGridParams=model.getNGridParams();
+  vector<int> gridParams=model.getGridParams();
+  const MyType* grid=model.getGrid();
+  for(int comb=0;comb<model.getGridCombs();comb++){
+    bool same=true;
+    for(int i=0;i<nGridParams;i++){
+      if(params[gridParams[i]]!=grid[comb*nGridParams+i]) same=false;
+    }
+    if(same) return comb;
+  }
+  return -1;
+}
+
+/**
+ * Compares the combinations found by GridSearch in params with the brute-force GridSearch of each voxel (grid_costs). The cost of the combination of every voxel must be the lowest cost of the grid. Different combinations with the same cost are only reported
+ * @return Number of voxels with a higher cost
+ */
+int compare_grid(Model<MyType>& model, const synthetic_data& data, const vector<MyType>& params, bool solve_scale, const char* name){
+  int higher=0, different=0;
+  for(int v=0;v<data.nvox;v++){
+    vector<double> costs=grid_costs(model,data,v,&data.params[v*NPARAMS],solve_scale);
+    int best=min_element(costs.begin(),costs.end())-costs.begin();
+    int comb=grid_comb_of(model,&params[v*NPARAMS]);
+    if(comb!=best) different++;
+    if(comb<0 || !(costs[comb]<=costs[best]*(1.0+TEST_GRID_COST))){
+      cout << "Voxel " << v << ": cost of the combination of " << name << " " << ((comb<0)?NAN:costs[comb]) << ", lowest cost of the grid " << costs[best] << endl;
+      higher++;
+    }
+  }
+  cout << name << ": " << higher << " of " << data.nvox << " voxels with a higher cost than the brute-force GridSearch, " << different << " with a different combination" << endl;
+  return higher;
+}
+
+/**
+ * dictionary: GridSearch with the dictionary of the predicted signals (--dictionary, --gridSearch) from the true parameters. Every voxel must get the combination of the grid with the lowest cost, solving the scale (SCALE_PARAM) as the dictionary. With --dictionary_dir, GridSearch is run again with the dictionary read from the file, and the parameters must be the same
+ */
+int test_dictionary(Model<MyType>& model){
+  cudimotOptions& opts = cudimotOptions::getInstance();
+  if(!opts.dictionary.value() || model.getNGridParams()==0){
+    cerr << "CUDIMOT Error: The test of the dictionary compares it with the brute-force GridSearch: it must be run with --dictionary and --gridSearch" << endl;
+    exit(-1);
+  }
+  synthetic_data data;
+  synthetic_dataset(model,TEST_NOISE,data);
+  vector<MyType> params(data.params);
+  run_gridsearch(model,data,params);
+  int failed=compare_grid(model,data,params,true,"GridSearch with a dictionary");
+
+  if(opts.dictionary_dir.value()!=""){
+    vector<MyType> params_file(data.params);
+    run_gridsearch(model,data,params_file);
+    int different=0;
+    for(int i=0;i<data.nvox*NPARAMS;i++){
+      if(params_file[i]!=params[i]) different++;
+    }
+    cout << "GridSearch with the dictionary of --dictionary_dir: " << different << " different parameters" << endl;
+    failed+=different;
+  }
+  return failed>0;
+}
+
+/**
+ * levels: coarse-to-fine GridSearch (--gridLevels, --gridSearch) from the true parameters, with a dataset with little noise. Every voxel must get the combination of the dense grid with the lowest cost
+ */
+int test_levels(Model<MyType>& model){
+  cudimotOptions& opts = cudimotOptions::getInstance();
+  if(opts.gridLevels.value()<2 || model.getNGridParams()==0 || opts.dictionary.value()){
+    cerr << "CUDIMOT Error: The test of the coarse-to-fine GridSearch compares it with the dense grid: it must be run with --gridLevels (at least 2) and --gridSearch, without --dictionary" << endl;
+    exit(-1);
+  }
+  synthetic_data data;
+  synthetic_dataset(model,TEST_NOISE_LEVELS,data);
+  vector<MyType> params(data.params);
+  run_gridsearch(model,data,params);
+  return compare_grid(model,data,params,false,"Coarse-to-fine GridSearch")>0;
+}
+
+/**
+ * Quantile of some samples, interpolated between the sorted samples (type 7 of Hyndman and Fan, as the quantiles of up to 5 samples in MCMC_summary.h)
+ */
+double exact_quantile(vector<double> samples, double p){
+  sort(samples.begin(),samples.end());
+  double pos=p*(samples.size()-1);
+  int i=(int)pos;
+  if(i>=(int)samples.size()-1) return samples.back();
+  return samples[i]+(pos-i)*(samples[i+1]-samples[i]);
+}
+
+/**
+ * summary: MCMC is run twice with the same options, keeping the samples and the summaries (--summary_only). The chains are the same, so the mean and the standard deviation of the summaries must match those of the samples, and the quantiles estimated with the P-square algorithm must be close to the exact quantiles of the samples. The errors are relative to the standard deviation of the samples
+ */
+int test_summary(Model<MyType>& model){
+  cudimotOptions& opts = cudimotOptions::getInstance();
+  synthetic_data data;
+  synthetic_dataset(model,TEST_NOISE,data);
+  int nvox=data.nvox;
+  mcmc_results samples, summaries;
+  run_mcmc(model,data,0,nvox,model.getFixed(),false,samples);
+  run_mcmc(model,data,0,nvox,model.getFixed(),true,summaries);
+  int nsamples=samples.nsamples;
+
+  int failed=0;
+  int nsummaries=NPARAMS+(opts.rician.value()?1:0); // tau is summarised after the parameters
+  for(int idpar=0;idpar<nsummaries;idpar++){
+    double error_moments=0.0, error_quantiles[SUMMARY_NQUANTILES]={0.0};
+    int tested=0;
+    for(int v=0;v<nvox;v++){
+      vector<double> s(nsamples);
+      for(int i=0;i<nsamples;i++){
+	s[i]=(idpar<NPARAMS)?samples.samples[(v*NPARAMS+idpar)*nsamples+i]:samples.tau[v*nsamples+i];
+      }
+      double mean=0.0, var=0.0;
+      for(int i=0;i<nsamples;i++){
+	mean+=s[i];
+      }
+      mean/=nsamples;
+      for(int i=0;i<nsamples;i++){
+	var+=(s[i]-mean)*(s[i]-mean);
+      }
+      double std=sqrt(var/(nsamples-1));
+      if(std==0.0) continue; // fixed parameter
+      tested++;
+      MyType out[SUMMARY_NOUTPUTS];
+      summary_finalise(&summaries.summary[v*SUMMARY_VOXEL_SIZE+idpar*SUMMARY_SIZE],out);
+      error_moments=max(error_moments,max(fabs(out[0]-mean),fabs(out[1]-std))/std);
+      for(int k=0;k<SUMMARY_NQUANTILES;k++){
+	error_quantiles[k]+=fabs(out[2+k]-exact_quantile(s,SUMMARY_QUANTILE(k)))/std;
+      }
+    }
+    if(tested==0) continue;
+    bool ok=error_moments<=TEST_SUMMARY_MOMENTS;
+    cout << (idpar<NPARAMS?"Parameter "+to_string(idpar):string("Tau")) << ": maximum error of the mean and std " << error_moments << " std, mean error of the quantiles";
+    for(int k=0;k<SUMMARY_NQUANTILES;k++){
+      error_quantiles[k]/=tested;
+      cout << " " << error_quantiles[k];
+      ok=ok && error_quantiles[k]<=TEST_SUMMARY_QUANTILES;
+    }
+    cout << " std" << (ok?"":" (too large)") << endl;
+    if(!ok) failed++;
+  }
+  return failed>0;
+}
+
+int main(int argc, char *argv[]){
+  if(argc<2){
+    cout << "CUDIMOT" << endl;
+    cout << "Usage:" << endl;
+    cout << "\t" << argv[0] << " tables|lm|grid|dictionary|levels|mcmc|gaussian|summary [CUDIMOT options]" << endl;
+    cout << "Regression tests with a synthetic dataset, run by testRegression.sh" << endl;
+    exit(-1);
+  }
+  string mode(argv[1]);
+
+  // The options are parsed without the mode
+  vector<char*> args;
+  args.push_back(argv[0]);
+  for(int a=2;a<argc;a++){
+    args.push_back(argv[a]);
+  }
+  Log& logger = LogSingleton::getInstance();
+  cudimotOptions& opts = cudimotOptions::getInstance();
+  opts.parse_command_line(args.size(),args.data(),logger);
+  srand(opts.seed.value());
+
+  init_backend();
+  init_tables();
+
+  // get path of this binary to get the priors file
+  char buf[1024];
+  ssize_t count = readlink("/proc/self/exe",buf,sizeof(buf)-1);
+  string bin_path(buf,(count > 0) ? count : 0 );
+  string default_priors_file(bin_path+"_priors");
+  Model<MyType> model(default_priors_file);
+
+  if(mode=="tables"){
+    return 0; // the tables were built and validated by init_tables
+  }
+  if(mode=="lm"){
+    return test_lm(model);
+  }
+  if(mode=="grid"){
+    return write_grid(model);
+  }
+  if(mode=="dictionary"){
+    return test_dictionary(model);
+  }
+  if(mode=="levels"){
+    return test_levels(model);
+  }
+  if(mode=="mcmc"){
+    return test_mcmc(model);
+  }
+  if(mode=="gaussian"){
+    return test_gaussian(model);
+  }
+  if(mode=="summary"){
+    return test_summary(model);
+  }
+  cerr << "CUDIMOT Error: Unknown test '" << mode << "'" << endl;
+  exit(-1);
+}
@@ -0,0 +1,179 @@
+#!/bin/bash
+#
+# Regression tests of a model with a synthetic dataset (see testRegression.cc). Run by "make tests"
+#
+# Usage: testRegression.sh testRegression_modelname modelpriors
+#
+# agent
+#
+# Copyright (C) 2026 University of Oxford
+#
+
+if [ $# -lt 2 ]; then
+    echo "Usage: $0 testRegression_modelname modelpriors"
+    exit 1
+fi
+bin=$1
+priors=$2
+
+tmpdir=`mktemp -d ${TMPDIR:-/tmp}/cudimot_tests.XXXXXX`
+trap "rm -rf $tmpdir" EXIT
+common="--data=synthetic --maskfile=synthetic --outputdir=$tmpdir --ld=$tmpdir/logdir --forcedir --priors=$priors"
+
+failed=0
+report(){
+    # report name status
+    if [ $2 -eq 0 ]; then
+	echo "PASS: $1"
+    else
+	echo "FAIL: $1"
+	failed=1
+    fi
+}
+
+# mcmc_samples name nParts [options]: MCMC of all the parts of the dataset, in $tmpdir/name/samples
+mcmc_samples(){
+    local name=$1
+    local nparts=$2
+    shift 2
+    local dir=$tmpdir/$name
+    mkdir -p $dir
+    : > $dir/samples
+    local part=0 status
+    while [ $part -lt $nparts ]; do
+	mkdir -p $dir/part_$part
+	$bin mcmc $common --partsdir=$dir --idPart=$part --nParts=$nparts --runMCMC "$@" > $dir/log_$part 2>&1
+	status=$?
+	if [ $status -ne 0 ]; then
+	    cat $dir/log_$part
+	    return $status
+	fi
+	cat $dir/part_$part/samples >> $dir/samples
+	part=`expr $part + 1`
+    done
+    return 0
+}
+
+# The tables of the model (--tables) are validated (--validate_tables) below their maximum error
+mkdir -p $tmpdir/tables
+$bin tables $common --partsdir=$tmpdir/tables --idPart=0 --nParts=1 --tables=0.000001 --validate_tables > $tmpdir/tables/log 2>&1
+status=$?
+cat $tmpdir/tables/log
+if grep -q "does not have tabulated functions" $tmpdir/tables/log; then
+    echo "SKIPPED: validation of the tables (the model does not have tabulated functions)"
+else
+    [ $status -eq 0 ] && grep -q "Validation of the table" $tmpdir/tables/log && ! grep -q "above the maximum error" $tmpdir/tables/log
+    report "The tables validated with --validate_tables are below the maximum error of --tables" $?
+fi
+
+# The synthetic dataset can only be built for some models
+$bin mcmc $common --partsdir=$tmpdir --idPart=0 --nParts=1 --runMCMC --backend=cpu --bi=1 --nj=1 --se=1 > $tmpdir/log 2>&1
+if [ $? -eq 77 ]; then
+    cat $tmpdir/log
+    exit 0
+fi
+
+# Levenberg-Marquardt gives fits with the same cost on the GPU and on the CPU
+if nvidia-smi -L > /dev/null 2>&1; then
+    mkdir -p $tmpdir/lm
+    $bin lm $common --partsdir=$tmpdir/lm --idPart=0 --nParts=1 --backend=cuda > $tmpdir/lm/log 2>&1
+    status=$?
+    cat $tmpdir/lm/log
+    report "Levenberg-Marquardt on the GPU and on the CPU gives the same costs" $status
+else
+    echo "SKIPPED: Levenberg-Marquardt on the GPU and on the CPU (no GPU)"
+fi
+
+# The grid of the tests of GridSearch (--gridSearch), around the parameters of the dataset
+mkdir -p $tmpdir/grid
+$bin grid $common --partsdir=$tmpdir/grid --idPart=0 --nParts=1 > $tmpdir/grid/log 2>&1
+cat $tmpdir/grid/log
+grid="--gridSearch=$tmpdir/grid/gridSearch"
+
+# dictionary backend: GridSearch with a dictionary (--dictionary) finds the best combination of the brute-force GridSearch. The dictionary is written to --dictionary_dir and read in a second run, that must give the same parameters
+dictionary(){
+    local dir=$tmpdir/dictionary_$1
+    mkdir -p $dir/files
+    $bin dictionary $common --partsdir=$dir --idPart=0 --nParts=1 --backend=$1 $grid --dictionary --dictionary_dir=$dir/files > $dir/log 2>&1
+    local status=$?
+    cat $dir/log
+    [ $status -eq 0 ] && grep -q "GridSearch dictionary written to" $dir/log && grep -q "GridSearch dictionary: .* read from" $dir/log
+}
+
+dictionary cpu
+report "GridSearch on the CPU with --dictionary gives the combinations of the brute-force GridSearch, also with the dictionary of --dictionary_dir" $?
+if nvidia-smi -L > /dev/null 2>&1; then
+    dictionary cuda
+    report "GridSearch on the GPU with --dictionary gives the combinations of the brute-force GridSearch, also with the dictionary of --dictionary_dir" $?
+else
+    echo "SKIPPED: GridSearch on the GPU with --dictionary (no GPU)"
+fi
+
+# The coarse-to-fine GridSearch (--gridLevels) finds the best combination of the dense grid
+mkdir -p $tmpdir/levels_cpu
+$bin levels $common --partsdir=$tmpdir/levels_cpu --idPart=0 --nParts=1 --backend=cpu $grid --gridLevels=3 > $tmpdir/levels_cpu/log 2>&1
+status=$?
+cat $tmpdir/levels_cpu/log
+report "GridSearch on the CPU with --gridLevels=3 gives the combinations of the dense grid" $status
+if nvidia-smi -L > /dev/null 2>&1; then
+    mkdir -p $tmpdir/levels_gpu
+    $bin levels $common --partsdir=$tmpdir/levels_gpu --idPart=0 --nParts=1 --backend=cuda $grid --gridLevels=3 > $tmpdir/levels_gpu/log 2>&1
+    status=$?
+    cat $tmpdir/levels_gpu/log
+    report "GridSearch on the GPU with --gridLevels=3 gives the combinations of the dense grid" $status
+else
+    echo "SKIPPED: GridSearch on the GPU with --gridLevels (no GPU)"
+fi
+
+# The samples of MCMC on the CPU do not depend on the number of threads or of parts
+mcmc="--backend=cpu --bi=200 --nj=200 --se=4"
+mcmc_samples reference 1 $mcmc --nthreads=1
+report "MCMC on the CPU" $?
+mcmc_samples threads 1 $mcmc --nthreads=4 && cmp -s $tmpdir/reference/samples $tmpdir/threads/samples
+report "MCMC on the CPU with --nthreads=1 and --nthreads=4 gives the same samples" $?
+mcmc_samples parts 3 $mcmc --nthreads=3 && cmp -s $tmpdir/reference/samples $tmpdir/parts/samples
+report "MCMC on the CPU with --nParts=1 and --nParts=3 gives the same samples" $?
+mcmc_samples chains_1 1 $mcmc --nthreads=1 --nchains=2 --sampler=adaptive_block && mcmc_samples chains_3 3 $mcmc --nthreads=2 --nchains=2 --sampler=adaptive_block && cmp -s $tmpdir/chains_1/samples $tmpdir/chains_3/samples
+report "MCMC on the CPU with several chains gives the same samples with any --nthreads and --nParts" $?
+
+# resume name [options]: MCMC with checkpoints (--checkpoint), stopped while half of the checkpoint was written, and resumed (--resume). It must give the same samples as without stopping
+resume(){
+    local name=$1
+    shift
+    mcmc_samples ${name}_reference 1 "$@" || return 1
+    mcmc_samples $name 1 "$@" --checkpoint=0.000001 || return 1
+    local file=$tmpdir/$name/part_0/MCMC_checkpoint
+    local size=`wc -c < $file`
+    truncate -s `expr $size / 2` $file
+    mcmc_samples $name 1 "$@" --checkpoint=0.000001 --resume || return 1
+    cmp -s $tmpdir/${name}_reference/samples $tmpdir/$name/samples
+}
+
+resume resume_cpu $mcmc --nthreads=2 && grep -q "MCMC: [1-9][0-9]* voxels of the part restored" $tmpdir/resume_cpu/log_0
+report "MCMC on the CPU resumed from a checkpoint gives the same samples" $?
+resume resume_cpu_summary $mcmc --nthreads=2 --nchains=2 --rician --summary_only
+report "MCMC on the CPU with --summary_only resumed from a checkpoint gives the same summaries" $?
+if nvidia-smi -L > /dev/null 2>&1; then
+    resume resume_gpu --backend=cuda --bi=200 --nj=200 --se=4
+    report "MCMC on the GPU resumed from a checkpoint gives the same samples" $?
+else
+    echo "SKIPPED: MCMC on the GPU resumed from a checkpoint (no GPU)"
+fi
+
+# HMC and NUTS sample the posterior of each parameter, close to a Gaussian with little noise
+for sampler in hmc nuts; do
+    mkdir -p $tmpdir/gaussian_$sampler/part_0
+    $bin gaussian $common --partsdir=$tmpdir/gaussian_$sampler --idPart=0 --nParts=1 --runMCMC --backend=cpu --sampler=$sampler --nthreads=4 --bi=500 --nj=1000 --se=1 > $tmpdir/gaussian_$sampler/log 2>&1
+    status=$?
+    cat $tmpdir/gaussian_$sampler/log
+    report "MCMC on the CPU with --sampler=$sampler recovers the posterior of the parameters" $status
+done
+
+# The summaries of --summary_only match the samples, and the quantiles estimated with the P-square algorithm are close to the exact ones
+mkdir -p $tmpdir/summary/part_0
+$bin summary $common --partsdir=$tmpdir/summary --idPart=0 --nParts=1 --runMCMC --backend=cpu --nthreads=4 --rician --bi=500 --nj=2000 --se=2 > $tmpdir/summary/log 2>&1
+status=$?
+cat $tmpdir/summary/log
+report "MCMC on the CPU with --summary_only gives the mean, std and quantiles of the samples" $status
+
+exit $failed
@@ -19,8 +19,15 @@ Usage() {
     
 [ "$5" = "" ] && Usage
 
+# Only the CUDA backend needs the GPU queue: with auto (default) the job runs on the GPU of the node if it has one, otherwise on the CPU
+backend="auto"
+for option in "${@:6}"; do
+    case "$option" in
+	--backend=*) backend=${option#--backend=};;
+    esac
+done
 queue=""
-if [ "x$SGE_ROOT" != "x" ]; then
+if [ "x$SGE_ROOT" != "x" ] && [ "$backend" = "cuda" ]; then
 	queue="-q $FSLGECUDAQ"
 fi
 
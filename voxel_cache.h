@@ -0,0 +1,66 @@
+#ifndef CUDIMOT_VOXEL_CACHE_H_INCLUDED
+#define CUDIMOT_VOXEL_CACHE_H_INCLUDED
+
+/*  voxel_cache.h
+
+    Optional per-voxel precomputation of the model functions. Many quantities of a model depend only on the parameters of the voxel (e.g. the fibre orientation, or the spherical harmonic coefficients of a Watson distribution), but Predicted_Signal and Partial_Derivatives are evaluated for every measurement. A model can define in modelparameters.h:
+
+      #define NCACHE n // Number of values precomputed per voxel
+
+    and provide in modelfunctions.h:
+
+      MACRO void Prepare_Voxel(T* P, T* FixP, T* cache);
+      MACRO T Predicted_Signal(int npar, T* P, T* CFP, T* FixP, T* cache);
+      MACRO void Partial_Derivatives(int npar, T* P, T* CFP, T* FixP, T* cache, T* derivatives);
+
+    The engines call Prepare_Voxel once each time the parameters of a voxel change, and pass its output to the functions with cache for all the measurements. The functions without cache (used by NUMERICAL, AUTODIFF and testFunctions) are defined here: they prepare the cache and call the functions with cache.
+
+    If the model does not define NCACHE, the functions with cache are defined here and call the functions without cache of the model.
+
+    It is included by macro_numerical.h
+
+    agent
+
+    Copyright (C) 2026 University of Oxford  */
+
+/*  CCOPYRIGHT  */
+
+#ifdef NCACHE
+
+MACRO void Prepare_Voxel(T* P, T* FixP, T* cache);
+MACRO T Predicted_Signal(int npar, T* P, T* CFP, T* FixP, T* cache);
+MACRO void Partial_Derivatives(int npar, T* P, T* CFP, T* FixP, T* cache, T* derivatives);
+
+MACRO T Predicted_Signal(int npar, T* P, T* CFP, T* FixP){
+  T cache[NCACHE];
+  Prepare_Voxel(P,FixP,cache);
+  return Predicted_Signal(npar,P,CFP,FixP,cache);
+}
+
+MACRO void Partial_Derivatives(int npar, T* P, T* CFP, T* FixP, T* derivatives){
+  T cache[NCACHE];
+  Prepare_Voxel(P,FixP,cache);
+  Partial_Derivatives(npar,P,CFP,FixP,cache,derivatives);
+}
+
+#define CACHE_SIZE NCACHE
+
+#else
+
+MACRO void Partial_Derivatives(int npar, T* P, T* CFP, T* FixP, T* derivatives);
+
+MACRO void Prepare_Voxel(T* P, T* FixP, T* cache){}
+
+MACRO T Predicted_Signal(int npar, T* P, T* CFP, T* FixP, T* cache){
+  return Predicted_Signal(npar,P,CFP,FixP);
+}
+
+MACRO void Partial_Derivatives(int npar, T* P, T* CFP, T* FixP, T* cache, T* derivatives){
+  Partial_Derivatives(npar,P,CFP,FixP,derivatives);
+}
+
+#define CACHE_SIZE 1 // Size of the arrays of the engines (not used)
+
+#endif
+
+#endif
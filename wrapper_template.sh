@@ -15,12 +15,14 @@ Usage() {
     echo ""
     echo "<options>:"
     echo "-waitfor (job_ID)"
-    echo "-Q (name of the GPU(s) queue, default cuda.q (defined in environment variable: FSLGECUDAQ)"
+    echo "-Q (name of the queue. With --backend=cuda the GPU(s) queue is used, default cuda.q (defined in environment variable: FSLGECUDAQ)"
     echo "-NJOBS (number of jobs to queue, the data is divided in NJOBS parts, usefull for a GPU cluster, default 4)"
     echo "--no_LevMar (Do not run Levenberg-Marquardt)"
     echo "--runMCMC (Run MCMC)"
     echo "--CFP=filePath (Specify path of the file with the list of common fixed parameters ascii files)"
     echo "--FixP=filePath (Specify path of the file with the list of fixed parameters NIfTI files)"
+    echo "--backend=cpu|cuda|auto (Hardware for the fitting routines, default auto: the GPU if the node has one, otherwise the CPU)"
+    echo "--nthreads=N (Number of threads of the CPU backend, default all the available cores)"
     echo "-b (burnin period, default 5000)"
     echo "-j (number of jumps, default 1250)"
     echo "-s (sample every, default 25)"
@@ -65,6 +67,7 @@ sampleevery=25
 other=""
 queue=""
 wait=""
+backend="auto"
 
 shift
 while [ ! -z "$1" ]
@@ -76,6 +79,7 @@ do
       -b) burnin=$2;shift;;
       -j) njumps=$2;shift;;
       -s) sampleevery=$2;shift;;
+      --backend=*) backend=${1#--backend=};other=$other" "$1;;
       *) other=$other" "$1;;
   esac
   shift
@@ -85,7 +89,8 @@ done
 opts="--bi=$burnin --nj=$njumps --se=$sampleevery"
 opts="$opts $other"
 
-if [ $qsys -eq 0 ] && [ "x$SGE_ROOT" != "x" ]; then
+# Only the CUDA backend needs the GPU queue: with auto the job runs on the GPU of the node if it has one, otherwise on the CPU
+if [ $qsys -eq 0 ] && [ "x$SGE_ROOT" != "x" ] && [ "$backend" = "cuda" ]; then
 	queue="-q $FSLGECUDAQ"
 fi
 